@@ -168,6 +168,8 @@ typedef struct fbUDPConnSpec_st {
     uint32_t                  obdomain;
     /** reject flag */
     gboolean                  reject;
+    /** counters for this peer; see fbCollectorEnableUDPStats() */
+    fbCollectorStats_t        stats;
 } fbUDPConnSpec_t;
 
 
@@ -347,6 +349,19 @@ uint16_t
 fBufGetInternalTemplate(
     fBuf_t  *fbuf);
 
+/**
+ * fBufSetSharedInfoModel
+ *
+ * Marks the information model of `fbuf` as shared with other threads.
+ * The buffer then skips RFC 5610 information element type records rather
+ * than add their elements to the model, which the caller must have done
+ * before the threads started.  Used by fbParallelReaderRun().
+ *
+ */
+void
+fBufSetSharedInfoModel(
+    fBuf_t  *fbuf);
+
 /**
  * fbInfoElementHash
  *
@@ -571,6 +586,24 @@ fbSession_t *
 fbSessionClone(
     fbSession_t  *base);
 
+/**
+ * fbSessionCopyExternalTemplates
+ *
+ * Adds the external templates of every observation domain of `base` to
+ * `session`, copies the metadata export settings, and leaves `session`
+ * in the current domain of `base`.
+ *
+ * @param session
+ * @param base
+ * @param err
+ *
+ */
+gboolean
+fbSessionCopyExternalTemplates(
+    fbSession_t  *session,
+    fbSession_t  *base,
+    GError      **err);
+
 /**
  * fbSessionGetSequence
  *
@@ -606,6 +639,47 @@ fbSessionSetTemplateBuffer(
     fbSession_t  *session,
     fBuf_t       *fbuf);
 
+/**
+ * fbSessionGetTemplateSets
+ *
+ * Gets the external templates of the current domain encoded as a
+ * sequence of template and options template sets, none longer than
+ * `maxlen`, for use by template refresh.  The encoding is cached on the
+ * session until the external template table changes.
+ *
+ * @param session
+ * @param maxlen maximum length of a single set
+ * @param sets set to the encoded sets, owned by the session
+ * @param setslen set to the total length of the encoded sets
+ * @param err
+ *
+ */
+gboolean
+fbSessionGetTemplateSets(
+    fbSession_t     *session,
+    uint16_t         maxlen,
+    const uint8_t  **sets,
+    size_t          *setslen,
+    GError         **err);
+
+/**
+ * fbSessionReplayTemplates
+ *
+ * Does a full template export, including RFC 5610 metadata if enabled,
+ * in each observation domain of the session, emitting each domain's
+ * messages before moving to the next, and restores the current domain.
+ * Used to start the new file of a rotating exporter; the delta export
+ * records are reset to match.
+ *
+ * @param session
+ * @param err
+ *
+ */
+gboolean
+fbSessionReplayTemplates(
+    fbSession_t  *session,
+    GError      **err);
+
 /**
  * fbSessionSetCollector
  *
@@ -671,44 +745,21 @@ fbSessionGetGroup(
 #endif /* if HAVE_SPREAD */
 
 /**
- * fbSessionClearIntTmplTableFlag
+ * fbSessionGetTemplateGeneration
  *
- * @param session
- *
- */
-void
-fbSessionClearIntTmplTableFlag(
-    fbSession_t  *session);
-
-/**
- * fbSessionClearExtTmplTableFlag
- *
- * @param session
- *
- */
-void
-fbSessionClearExtTmplTableFlag(
-    fbSession_t  *session);
-
-/**
- * fbSessionIntTmplTableFlagIsSet
- *
- * @param session
- *
- */
-int
-fbSessionIntTmplTableFlagIsSet(
-    fbSession_t  *session);
-
-/**
- * fbSessionExtTmplTableFlagIsSet
+ * Returns the generation of the session's internal template table when
+ * `internal` is TRUE or of its current external template table otherwise.
+ * The generation changes whenever a template is added to or removed from
+ * the table, or the external table is switched to another domain.
  *
  * @param session
+ * @param internal
  *
  */
-int
-fbSessionExtTmplTableFlagIsSet(
-    fbSession_t  *session);
+uint32_t
+fbSessionGetTemplateGeneration(
+    fbSession_t  *session,
+    gboolean      internal);
 
 /**
  * fbConnSpecLookupAI
@@ -840,6 +891,64 @@ uint16_t
 fbExporterGetMTU(
     fbExporter_t  *exporter);
 
+/**
+ * fbExporterRotationDue
+ *
+ * Counts `records` against the current file of a rotating exporter.
+ *
+ * @param exporter
+ * @param records
+ * @return TRUE if the exporter should move to its next file now
+ *
+ */
+gboolean
+fbExporterRotationDue(
+    fbExporter_t  *exporter,
+    uint32_t       records);
+
+/**
+ * fbExporterRotate
+ *
+ * Moves a rotating exporter to its next file, which is opened by the next
+ * message exported.  The previous file is closed on another thread.
+ * Returns FALSE if messages could not be written to the previous file;
+ * the exporter has still moved to the next file.
+ *
+ * @param exporter
+ * @param err
+ *
+ */
+gboolean
+fbExporterRotate(
+    fbExporter_t  *exporter,
+    GError       **err);
+
+/**
+ * fbExporterTemplateRefreshDue
+ *
+ * Counts one message against the exporter's template refresh interval.
+ *
+ * @param exporter
+ * @return TRUE if the cached templates should be resent now
+ *
+ */
+gboolean
+fbExporterTemplateRefreshDue(
+    fbExporter_t  *exporter);
+
+/**
+ * fbExporterResetTemplateRefresh
+ *
+ * Restarts the template refresh interval, e.g. after a full template
+ * export.  Accepts NULL.
+ *
+ * @param exporter
+ *
+ */
+void
+fbExporterResetTemplateRefresh(
+    fbExporter_t  *exporter);
+
 /**
  * fbExportMessage
  *
@@ -856,6 +965,26 @@ fbExportMessage(
     size_t         msglen,
     GError       **err);
 
+/**
+ * fbExportMessageBuffer
+ *
+ * Exports the first `msglen` octets of `msgbuf`.  An asynchronous
+ * exporter keeps a reference to the buffer until the message is written
+ * instead of copying it.
+ *
+ * @param exporter
+ * @param msgbuf
+ * @param msglen
+ * @param err
+ *
+ */
+gboolean
+fbExportMessageBuffer(
+    fbExporter_t       *exporter,
+    fbMessageBuffer_t  *msgbuf,
+    size_t              msglen,
+    GError            **err);
+
 /**
  * fbExporterFree
  *
@@ -919,6 +1048,82 @@ fbCollectorAllocTLS(
     size_t            peerlen,
     GError          **err);
 
+/**
+ * fbCollectorAllocFileRange
+ *
+ * Allocates a collector that reads the `prefix_len` octets of whole
+ * messages at `prefix`, then `length` octets of the file at `path`
+ * starting at `offset`, which must begin a message.  The collector takes
+ * ownership of `prefix`, which must be allocated with g_malloc().
+ *
+ * @param ctx
+ * @param path
+ * @param offset
+ * @param length
+ * @param prefix
+ * @param prefix_len
+ * @param err
+ *
+ */
+fbCollector_t *
+fbCollectorAllocFileRange(
+    void        *ctx,
+    const char  *path,
+    uint64_t     offset,
+    uint64_t     length,
+    uint8_t     *prefix,
+    size_t       prefix_len,
+    GError     **err);
+
+/**
+ * fbCollectorNoteSequenceGap
+ *
+ * Counts a message whose sequence number `received` is not the
+ * `expected` one, for the collector and its current UDP peer.
+ *
+ * @param collector
+ * @param expected
+ * @param received
+ *
+ */
+void
+fbCollectorNoteSequenceGap(
+    fbCollector_t  *collector,
+    uint32_t        expected,
+    uint32_t        received);
+
+/**
+ * fbCollectorIsMapped
+ *
+ * Returns TRUE if the collector reads a memory-mapped file and its messages
+ * should be read in place with fbCollectMappedMessage().
+ *
+ * @param collector
+ *
+ */
+gboolean
+fbCollectorIsMapped(
+    fbCollector_t  *collector);
+
+/**
+ * fbCollectMappedMessage
+ *
+ * Sets `msgbase` to the next message in a memory-mapped collector's file
+ * and `msglen` to its length.
+ *
+ * @param collector
+ * @param msgbase
+ * @param msglen
+ * @param err
+ *
+ */
+gboolean
+fbCollectMappedMessage(
+    fbCollector_t  *collector,
+    uint8_t       **msgbase,
+    size_t         *msglen,
+    GError        **err);
+
 /**
  * fbCollectMessage
  *
@@ -936,14 +1141,19 @@ fbCollectMessage(
     GError        **err);
 
 /**
- * fbCollectorGetFD
+ * fbCollectorHasPendingMessages
  *
- * @param collector
+ * Returns TRUE if a UDP collector with batching enabled holds datagrams,
+ * a TCP collector's read-ahead buffer holds a complete message, or the
+ * ring of a collector with a read-ahead thread holds a message, that have
+ * been received but not yet read by its fBuf.  Also TRUE once the
+ * read-ahead thread has stopped, so its error is read.
  *
+ * @param collector
  *
  */
-int
-fbCollectorGetFD(
+gboolean
+fbCollectorHasPendingMessages(
     fbCollector_t  *collector);
 
 /**
@@ -1093,4 +1303,182 @@ fbListenerSetPeerSession(
     fbListener_t  *listener,
     fbSession_t   *session);
 
+/** Compression codecs of file collectors and exporters */
+typedef enum fbCompressCodec_en {
+    FB_COMPRESS_NONE = 0,
+    FB_COMPRESS_GZIP,
+    FB_COMPRESS_ZSTD
+} fbCompressCodec_t;
+
+/**
+ * A compressed file stream whose codec runs on a helper thread.  See
+ * fbcompress.c.
+ */
+typedef struct fbCompressStream_st fbCompressStream_t;
+
+/**
+ * fbCompressCodecForPath
+ *
+ * Returns the codec named by the extension of `path`: ".gz" or ".zst".
+ *
+ * @param path
+ *
+ */
+fbCompressCodec_t
+fbCompressCodecForPath(
+    const char  *path);
+
+/**
+ * fbCompressCodecForStream
+ *
+ * Returns the codec whose magic number begins the data in `fp`, without
+ * consuming any of it.
+ *
+ * @param fp
+ *
+ */
+fbCompressCodec_t
+fbCompressCodecForStream(
+    FILE  *fp);
+
+/**
+ * fbCompressStreamAlloc
+ *
+ * Starts a helper thread that decompresses `fp` for
+ * fbCompressStreamRead(), or compresses the data given to
+ * fbCompressStreamWrite() into `fp` when `writing` is TRUE.  The caller
+ * keeps ownership of `fp`.
+ *
+ * @param fp
+ * @param codec
+ * @param writing
+ * @param err
+ *
+ */
+fbCompressStream_t *
+fbCompressStreamAlloc(
+    FILE               *fp,
+    fbCompressCodec_t   codec,
+    gboolean            writing,
+    GError            **err);
+
+/**
+ * fbCompressStreamRead
+ *
+ * Copies up to `len` octets of decompressed data to `buf` and sets `got`
+ * to the number copied, which is less than `len` only at end of file.
+ *
+ * @param stream
+ * @param buf
+ * @param len
+ * @param got
+ * @param err
+ *
+ */
+gboolean
+fbCompressStreamRead(
+    fbCompressStream_t  *stream,
+    uint8_t             *buf,
+    size_t               len,
+    size_t              *got,
+    GError             **err);
+
+/**
+ * fbCompressStreamWrite
+ *
+ * Queues `len` octets at `buf` for compression.
+ *
+ * @param stream
+ * @param buf
+ * @param len
+ * @param err
+ *
+ */
+gboolean
+fbCompressStreamWrite(
+    fbCompressStream_t  *stream,
+    const uint8_t       *buf,
+    size_t               len,
+    GError             **err);
+
+/**
+ * fbCompressStreamFlush
+ *
+ * Compresses and writes all queued data so a reader of the file can
+ * decode everything written so far.
+ *
+ * @param stream
+ * @param err
+ *
+ */
+gboolean
+fbCompressStreamFlush(
+    fbCompressStream_t  *stream,
+    GError             **err);
+
+/**
+ * fbCompressStreamFree
+ *
+ * Stops the helper thread, first ending the compressed data of a writing
+ * stream, and frees the stream.  Does not close the file.  Returns FALSE
+ * if the compressed data could not be completed.
+ *
+ * @param stream
+ * @param err
+ *
+ */
+gboolean
+fbCompressStreamFree(
+    fbCompressStream_t  *stream,
+    GError             **err);
+
+/**
+ * fbBufferPoolRef
+ *
+ * Adds a reference to `pool` and returns it.
+ *
+ * @param pool
+ *
+ */
+fbBufferPool_t *
+fbBufferPoolRef(
+    fbBufferPool_t  *pool);
+
+/**
+ * fbMessageBufferAllocSize
+ *
+ * Allocates a message buffer of `capacity` octets that does not belong to
+ * a pool.  The caller holds the only reference.
+ *
+ * @param capacity
+ *
+ */
+fbMessageBuffer_t *
+fbMessageBufferAllocSize(
+    size_t   capacity);
+
+/**
+ * fbMessageBufferGetPool
+ *
+ * Returns the pool `msgbuf` returns to when released, or NULL.
+ *
+ * @param msgbuf
+ *
+ */
+fbBufferPool_t *
+fbMessageBufferGetPool(
+    const fbMessageBuffer_t  *msgbuf);
+
+/**
+ * fbMessageBufferIsShared
+ *
+ * Returns TRUE if `msgbuf` has more than one reference.
+ *
+ * @param msgbuf
+ *
+ */
+gboolean
+fbMessageBufferIsShared(
+    fbMessageBuffer_t  *msgbuf);
+
 #endif /* ifndef _FB_PRIVATE_H_ */
@@ -1187,7 +1187,9 @@ extern "C" {
 #define FB_ERROR_IO                 7
 /**
  * No data is available for reading from the transport layer.
- * Either a transport layer read was interrupted, or timed out.
+ * Either a transport layer read was interrupted, or timed out, or the
+ * collector is non-blocking and has no data (see
+ * fbCollectorSetNonBlocking()).
  */
 #define FB_ERROR_NLREAD             8
 /**
@@ -1250,7 +1252,8 @@ typedef struct fbVarfield_st {
      * Content buffer. In network byte order as appropriate. On write, this
      * buffer will be copied into the message buffer. On read, this buffer
      * points into the message buffer and must be copied by the caller before
-     * any call to fBufNext().
+     * any call to fBufNext(), unless the caller keeps the message with
+     * fBufRetainCurrentMessage().
      */
     uint8_t  *buf;
 } fbVarfield_t;
@@ -1889,6 +1892,23 @@ typedef enum fbTransport_en {
     FB_DTLS_UDP
 } fbTransport_t;
 
+/**
+ * Selects how a collector or exporter performs its socket I/O.  See
+ * fbCollectorSetIOBackend(), fbExporterSetIOBackend(), and
+ * fbListenerSetIOBackend().
+ *
+ * @since libfixbuf 2.6.0
+ */
+typedef enum fbIOBackend_en {
+    /** Use read(), write(), and friends directly.  The default. */
+    FB_IO_SYSCALL = 0,
+    /**
+     * Use Linux io_uring to submit reads and writes.  Only available if
+     * fixbuf was built with liburing support.
+     */
+    FB_IO_URING = 1
+} fbIOBackend_t;
+
 /**
  * Connection specifier. Used to define a peer address for @ref
  * fbExporter_t, or a passive address for @ref fbListener_t.
@@ -4722,6 +4742,7 @@ fbSessionExportTemplate(
  * records are also exported.
  *
  * All external templates are exported each time this function is called.
+ * Use fbSessionExportTemplatesDelta() to export only what has changed.
  *
  * @param session   a session state container associated with an export buffer
  * @param err       an error description, set on failure.
@@ -4735,6 +4756,37 @@ fbSessionExportTemplates(
     fbSession_t  *session,
     GError      **err);
 
+/**
+ * Exports the external templates and metadata in the current domain of a
+ * given session that have not yet been exported to the exporter of the
+ * associated export buffer.  Otherwise behaves like
+ * fbSessionExportTemplates().
+ *
+ * The session tracks, per observation domain, every external template
+ * added, replaced, or removed since the last export, whether or not an
+ * exporter was attached at the time, and the information elements whose
+ * type metadata has been exported.  A delta export writes withdrawals of
+ * the removed templates, then the added and replaced templates with their
+ * template metadata records, and type metadata records for elements added
+ * to the information model since the last export.  This suits a periodic
+ * template refresh.
+ *
+ * When no full export has succeeded in the current domain since the
+ * session's export buffer was set, this function performs a full export.
+ * A new transport connection needs a full export; call
+ * fbSessionExportTemplates() after an exporter reconnects.
+ *
+ * @param session   a session state container associated with an export buffer
+ * @param err       an error description, set on failure.
+ * @return TRUE on success, FALSE on failure.
+ * @since libfixbuf 2.6.0
+ */
+
+gboolean
+fbSessionExportTemplatesDelta(
+    fbSession_t  *session,
+    GError      **err);
+
 /**
  * Adds a template to a session. If external, adds the template to the current
  * domain, and exports the template if the session is associated with an
@@ -4862,6 +4914,13 @@ fbExporterAllocSpread(
  * file will not be opened until the first message is emitted from the
  * buffer associated with the exporter.
  *
+ * If `path` ends in ".gz" or ".zst", the file is written compressed with
+ * gzip or zstd by a helper thread, so compression overlaps with encoding.
+ * The compressed data is completed when the exporter is closed; use
+ * fbExporterFlush() to make everything exported so far readable before
+ * then.  Opening fails if libfixbuf was built without support for the
+ * codec (since libfixbuf 2.6.0).
+ *
  * @param path      pathname of the IPFIX File to write, or "-" to
  *                  open standard output.  Path is duplicated and handled.
  *                  Original pointer is up to the user.
@@ -4934,6 +4993,39 @@ void
 fbExporterAutoStream(
     fbExporter_t  *exporter);
 
+/**
+ * Enables periodic template refresh on an exporting process endpoint. When
+ * enabled, the external templates of the session's current observation
+ * domain are resent after a data message is emitted by fBufEmit() once
+ * `interval` seconds have passed or `msg_count` messages have been exported
+ * since the last refresh (or since the last call to
+ * fbSessionExportTemplates()), as RFC 7011 recommends for UDP transport.
+ *
+ * The template sets are encoded once and cached by the session until its
+ * external templates change; a refresh writes them in separate messages at
+ * a message boundary and does not disturb the record stream or the
+ * message sequence numbers.  Template and information element metadata
+ * records are not part of a refresh.  Since the data message has already
+ * been exported, a refresh that fails (for example, because a template
+ * does not fit in the exporter's MTU) is logged as a warning and does not
+ * make fBufEmit() fail; the next refresh tries again.
+ *
+ * Template refresh is disabled by default.  Pass 0 for both `interval` and
+ * `msg_count` to disable it.
+ *
+ * @param exporter  an exporting process endpoint.
+ * @param interval  seconds between template refreshes, or 0 to not
+ *                  refresh by time.
+ * @param msg_count messages between template refreshes, or 0 to not
+ *                  refresh by message count.
+ * @since libfixbuf 2.6.0
+ */
+void
+fbExporterSetTemplateRefresh(
+    fbExporter_t  *exporter,
+    uint32_t       interval,
+    uint32_t       msg_count);
+
 /**
  * Forces the file or socket underlying an exporting process endpoint to close.
  * No effect on open file endpoints. The file or socket may be reopened on a
@@ -4945,6 +5037,321 @@ void
 fbExporterClose(
     fbExporter_t  *exporter);
 
+/**
+ * Selects the I/O backend used by a TCP or UDP exporter.  With
+ * FB_IO_URING, each message emitted by fBufEmit() is copied into a ring of
+ * MTU-sized slots and queued.  The queued sends are submitted through
+ * io_uring together, as one system call, once 16 messages or 64 KiB are
+ * queued, when every slot is occupied, and by fbExporterFlush() and
+ * fbExporterClose(); the caller does not wait for them to complete unless
+ * every slot is occupied.  An error from an earlier send is reported by a
+ * later fBufEmit() or by fbExporterFlush().  Use fbExporterFlush() to send
+ * the queued messages and wait for them.
+ *
+ * @param exporter  a TCP or UDP exporting process endpoint.
+ * @param backend   the I/O backend to use
+ * @param err       An error description, set on failure.
+ * @return TRUE on success.  FALSE if the exporter is not a plain TCP or
+ *         UDP exporter or fixbuf was built without liburing support.
+ * @since libfixbuf 2.6.0
+ */
+gboolean
+fbExporterSetIOBackend(
+    fbExporter_t   *exporter,
+    fbIOBackend_t   backend,
+    GError        **err);
+
+/**
+ * Enables batched sends on a UDP exporter.  By default each message
+ * emitted by fBufEmit() is sent with its own system call.  When `count`
+ * is greater than 1, messages are instead queued and sent together once
+ * `count` messages are queued, once fewer than an MTU of the `bytes`
+ * octets of queue space are left, or when fbExporterFlush() is called.
+ *
+ * Where the kernel supports UDP generic segmentation offload, a batch
+ * whose messages all have the same length, except for a shorter last
+ * one, is passed to the kernel in a single send that it splits into one
+ * datagram per message.  Other batches are sent with sendmmsg(), or with
+ * one send per message on platforms without it.  Datagrams leave in the
+ * order their messages were emitted, so sequence numbers stay in order.
+ * As with unbatched UDP export, a failed send is logged once and the
+ * messages are lost.
+ *
+ * A low-rate exporter should call fbExporterFlush() periodically, since
+ * a message waits in the queue until the batch fills.  Closing the
+ * exporter flushes it.  Selecting an I/O backend with
+ * fbExporterSetIOBackend() turns batching off.
+ *
+ * @param exporter  a UDP exporting process endpoint.
+ * @param count     the number of messages that fill a batch, at most 64;
+ *                  0 or 1 disables batching
+ * @param bytes     the octets of queue space; 0 for the default of 65000.
+ *                  Must be at least the exporter's MTU and at most 65535.
+ * @param err       An error description, set on failure.
+ * @return TRUE on success.  FALSE if the exporter is not a plain UDP
+ *         exporter, uses io_uring, or a parameter is out of range.
+ * @since libfixbuf 2.6.0
+ */
+gboolean
+fbExporterSetUDPBatch(
+    fbExporter_t  *exporter,
+    unsigned int   count,
+    size_t         bytes,
+    GError       **err);
+
+/**
+ * Enables write coalescing on a TCP, TLS over TCP, or uncompressed file
+ * exporter.  By default each message emitted by fBufEmit() is written to
+ * the stream on its own, which costs a system call per message when the
+ * messages are small.  With coalescing, messages are gathered in a buffer
+ * of `bytes` octets and written with a single call when the next message
+ * would not fit, when the buffer is full, when the oldest message in it
+ * has waited `max_delay_ms` milliseconds, or on fbExporterFlush().
+ * Closing the exporter writes the buffer.  A message larger than the
+ * buffer is written on its own, after any gathered messages.
+ *
+ * When `max_delay_ms` is not 0, a thread writes the buffer once its
+ * oldest message is due, so the delay holds even when the application
+ * stops emitting.  A write error is reported by the fBufEmit() or
+ * fbExporterFlush() that triggered the write, or for a write made by that
+ * thread, by the next fBufEmit() or fbExporterFlush(); the gathered
+ * messages are lost.  Selecting an I/O backend with
+ * fbExporterSetIOBackend() turns coalescing off.
+ *
+ * @param exporter      a TCP, TLS over TCP, or file exporting process
+ *                      endpoint.
+ * @param bytes         the size of the buffer; 0 disables coalescing
+ * @param max_delay_ms  the longest a message may wait in the buffer, in
+ *                      milliseconds; 0 for no limit
+ * @param err           An error description, set on failure.
+ * @return TRUE on success.  FALSE if the exporter's transport does not
+ *         support coalescing, the exporter uses io_uring, or the flush
+ *         thread cannot be started.
+ * @since libfixbuf 2.6.0
+ */
+gboolean
+fbExporterSetCoalesce(
+    fbExporter_t  *exporter,
+    size_t         bytes,
+    uint32_t       max_delay_ms,
+    GError       **err);
+
+/**
+ * What an asynchronous exporter does with a message emitted while its
+ * ring is full.  See fbExporterEnableAsync().
+ *
+ * @since libfixbuf 2.6.0
+ */
+typedef enum fbAsyncPolicy_en {
+    /** Wait for the export thread to free a slot.  The default. */
+    FB_ASYNC_BLOCK = 0,
+    /**
+     * Discard the message.  Messages holding templates are never
+     * discarded; they wait as with FB_ASYNC_BLOCK.
+     */
+    FB_ASYNC_DROP_NEWEST = 1,
+    /**
+     * Append the message, and every later one until the export thread
+     * catches up, to a spill file that the thread writes out once the
+     * ring is empty.
+     */
+    FB_ASYNC_SPILL = 2
+} fbAsyncPolicy_t;
+
+/**
+ * Counters of an asynchronous exporter.  See fbExporterGetAsyncStats().
+ *
+ * @since libfixbuf 2.6.0
+ */
+typedef struct fbExporterAsyncStats_st {
+    /** Messages put in the ring */
+    uint64_t   queued;
+    /** Messages the export thread wrote, from the ring or the spill file */
+    uint64_t   written;
+    /** Messages that waited for a free slot */
+    uint64_t   blocked;
+    /** Messages discarded by FB_ASYNC_DROP_NEWEST */
+    uint64_t   dropped;
+    /** Messages appended to the spill file */
+    uint64_t   spilled;
+    /** Messages the export thread failed to write */
+    uint64_t   write_errors;
+} fbExporterAsyncStats_t;
+
+/**
+ * Starts a thread that performs the transport writes of an exporter.
+ * Afterward fBufEmit() puts a reference to the finished message in a
+ * ring of `slots` entries and returns; the fBuf writes its next message
+ * into a new message buffer, so give the fBuf a pool with
+ * fBufSetBufferPool() to avoid an allocation per message.  The thread
+ * writes the messages in the order they were emitted and reopens the
+ * stream after a failure as a synchronous exporter would.  An error from
+ * a write is reported by the next fBufEmit() or fbExporterFlush().
+ *
+ * When the ring is full, `policy` decides whether fBufEmit() waits,
+ * discards the message, or appends it to the file at `spill_path`, which
+ * is created or truncated now and removed when the exporter is freed.
+ *
+ * fbExporterFlush() and fbExporterClose() first wait for the thread to
+ * write every queued and spilled message, as do the functions that
+ * change how the exporter writes.  Asynchronous export stays enabled
+ * until the exporter is freed.  Only the thread that emits messages may
+ * call functions on the exporter.
+ *
+ * @param exporter      an exporting process endpoint that does not write
+ *                      to a buffer
+ * @param slots         the number of messages the ring holds; 0 for the
+ *                      default of 64
+ * @param policy        what to do with a message when the ring is full
+ * @param spill_path    the spill file for FB_ASYNC_SPILL; ignored
+ *                      otherwise
+ * @param err           An error description, set on failure.
+ * @return TRUE on success.  FALSE if asynchronous export is already
+ *         enabled, the exporter writes to a buffer, the spill file cannot
+ *         be created, or the thread cannot be started.
+ * @since libfixbuf 2.6.0
+ */
+gboolean
+fbExporterEnableAsync(
+    fbExporter_t     *exporter,
+    unsigned int      slots,
+    fbAsyncPolicy_t   policy,
+    const char       *spill_path,
+    GError          **err);
+
+/**
+ * Copies the counters of an asynchronous exporter into `stats`.  The copy
+ * is consistent and may be taken from any thread while the export thread
+ * runs.
+ *
+ * @param exporter  an exporting process endpoint
+ * @param stats     filled with the counters
+ * @return TRUE on success, FALSE if asynchronous export is not enabled.
+ * @since libfixbuf 2.6.0
+ */
+gboolean
+fbExporterGetAsyncStats(
+    fbExporter_t            *exporter,
+    fbExporterAsyncStats_t  *stats);
+
+/**
+ * Makes a file exporter write a series of files, moving to the next file
+ * once the current one has received `max_bytes` octets or `max_records`
+ * records, or at each multiple of `interval` seconds since the UNIX
+ * epoch, whichever comes first.  Limits that are 0 are not used.  The
+ * checks are made when fBufEmit() finishes a message, so a file is never
+ * split within a message and an idle exporter keeps its file open.
+ *
+ * File names come from `pattern`, expanded by strftime() with the UTC
+ * time the file is started, after `%N` is replaced by the number of the
+ * file, counting from 0.  A pattern with neither time conversions nor
+ * `%N` reuses one name and overwrites the file.  The pattern must end in
+ * the same compression suffix (".gz", ".zst", or none) as the exporter's
+ * path.  If the exporter has not opened its file yet, the first file is
+ * named from the pattern as well; otherwise the open file is the first of
+ * the series.
+ *
+ * Each new file starts with the external templates of every observation
+ * domain of the session, each domain in messages with its own header,
+ * along with the RFC 5610 metadata enabled by
+ * fbSessionSetMetadataExportElements() and
+ * fbSessionSetMetadataExportTemplates(), so every file can be read on its
+ * own; fbSessionExportTemplatesDelta() then sends only what changes
+ * after that.  A failure to write these templates is logged and does not
+ * fail the fBufEmit() that started the file.
+ * The finished file is completed and closed on a separate thread.  On an
+ * asynchronous exporter, the export thread makes the switch after writing
+ * the messages queued before it, so fBufEmit() does not wait for them.
+ *
+ * @param exporter      a file exporting process endpoint, not stdout
+ * @param pattern       the pattern of file names, or NULL to stop rotating
+ *                      and keep writing the current file
+ * @param max_bytes     octets per file, or 0
+ * @param max_records   records per file, or 0
+ * @param interval      seconds per file, or 0
+ * @param err           An error description, set on failure.
+ * @return TRUE on success.  FALSE if the exporter does not write a file
+ *         or `pattern` is unusable.
+ * @since libfixbuf 2.6.0
+ */
+gboolean
+fbExporterSetRotation(
+    fbExporter_t  *exporter,
+    const char    *pattern,
+    uint64_t       max_bytes,
+    uint64_t       max_records,
+    uint32_t       interval,
+    GError       **err);
+
+/**
+ * Allocates a fan-out exporter, which writes every message it is given to
+ * each of its children, added by fbExporterAddFanoutChild().  A buffer
+ * using a fan-out exporter encodes each message once, however many
+ * destinations receive it.
+ *
+ * Each child opens on the first message and fails on its own.  A child
+ * whose write fails is closed and then skipped, missing messages, for one
+ * second; after each further failure the wait doubles, up to 64 seconds.
+ * The first message after the wait reopens the child, which for a
+ * connection-oriented transport reconnects to the collector.  The
+ * fan-out exporter keeps the template records of the messages it writes,
+ * for every observation domain, along with the latest RFC 5610
+ * information element type record for each element and the latest
+ * template metadata record for each template, and writes them to a
+ * reopened child, and to that child only, before the message that
+ * reopened it.  Failures and recoveries are logged.  fBufEmit() fails
+ * only when no child takes a message.
+ *
+ * The fan-out exporter's MTU is the smallest of its children's.  Template
+ * refresh (fbExporterSetTemplateRefresh()) and asynchronous export
+ * (fbExporterEnableAsync()) may be set on the fan-out exporter; file
+ * rotation and template refresh set on a child are not applied.  Freeing
+ * or closing the fan-out exporter frees or closes its children.
+ *
+ * @return a new fan-out exporter with no children
+ * @since libfixbuf 2.6.0
+ */
+fbExporter_t *
+fbExporterAllocFanout(
+    void);
+
+/**
+ * Adds a child to a fan-out exporter created by fbExporterAllocFanout().
+ * The fan-out exporter takes ownership of `child`, which must not be used
+ * on its own or added elsewhere afterward.  Children should be added
+ * before the first message is emitted, since the MTU of the fan-out
+ * exporter may shrink.
+ *
+ * @param exporter  a fan-out exporting process endpoint
+ * @param child     the exporter to add; not a buffer exporter
+ * @param err       An error description, set on failure.
+ * @return TRUE on success.  FALSE if `exporter` is not a fan-out exporter
+ *         or `child` cannot be added; the caller keeps `child`.
+ * @since libfixbuf 2.6.0
+ */
+gboolean
+fbExporterAddFanoutChild(
+    fbExporter_t  *exporter,
+    fbExporter_t  *child,
+    GError       **err);
+
+/**
+ * Waits until every message emitted to an exporter has been handed to the
+ * operating system.  Only an exporter that queues messages (see
+ * fbExporterSetIOBackend(), fbExporterSetUDPBatch(), and
+ * fbExporterSetCoalesce()) or writes to a buffered file has work to do.
+ * A fan-out exporter flushes each of its children.
+ *
+ * @param exporter  an exporting process endpoint.
+ * @param err       An error description, set on failure.
+ * @return TRUE on success, FALSE if a queued write failed.
+ * @since libfixbuf 2.6.0
+ */
+gboolean
+fbExporterFlush(
+    fbExporter_t  *exporter,
+    GError       **err);
+
 /**
  * Gets the (transcoded) message length that was copied to the exporting
  * buffer upon fBufEmit() when using fbExporterAllocBuffer().
@@ -4985,6 +5392,12 @@ fbExporterAddSourceIP6(
  * Allocates a collecting process endpoint for a named file. The underlying
  * file will be opened immediately.
  *
+ * A file (or standard input) that begins with the gzip or zstd magic
+ * number is decompressed by a helper thread, so decompression overlaps
+ * with transcoding.  Allocation fails if libfixbuf was built without
+ * support for the codec.  NetFlow V9 translation is not supported on
+ * compressed input (since libfixbuf 2.6.0).
+ *
  * @param ctx       application context; for application use, retrievable
  *                  by fbCollectorGetContext()
  * @param path      path of file to read, or "-" to read standard input.
@@ -4999,6 +5412,31 @@ fbCollectorAllocFile(
     const char  *path,
     GError     **err);
 
+/**
+ * Allocates a collecting process endpoint for a named file, reading the file
+ * through a memory mapping.  The file is mapped when it is opened and
+ * libfixbuf decodes each message where it lies in the mapping, avoiding the
+ * read and copy of every message done by fbCollectorAllocFile().  The
+ * mapping is advised for sequential access.
+ *
+ * When `path` is "-" or names something that cannot be mapped, such as a
+ * pipe, an empty file, or a compressed file, the collector reads the file
+ * as a stream, exactly as one returned by fbCollectorAllocFile().  Data
+ * appended to the file after it is opened is not seen.
+ *
+ * @param ctx       application context; for application use, retrievable
+ *                  by fbCollectorGetContext()
+ * @param path      path of file to read, or "-" to read standard input.
+ * @param err       An error description, set on failure.
+ * @return a collecting process endpoint, or NULL on failure.
+ * @since libfixbuf 2.6.0
+ */
+fbCollector_t *
+fbCollectorAllocMappedFile(
+    void        *ctx,
+    const char  *path,
+    GError     **err);
+
 /**
  * Allocates a collecting process endpoint for an open file.
  *
@@ -5118,6 +5556,50 @@ fbListenerAlloc(
     fbListenerAppFree_fn   appfree,
     GError               **err);
 
+/**
+ * Allocates `count` UDP listeners that share the local endpoint in `spec`.
+ * Each listener's sockets are bound with the SO_REUSEPORT socket option, so
+ * the kernel spreads incoming datagrams across the listeners by hashing the
+ * sender's address and port.  Since a given exporter is always hashed to the
+ * same listener, its templates and sequence numbers stay on one shard.
+ *
+ * Each listener in `shards` has its own collector, collection buffer, and
+ * clones of `session`, and behaves exactly like a listener returned by
+ * fbListenerAlloc().  The intended use is to drive each listener from its
+ * own thread with fbListenerWait() and fBufNext(); the listeners share no
+ * mutable state other than `session`, which must not be modified while the
+ * shards are in use.  Free each listener with fbListenerFree().
+ *
+ * `spec` must name an explicit port; binding several listeners to an
+ * ephemeral port ("0") gives each one a different port.
+ *
+ * @param spec      local endpoint connection specifier; must use the
+ *                  FB_UDP transport.  A copy is made for each listener.
+ * @param session   session state container to clone for each shard.
+ *                  Not freed by the listeners.  Must be kept alive while
+ *                  any of the listeners exists.
+ * @param appinit   application connection initiation function, called as
+ *                  for fbListenerAlloc() on each shard.
+ * @param appfree   application context free function.
+ * @param count     number of listeners to create.
+ * @param shards    array of at least `count` elements that is filled with
+ *                  the new listeners.
+ * @param err       An error description, set on failure.
+ * @return TRUE on success.  FALSE if the transport is not UDP, the platform
+ *         does not support SO_REUSEPORT, or a socket cannot be created; in
+ *         that case no listeners are returned.
+ * @since libfixbuf 2.6.0
+ */
+gboolean
+fbListenerAllocShards(
+    fbConnSpec_t          *spec,
+    fbSession_t           *session,
+    fbListenerAppInit_fn   appinit,
+    fbListenerAppFree_fn   appfree,
+    unsigned int           count,
+    fbListener_t         **shards,
+    GError               **err);
+
 /**
  * Frees a listener. Stops listening on the local endpoint, and frees any
  * open buffers still managed by the listener.
@@ -5183,6 +5665,45 @@ fbListenerInterrupt(
     fbListener_t  *listener);
 
 
+/**
+ * A suggested size for the read-ahead buffer of a TCP collector.  See
+ * fbListenerSetTCPReadBuffer() and fbCollectorSetTCPReadBuffer().
+ * @since libfixbuf 2.6.0
+ */
+#define FB_TCP_READ_BUFFER_DEFAULT  (256 * 1024)
+
+/**
+ * Sets the size of the read-ahead buffer given to each TCP collector the
+ * listener creates from this point on, including the collector created by
+ * fbListenerOwnSocketCollectorTCP().  See fbCollectorSetTCPReadBuffer().
+ * The default is 0, meaning collectors read each message with separate
+ * reads of its header and body.
+ *
+ * @param listener handle to the listener state
+ * @param size     read-ahead buffer size in octets, or 0 to disable.
+ *                 FB_TCP_READ_BUFFER_DEFAULT is a reasonable choice.
+ * @since libfixbuf 2.6.0
+ */
+void
+fbListenerSetTCPReadBuffer(
+    fbListener_t  *listener,
+    size_t         size);
+
+/**
+ * Sets the I/O backend of each TCP collector the listener creates from
+ * this point on.  See fbCollectorSetIOBackend().  If the backend cannot be
+ * enabled on a new collector, a warning is logged and the collector uses
+ * FB_IO_SYSCALL.
+ *
+ * @param listener handle to the listener state
+ * @param backend  the I/O backend to use
+ * @since libfixbuf 2.6.0
+ */
+void
+fbListenerSetIOBackend(
+    fbListener_t   *listener,
+    fbIOBackend_t   backend);
+
 /**
  * If a collector is associated with the listener class, this will return a
  * handle to the collector state structure.
@@ -5347,6 +5868,994 @@ fbCollectorSetUDPMultiSession(
     fbCollector_t  *collector,
     gboolean        multi_session);
 
+/**
+ * Enables batched reads on a @ref fbCollector_t associated with a UDP
+ * @ref fbListener_t.  By default the collector makes one system call to
+ * receive each datagram.  When `count` is greater than 1, the collector
+ * instead receives up to `count` datagrams with a single call to
+ * recvmmsg() and hands them to fBufNext() one at a time; each datagram
+ * keeps the peer address it arrived with, so UDP sessions and
+ * fbCollectorSetAcceptOnly() behave as before.  The ring of datagrams
+ * uses 64 KiB of memory per slot, and `count` is limited to 1024.
+ *
+ * A `count` of 0 or 1 disables batching.  The batch size may not be
+ * changed while datagrams from a previous receive are waiting to be read.
+ *
+ * The caller may use fbListenerGetCollector() to get the collector given a
+ * listener.
+ *
+ * @param collector     pointer to collector associated with listener.
+ * @param count         maximum number of datagrams to read at once
+ * @param err           An error description, set on failure.
+ * @return TRUE on success.  FALSE if the collector is not a UDP collector
+ *         or the platform does not provide recvmmsg().
+ * @since libfixbuf 2.6.0
+ */
+gboolean
+fbCollectorSetUDPBatch(
+    fbCollector_t  *collector,
+    unsigned int    count,
+    GError        **err);
+
+/**
+ * Sets how long a peer of a @ref fbCollector_t associated with a UDP
+ * @ref fbListener_t may be silent before the collector frees its session.
+ * A UDP collector keeps a session for each peer address and observation
+ * domain it receives from; the session of a peer that has sent nothing
+ * for longer than `timeout` seconds is freed, calling the `appfree`
+ * function in multi-session mode.  The default is 1800 seconds.
+ *
+ * The caller may use fbListenerGetCollector() to get the collector given a
+ * listener.
+ *
+ * @param collector     pointer to collector associated with listener.
+ * @param timeout       idle timeout in seconds; 0 restores the default
+ * @param err           An error description, set on failure.
+ * @return TRUE on success.  FALSE if the collector is not a UDP collector.
+ * @since libfixbuf 2.6.0
+ */
+gboolean
+fbCollectorSetUDPTimeout(
+    fbCollector_t  *collector,
+    uint32_t        timeout,
+    GError        **err);
+
+/**
+ * Counters kept by a @ref fbCollector_t, for the collector as a whole and,
+ * on a UDP collector, for each peer.  See fbCollectorGetStats() and
+ * fbCollectorForEachPeerStats().
+ *
+ * @since libfixbuf 2.6.0
+ */
+typedef struct fbCollectorStats_st {
+    /** Number of messages read */
+    uint64_t   messages;
+    /**
+     * Number of datagrams the kernel dropped because the socket receive
+     * buffer was full.  The kernel does not say whose datagrams it
+     * dropped; a peer is charged with the drops reported with its next
+     * datagram.  Requires fbCollectorEnableUDPStats() and SO_RXQ_OVFL.
+     */
+    uint64_t   kernel_drops;
+    /**
+     * Largest number of octets seen waiting in the socket receive buffer
+     * when the collector went to read it; for a peer, when the collector
+     * read one of its datagrams.  Requires fbCollectorEnableUDPStats()
+     * and SO_MEMINFO.
+     */
+    uint64_t   rcvbuf_high;
+    /** Size of the socket receive buffer, when rcvbuf_high is known */
+    uint64_t   rcvbuf_size;
+    /**
+     * Number of messages whose sequence number was not the one expected,
+     * each of which fBufNext() also reports with a warning.
+     */
+    uint64_t   seq_gaps;
+    /**
+     * Number of records missing according to the sequence numbers, not
+     * counting messages that arrived out of order.
+     */
+    uint64_t   seq_missing;
+} fbCollectorStats_t;
+
+/**
+ * A function called by fbCollectorForEachPeerStats() for each peer of a
+ * UDP collector.
+ *
+ * @param peer      the peer's address
+ * @param peerlen   the length of `peer`
+ * @param obdomain  the observation domain the counters belong to; a peer
+ *                  that exports several domains is reported once for each
+ * @param stats     the counters
+ * @param ctx       the ctx given to fbCollectorForEachPeerStats()
+ * @since libfixbuf 2.6.0
+ */
+typedef void
+(*fbCollectorPeerStats_fn)(
+    const struct sockaddr     *peer,
+    size_t                     peerlen,
+    uint32_t                   obdomain,
+    const fbCollectorStats_t  *stats,
+    void                      *ctx);
+
+/**
+ * Enables the socket counters of a @ref fbCollector_t associated with a
+ * UDP @ref fbListener_t: the kernel's count of datagrams dropped on the
+ * socket, read from the ancillary data of each datagram (SO_RXQ_OVFL),
+ * and the amount of data waiting in the socket receive buffer, sampled
+ * each time the collector reads the socket (SO_MEMINFO; one more system
+ * call per read, or per batch with fbCollectorSetUDPBatch()).  On
+ * platforms without these options the counters stay zero.
+ *
+ * Message and sequence counters are always kept and need not be enabled.
+ *
+ * The caller may use fbListenerGetCollector() to get the collector given a
+ * listener.
+ *
+ * @param collector     pointer to collector associated with listener.
+ * @param err           An error description, set on failure.
+ * @return TRUE on success.  FALSE if the collector is not a UDP collector
+ *         or the socket option cannot be set.
+ * @since libfixbuf 2.6.0
+ */
+gboolean
+fbCollectorEnableUDPStats(
+    fbCollector_t  *collector,
+    GError        **err);
+
+/**
+ * Copies the counters of `collector`, totalled over all of its peers, to
+ * `stats`.
+ *
+ * @param collector     a collector
+ * @param stats         set to the counters
+ * @since libfixbuf 2.6.0
+ */
+void
+fbCollectorGetStats(
+    fbCollector_t       *collector,
+    fbCollectorStats_t  *stats);
+
+/**
+ * Calls `fn` with the counters of each peer of a UDP collector whose
+ * session has not timed out, most recently heard from first.  `fn` must
+ * not read from the collector.
+ *
+ * @param collector     a UDP collector
+ * @param fn            the function to call
+ * @param ctx           passed to `fn`
+ * @since libfixbuf 2.6.0
+ */
+void
+fbCollectorForEachPeerStats(
+    fbCollector_t            *collector,
+    fbCollectorPeerStats_fn   fn,
+    void                     *ctx);
+
+/**
+ * Enables or disables buffered reads on a TCP @ref fbCollector_t.  By
+ * default a TCP collector waits for the socket and reads each message's
+ * 4-octet header and then its body, at least four system calls per
+ * message.  With a read-ahead buffer, the collector reads as much as the
+ * socket has available, up to `size` octets, and hands the complete
+ * messages in the buffer to fBufNext() one at a time without further
+ * system calls; only a partial message at the end of the buffer is moved
+ * before the next read.  Data already read is kept if a read is
+ * interrupted.
+ *
+ * `size` is raised to the maximum IPFIX message size when smaller.  A
+ * `size` of 0 disables buffering.  The buffer may not be changed while it
+ * holds unread data.  Use fbListenerSetTCPReadBuffer() to enable buffering
+ * on every collector a listener creates.
+ *
+ * @param collector     a TCP collector
+ * @param size          read-ahead buffer size in octets, or 0
+ * @param err           An error description, set on failure.
+ * @return TRUE on success.  FALSE if the collector does not read from a
+ *         plain TCP socket or the buffer holds unread data.
+ * @since libfixbuf 2.6.0
+ */
+gboolean
+fbCollectorSetTCPReadBuffer(
+    fbCollector_t  *collector,
+    size_t          size,
+    GError        **err);
+
+/**
+ * Selects the I/O backend used by a TCP @ref fbCollector_t.  FB_IO_URING
+ * requires a read-ahead buffer and enables one of size
+ * FB_TCP_READ_BUFFER_DEFAULT if the collector has none (see
+ * fbCollectorSetTCPReadBuffer()).  A single multishot receive is then kept
+ * armed on the socket; it fills buffers owned by the collector, and each
+ * read collects every receive completed so far with one system call,
+ * waiting for the socket only when none has.  Disabling the read-ahead
+ * buffer returns the collector to FB_IO_SYSCALL.  The first read of the
+ * collector must be made by the thread that makes all later reads, which
+ * is the read-ahead thread if fbCollectorEnableReadAhead() is used.
+ * Requires Linux 6.1 or later.
+ *
+ * @param collector     a TCP collector
+ * @param backend       the I/O backend to use
+ * @param err           An error description, set on failure.
+ * @return TRUE on success.  FALSE if the collector does not read from a
+ *         plain TCP socket, fixbuf was built without liburing support, or
+ *         the kernel does not support the ring.
+ * @since libfixbuf 2.6.0
+ */
+gboolean
+fbCollectorSetIOBackend(
+    fbCollector_t  *collector,
+    fbIOBackend_t   backend,
+    GError        **err);
+
+/**
+ * Puts the socket of a TCP or TLS @ref fbCollector_t in or out of
+ * non-blocking mode.  A non-blocking collector never waits: when the socket
+ * has no data, fBufNext() fails with FB_ERROR_NLREAD and keeps the part of
+ * the message read so far, so the next call, typically made once the
+ * socket is readable again, continues exactly where the previous one
+ * stopped.  This lets an application drive many collectors from its own
+ * event loop; use fbCollectorGetFD() to get the socket to watch.
+ *
+ * A blocking collector also keeps a partly read message when a read is
+ * interrupted.
+ *
+ * @param collector     a TCP or TLS collector
+ * @param nonblocking   TRUE to make reads non-blocking, FALSE to restore
+ *                      blocking reads
+ * @param err           An error description, set on failure.
+ * @return TRUE on success.  FALSE if the collector does not read from a
+ *         TCP or TLS socket or the socket mode could not be changed.
+ * @since libfixbuf 2.6.0
+ */
+gboolean
+fbCollectorSetNonBlocking(
+    fbCollector_t  *collector,
+    gboolean        nonblocking,
+    GError        **err);
+
+/**
+ * Starts a thread that reads whole messages from `collector` ahead of the
+ * @ref fBuf_t into a ring of `slots` messages, so reading overlaps with
+ * transcoding and short bursts of input are absorbed while the
+ * application is busy.  fBufNext() then takes messages from the ring,
+ * waiting only when it is empty.  The thread waits when the ring is full.
+ * Errors, including FB_ERROR_EOF, are returned by fBufNext() once the
+ * messages read before them have been taken.
+ *
+ * Read-ahead is supported on file, TCP, SCTP, and TLS collectors, but not
+ * on UDP, mapped file, or non-blocking collectors.  Enable it after any
+ * other setup of the collector, such as fbCollectorSetTCPReadBuffer() or
+ * a NetFlow or sFlow translator, and before the first read; it stays
+ * enabled until the collector is closed.  fBufInterruptSocket() makes a
+ * waiting fBufNext() return FB_ERROR_NLREAD.
+ *
+ * @param collector     a collector
+ * @param slots         the number of messages the ring holds; 0 for the
+ *                      default of 32.  Each slot uses 64 KiB.
+ * @param err           An error description, set on failure.
+ * @return TRUE on success.  FALSE if read-ahead is already enabled or not
+ *         supported by the collector, or the thread could not be started.
+ * @since libfixbuf 2.6.0
+ */
+gboolean
+fbCollectorEnableReadAhead(
+    fbCollector_t  *collector,
+    unsigned int    slots,
+    GError        **err);
+
+/**
+ * Returns the file descriptor a socket @ref fbCollector_t reads from, for
+ * use with select(), poll(), or epoll.
+ *
+ * @param collector     a socket collector
+ * @return the socket file descriptor
+ * @since libfixbuf 2.6.0
+ */
+int
+fbCollectorGetFD(
+    fbCollector_t  *collector);
+
+/**
+ * A parallel reader decodes one uncompressed IPFIX file on several
+ * threads.  When it is allocated, it reads the headers of every message
+ * and set in the file, noting where templates are defined, and divides
+ * the file into chunks at message boundaries.  fbParallelReaderRun() then
+ * gives each chunk to a worker thread as an @ref fBuf_t whose session
+ * already holds the templates in effect at the start of the chunk.  The
+ * internals of this structure are private to libfixbuf.
+ *
+ * @since libfixbuf 2.6.0
+ */
+typedef struct fbParallelReader_st fbParallelReader_t;
+
+/**
+ * The function a worker thread of fbParallelReaderRun() calls to decode a
+ * chunk.  It should set an internal template on `fbuf` and read records
+ * with fBufNext() until FB_ERROR_EOF, placing anything it produces in
+ * `result`.  The fBuf, its session, and its collector are freed when the
+ * function returns.  Calls for different chunks run at the same time.
+ *
+ * @param fbuf      a buffer that reads the chunk
+ * @param chunk     the number of the chunk, from 0
+ * @param app_ctx   the app_ctx given to fbParallelReaderRun()
+ * @param result    set to the result to deliver for the chunk
+ * @param err       An error description, set on failure.
+ * @return TRUE on success.  FALSE stops the run; `result` is not
+ *         delivered.
+ * @since libfixbuf 2.6.0
+ */
+typedef gboolean
+(*fbParallelDecode_fn)(
+    fBuf_t        *fbuf,
+    unsigned int   chunk,
+    void          *app_ctx,
+    void         **result,
+    GError       **err);
+
+/**
+ * The function fbParallelReaderRun() calls with the result of each
+ * decoded chunk.  Only one call runs at a time.
+ *
+ * @param chunk     the number of the chunk, from 0
+ * @param result    the result the decode function set for the chunk
+ * @param app_ctx   the app_ctx given to fbParallelReaderRun()
+ * @since libfixbuf 2.6.0
+ */
+typedef void
+(*fbParallelDeliver_fn)(
+    unsigned int   chunk,
+    void          *result,
+    void          *app_ctx);
+
+/**
+ * Allocates a reader that decodes the IPFIX file at `path` in parallel.
+ * This reads the headers of every message in the file, which is much
+ * faster than decoding it, and splits the file into chunks of about
+ * `chunk_size` octets.
+ *
+ * Each worker decodes with a clone of `session`, which should hold the
+ * internal templates and new template callback the workers use, and must
+ * not change and must outlive the reader.  Elements in the file's
+ * templates that are not in the session's information model are added to
+ * it here, and so are the elements described by the file's RFC 5610
+ * information element type records, so the workers only read the model.
+ * A worker's buffer with fBufSetAutomaticInsert() skips those records.
+ * The application must not change the model while fbParallelReaderRun()
+ * runs.
+ *
+ * @param path          the file to read; it may not be compressed
+ * @param session       the session the workers clone
+ * @param chunk_size    approximate size of each chunk, in octets
+ * @param err           An error description, set on failure.
+ * @return a new reader, or NULL if the file cannot be read or is not a
+ *         valid IPFIX file.
+ * @since libfixbuf 2.6.0
+ */
+fbParallelReader_t *
+fbParallelReaderAlloc(
+    const char   *path,
+    fbSession_t  *session,
+    uint64_t      chunk_size,
+    GError      **err);
+
+/**
+ * Returns the number of chunks `reader` divided its file into.
+ *
+ * @param reader    a parallel reader
+ * @return the number of chunks
+ * @since libfixbuf 2.6.0
+ */
+unsigned int
+fbParallelReaderGetChunkCount(
+    fbParallelReader_t  *reader);
+
+/**
+ * Decodes the file of `reader` on `threads` worker threads.  Each chunk
+ * is passed to `decode` on a worker, and its result is passed to
+ * `deliver`.  When `ordered` is TRUE, results are delivered in chunk
+ * order; otherwise each is delivered as soon as it is ready.
+ *
+ * When `decode` fails, no further chunks are started and the first error
+ * is returned.  The results of chunks that were decoded are still
+ * delivered, so the application can release them, though when `ordered`
+ * is TRUE those after the failed chunk are delivered once the workers
+ * stop.
+ *
+ * @param reader    a parallel reader
+ * @param threads   the number of worker threads; 0 for one per processor
+ * @param ordered   whether to deliver results in chunk order
+ * @param decode    the function that decodes a chunk
+ * @param deliver   the function that receives the result of a chunk
+ * @param app_ctx   passed to `decode` and `deliver`
+ * @param err       An error description, set on failure.
+ * @return TRUE if every chunk was decoded.
+ * @since libfixbuf 2.6.0
+ */
+gboolean
+fbParallelReaderRun(
+    fbParallelReader_t    *reader,
+    unsigned int           threads,
+    gboolean               ordered,
+    fbParallelDecode_fn    decode,
+    fbParallelDeliver_fn   deliver,
+    void                  *app_ctx,
+    GError               **err);
+
+/**
+ * Frees a parallel reader.  This does not free the session given to
+ * fbParallelReaderAlloc().
+ *
+ * @param reader    the reader to free
+ * @since libfixbuf 2.6.0
+ */
+void
+fbParallelReaderFree(
+    fbParallelReader_t  *reader);
+
+/**
+ * A message index lists the offset, export time, and observation domain
+ * of every message in an uncompressed IPFIX file, and the IDs of the
+ * templates each message defines or withdraws.  It lets
+ * fbCollectorAllocFileTimeRange() read only the messages exported in a
+ * time range.  An index may be saved beside the file it describes, by
+ * convention with the suffix ".idx", and loaded again instead of being
+ * rebuilt.  The internals of this structure are private to libfixbuf.
+ *
+ * @since libfixbuf 2.6.0
+ */
+typedef struct fbFileIndex_st fbFileIndex_t;
+
+/**
+ * Builds the message index of the IPFIX file at `path` by reading the
+ * headers of its messages and sets.
+ *
+ * @param path      the file to index; it may not be compressed
+ * @param err       An error description, set on failure.
+ * @return a new index, or NULL if the file cannot be read or is not a
+ *         valid IPFIX file.
+ * @since libfixbuf 2.6.0
+ */
+fbFileIndex_t *
+fbFileIndexBuild(
+    const char  *path,
+    GError     **err);
+
+/**
+ * Writes `index` to the file at `path`, replacing it atomically.
+ *
+ * @param index     a message index
+ * @param path      the file to write
+ * @param err       An error description, set on failure.
+ * @return TRUE on success.
+ * @since libfixbuf 2.6.0
+ */
+gboolean
+fbFileIndexSave(
+    const fbFileIndex_t  *index,
+    const char           *path,
+    GError              **err);
+
+/**
+ * Reads a message index written by fbFileIndexSave().
+ *
+ * @param path      the file to read
+ * @param err       An error description, set on failure.
+ * @return the index, or NULL if the file cannot be read or is not a valid
+ *         message index.
+ * @since libfixbuf 2.6.0
+ */
+fbFileIndex_t *
+fbFileIndexLoad(
+    const char  *path,
+    GError     **err);
+
+/**
+ * Returns the number of messages in the file `index` describes.
+ *
+ * @param index     a message index
+ * @return the number of messages
+ * @since libfixbuf 2.6.0
+ */
+uint32_t
+fbFileIndexGetMessageCount(
+    const fbFileIndex_t  *index);
+
+/**
+ * Frees a message index.
+ *
+ * @param index     the index to free
+ * @since libfixbuf 2.6.0
+ */
+void
+fbFileIndexFree(
+    fbFileIndex_t  *index);
+
+/**
+ * Allocates a collecting process endpoint that reads the messages of the
+ * file at `path` exported between `start_time` and `end_time`, using
+ * `index` to find them.  Reading starts at the first message whose export
+ * time is at or after `start_time` and stops before the next message
+ * whose export time is later than `end_time`.  The templates in effect at
+ * the first message are read from the earlier messages that define them
+ * before any data, so records decode as they would when reading the whole
+ * file.
+ *
+ * Allocation fails if the size of the file does not match the index.
+ *
+ * @param ctx           application context; for application use,
+ *                      retrievable by fbCollectorGetContext()
+ * @param path          the file to read
+ * @param index         the message index of the file
+ * @param start_time    the earliest export time to read, in seconds since
+ *                      the UNIX epoch
+ * @param end_time      the latest export time to read; UINT32_MAX to read
+ *                      to the end of the file
+ * @param err           An error description, set on failure.
+ * @return a collecting process endpoint, or NULL on failure.
+ * @since libfixbuf 2.6.0
+ */
+fbCollector_t *
+fbCollectorAllocFileTimeRange(
+    void                 *ctx,
+    const char           *path,
+    const fbFileIndex_t  *index,
+    uint32_t              start_time,
+    uint32_t              end_time,
+    GError              **err);
+
+
+/**
+ * A pool of message buffers of one size.  An @ref fBuf_t given a pool
+ * with fBufSetBufferPool() takes the storage for its messages from the
+ * pool, and buffers released by fBufs and applications go back to the
+ * pool for reuse.  A pool may be shared by fBufs on any number of
+ * threads.  The internals of this structure are private to libfixbuf.
+ *
+ * @since libfixbuf 2.6.0
+ */
+typedef struct fbBufferPool_st fbBufferPool_t;
+
+/**
+ * A reference-counted block of memory that holds IPFIX Messages for an
+ * @ref fBuf_t.  A buffer may be filled on one thread and given to an fBuf
+ * on another with fBufSetMessageBuffer().  The internals of this
+ * structure are private to libfixbuf.
+ *
+ * @since libfixbuf 2.6.0
+ */
+typedef struct fbMessageBuffer_st fbMessageBuffer_t;
+
+/**
+ * Allocates a pool of message buffers of `buffer_size` octets.
+ *
+ * The buffers of a collecting fBuf must be large enough for the largest
+ * message it reads; a message read from a UDP socket into a smaller
+ * buffer is truncated and rejected.  An exporting fBuf uses the pool only
+ * when its buffers are at least the MTU of its exporter.
+ *
+ * @param buffer_size   the size of each buffer, from 32 to 65536 octets
+ * @param max_idle      the most released buffers the pool keeps for
+ *                      reuse; 0 for the default of 64
+ * @param err           An error description, set on failure.
+ * @return a new pool, or NULL if `buffer_size` is out of range.
+ * @since libfixbuf 2.6.0
+ */
+fbBufferPool_t *
+fbBufferPoolAlloc(
+    size_t         buffer_size,
+    unsigned int   max_idle,
+    GError       **err);
+
+/**
+ * Releases the application's reference to a buffer pool.  The pool is
+ * freed once no fBuf uses it and every buffer taken from it has been
+ * released.
+ *
+ * @param pool  the pool to release; may be NULL
+ * @since libfixbuf 2.6.0
+ */
+void
+fbBufferPoolFree(
+    fbBufferPool_t  *pool);
+
+/**
+ * Returns the size of the buffers in a pool.
+ *
+ * @param pool  a buffer pool
+ * @return the size of each buffer in octets
+ * @since libfixbuf 2.6.0
+ */
+size_t
+fbBufferPoolGetBufferSize(
+    const fbBufferPool_t  *pool);
+
+/**
+ * Takes a buffer from a pool, reusing a released one when the pool has
+ * one.  The buffer is empty and the caller holds the only reference.
+ *
+ * @param pool  a buffer pool
+ * @return a message buffer
+ * @since libfixbuf 2.6.0
+ */
+fbMessageBuffer_t *
+fbMessageBufferAlloc(
+    fbBufferPool_t  *pool);
+
+/**
+ * Adds a reference to a message buffer.
+ *
+ * @param msgbuf    a message buffer
+ * @return `msgbuf`
+ * @since libfixbuf 2.6.0
+ */
+fbMessageBuffer_t *
+fbMessageBufferRef(
+    fbMessageBuffer_t  *msgbuf);
+
+/**
+ * Releases a reference to a message buffer.  When the last reference is
+ * released the buffer returns to its pool or is freed.  May be called on
+ * any thread.
+ *
+ * @param msgbuf    a message buffer; may be NULL
+ * @since libfixbuf 2.6.0
+ */
+void
+fbMessageBufferUnref(
+    fbMessageBuffer_t  *msgbuf);
+
+/**
+ * Returns the memory of a message buffer, fbMessageBufferGetCapacity()
+ * octets long.
+ *
+ * @param msgbuf    a message buffer
+ * @return the start of the buffer's memory
+ * @since libfixbuf 2.6.0
+ */
+uint8_t *
+fbMessageBufferGetData(
+    fbMessageBuffer_t  *msgbuf);
+
+/**
+ * Returns the size of the memory of a message buffer.
+ *
+ * @param msgbuf    a message buffer
+ * @return the capacity in octets
+ * @since libfixbuf 2.6.0
+ */
+size_t
+fbMessageBufferGetCapacity(
+    const fbMessageBuffer_t  *msgbuf);
+
+/**
+ * Returns the number of octets of a message buffer that hold messages.
+ *
+ * @param msgbuf    a message buffer
+ * @return the length in octets
+ * @since libfixbuf 2.6.0
+ */
+size_t
+fbMessageBufferGetLength(
+    const fbMessageBuffer_t  *msgbuf);
+
+/**
+ * Sets the number of octets at the start of a message buffer that hold
+ * one or more complete IPFIX Messages.  Call this after filling the
+ * buffer and before passing it to fBufSetMessageBuffer().
+ *
+ * @param msgbuf    a message buffer
+ * @param length    the length of the messages in octets
+ * @param err       An error description, set on failure.
+ * @return TRUE on success, FALSE if `length` exceeds the capacity.
+ * @since libfixbuf 2.6.0
+ */
+gboolean
+fbMessageBufferSetLength(
+    fbMessageBuffer_t  *msgbuf,
+    size_t              length,
+    GError            **err);
+
+/**
+ * Sets the pool an fBuf takes its message storage from.  By default an
+ * fBuf allocates storage of its own when it reads or writes its first
+ * message: 65536 octets when collecting and the exporter's MTU when
+ * exporting.  The fBuf changes to the pool the next time it needs
+ * storage; it does not release a message it is in the middle of.
+ *
+ * The fBuf holds a reference to the pool, so the application may call
+ * fbBufferPoolFree() at any time.
+ *
+ * @param fbuf  an IPFIX message buffer
+ * @param pool  the pool to use, or NULL to go back to the default
+ * @since libfixbuf 2.6.0
+ */
+void
+fBufSetBufferPool(
+    fBuf_t          *fbuf,
+    fbBufferPool_t  *pool);
+
+/**
+ * Gives a filled message buffer to a collecting fBuf.  The buffer may
+ * have been filled on another thread, for example by a thread that
+ * receives messages while this one decodes them; set its length with
+ * fbMessageBufferSetLength() first.  Any message the fBuf was reading is
+ * abandoned.
+ *
+ * fBufNext() reads the messages in `msgbuf` one after another.  When they
+ * are used up, an fBuf with a collector goes back to reading from the
+ * collector, and an fBuf without one returns FB_ERROR_BUFSZ as it does
+ * after fBufSetBuffer().
+ *
+ * The fBuf adds a reference to `msgbuf` and releases it when done, so the
+ * caller should release its own reference when it no longer needs the
+ * buffer.
+ *
+ * @param fbuf      an IPFIX message buffer that is not exporting
+ * @param msgbuf    a message buffer holding complete IPFIX Messages
+ * @param err       An error description, set on failure.
+ * @return TRUE on success, FALSE if `fbuf` has an exporter or `msgbuf`
+ *         is empty.
+ * @since libfixbuf 2.6.0
+ */
+gboolean
+fBufSetMessageBuffer(
+    fBuf_t             *fbuf,
+    fbMessageBuffer_t  *msgbuf,
+    GError            **err);
+
+/**
+ * Keeps the message the most recent record read from an fBuf came from.
+ * The varfield contents and list data of records decoded from that
+ * message point into it, and they stay valid until the returned buffer
+ * is released with fbMessageBufferUnref().  The fBuf reads its next
+ * message into a fresh buffer, taken from its pool if it has one (see
+ * fBufSetBufferPool()), so records can be handed to another thread
+ * without copying their strings.  Retaining the same message more than
+ * once returns the same buffer with another reference.
+ *
+ * Messages read from a memory-mapped file and from a buffer given to
+ * fBufSetBuffer() are not in a message buffer and cannot be retained.
+ *
+ * @param fbuf  an IPFIX message buffer that is collecting
+ * @param err   An error description, set on failure.
+ * @return a reference to the current message buffer, or NULL if there
+ *         is no current message or it cannot be retained.
+ * @since libfixbuf 2.6.0
+ */
+fbMessageBuffer_t *
+fBufRetainCurrentMessage(
+    fBuf_t  *fbuf,
+    GError **err);
+
+/**
+ * A front-end that spreads the records of one export stream across
+ * several exporters, so that a tier of collectors can share the load.
+ * Each exporter has its own @ref fBuf_t and @ref fbSession_t, and
+ * therefore its own messages and sequence numbers.  Templates added to
+ * the partitioner are added to every session, and each exporter writes
+ * all of them before its first record.  A record goes to the exporter
+ * chosen by a hash of the observation domain and the values of the key
+ * elements in the record, so every record of a flow reaches the same
+ * collector.  The internals of this structure are private to libfixbuf.
+ *
+ * @since libfixbuf 2.6.0
+ */
+typedef struct fbPartitioner_st fbPartitioner_t;
+
+/**
+ * Allocates a partitioner that hashes records on the elements named in
+ * `key`, for example the five elements of the flow key.  A record whose
+ * internal template lacks a key element is hashed on the elements it
+ * has; a record with none of them goes to the same exporter as every
+ * other such record in its observation domain.  A NULL or empty `key`
+ * partitions by observation domain alone.  The hash covers the octets
+ * of each value as stored in the record, so two internal templates
+ * should give a key element the same length.
+ *
+ * The partitioner starts with the templates of `session` in every
+ * observation domain, its template metadata settings, and its current
+ * domain.  `session` is not used afterward; the application still owns
+ * it.  Add exporters with fbPartitionerAddExporter().
+ *
+ * @param session   a session whose information model and templates the
+ *                  partitioner copies
+ * @param key       an array of elements terminated by FB_IESPEC_NULL;
+ *                  only the names are used.  Lists cannot be key elements.
+ * @param err       An error description, set on failure.
+ * @return a new partitioner, or NULL if an element of `key` is unknown
+ *         or unusable.
+ * @since libfixbuf 2.6.0
+ */
+fbPartitioner_t *
+fbPartitionerAlloc(
+    fbSession_t                *session,
+    const fbInfoElementSpec_t  *key,
+    GError                    **err);
+
+/**
+ * Frees a partitioner along with its exporters and their buffers and
+ * sessions.  Records appended since the last fbPartitionerEmit() are lost.
+ *
+ * @param part  a partitioner
+ * @since libfixbuf 2.6.0
+ */
+void
+fbPartitionerFree(
+    fbPartitioner_t  *part);
+
+/**
+ * Adds an exporter to a partitioner, which takes ownership of it.  The
+ * exporter gets a session of its own holding the partitioner's
+ * templates.  Since the number of exporters decides where each key goes,
+ * exporters can only be added before the first record is appended.
+ *
+ * @param part      a partitioner
+ * @param exporter  an exporting process endpoint not used elsewhere
+ * @param err       An error description, set on failure.
+ * @return TRUE on success.  FALSE if records have been appended; the
+ *         caller keeps `exporter`.
+ * @since libfixbuf 2.6.0
+ */
+gboolean
+fbPartitionerAddExporter(
+    fbPartitioner_t  *part,
+    fbExporter_t     *exporter,
+    GError          **err);
+
+/**
+ * Returns the number of exporters of a partitioner.
+ *
+ * @param part  a partitioner
+ * @return the number of exporters added by fbPartitionerAddExporter()
+ * @since libfixbuf 2.6.0
+ */
+unsigned int
+fbPartitionerGetCount(
+    const fbPartitioner_t  *part);
+
+/**
+ * Adds a template to every session of a partitioner, as
+ * fbSessionAddTemplate() does for one session.  An external template is
+ * written by each exporter that has started.  The template is shared by
+ * the sessions and must not be added to others.
+ *
+ * @param part      a partitioner
+ * @param internal  TRUE if the template is internal, FALSE if external.
+ * @param tid       Template ID to assign, replacing any current template,
+ *                  or FB_TID_AUTO to assign a new ID, which is the same in
+ *                  every session.
+ * @param tmpl      Template to add
+ * @param err       An error description, set on failure.
+ * @return the template ID of the added template, or 0 on failure.
+ * @since libfixbuf 2.6.0
+ */
+uint16_t
+fbPartitionerAddTemplate(
+    fbPartitioner_t  *part,
+    gboolean          internal,
+    uint16_t          tid,
+    fbTemplate_t     *tmpl,
+    GError          **err);
+
+/**
+ * Removes a template from every session of a partitioner, as
+ * fbSessionRemoveTemplate() does for one session.
+ *
+ * @param part      a partitioner
+ * @param internal  TRUE if the template is internal, FALSE if external.
+ * @param tid       Template ID to remove.
+ * @param err       An error description, set on failure.
+ * @return TRUE on success, FALSE on failure.
+ * @since libfixbuf 2.6.0
+ */
+gboolean
+fbPartitionerRemoveTemplate(
+    fbPartitioner_t  *part,
+    gboolean          internal,
+    uint16_t          tid,
+    GError          **err);
+
+/**
+ * Sets the observation domain of every session of a partitioner, first
+ * emitting the messages in progress.  Each exporter that has started
+ * writes the templates of the domain it has not yet written.  The export
+ * template must be selected again with fbPartitionerSetExportTemplate().
+ *
+ * @param part      a partitioner
+ * @param domain    the observation domain ID
+ * @param err       An error description, set on failure.
+ * @return TRUE on success, FALSE if emitting a message failed; the
+ *         domain is changed either way.
+ * @since libfixbuf 2.6.0
+ */
+gboolean
+fbPartitionerSetDomain(
+    fbPartitioner_t  *part,
+    uint32_t          domain,
+    GError          **err);
+
+/**
+ * Sets the export time of every buffer of a partitioner, as
+ * fBufSetExportTime() does for one buffer.
+ *
+ * @param part      a partitioner
+ * @param extime    the export time, in seconds since the UNIX epoch
+ * @since libfixbuf 2.6.0
+ */
+void
+fbPartitionerSetExportTime(
+    fbPartitioner_t  *part,
+    uint32_t          extime);
+
+/**
+ * Selects the internal template describing the records appended next, as
+ * fBufSetInternalTemplate() does for one buffer.  The position of each
+ * key element in such records is found here.
+ *
+ * @param part      a partitioner
+ * @param tid       ID of an internal template of the partitioner
+ * @param err       An error description, set on failure.
+ * @return TRUE on success, FALSE if the template does not exist.
+ * @since libfixbuf 2.6.0
+ */
+gboolean
+fbPartitionerSetInternalTemplate(
+    fbPartitioner_t  *part,
+    uint16_t          tid,
+    GError          **err);
+
+/**
+ * Selects the external template the records appended next are written
+ * with, as fBufSetExportTemplate() does for one buffer.
+ *
+ * @param part      a partitioner
+ * @param tid       ID of an external template of the partitioner in the
+ *                  current observation domain
+ * @param err       An error description, set on failure.
+ * @return TRUE on success, FALSE if the template does not exist.
+ * @since libfixbuf 2.6.0
+ */
+gboolean
+fbPartitionerSetExportTemplate(
+    fbPartitioner_t  *part,
+    uint16_t          tid,
+    GError          **err);
+
+/**
+ * Appends a record to the buffer of the exporter its key hashes to, as
+ * fBufAppend() does for one buffer.  The first record for an exporter
+ * makes it write the partitioner's templates.
+ *
+ * @param part      a partitioner
+ * @param recbase   the record, described by the internal template
+ * @param recsize   the size of the record in octets
+ * @param err       An error description, set on failure.
+ * @return TRUE on success, FALSE on failure.
+ * @since libfixbuf 2.6.0
+ */
+gboolean
+fbPartitionerAppend(
+    fbPartitioner_t  *part,
+    uint8_t          *recbase,
+    size_t            recsize,
+    GError          **err);
+
+/**
+ * Emits the message in progress of every exporter of a partitioner, as
+ * fBufEmit() does for one buffer.  Every exporter is tried even if one
+ * fails.
+ *
+ * @param part      a partitioner
+ * @param err       An error description of the first failure.
+ * @return TRUE on success, FALSE if any exporter failed.
+ * @since libfixbuf 2.6.0
+ */
+gboolean
+fbPartitionerEmit(
+    fbPartitioner_t  *part,
+    GError          **err);
+
 
 /* Hide this from uncrustify */
 /* *INDENT-OFF* */
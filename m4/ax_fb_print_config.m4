@@ -75,6 +75,36 @@ AC_DEFUN([AX_FB_PRINT_CONFIG],[
     * SCTP Support:                 NO"
     fi
 
+    # io_uring
+    if test "x${FIXBUF_REQ_LIBURING}" = "x1"
+    then
+        FB_BUILD_CONFIG="${FB_BUILD_CONFIG}
+    * io_uring Support:             YES (${LIBURING_LIBS})"
+    else
+        FB_BUILD_CONFIG="${FB_BUILD_CONFIG}
+    * io_uring Support:             NO"
+    fi
+
+    # gzip
+    if test "x${FIXBUF_REQ_ZLIB}" = "x1"
+    then
+        FB_BUILD_CONFIG="${FB_BUILD_CONFIG}
+    * gzip File Support:            YES (${ZLIB_LIBS})"
+    else
+        FB_BUILD_CONFIG="${FB_BUILD_CONFIG}
+    * gzip File Support:            NO"
+    fi
+
+    # zstd
+    if test "x${FIXBUF_REQ_ZSTD}" = "x1"
+    then
+        FB_BUILD_CONFIG="${FB_BUILD_CONFIG}
+    * zstd File Support:            YES (${ZSTD_LIBS})"
+    else
+        FB_BUILD_CONFIG="${FB_BUILD_CONFIG}
+    * zstd File Support:            NO"
+    fi
+
     # SPREAD
     if test "x${FIXBUF_REQ_LIBSPREAD}" = "x1"
     then
@@ -39,10 +39,24 @@
  *  ------------------------------------------------------------------------
  */
 
+#ifndef _GNU_SOURCE
+/* for recvmmsg() */
+#define _GNU_SOURCE
+#endif
 #define _FIXBUF_SOURCE_
 #include <fixbuf/private.h>
 
 #include "fbcollector.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <pthread.h>
+#if HAVE_LINUX_SOCK_DIAG_H
+#include <linux/sock_diag.h>
+#endif
+#if HAVE_LIBURING
+#include <liburing.h>
+#endif
 
 
 /*#################################################
@@ -380,6 +394,66 @@ fbCollectorReadFile(
     return FALSE;
 }
 
+/**
+ * fbCollectorReadCompressed
+ *
+ * The file reader for a gzip or zstd file, which reads the decompressed
+ * data from the collector's compressed stream.
+ *
+ */
+static gboolean
+fbCollectorReadCompressed(
+    fbCollector_t  *collector,
+    uint8_t        *msgbase,
+    size_t         *msglen,
+    GError        **err)
+{
+    size_t   got;
+    uint16_t h_len;
+
+    /* Read and decode version and length */
+    g_assert(*msglen > 4);
+
+    if (!fbCompressStreamRead(collector->compress, msgbase, 4, &got, err)) {
+        return FALSE;
+    }
+    if (got < 4) {
+        if (0 == got) {
+            g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_EOF,
+                        "End of file");
+        } else {
+            g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_EOF,
+                        "Too few bytes available for IPFIX Message Header"
+                        " (%d/16)", (int)got);
+        }
+        return FALSE;
+    }
+    if (!collector->coreadLen(collector, (fbCollectorMsgVL_t *)msgbase,
+                              *msglen, &h_len, err))
+    {
+        return FALSE;
+    }
+
+    /* read rest of message */
+    if (!fbCompressStreamRead(collector->compress, msgbase + 4, h_len - 4,
+                              &got, err))
+    {
+        return FALSE;
+    }
+    if (got < (size_t)h_len - 4) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_EOF,
+                    "End of file in IPFIX Message (%u/%u)",
+                    (unsigned int)got + 4, (unsigned int)h_len);
+        return FALSE;
+    }
+
+    *msglen = h_len;
+    if (!collector->copostRead(collector, msgbase, msglen, err)) {
+        return FALSE;
+    }
+    return TRUE;
+}
+
 /**
  * fbCollectorCloseFile
  *
@@ -390,6 +464,10 @@ static void
 fbCollectorCloseFile(
     fbCollector_t  *collector)
 {
+    if (collector->compress) {
+        fbCompressStreamFree(collector->compress, NULL);
+        collector->compress = NULL;
+    }
     if (collector->stream.fp != stdin) {
         fclose(collector->stream.fp);
     }
@@ -445,8 +523,10 @@ fbCollectorAllocFile(
     const char  *path,
     GError     **err)
 {
-    fbCollector_t *collector = NULL;
-    FILE          *fp = NULL;
+    fbCollector_t      *collector = NULL;
+    FILE               *fp = NULL;
+    fbCompressStream_t *compress = NULL;
+    fbCompressCodec_t   codec;
 
     /* check to see if we're opening stdin */
     if ((strlen(path) == 1) && (path[0] == '-')) {
@@ -472,8 +552,24 @@ fbCollectorAllocFile(
         return NULL;
     }
 
+    /* decompress a gzip or zstd file on a helper thread */
+    codec = fbCompressCodecForStream(fp);
+    if (codec != FB_COMPRESS_NONE) {
+        compress = fbCompressStreamAlloc(fp, codec, FALSE, err);
+        if (!compress) {
+            if (fp != stdin) {
+                fclose(fp);
+            }
+            return NULL;
+        }
+    }
+
     /* allocate a collector */
     collector = fbCollectorAllocFP(ctx, fp);
+    if (compress) {
+        collector->compress = compress;
+        collector->coread = fbCollectorReadCompressed;
+    }
 
     /* set the file close function */
     collector->coclose = fbCollectorCloseFile;
@@ -507,6 +603,264 @@ fbCollectorAllocFile(
     return collector;
 }
 
+/**
+ * fbCollectorMapNextMessage
+ *
+ * Finds the next message in the mapping of a collector created by
+ * fbCollectorAllocMappedFile(), returns a pointer to it in `msgbase` and
+ * its length in `msglen`, and advances past it.
+ *
+ */
+static gboolean
+fbCollectorMapNextMessage(
+    fbCollector_t  *collector,
+    uint8_t       **msgbase,
+    uint16_t       *msglen,
+    GError        **err)
+{
+    fbCollectorMsgVL_t hdr;
+    size_t             avail = collector->map_len - collector->map_off;
+
+    if (0 == avail) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_EOF,
+                    "End of file");
+        return FALSE;
+    }
+    if (avail < 4) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_EOF,
+                    "Too few bytes available for IPFIX Message Header (%d/16)",
+                    (int)avail);
+        return FALSE;
+    }
+
+    /* copy the header; the mapping has no alignment guarantees */
+    memcpy(&hdr, collector->map_base + collector->map_off, sizeof(hdr));
+    if (!collector->coreadLen(collector, &hdr, 0, msglen, err)) {
+        return FALSE;
+    }
+    if (*msglen > avail) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_EOF,
+                    "Too few bytes available for IPFIX Message (%u/%u)",
+                    (unsigned int)avail, *msglen);
+        return FALSE;
+    }
+
+    *msgbase = collector->map_base + collector->map_off;
+    collector->map_off += *msglen;
+    return TRUE;
+}
+
+/**
+ * fbCollectorReadMappedFile
+ *
+ * Reader for a collector created by fbCollectorAllocMappedFile().  The fBuf
+ * normally reads messages in place with fbCollectMappedMessage(); this
+ * copies the message into `msgbase` for the cases that need a private copy,
+ * such as when a translator is in use.
+ *
+ */
+static gboolean
+fbCollectorReadMappedFile(
+    fbCollector_t  *collector,
+    uint8_t        *msgbase,
+    size_t         *msglen,
+    GError        **err)
+{
+    uint8_t *base;
+    uint16_t h_len;
+
+    if (!fbCollectorMapNextMessage(collector, &base, &h_len, err)) {
+        return FALSE;
+    }
+    if (h_len > *msglen) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_BUFSZ,
+                    "Buffer too small to read IPFIX Message "
+                    "(message size %hu, buffer size %u).",
+                    h_len, (uint32_t)*msglen);
+        return FALSE;
+    }
+    memcpy(msgbase, base, h_len);
+
+    *msglen = h_len;
+    if (!collector->copostRead(collector, msgbase, msglen, err)) {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ * fbCollectorReadFileRange
+ *
+ * The reader of a collector created by fbCollectorAllocFileRange().
+ * Returns the messages in the prefix, then reads messages from the file
+ * until the range is used up.
+ *
+ */
+static gboolean
+fbCollectorReadFileRange(
+    fbCollector_t  *collector,
+    uint8_t        *msgbase,
+    size_t         *msglen,
+    GError        **err)
+{
+    fbCollectorRange_t *range = collector->range;
+    fbCollectorMsgVL_t  hdr;
+    uint16_t            h_len;
+    off_t               start;
+    off_t               end;
+
+    if (range->prefix_off < range->prefix_len) {
+        /* the prefix is built by libfixbuf and holds whole messages */
+        memcpy(&hdr, range->prefix + range->prefix_off, sizeof(hdr));
+        if (!collector->coreadLen(collector, &hdr, *msglen, &h_len, err)) {
+            return FALSE;
+        }
+        memcpy(msgbase, range->prefix + range->prefix_off, h_len);
+        range->prefix_off += h_len;
+        *msglen = h_len;
+        return collector->copostRead(collector, msgbase, msglen, err);
+    }
+
+    if (0 == range->remaining) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_EOF,
+                    "End of file");
+        return FALSE;
+    }
+    start = ftello(collector->stream.fp);
+    if (!fbCollectorReadFile(collector, msgbase, msglen, err)) {
+        return FALSE;
+    }
+    end = ftello(collector->stream.fp);
+    if (start < 0 || end < start || (uint64_t)(end - start) > range->remaining)
+    {
+        range->remaining = 0;
+    } else {
+        range->remaining -= (uint64_t)(end - start);
+    }
+    return TRUE;
+}
+
+fbCollector_t *
+fbCollectorAllocFileRange(
+    void        *ctx,
+    const char  *path,
+    uint64_t     offset,
+    uint64_t     length,
+    uint8_t     *prefix,
+    size_t       prefix_len,
+    GError     **err)
+{
+    fbCollector_t *collector;
+    FILE          *fp;
+
+    fp = fopen(path, "r");
+    if (!fp) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                    "Couldn't open %s for collection: %s",
+                    path, strerror(errno));
+        return NULL;
+    }
+    if (fseeko(fp, (off_t)offset, SEEK_SET) != 0) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                    "Couldn't seek to offset %" G_GUINT64_FORMAT " of %s: %s",
+                    (guint64)offset, path, strerror(errno));
+        fclose(fp);
+        return NULL;
+    }
+
+    collector = fbCollectorAllocFP(ctx, fp);
+    collector->coclose = fbCollectorCloseFile;
+    collector->coread = fbCollectorReadFileRange;
+    collector->range = g_slice_new0(fbCollectorRange_t);
+    collector->range->prefix = prefix;
+    collector->range->prefix_len = prefix_len;
+    collector->range->remaining = length;
+
+    return collector;
+}
+
+/**
+ * fbCollectorAllocMappedFile
+ *
+ *
+ *
+ */
+fbCollector_t *
+fbCollectorAllocMappedFile(
+    void        *ctx,
+    const char  *path,
+    GError     **err)
+{
+    fbCollector_t *collector = NULL;
+    struct stat    st;
+    void          *map;
+
+    collector = fbCollectorAllocFile(ctx, path, err);
+    if (!collector) {
+        return NULL;
+    }
+
+    /* pipes, terminals, stdin, empty files, and compressed files are read
+     * as a stream */
+    if (collector->stream.fp == stdin || collector->compress ||
+        fstat(fileno(collector->stream.fp), &st) != 0 ||
+        !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+        (uintmax_t)st.st_size > (uintmax_t)SIZE_MAX)
+    {
+        return collector;
+    }
+
+    /* a private, writable mapping so that decoding in place can never
+     * modify the file */
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+               fileno(collector->stream.fp), 0);
+    if (MAP_FAILED == map) {
+        return collector;
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+
+    collector->map_base = (uint8_t *)map;
+    collector->map_len = (size_t)st.st_size;
+    collector->map_off = 0;
+    collector->coread = fbCollectorReadMappedFile;
+
+    return collector;
+}
+
+gboolean
+fbCollectorIsMapped(
+    fbCollector_t  *collector)
+{
+    /* translators may rewrite and grow the message; give them a copy */
+    return (collector->map_base && !collector->translationActive);
+}
+
+gboolean
+fbCollectMappedMessage(
+    fbCollector_t  *collector,
+    uint8_t       **msgbase,
+    size_t         *msglen,
+    GError        **err)
+{
+    uint16_t h_len;
+
+    /* Ensure stream is open */
+    if (!collector->active) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
+                    "Collector not active");
+        return FALSE;
+    }
+
+    if (!fbCollectorMapNextMessage(collector, msgbase, &h_len, err)) {
+        return FALSE;
+    }
+    *msglen = h_len;
+    ++collector->stats.messages;
+    return TRUE;
+}
+
 #if FB_ENABLE_SCTP
 
 /**
@@ -599,9 +953,63 @@ fbCollectorHandleSelect(
 }
 
 /**
- * fbCollectorReadTCP
+ * fbCollectorSavePartial
+ *
+ * Keeps the first `got` octets of the message being read at `msgbase`,
+ * and its length `len` once the header has been decoded (0 before), so
+ * the next call to the reader continues where this one stopped.
+ *
+ */
+static void
+fbCollectorSavePartial(
+    fbCollector_t  *collector,
+    const uint8_t  *msgbase,
+    size_t          got,
+    uint16_t        len)
+{
+    fbCollectorPartial_t *partial = &collector->partial;
+
+    if (got && !partial->buf) {
+        partial->buf = g_new(uint8_t, FB_MSGLEN_MAX);
+    }
+    memcpy(partial->buf, msgbase, got);
+    partial->got = got;
+    partial->len = len;
+}
+
+/**
+ * fbCollectorRestorePartial
+ *
+ * Copies a message kept by fbCollectorSavePartial() to `msgbase`, sets
+ * `len` to its decoded length or 0, and returns the number of octets
+ * copied.  The kept state is cleared.
  *
+ */
+static size_t
+fbCollectorRestorePartial(
+    fbCollector_t  *collector,
+    uint8_t        *msgbase,
+    uint16_t       *len)
+{
+    fbCollectorPartial_t *partial = &collector->partial;
+    size_t                got = partial->got;
+
+    if (got) {
+        memcpy(msgbase, partial->buf, got);
+    }
+    *len = partial->len;
+    partial->got = 0;
+    partial->len = 0;
+    return got;
+}
+
+/**
+ * fbCollectorReadTCP
  *
+ * Reads the 4-octet header, then the rest of the message.  If the read is
+ * interrupted or, on a non-blocking socket, would block, the octets read
+ * so far are kept and FB_ERROR_NLREAD is returned; the next call resumes
+ * the same message.
  *
  */
 static gboolean
@@ -611,34 +1019,51 @@ fbCollectorReadTCP(
     size_t         *msglen,
     GError        **err)
 {
-    int      rc;
-    uint16_t h_len, rrem;
-    gboolean goodLen;
+    ssize_t  rc;
+    size_t   got;
+    size_t   want;
+    uint16_t h_len;
 
-    /* Read and decode version and length */
     g_assert(*msglen > 4);
-    rrem = 4;
-    while (rrem) {
-        rc = fbCollectorHandleSelect(collector);
+    got = fbCollectorRestorePartial(collector, msgbase, &h_len);
+    for (;;) {
+        if (0 == h_len && got >= 4) {
+            /* Decode version and length */
+            if (!collector->coreadLen(collector, (fbCollectorMsgVL_t *)msgbase,
+                                      *msglen, &h_len, err))
+            {
+                return FALSE;
+            }
+        }
+        want = (h_len ? h_len : 4);
+        if (got >= want) {
+            break;
+        }
 
-        if (rc < 0) {
+        if (!collector->nonblocking && fbCollectorHandleSelect(collector) < 0)
+        {
+            /* interrupted by pipe read or other error with select*/
             g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
                         "Interrupted by pipe");
-            /* interrupted by pipe read or other error with select*/
+            fbCollectorSavePartial(collector, msgbase, got, h_len);
             return FALSE;
         }
 
-        rc = read(collector->stream.fd, msgbase, rrem);
+        rc = read(collector->stream.fd, msgbase + got, want - got);
         if (rc > 0) {
-            rrem -= rc;
-            msgbase += rc;
+            got += rc;
         } else if (rc == 0) {
             g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_EOF,
                         "End of file");
             return FALSE;
-        } else if (errno == EINTR) {
+        } else if (errno == EINTR || errno == EAGAIN ||
+                   errno == EWOULDBLOCK)
+        {
             g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_NLREAD,
-                        "TCP read interrupt at message start");
+                        "TCP read %s %s",
+                        ((errno == EINTR) ? "interrupt" : "would block"),
+                        (got ? "in message" : "at message start"));
+            fbCollectorSavePartial(collector, msgbase, got, h_len);
             return FALSE;
         } else {
             g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
@@ -646,33 +1071,386 @@ fbCollectorReadTCP(
             return FALSE;
         }
     }
-    goodLen = collector->coreadLen(collector,
-                                   (fbCollectorMsgVL_t *)(msgbase - 4),
-                                   *msglen, &h_len, err);
-    if (FALSE == goodLen) {return FALSE;}
 
-    /* read rest of message */
-    rrem = h_len - 4;
-    while (rrem) {
-        rc = fbCollectorHandleSelect(collector);
+    /* Post process, if needed and return message length from header. */
+    *msglen = h_len;
+    if (!collector->copostRead(collector, msgbase, msglen, err)) {
+        return FALSE;
+    }
+    return TRUE;
+}
 
-        if (rc < 0) {
+#if HAVE_LIBURING
+
+/* Number of submission queue entries in a collector's ring */
+#define FB_URING_ENTRIES      4
+
+/* Number and size of the buffers the multishot receive fills */
+#define FB_URING_RECV_BUFS    32
+#define FB_URING_RECV_BUFLEN  8192
+
+/* Buffer group of the receive buffers */
+#define FB_URING_BGID         0
+
+/**
+ * io_uring receive state of a TCP collector.  A single multishot receive
+ * stays armed on the socket and fills buffers the collector provides to
+ * the kernel; each completion names the buffer it filled.  The ring is
+ * created with deferred task running, so the kernel only moves data off
+ * the socket while the reading thread collects completions and the socket
+ * stays an accurate readiness source for fbListenerWait().
+ */
+struct fbCollectorUring_st {
+    struct io_uring            ring;
+    /** Ring of free receive buffers shared with the kernel */
+    struct io_uring_buf_ring  *br;
+    /** Storage of the receive buffers */
+    uint8_t                   *bufs;
+    /** TRUE once the ring is enabled; see fbCollectorUringFill() */
+    gboolean                   enabled;
+    /** TRUE while the multishot receive is outstanding */
+    gboolean                   armed;
+    /** 1 until the receive ends; then 0 at end of file or -errno */
+    int                        final;
+    /** Buffer holding received data not yet copied out, if 'cur_len' */
+    unsigned int               cur_bid;
+    /** Offset of that data in the buffer */
+    size_t                     cur_off;
+    /** Octets of that data */
+    size_t                     cur_len;
+};
+
+static void
+fbCollectorUringFree(
+    fbCollectorUring_t  *uring)
+{
+    if (uring) {
+        /* exiting the ring cancels the receive and drops the buffer ring */
+        io_uring_queue_exit(&uring->ring);
+        munmap(uring->br, FB_URING_RECV_BUFS * sizeof(struct io_uring_buf));
+        g_free(uring->bufs);
+        g_slice_free(fbCollectorUring_t, uring);
+    }
+}
+
+/**
+ * fbCollectorUringRecycle
+ *
+ * Returns receive buffer `bid` to the kernel.
+ *
+ */
+static void
+fbCollectorUringRecycle(
+    fbCollectorUring_t  *uring,
+    unsigned int         bid)
+{
+    io_uring_buf_ring_add(uring->br,
+                          uring->bufs + (size_t)bid * FB_URING_RECV_BUFLEN,
+                          FB_URING_RECV_BUFLEN, bid,
+                          io_uring_buf_ring_mask(FB_URING_RECV_BUFS), 0);
+    io_uring_buf_ring_advance(uring->br, 1);
+}
+
+/**
+ * fbCollectorUringAlloc
+ *
+ * Creates the ring and buffers of a TCP collector.  The ring is left
+ * disabled so the thread that first reads becomes its only submitter.
+ *
+ */
+static fbCollectorUring_t *
+fbCollectorUringAlloc(
+    GError        **err)
+{
+    fbCollectorUring_t     *uring = g_slice_new0(fbCollectorUring_t);
+    struct io_uring_params  params;
+    struct io_uring_buf_reg reg;
+    unsigned int            i;
+    int                     ret;
+
+    memset(&params, 0, sizeof(params));
+    params.flags = (IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN
+                    | IORING_SETUP_R_DISABLED);
+    ret = io_uring_queue_init_params(FB_URING_ENTRIES, &uring->ring, &params);
+    if (ret < 0) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                    "Unable to create io_uring: %s", strerror(-ret));
+        g_slice_free(fbCollectorUring_t, uring);
+        return NULL;
+    }
+
+    uring->br = mmap(NULL, FB_URING_RECV_BUFS * sizeof(struct io_uring_buf),
+                     PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE,
+                     -1, 0);
+    if (MAP_FAILED == uring->br) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                    "Unable to map io_uring buffer ring: %s",
+                    strerror(errno));
+        io_uring_queue_exit(&uring->ring);
+        g_slice_free(fbCollectorUring_t, uring);
+        return NULL;
+    }
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (unsigned long)uring->br;
+    reg.ring_entries = FB_URING_RECV_BUFS;
+    reg.bgid = FB_URING_BGID;
+    ret = io_uring_register_buf_ring(&uring->ring, &reg, 0);
+    if (ret < 0) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                    "Unable to register io_uring buffer ring: %s",
+                    strerror(-ret));
+        fbCollectorUringFree(uring);
+        return NULL;
+    }
+
+    uring->bufs = g_new(uint8_t, FB_URING_RECV_BUFS * FB_URING_RECV_BUFLEN);
+    for (i = 0; i < FB_URING_RECV_BUFS; ++i) {
+        fbCollectorUringRecycle(uring, i);
+    }
+    uring->final = 1;
+    return uring;
+}
+
+/**
+ * fbCollectorUringDrain
+ *
+ * Copies data the multishot receive has completed into the collector's
+ * read-ahead buffer until either runs out, without entering the kernel
+ * unless liburing must flush completions.  Returns TRUE if any data was
+ * copied.  Notes the end of the receive in 'final'.
+ *
+ */
+static gboolean
+fbCollectorUringDrain(
+    fbCollector_t  *collector)
+{
+    fbCollectorUring_t   *uring = collector->uring;
+    fbCollectorReadBuf_t *rbuf = collector->rbuf;
+    struct io_uring_cqe  *cqe;
+    gboolean              got = FALSE;
+    size_t                avail;
+    size_t                len;
+
+    for (;;) {
+        if (uring->cur_len) {
+            /* make room, moving any partial message to the front */
+            avail = rbuf->end - rbuf->start;
+            if (0 == avail) {
+                rbuf->start = rbuf->end = 0;
+            } else if (rbuf->end == rbuf->size && rbuf->start) {
+                memmove(rbuf->buf, rbuf->buf + rbuf->start, avail);
+                rbuf->start = 0;
+                rbuf->end = avail;
+            }
+            len = MIN(rbuf->size - rbuf->end, uring->cur_len);
+            if (0 == len) {
+                /* full; it holds at least one complete message */
+                return got;
+            }
+            memcpy(rbuf->buf + rbuf->end,
+                   (uring->bufs + (size_t)uring->cur_bid * FB_URING_RECV_BUFLEN
+                    + uring->cur_off), len);
+            rbuf->end += len;
+            uring->cur_off += len;
+            uring->cur_len -= len;
+            got = TRUE;
+            if (0 == uring->cur_len) {
+                fbCollectorUringRecycle(uring, uring->cur_bid);
+            }
+            continue;
+        }
+
+        if (io_uring_peek_cqe(&uring->ring, &cqe) != 0) {
+            return got;
+        }
+        if (!(cqe->flags & IORING_CQE_F_MORE)) {
+            uring->armed = FALSE;
+        }
+        if (cqe->res > 0) {
+            uring->cur_bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+            uring->cur_off = 0;
+            uring->cur_len = cqe->res;
+        } else {
+            if (cqe->flags & IORING_CQE_F_BUFFER) {
+                fbCollectorUringRecycle(uring,
+                                        cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+            }
+            /* running out of buffers only stops the receive; it is
+             * rearmed once they are recycled */
+            if (cqe->res != -ENOBUFS) {
+                uring->final = cqe->res;
+            }
+        }
+        io_uring_cqe_seen(&uring->ring, cqe);
+    }
+}
+
+/**
+ * fbCollectorUringFill
+ *
+ * io_uring replacement for the fbCollectorHandleSelect() and read() pair
+ * of the buffered TCP reader.  Arms the multishot receive if it is not
+ * outstanding and collects its completions with a single enter of the
+ * kernel, which also submits the receive.  Only when that yields nothing
+ * does it wait for the socket (and the interrupt pipe) to become readable,
+ * so a busy connection costs one system call per fill however many
+ * receives completed.
+ *
+ */
+static gboolean
+fbCollectorUringFill(
+    fbCollector_t  *collector,
+    GError        **err)
+{
+    fbCollectorUring_t  *uring = collector->uring;
+    struct io_uring_sqe *sqe;
+    int                  ret;
+
+    if (!uring->enabled) {
+        /* the reading thread becomes the ring's only submitter */
+        ret = io_uring_enable_rings(&uring->ring);
+        if (ret < 0) {
+            g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                        "Unable to enable io_uring: %s", strerror(-ret));
+            return FALSE;
+        }
+        uring->enabled = TRUE;
+    }
+
+    for (;;) {
+        if (fbCollectorUringDrain(collector)) {
+            return TRUE;
+        }
+        if (uring->final <= 0) {
+            break;
+        }
+        if (!uring->armed) {
+            sqe = io_uring_get_sqe(&uring->ring);
+            io_uring_prep_recv_multishot(sqe, collector->stream.fd,
+                                         NULL, 0, 0);
+            sqe->flags |= IOSQE_BUFFER_SELECT;
+            sqe->buf_group = FB_URING_BGID;
+            uring->armed = TRUE;
+        }
+        ret = io_uring_submit_and_get_events(&uring->ring);
+        if (ret < 0 && ret != -EINTR) {
+            g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                        "io_uring error: %s", strerror(-ret));
+            return FALSE;
+        }
+        if (fbCollectorUringDrain(collector)) {
+            return TRUE;
+        }
+        if (uring->final <= 0) {
+            break;
+        }
+        if (collector->nonblocking) {
+            g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_NLREAD,
+                        "TCP read would block");
+            return FALSE;
+        }
+        if (fbCollectorHandleSelect(collector) < 0) {
+            g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                        "Interrupted by pipe");
+            return FALSE;
+        }
+    }
+
+    if (0 == uring->final) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_EOF,
+                    "End of file");
+    } else {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                    "TCP I/O error: %s", strerror(-uring->final));
+    }
+    return FALSE;
+}
+#endif  /* HAVE_LIBURING */
+
+/**
+ * fbCollectorReadTCPBuffered
+ *
+ * The TCP reader used once fbCollectorSetTCPReadBuffer() is called.  Fills
+ * the collector's read-ahead buffer with as much data as the socket has
+ * available and copies one complete message at a time out of it, so a
+ * single read() usually yields many messages.  A partial message at the
+ * end of the buffer is moved to the front before the next read.
+ *
+ */
+static gboolean
+fbCollectorReadTCPBuffered(
+    fbCollector_t  *collector,
+    uint8_t        *msgbase,
+    size_t         *msglen,
+    GError        **err)
+{
+    fbCollectorReadBuf_t *rbuf = collector->rbuf;
+    uint16_t              h_len;
+    size_t                avail;
+    ssize_t               rc;
+
+    g_assert(*msglen > 4);
+    for (;;) {
+        avail = rbuf->end - rbuf->start;
+        if (avail >= 4) {
+            /* decode the header from a copy; the length function may
+             * rewrite it */
+            memcpy(msgbase, rbuf->buf + rbuf->start, 4);
+            if (!collector->coreadLen(collector, (fbCollectorMsgVL_t *)msgbase,
+                                      *msglen, &h_len, err))
+            {
+                return FALSE;
+            }
+            if (avail >= h_len) {
+                memcpy(msgbase + 4, rbuf->buf + rbuf->start + 4, h_len - 4);
+                rbuf->start += h_len;
+                *msglen = h_len;
+                return collector->copostRead(collector, msgbase, msglen, err);
+            }
+        }
+
+        /* Need more data.  Make room at the end of the buffer, moving any
+         * partial message to the front. */
+        if (0 == avail) {
+            rbuf->start = rbuf->end = 0;
+        } else if (rbuf->end == rbuf->size) {
+            memmove(rbuf->buf, rbuf->buf + rbuf->start, avail);
+            rbuf->start = 0;
+            rbuf->end = avail;
+        }
+
+#if HAVE_LIBURING
+        if (collector->uring) {
+            if (!fbCollectorUringFill(collector, err)) {
+                return FALSE;
+            }
+            continue;
+        }
+#endif  /* HAVE_LIBURING */
+
+        if (!collector->nonblocking && fbCollectorHandleSelect(collector) < 0)
+        {
             g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
                         "Interrupted by pipe");
             /* interrupted by pipe read or other error with select*/
             return FALSE;
         }
-        rc = read(collector->stream.fd, msgbase, rrem);
+
+        rc = read(collector->stream.fd, rbuf->buf + rbuf->end,
+                  rbuf->size - rbuf->end);
         if (rc > 0) {
-            rrem -= rc;
-            msgbase += rc;
+            rbuf->end += rc;
         } else if (rc == 0) {
             g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_EOF,
                         "End of file");
             return FALSE;
-        } else if (errno == EINTR) {
+        } else if (errno == EINTR || errno == EAGAIN ||
+                   errno == EWOULDBLOCK)
+        {
+            /* octets already read stay in the buffer */
             g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_NLREAD,
-                        "TCP read interrupt in message");
+                        "TCP read %s",
+                        ((errno == EINTR) ? "interrupt" : "would block"));
             return FALSE;
         } else {
             g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
@@ -680,15 +1458,151 @@ fbCollectorReadTCP(
             return FALSE;
         }
     }
+}
 
-    /* Post process, if needed and return message length from header. */
-    *msglen = h_len;
-    if (!collector->copostRead(collector, msgbase, msglen, err)) {
+gboolean
+fbCollectorSetTCPReadBuffer(
+    fbCollector_t  *collector,
+    size_t          size,
+    GError        **err)
+{
+    if (collector->coread != fbCollectorReadTCP &&
+        collector->coread != fbCollectorReadTCPBuffered)
+    {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IMPL,
+                    "Read buffering is only supported on TCP collectors");
         return FALSE;
     }
+    if ((collector->rbuf && collector->rbuf->end > collector->rbuf->start)
+#if HAVE_LIBURING
+        || (collector->uring && collector->uring->cur_len)
+#endif
+        )
+    {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_SETUP,
+                    "Cannot change TCP read buffer while it holds unread"
+                    " data");
+        return FALSE;
+    }
+
+    if (collector->rbuf) {
+        g_free(collector->rbuf->buf);
+        g_slice_free(fbCollectorReadBuf_t, collector->rbuf);
+        collector->rbuf = NULL;
+    }
+    if (0 == size) {
+#if HAVE_LIBURING
+        /* the ring reads into the read-ahead buffer */
+        fbCollectorUringFree(collector->uring);
+        collector->uring = NULL;
+#endif
+        collector->coread = fbCollectorReadTCP;
+        return TRUE;
+    }
+
+    /* must hold the largest possible message */
+    if (size < FB_MSGLEN_MAX) {
+        size = FB_MSGLEN_MAX;
+    }
+    collector->rbuf = g_slice_new0(fbCollectorReadBuf_t);
+    collector->rbuf->buf = g_new(uint8_t, size);
+    collector->rbuf->size = size;
+    collector->coread = fbCollectorReadTCPBuffered;
     return TRUE;
 }
 
+gboolean
+fbCollectorSetIOBackend(
+    fbCollector_t  *collector,
+    fbIOBackend_t   backend,
+    GError        **err)
+{
+    if (collector->coread != fbCollectorReadTCP &&
+        collector->coread != fbCollectorReadTCPBuffered)
+    {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IMPL,
+                    "Alternate I/O backends are only supported on TCP"
+                    " collectors");
+        return FALSE;
+    }
+
+    switch (backend) {
+      case FB_IO_SYSCALL:
+#if HAVE_LIBURING
+        if (collector->uring && collector->uring->cur_len) {
+            g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_SETUP,
+                        "Cannot change I/O backend while io_uring holds"
+                        " unread data");
+            return FALSE;
+        }
+        fbCollectorUringFree(collector->uring);
+        collector->uring = NULL;
+#endif
+        return TRUE;
+      case FB_IO_URING:
+#if HAVE_LIBURING
+        if (collector->uring) {
+            return TRUE;
+        }
+        /* the ring reads into the read-ahead buffer */
+        if (!collector->rbuf &&
+            !fbCollectorSetTCPReadBuffer(collector, FB_TCP_READ_BUFFER_DEFAULT,
+                                         err))
+        {
+            return FALSE;
+        }
+        collector->uring = fbCollectorUringAlloc(err);
+        return (NULL != collector->uring);
+#else
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IMPL,
+                    "libfixbuf was built without io_uring support");
+        return FALSE;
+#endif  /* HAVE_LIBURING */
+    }
+
+    g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IMPL,
+                "Unknown I/O backend %d", (int)backend);
+    return FALSE;
+}
+
+/**
+ * fbCollectorUDPSpecHash
+ *
+ * Hashes the peer address and observation domain of a UDP connection
+ * spec, the key of the collector's table of peers.
+ *
+ */
+static guint
+fbCollectorUDPSpecHash(
+    gconstpointer   v)
+{
+    const fbUDPConnSpec_t *spec = (const fbUDPConnSpec_t *)v;
+    const uint8_t         *cp = (const uint8_t *)&spec->peer;
+    guint                  h = 5381;
+    size_t                 i;
+
+    for (i = 0; i < spec->peerlen; ++i) {
+        h = (h << 5) + h + cp[i];
+    }
+    return h ^ spec->obdomain;
+}
+
+/**
+ * fbCollectorUDPSpecEqual
+ *
+ */
+static gboolean
+fbCollectorUDPSpecEqual(
+    gconstpointer   a,
+    gconstpointer   b)
+{
+    const fbUDPConnSpec_t *x = (const fbUDPConnSpec_t *)a;
+    const fbUDPConnSpec_t *y = (const fbUDPConnSpec_t *)b;
+
+    return (x->obdomain == y->obdomain && x->peerlen == y->peerlen
+            && 0 == memcmp(&x->peer, &y->peer, x->peerlen));
+}
+
 static void
 fbCollectorSetUDPSpec(
     fbCollector_t    *collector,
@@ -731,6 +1645,10 @@ fbCollectorFreeUDPSpec(
     /* let translators release state */
     collector->cotimeOut(collector, spec->session);
 
+    if (collector->udp_peers) {
+        g_hash_table_remove(collector->udp_peers, spec);
+    }
+
     /* don't free the last session, fbufree will do that */
     if (collector->udp_tail != collector->udp_head) {
         fbSessionFree(spec->session);
@@ -765,8 +1683,8 @@ fbCollectorVerifyUDPPeer(
     socklen_t         fromlen,
     GError          **err)
 {
-    fbUDPConnSpec_t *udp = collector->udp_head;
-    gboolean         found = FALSE;
+    fbUDPConnSpec_t *udp;
+    fbUDPConnSpec_t  key;
 
     /* stash the address if we've not seen it before */
     /* compare the address if we have */
@@ -800,30 +1718,26 @@ fbCollectorVerifyUDPPeer(
                sizeof(collector->peer) : fromlen);
     }
 
-    while (udp) {
-        /* loop through and find current one */
-        if (udp->obdomain == collector->obdomain) {
-            if (!memcmp(&(udp->peer.so), from, udp->peerlen)) {
-                /* we have a match - set session */
-                fbCollectorSetUDPSpec(collector, udp);
-                found = TRUE;
-                break;
-            }
-        }
-        udp = udp->next;
+    /* find the spec of this peer and domain */
+    if (NULL == collector->udp_peers) {
+        collector->udp_peers = g_hash_table_new(fbCollectorUDPSpecHash,
+                                                fbCollectorUDPSpecEqual);
     }
+    memset(&key, 0, sizeof(key));
+    key.peerlen = ((fromlen > sizeof(key.peer)) ? sizeof(key.peer) : fromlen);
+    memcpy(&(key.peer.so), from, key.peerlen);
+    key.obdomain = collector->obdomain;
+    udp = g_hash_table_lookup(collector->udp_peers, &key);
 
-    if (!found) {
+    if (!udp) {
         udp = g_slice_new0(fbUDPConnSpec_t);
-        memcpy(&(udp->peer.so), from, (fromlen > sizeof(udp->peer)) ?
-               sizeof(udp->peer) : fromlen);
-        udp->peerlen = ((fromlen > sizeof(udp->peer))
-                        ? sizeof(udp->peer)
-                        : fromlen);
+        memcpy(&(udp->peer.so), &(key.peer.so), key.peerlen);
+        udp->peerlen = key.peerlen;
         udp->obdomain = collector->obdomain;
         /* create a new session */
         udp->session = fbListenerSetPeerSession(collector->listener, NULL);
         fbCollectorSetUDPSpec(collector, udp);
+        g_hash_table_insert(collector->udp_peers, udp, udp);
 
         /* call app init for new UDP connection*/
         if (collector->multi_session) {
@@ -838,6 +1752,8 @@ fbCollectorVerifyUDPPeer(
             udp->ctx = collector->ctx;
         }
     } else {
+        /* we have a match - set session */
+        fbCollectorSetUDPSpec(collector, udp);
         if (udp->reject) {
             g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_NLREAD,
                         "Rejecting previously rejected connection");
@@ -848,88 +1764,526 @@ fbCollectorVerifyUDPPeer(
     collector->ctx = udp->ctx;
     udp->last_seen = collector->time;
 
-    while (collector->udp_tail &&
-           (difftime(collector->time, collector->udp_tail->last_seen) >
-            FB_UDP_TIMEOUT))
+    /* the list is in order of last use, so idle peers are at the tail */
+    while (collector->udp_tail &&
+           (difftime(collector->time, collector->udp_tail->last_seen) >
+            collector->udp_timeout))
+    {
+        /* timeout check */
+        fbCollectorFreeUDPSpec(collector, collector->udp_tail);
+    }
+
+    return TRUE;
+}
+
+/* Room for the ancillary data of one datagram */
+#define FB_UDP_CMSGLEN  64
+
+/**
+ * fbCollectorUDPStatsQueued
+ *
+ * When statistics are enabled on a UDP collector, samples the number of
+ * octets waiting in its socket receive queue and updates the collector's
+ * high-water mark.  Called when the socket is readable, before the
+ * datagrams are received.
+ *
+ */
+static void
+fbCollectorUDPStatsQueued(
+    fbCollector_t  *collector)
+{
+#if defined(SO_MEMINFO) && HAVE_LINUX_SOCK_DIAG_H
+    uint32_t  meminfo[SK_MEMINFO_VARS];
+    socklen_t len = sizeof(meminfo);
+
+    if (!collector->udp_stats) {
+        return;
+    }
+    if (getsockopt(collector->stream.fd, SOL_SOCKET, SO_MEMINFO,
+                   meminfo, &len) == 0)
+    {
+        collector->udp_queued = meminfo[SK_MEMINFO_RMEM_ALLOC];
+        collector->stats.rcvbuf_size = meminfo[SK_MEMINFO_RCVBUF];
+        if (collector->udp_queued > collector->stats.rcvbuf_high) {
+            collector->stats.rcvbuf_high = collector->udp_queued;
+        }
+    }
+#else  /* SO_MEMINFO */
+    (void)collector;
+#endif  /* SO_MEMINFO */
+}
+
+/**
+ * fbCollectorUDPStatsDatagram
+ *
+ * When statistics are enabled on a UDP collector, reads the kernel's
+ * count of datagrams dropped on the socket from the ancillary data `mh`
+ * of a received datagram and returns the number dropped since the last
+ * datagram, adding it to the collector's total.
+ *
+ */
+static uint32_t
+fbCollectorUDPStatsDatagram(
+    fbCollector_t        *collector,
+    const struct msghdr  *mh)
+{
+#ifdef SO_RXQ_OVFL
+    struct cmsghdr *cmsg;
+    uint32_t        ovfl;
+    uint32_t        drops;
+
+    if (!collector->udp_stats) {
+        return 0;
+    }
+    for (cmsg = CMSG_FIRSTHDR((struct msghdr *)mh); cmsg != NULL;
+         cmsg = CMSG_NXTHDR((struct msghdr *)mh, cmsg))
+    {
+        if (SOL_SOCKET == cmsg->cmsg_level && SO_RXQ_OVFL == cmsg->cmsg_type)
+        {
+            /* a running count for the socket */
+            memcpy(&ovfl, CMSG_DATA(cmsg), sizeof(ovfl));
+            drops = ovfl - collector->udp_ovfl;
+            collector->udp_ovfl = ovfl;
+            collector->stats.kernel_drops += drops;
+            return drops;
+        }
+    }
+#else  /* SO_RXQ_OVFL */
+    (void)collector;
+    (void)mh;
+#endif  /* SO_RXQ_OVFL */
+    return 0;
+}
+
+/**
+ * fbCollectorUDPStatsPeer
+ *
+ * Charges a datagram accepted by fbCollectorVerifyUDPPeer(), and the
+ * `drops` seen with it, to the current peer.  Called for every datagram;
+ * the socket figures stay zero unless statistics are enabled.
+ *
+ */
+static void
+fbCollectorUDPStatsPeer(
+    fbCollector_t  *collector,
+    uint32_t        drops)
+{
+    fbCollectorStats_t *stats = &collector->udp_head->stats;
+
+    ++stats->messages;
+    stats->kernel_drops += drops;
+    if (collector->udp_queued > stats->rcvbuf_high) {
+        stats->rcvbuf_high = collector->udp_queued;
+    }
+    stats->rcvbuf_size = collector->stats.rcvbuf_size;
+}
+
+/**
+ * fbCollectorReadUDP
+ *
+ *
+ *
+ */
+static gboolean
+fbCollectorReadUDP(
+    fbCollector_t  *collector,
+    uint8_t        *msgbase,
+    size_t         *msglen,
+    GError        **err)
+{
+    uint16_t msgSize = 0;
+    ssize_t  recvlen = 0;
+    int      rc;
+    union {
+        struct sockaddr       so;
+        struct sockaddr_in    ip4;
+        struct sockaddr_in6   ip6;
+    }                           peer;
+    socklen_t peerlen;
+    struct msghdr mh;
+    struct iovec  iov;
+    union {
+        struct cmsghdr   hdr;
+        uint8_t          buf[FB_UDP_CMSGLEN];
+    }             ctrl;
+    uint32_t      drops;
+
+    memset(&peer, 0, sizeof(peer));
+
+    rc = fbCollectorHandleSelect(collector);
+
+    if (rc < 0) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                    "Interrupted by pipe");
+        /* interrupted by pipe read or other error with select*/
+        return FALSE;
+    }
+    fbCollectorUDPStatsQueued(collector);
+
+    iov.iov_base = msgbase;
+    iov.iov_len = *msglen;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_name = &peer;
+    mh.msg_namelen = sizeof(peer);
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    if (collector->udp_stats) {
+        mh.msg_control = &ctrl;
+        mh.msg_controllen = sizeof(ctrl);
+    }
+    recvlen = recvmsg(collector->stream.fd, &mh, 0);
+    peerlen = mh.msg_namelen;
+    drops = (recvlen > 0) ? fbCollectorUDPStatsDatagram(collector, &mh) : 0;
+
+    if (peer.so.sa_family == AF_INET6) {
+        peer.ip6.sin6_flowinfo = 0;
+        peer.ip6.sin6_scope_id = 0;
+    }
+
+    if (!collector->comsgHeader(collector, msgbase, recvlen, &msgSize, err)) {
+        return FALSE;
+    }
+
+    if (msgSize > 0) {
+        *msglen = msgSize;
+        /** Fixed this to do the right thing.  We now map ip
+         * addresses/port and observation domains to sessions.  If
+         * accept-only is set on the collector, we'll only return TRUE
+         * if the ip/ports match.  We will return NL_READ if FALSE, and the
+         * app using fixbuf should ignore error codes = NL_READ.**/
+
+        /* this will only veto if we set accept from explicitly*/
+        if (!fbCollectorVerifyUDPPeer(collector, &(peer.so), peerlen, err)) {
+            return FALSE;
+        }
+        fbCollectorUDPStatsPeer(collector, drops);
+        if (!collector->copostRead(collector, msgbase, msglen, err)) {
+            return FALSE;
+        }
+        return TRUE;
+    } else if (errno == EINTR || errno == EWOULDBLOCK) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_NLREAD,
+                    "UDP read interrupt or timeout");
+        return FALSE;
+    } else {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                    "UDP I/O error: %s", strerror(errno));
+        return FALSE;
+    }
+}
+
+#if HAVE_RECVMMSG
+/**
+ *  A slot's peer address; the same layout as the peer in fbCollector_t.
+ */
+typedef union fbCollectorUDPPeer_un {
+    struct sockaddr       so;
+    struct sockaddr_in    ip4;
+    struct sockaddr_in6   ip6;
+} fbCollectorUDPPeer_t;
+
+struct fbCollectorUDPBatch_st {
+    /** Message headers passed to recvmmsg(), one per slot */
+    struct mmsghdr        *msgs;
+    /** I/O vectors, one per slot, each pointing into 'bufs' */
+    struct iovec          *iov;
+    /** Peer address of the datagram in each slot */
+    fbCollectorUDPPeer_t  *peers;
+    /** Ancillary data of each slot, FB_UDP_CMSGLEN octets per slot */
+    uint8_t               *ctrl;
+    /** Datagram storage, FB_MSGLEN_MAX octets per slot */
+    uint8_t               *bufs;
+    /** Number of slots */
+    unsigned int           count;
+    /** Number of slots filled by the last recvmmsg() */
+    unsigned int           filled;
+    /** Next filled slot to hand to the fBuf */
+    unsigned int           next;
+};
+
+static void
+fbCollectorUDPBatchFree(
+    fbCollectorUDPBatch_t  *batch)
+{
+    if (batch) {
+        g_free(batch->msgs);
+        g_free(batch->iov);
+        g_free(batch->peers);
+        g_free(batch->ctrl);
+        g_free(batch->bufs);
+        g_slice_free(fbCollectorUDPBatch_t, batch);
+    }
+}
+
+static fbCollectorUDPBatch_t *
+fbCollectorUDPBatchAlloc(
+    unsigned int   count)
+{
+    fbCollectorUDPBatch_t *batch = g_slice_new0(fbCollectorUDPBatch_t);
+    unsigned int           i;
+
+    batch->count = count;
+    batch->msgs = g_new0(struct mmsghdr, count);
+    batch->iov = g_new0(struct iovec, count);
+    batch->peers = g_new0(fbCollectorUDPPeer_t, count);
+    /* g_malloc() memory is suitably aligned for a struct cmsghdr */
+    batch->ctrl = g_new0(uint8_t, (size_t)count * FB_UDP_CMSGLEN);
+    batch->bufs = g_new(uint8_t, (size_t)count * FB_MSGLEN_MAX);
+
+    for (i = 0; i < count; ++i) {
+        batch->iov[i].iov_base = batch->bufs + (size_t)i * FB_MSGLEN_MAX;
+        batch->iov[i].iov_len = FB_MSGLEN_MAX;
+        batch->msgs[i].msg_hdr.msg_iov = &batch->iov[i];
+        batch->msgs[i].msg_hdr.msg_iovlen = 1;
+        batch->msgs[i].msg_hdr.msg_name = &batch->peers[i];
+    }
+    return batch;
+}
+
+/**
+ * fbCollectorReadUDPBatch
+ *
+ * The UDP reader used once fbCollectorSetUDPBatch() is called.  When every
+ * datagram from the previous receive has been handed out, waits for the
+ * socket and fills the ring with a single recvmmsg(); then copies the next
+ * datagram into msgbase and processes it exactly as fbCollectorReadUDP()
+ * does, using the peer address that arrived with that datagram.
+ *
+ */
+static gboolean
+fbCollectorReadUDPBatch(
+    fbCollector_t  *collector,
+    uint8_t        *msgbase,
+    size_t         *msglen,
+    GError        **err)
+{
+    fbCollectorUDPBatch_t *batch = collector->udp_batch;
+    fbCollectorUDPPeer_t  *peer;
+    uint16_t               msgSize = 0;
+    size_t                 recvlen;
+    uint32_t               drops;
+    unsigned int           i;
+    int                    rc;
+
+    if (batch->next >= batch->filled) {
+        batch->next = 0;
+        batch->filled = 0;
+
+        rc = fbCollectorHandleSelect(collector);
+        if (rc < 0) {
+            g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                        "Interrupted by pipe");
+            /* interrupted by pipe read or other error with select*/
+            return FALSE;
+        }
+
+        fbCollectorUDPStatsQueued(collector);
+        memset(batch->peers, 0, batch->count * sizeof(fbCollectorUDPPeer_t));
+        for (i = 0; i < batch->count; ++i) {
+            batch->msgs[i].msg_hdr.msg_namelen = sizeof(fbCollectorUDPPeer_t);
+            if (collector->udp_stats) {
+                batch->msgs[i].msg_hdr.msg_control =
+                    batch->ctrl + (size_t)i * FB_UDP_CMSGLEN;
+                batch->msgs[i].msg_hdr.msg_controllen = FB_UDP_CMSGLEN;
+            }
+        }
+
+        /* the socket is readable; take whatever is queued without
+         * blocking for the rest of the ring */
+        rc = recvmmsg(collector->stream.fd, batch->msgs, batch->count,
+                      MSG_DONTWAIT, NULL);
+        if (rc <= 0) {
+            if (rc == 0 || errno == EINTR || errno == EWOULDBLOCK ||
+                errno == EAGAIN)
+            {
+                g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_NLREAD,
+                            "UDP read interrupt or timeout");
+            } else {
+                g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                            "UDP I/O error: %s", strerror(errno));
+            }
+            return FALSE;
+        }
+        batch->filled = rc;
+    }
+
+    i = batch->next++;
+    peer = &batch->peers[i];
+    recvlen = batch->msgs[i].msg_len;
+    drops = fbCollectorUDPStatsDatagram(collector, &batch->msgs[i].msg_hdr);
+    if (recvlen > *msglen) {
+        recvlen = *msglen;
+    }
+    memcpy(msgbase, batch->iov[i].iov_base, recvlen);
+
+    if (peer->so.sa_family == AF_INET6) {
+        peer->ip6.sin6_flowinfo = 0;
+        peer->ip6.sin6_scope_id = 0;
+    }
+
+    if (!collector->comsgHeader(collector, msgbase, recvlen, &msgSize, err)) {
+        return FALSE;
+    }
+
+    if (0 == msgSize) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_NLREAD,
+                    "Empty UDP datagram");
+        return FALSE;
+    }
+
+    *msglen = msgSize;
+    if (!fbCollectorVerifyUDPPeer(collector, &(peer->so),
+                                  batch->msgs[i].msg_hdr.msg_namelen, err))
+    {
+        return FALSE;
+    }
+    fbCollectorUDPStatsPeer(collector, drops);
+    if (!collector->copostRead(collector, msgbase, msglen, err)) {
+        return FALSE;
+    }
+    return TRUE;
+}
+#endif  /* HAVE_RECVMMSG */
+
+gboolean
+fbCollectorSetUDPBatch(
+    fbCollector_t  *collector,
+    unsigned int    count,
+    GError        **err)
+{
+#if HAVE_RECVMMSG
+    if (collector->coread != fbCollectorReadUDP &&
+        collector->coread != fbCollectorReadUDPBatch)
+    {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IMPL,
+                    "Batched reads are only supported on UDP collectors");
+        return FALSE;
+    }
+    if (collector->udp_batch &&
+        collector->udp_batch->next < collector->udp_batch->filled)
+    {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_SETUP,
+                    "Cannot change UDP batch size while datagrams from the"
+                    " previous batch are unread");
+        return FALSE;
+    }
+    if (count > FB_UDP_BATCH_MAX) {
+        count = FB_UDP_BATCH_MAX;
+    }
+
+    fbCollectorUDPBatchFree(collector->udp_batch);
+    collector->udp_batch = NULL;
+    if (count <= 1) {
+        collector->coread = fbCollectorReadUDP;
+    } else {
+        collector->udp_batch = fbCollectorUDPBatchAlloc(count);
+        collector->coread = fbCollectorReadUDPBatch;
+    }
+    return TRUE;
+#else  /* HAVE_RECVMMSG */
+    (void)collector;
+    if (count <= 1) {
+        return TRUE;
+    }
+    g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IMPL,
+                "Batched UDP reads require recvmmsg(), which is not"
+                " available on this platform");
+    return FALSE;
+#endif  /* HAVE_RECVMMSG */
+}
+
+gboolean
+fbCollectorSetUDPTimeout(
+    fbCollector_t  *collector,
+    uint32_t        timeout,
+    GError        **err)
+{
+    if (collector->coread != fbCollectorReadUDP
+#if HAVE_RECVMMSG
+        && collector->coread != fbCollectorReadUDPBatch
+#endif
+        )
     {
-        /* timeout check */
-        fbCollectorFreeUDPSpec(collector, collector->udp_tail);
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IMPL,
+                    "Peer timeouts are only supported on UDP collectors");
+        return FALSE;
     }
-
+    collector->udp_timeout = timeout ? timeout : FB_UDP_TIMEOUT;
     return TRUE;
 }
 
-/**
- * fbCollectorReadUDP
- *
- *
- *
- */
-static gboolean
-fbCollectorReadUDP(
+gboolean
+fbCollectorEnableUDPStats(
     fbCollector_t  *collector,
-    uint8_t        *msgbase,
-    size_t         *msglen,
     GError        **err)
 {
-    uint16_t msgSize = 0;
-    ssize_t  recvlen = 0;
-    int      rc;
-    union {
-        struct sockaddr       so;
-        struct sockaddr_in    ip4;
-        struct sockaddr_in6   ip6;
-    }                           peer;
-    socklen_t peerlen;
-
-    memset(&peer, 0, sizeof(peer));
-
-    rc = fbCollectorHandleSelect(collector);
+#ifdef SO_RXQ_OVFL
+    int on = 1;
+#endif
 
-    if (rc < 0) {
+    if (collector->coread != fbCollectorReadUDP
+#if HAVE_RECVMMSG
+        && collector->coread != fbCollectorReadUDPBatch
+#endif
+        )
+    {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IMPL,
+                    "Socket statistics are only supported on UDP collectors");
+        return FALSE;
+    }
+#ifdef SO_RXQ_OVFL
+    if (setsockopt(collector->stream.fd, SOL_SOCKET, SO_RXQ_OVFL,
+                   &on, sizeof(on)) != 0)
+    {
         g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
-                    "Interrupted by pipe");
-        /* interrupted by pipe read or other error with select*/
+                    "Unable to enable SO_RXQ_OVFL: %s", strerror(errno));
         return FALSE;
     }
+#endif  /* SO_RXQ_OVFL */
+    collector->udp_stats = TRUE;
+    return TRUE;
+}
 
-    peerlen = sizeof(peer);
-    recvlen = recvfrom(collector->stream.fd, msgbase, *msglen, 0,
-                       (struct sockaddr *)&peer, &peerlen);
+void
+fbCollectorGetStats(
+    fbCollector_t       *collector,
+    fbCollectorStats_t  *stats)
+{
+    *stats = collector->stats;
+}
 
-    if (peer.so.sa_family == AF_INET6) {
-        peer.ip6.sin6_flowinfo = 0;
-        peer.ip6.sin6_scope_id = 0;
-    }
+void
+fbCollectorForEachPeerStats(
+    fbCollector_t            *collector,
+    fbCollectorPeerStats_fn   fn,
+    void                     *ctx)
+{
+    fbUDPConnSpec_t *udp;
 
-    if (!collector->comsgHeader(collector, msgbase, recvlen, &msgSize, err)) {
-        return FALSE;
+    for (udp = collector->udp_head; udp != NULL; udp = udp->next) {
+        fn(&udp->peer.so, udp->peerlen, udp->obdomain, &udp->stats, ctx);
     }
+}
 
-    if (msgSize > 0) {
-        *msglen = msgSize;
-        /** Fixed this to do the right thing.  We now map ip
-         * addresses/port and observation domains to sessions.  If
-         * accept-only is set on the collector, we'll only return TRUE
-         * if the ip/ports match.  We will return NL_READ if FALSE, and the
-         * app using fixbuf should ignore error codes = NL_READ.**/
-
-        /* this will only veto if we set accept from explicitly*/
-        if (!fbCollectorVerifyUDPPeer(collector, &(peer.so), peerlen, err)) {
-            return FALSE;
-        }
-        if (!collector->copostRead(collector, msgbase, msglen, err)) {
-            return FALSE;
+void
+fbCollectorNoteSequenceGap(
+    fbCollector_t  *collector,
+    uint32_t        expected,
+    uint32_t        received)
+{
+    uint32_t missing = received - expected;
+
+    ++collector->stats.seq_gaps;
+    /* a message from behind the expected number was reordered or
+     * duplicated, not lost */
+    if (missing < 0x80000000) {
+        collector->stats.seq_missing += missing;
+    }
+    if (collector->udp_head) {
+        ++collector->udp_head->stats.seq_gaps;
+        if (missing < 0x80000000) {
+            collector->udp_head->stats.seq_missing += missing;
         }
-        return TRUE;
-    } else if (errno == EINTR || errno == EWOULDBLOCK) {
-        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_NLREAD,
-                    "UDP read interrupt or timeout");
-        return FALSE;
-    } else {
-        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
-                    "UDP I/O error: %s", strerror(errno));
-        return FALSE;
     }
 }
 
@@ -988,6 +2342,7 @@ fbCollectorAllocSocket(
     collector->ctx = ctx;
     collector->stream.fd = fd;
     collector->bufferedStream = FALSE;
+    collector->udp_timeout = FB_UDP_TIMEOUT;
     collector->active = TRUE;
     collector->copostRead = fbCollectorPostProcNull;
     collector->coreadLen = fbCollectorDecodeMsgVL;
@@ -1052,51 +2407,60 @@ fbCollectorReadTLS(
     GError        **err)
 {
     int      rc;
-    uint16_t h_len, rrem;
+    int      sslerr;
+    size_t   got;
+    size_t   want;
+    uint16_t h_len;
     char     errbuf[FB_SSL_ERR_BUFSIZ];
-    gboolean rv;
 
-    /* Read and decode version and length */
     g_assert(*msglen > 4);
-    rrem = 4;
-    while (rrem) {
-        rc = SSL_read(collector->ssl, msgbase, rrem);
+    got = fbCollectorRestorePartial(collector, msgbase, &h_len);
+    for (;;) {
+        if (0 == h_len && got >= 4) {
+            /* Decode version and length */
+            if (!collector->coreadLen(collector, (fbCollectorMsgVL_t *)msgbase,
+                                      *msglen, &h_len, err))
+            {
+                return FALSE;
+            }
+        }
+        want = (h_len ? h_len : 4);
+        if (got >= want) {
+            break;
+        }
+
+        rc = SSL_read(collector->ssl, msgbase + got, want - got);
         if (rc > 0) {
-            rrem -= rc;
-            msgbase += rc;
-        } else if (rc == 0) {
+            got += rc;
+            continue;
+        }
+        sslerr = SSL_get_error(collector->ssl, rc);
+        if (SSL_ERROR_WANT_READ == sslerr || SSL_ERROR_WANT_WRITE == sslerr ||
+            (SSL_ERROR_SYSCALL == sslerr && EINTR == errno))
+        {
+            /* interrupted, or a non-blocking socket has no data yet */
+            g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_NLREAD,
+                        "TLS read %s %s",
+                        ((SSL_ERROR_SYSCALL == sslerr)
+                         ? "interrupt" : "would block"),
+                        (got ? "in message" : "at message start"));
+            fbCollectorSavePartial(collector, msgbase, got, h_len);
+            return FALSE;
+        }
+        if (0 == rc || SSL_ERROR_ZERO_RETURN == sslerr) {
             /* FIXME this isn't _quite_ robust but it's good enough for now.
              * we'll fix this when we do TLS/TCP stress testing. */
             g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_EOF,
                         "TLS connection shutdown");
-            return FALSE;
-        } else {
-            ERR_error_string_n(ERR_get_error(), errbuf, sizeof(errbuf));
-            g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
-                        "TLS I/O error at message start: %s", errbuf);
-            ERR_clear_error();
-            return FALSE;
-        }
-    }
-    rv = collector->coreadLen(collector,
-                              (fbCollectorMsgVL_t *)(msgbase - 4),
-                              *msglen, &h_len, err);
-    if (rv == FALSE) {return FALSE;}
-
-    /* read rest of message */
-    rrem = h_len - 4;
-    while (rrem) {
-        rc = SSL_read(collector->ssl, msgbase, rrem);
-        if (rc > 0) {
-            rrem -= rc;
-            msgbase += rc;
-        } else {
-            ERR_error_string_n(ERR_get_error(), errbuf, sizeof(errbuf));
-            g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
-                        "TLS I/O error in message: %s", errbuf);
             ERR_clear_error();
             return FALSE;
         }
+        ERR_error_string_n(ERR_get_error(), errbuf, sizeof(errbuf));
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                    "TLS I/O error %s: %s",
+                    (got ? "in message" : "at message start"), errbuf);
+        ERR_clear_error();
+        return FALSE;
     }
 
     /* All done. Return message length from header. */
@@ -1305,6 +2669,7 @@ fbCollectorAllocTLS(
     collector->ctx = ctx;
     collector->stream.fd = fd;
     collector->bufferedStream = FALSE;
+    collector->udp_timeout = FB_UDP_TIMEOUT;
     collector->active = TRUE;
     collector->copostRead = fbCollectorPostProcNull;
     collector->coreadLen = fbCollectorDecodeMsgVL;
@@ -1560,6 +2925,7 @@ fbCollectorAllocSpread(
     collector->ctx = ctx;
     collector->stream.spread = fbConnSpreadCopy(params);
     collector->bufferedStream = FALSE;
+    collector->udp_timeout = FB_UDP_TIMEOUT;
     collector->active = FALSE;
     collector->spread_active = 1;
 
@@ -1635,7 +3001,10 @@ fbCollectMessage(
     }
 
     /* Attempt to read message */
-    if (collector->coread(collector, msgbase, msglen, err)) {return TRUE;}
+    if (collector->coread(collector, msgbase, msglen, err)) {
+        ++collector->stats.messages;
+        return TRUE;
+    }
 
     /* Read failure; signal error */
     return FALSE;
@@ -1674,6 +3043,42 @@ fbCollectorHasTranslator(
     return collector->translationActive;
 }
 
+gboolean
+fbCollectorSetNonBlocking(
+    fbCollector_t  *collector,
+    gboolean        nonblocking,
+    GError        **err)
+{
+    int flags;
+
+    if (collector->coread != fbCollectorReadTCP &&
+        collector->coread != fbCollectorReadTCPBuffered
+#if HAVE_OPENSSL
+        && collector->coread != fbCollectorReadTLS
+#endif
+        )
+    {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IMPL,
+                    "Non-blocking reads are only supported on TCP and TLS"
+                    " collectors");
+        return FALSE;
+    }
+
+    flags = fcntl(collector->stream.fd, F_GETFL);
+    if (flags < 0 ||
+        fcntl(collector->stream.fd, F_SETFL,
+              (nonblocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK)))
+        < 0)
+    {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                    "Unable to change socket blocking mode: %s",
+                    strerror(errno));
+        return FALSE;
+    }
+    collector->nonblocking = nonblocking;
+    return TRUE;
+}
+
 /**
  * fbCollectorGetFD
  *
@@ -1704,6 +3109,337 @@ fbCollectorSetFD(
 }
 
 
+/*
+ *  Read-ahead: a thread runs the collector's reader and keeps a ring of
+ *  complete messages filled, and the collector's reader is replaced by one
+ *  that takes messages from the ring.  The thread is the only producer and
+ *  the fBuf the only consumer, so the ring needs no lock: each side owns
+ *  its index and they share only the count of full slots.  A side sleeps
+ *  on the condition only when the ring is empty or full, after announcing
+ *  it in 'waiting' so the other side knows to signal.
+ */
+
+/* Size of each slot of the read-ahead ring; the size of an fBuf's buffer */
+#define FB_AHEAD_SLOTLEN        (FB_MSGLEN_MAX + 1)
+
+/* Number of slots in the read-ahead ring when the caller does not say */
+#define FB_AHEAD_SLOTS_DEFAULT  32
+
+/* Bits of fbCollectorAhead_t's 'waiting' */
+#define FB_AHEAD_WAIT_DATA      1
+#define FB_AHEAD_WAIT_SPACE     2
+
+struct fbCollectorAhead_st {
+    /** The collector's own reader, run by the thread */
+    fbCollectorRead_fn   coread;
+    /** Message storage, FB_AHEAD_SLOTLEN octets per slot */
+    uint8_t             *bufs;
+    /** Length of the message in each slot */
+    size_t              *lens;
+    /** Number of slots */
+    unsigned int         slots;
+    /** Next slot to fill; used only by the thread */
+    unsigned int         tail;
+    /** Next slot to take; used only by the consumer */
+    unsigned int         head;
+    /** Number of full slots */
+    volatile gint        count;
+    /** FB_AHEAD_WAIT_* bits of the sides asleep on 'cond' */
+    volatile gint        waiting;
+    /** Set by the thread when it stops; 'error' says why */
+    volatile gint        finished;
+    /** Set to ask the thread to stop */
+    volatile gint        stop;
+    /** Set by fbCollectorInterruptSocket() to wake the consumer */
+    volatile gint        interrupted;
+    /** The error that stopped the thread */
+    GError              *error;
+    pthread_t            thread;
+    pthread_mutex_t      mutex;
+    pthread_cond_t       cond;
+};
+
+/**
+ * fbCollectorAheadWake
+ *
+ * Wakes any side asleep on the read-ahead condition.
+ *
+ */
+static void
+fbCollectorAheadWake(
+    fbCollectorAhead_t  *ahead)
+{
+    pthread_mutex_lock(&ahead->mutex);
+    pthread_cond_broadcast(&ahead->cond);
+    pthread_mutex_unlock(&ahead->mutex);
+}
+
+/**
+ * fbCollectorAheadThread
+ *
+ * The read-ahead thread: reads messages into the ring until the reader
+ * fails or the collector asks it to stop.
+ *
+ */
+static void *
+fbCollectorAheadThread(
+    void  *arg)
+{
+    fbCollector_t      *collector = (fbCollector_t *)arg;
+    fbCollectorAhead_t *ahead = collector->ahead;
+    GError             *err = NULL;
+    size_t              msglen;
+
+    while (!g_atomic_int_get(&ahead->stop)) {
+        if (g_atomic_int_get(&ahead->count) == (gint)ahead->slots) {
+            pthread_mutex_lock(&ahead->mutex);
+            g_atomic_int_or((guint *)&ahead->waiting, FB_AHEAD_WAIT_SPACE);
+            while (g_atomic_int_get(&ahead->count) == (gint)ahead->slots
+                   && !g_atomic_int_get(&ahead->stop))
+            {
+                pthread_cond_wait(&ahead->cond, &ahead->mutex);
+            }
+            g_atomic_int_and((guint *)&ahead->waiting, ~FB_AHEAD_WAIT_SPACE);
+            pthread_mutex_unlock(&ahead->mutex);
+            continue;
+        }
+
+        msglen = FB_AHEAD_SLOTLEN;
+        if (!ahead->coread(collector,
+                           ahead->bufs + (size_t)ahead->tail * FB_AHEAD_SLOTLEN,
+                           &msglen, &err))
+        {
+            if (g_error_matches(err, FB_ERROR_DOMAIN, FB_ERROR_NLREAD)) {
+                /* interrupted; try again unless stopping */
+                g_clear_error(&err);
+                continue;
+            }
+            ahead->error = err;
+            break;
+        }
+        ahead->lens[ahead->tail] = msglen;
+        ahead->tail = (ahead->tail + 1) % ahead->slots;
+        g_atomic_int_inc(&ahead->count);
+        if (g_atomic_int_get(&ahead->waiting) & FB_AHEAD_WAIT_DATA) {
+            fbCollectorAheadWake(ahead);
+        }
+    }
+
+    if (NULL == ahead->error) {
+        g_set_error(&ahead->error, FB_ERROR_DOMAIN, FB_ERROR_EOF,
+                    "Collector closed");
+    }
+    g_atomic_int_set(&ahead->finished, 1);
+    fbCollectorAheadWake(ahead);
+    return NULL;
+}
+
+/**
+ * fbCollectorReadAhead
+ *
+ * The reader of a collector with read-ahead: takes the next message from
+ * the ring, waiting for the thread if the ring is empty.
+ *
+ */
+static gboolean
+fbCollectorReadAhead(
+    fbCollector_t  *collector,
+    uint8_t        *msgbase,
+    size_t         *msglen,
+    GError        **err)
+{
+    fbCollectorAhead_t *ahead = collector->ahead;
+    size_t              len;
+
+    if (0 == g_atomic_int_get(&ahead->count)) {
+        pthread_mutex_lock(&ahead->mutex);
+        g_atomic_int_or((guint *)&ahead->waiting, FB_AHEAD_WAIT_DATA);
+        while (0 == g_atomic_int_get(&ahead->count)
+               && !g_atomic_int_get(&ahead->finished)
+               && !g_atomic_int_get(&ahead->interrupted))
+        {
+            pthread_cond_wait(&ahead->cond, &ahead->mutex);
+        }
+        g_atomic_int_and((guint *)&ahead->waiting, ~FB_AHEAD_WAIT_DATA);
+        pthread_mutex_unlock(&ahead->mutex);
+
+        if (0 == g_atomic_int_get(&ahead->count)) {
+            if (g_atomic_int_get(&ahead->finished)) {
+                g_propagate_error(err, g_error_copy(ahead->error));
+            } else {
+                g_atomic_int_set(&ahead->interrupted, 0);
+                g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_NLREAD,
+                            "Read interrupted");
+            }
+            return FALSE;
+        }
+    }
+
+    len = ahead->lens[ahead->head];
+    if (len > *msglen) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_BUFSZ,
+                    "Buffer too small to contain IPFIX Message "
+                    "(message size %u, buffer size %u).",
+                    (uint32_t)len, (uint32_t)*msglen);
+        return FALSE;
+    }
+    memcpy(msgbase, ahead->bufs + (size_t)ahead->head * FB_AHEAD_SLOTLEN, len);
+    *msglen = len;
+    ahead->head = (ahead->head + 1) % ahead->slots;
+    g_atomic_int_add(&ahead->count, -1);
+    if (g_atomic_int_get(&ahead->waiting) & FB_AHEAD_WAIT_SPACE) {
+        fbCollectorAheadWake(ahead);
+    }
+    return TRUE;
+}
+
+/**
+ * fbCollectorStopReadAhead
+ *
+ * Stops the read-ahead thread of `collector`, if any, as the collector
+ * is closed, and restores its own reader.  Messages still in the ring are
+ * discarded.
+ *
+ */
+static void
+fbCollectorStopReadAhead(
+    fbCollector_t  *collector)
+{
+    fbCollectorAhead_t *ahead = collector->ahead;
+    uint8_t             byte = 0xe7;
+
+    if (NULL == ahead) {
+        return;
+    }
+    g_atomic_int_set(&ahead->stop, 1);
+    fbCollectorAheadWake(ahead);
+    /* wake a thread waiting for input: the socket readers select() on
+     * the interrupt pipe, and shutting the socket down ends any other
+     * read */
+    if (collector->wip != -1) {
+        write(collector->wip, &byte, sizeof(byte));
+    }
+    if (!collector->bufferedStream) {
+        shutdown(collector->stream.fd, SHUT_RD);
+    }
+    pthread_join(ahead->thread, NULL);
+
+    collector->coread = ahead->coread;
+    collector->ahead = NULL;
+    g_clear_error(&ahead->error);
+    pthread_cond_destroy(&ahead->cond);
+    pthread_mutex_destroy(&ahead->mutex);
+    g_free(ahead->bufs);
+    g_free(ahead->lens);
+    g_slice_free(fbCollectorAhead_t, ahead);
+}
+
+gboolean
+fbCollectorEnableReadAhead(
+    fbCollector_t  *collector,
+    unsigned int    slots,
+    GError        **err)
+{
+    fbCollectorAhead_t *ahead;
+    int                 rv;
+
+    if (collector->ahead) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_SETUP,
+                    "Read-ahead is already enabled");
+        return FALSE;
+    }
+    if (0 == slots) {
+        slots = FB_AHEAD_SLOTS_DEFAULT;
+    }
+
+    /* the thread must be the only user of the input and of the state
+     * the reader changes; UDP readers switch the fBuf's session per
+     * datagram and a mapped file is not copied at all */
+    if (collector->coread != fbCollectorReadFile &&
+        collector->coread != fbCollectorReadCompressed &&
+        collector->coread != fbCollectorReadFileRange &&
+        collector->coread != fbCollectorReadTCP &&
+        collector->coread != fbCollectorReadTCPBuffered
+#if FB_ENABLE_SCTP
+        && collector->coread != fbCollectorReadSCTP
+#endif
+#if HAVE_OPENSSL
+        && collector->coread != fbCollectorReadTLS
+#endif
+        )
+    {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IMPL,
+                    "Read-ahead is only supported on file, TCP, SCTP, and"
+                    " TLS collectors");
+        return FALSE;
+    }
+    if (collector->nonblocking) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_SETUP,
+                    "Read-ahead is not supported on non-blocking"
+                    " collectors");
+        return FALSE;
+    }
+
+    ahead = g_slice_new0(fbCollectorAhead_t);
+    ahead->coread = collector->coread;
+    ahead->slots = slots;
+    ahead->bufs = g_new(uint8_t, (size_t)slots * FB_AHEAD_SLOTLEN);
+    ahead->lens = g_new0(size_t, slots);
+    pthread_mutex_init(&ahead->mutex, NULL);
+    pthread_cond_init(&ahead->cond, NULL);
+    collector->ahead = ahead;
+
+    rv = pthread_create(&ahead->thread, NULL, fbCollectorAheadThread,
+                        collector);
+    if (rv != 0) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                    "Couldn't start read-ahead thread: %s", strerror(rv));
+        collector->ahead = NULL;
+        pthread_cond_destroy(&ahead->cond);
+        pthread_mutex_destroy(&ahead->mutex);
+        g_free(ahead->bufs);
+        g_free(ahead->lens);
+        g_slice_free(fbCollectorAhead_t, ahead);
+        return FALSE;
+    }
+    collector->coread = fbCollectorReadAhead;
+    return TRUE;
+}
+
+gboolean
+fbCollectorHasPendingMessages(
+    fbCollector_t  *collector)
+{
+    fbCollectorReadBuf_t *rbuf = collector->rbuf;
+    uint16_t              h_len;
+
+    /* the read-ahead thread owns the socket and any buffer behind it; a
+     * message in its ring, or the error that stopped it, is pending */
+    if (collector->ahead) {
+        return (g_atomic_int_get(&collector->ahead->count) > 0
+                || g_atomic_int_get(&collector->ahead->finished));
+    }
+#if HAVE_LIBURING
+    /* completed receives are only seen by draining them into the buffer */
+    if (collector->uring) {
+        fbCollectorUringDrain(collector);
+    }
+#endif
+    /* a complete message in the TCP read-ahead buffer */
+    if (rbuf && rbuf->end - rbuf->start >= 4) {
+        memcpy(&h_len, rbuf->buf + rbuf->start + 2, sizeof(h_len));
+        if (g_ntohs(h_len) <= rbuf->end - rbuf->start) {
+            return TRUE;
+        }
+    }
+#if HAVE_RECVMMSG
+    return (collector->udp_batch &&
+            collector->udp_batch->next < collector->udp_batch->filled);
+#else
+    return FALSE;
+#endif
+}
+
 /**
  * fbCollectorClose
  *
@@ -1714,6 +3450,12 @@ void
 fbCollectorClose(
     fbCollector_t  *collector)
 {
+    fbCollectorStopReadAhead(collector);
+#if HAVE_LIBURING
+    /* the outstanding receive holds the socket open */
+    fbCollectorUringFree(collector->uring);
+    collector->uring = NULL;
+#endif
     if (collector->active && collector->coclose) {
         collector->coclose(collector);
     }
@@ -1733,6 +3475,8 @@ void
 fbCollectorFree(
     fbCollector_t  *collector)
 {
+    /* the read-ahead thread may be using the translator */
+    fbCollectorStopReadAhead(collector);
     if (!collector->multi_session) {
         fbListenerAppFree(collector->listener, collector->ctx);
     }
@@ -1746,6 +3490,26 @@ fbCollectorFree(
     while (collector->udp_tail) {
         fbCollectorFreeUDPSpec(collector, collector->udp_tail);
     }
+    if (collector->udp_peers) {
+        g_hash_table_destroy(collector->udp_peers);
+    }
+#if HAVE_RECVMMSG
+    fbCollectorUDPBatchFree(collector->udp_batch);
+#endif
+    if (collector->rbuf) {
+        g_free(collector->rbuf->buf);
+        g_slice_free(fbCollectorReadBuf_t, collector->rbuf);
+    }
+    g_free(collector->partial.buf);
+    if (collector->range) {
+        g_free(collector->range->prefix);
+        g_slice_free(fbCollectorRange_t, collector->range);
+    }
+    /* unmapped here rather than on close since the fBuf may still point
+     * into the mapping */
+    if (collector->map_base) {
+        munmap(collector->map_base, collector->map_len);
+    }
 
     g_slice_free(fbCollector_t, collector);
 }
@@ -1848,6 +3612,13 @@ fbCollectorInterruptSocket(
     }
 #endif /* if HAVE_SPREAD */
 
+    if (collector->ahead) {
+        /* the fBuf waits on the ring, not the socket */
+        g_atomic_int_set(&collector->ahead->interrupted, 1);
+        fbCollectorAheadWake(collector->ahead);
+        return;
+    }
+
     write(collector->wip, &byte, sizeof(byte));
     write(collector->rip, &byte, sizeof(byte));
 }
@@ -46,7 +46,7 @@
 #include <fixbuf/public.h>
 
 
-/* 30 mins in seconds */
+/* default UDP peer timeout: 30 mins in seconds */
 #define FB_UDP_TIMEOUT 1800
 
 
@@ -65,6 +65,63 @@ typedef void
 
 
 
+/** io_uring state of a TCP collector; see fbCollectorSetIOBackend() */
+typedef struct fbCollectorUring_st fbCollectorUring_t;
+
+/** batched UDP receive state; see fbCollectorSetUDPBatch() */
+typedef struct fbCollectorUDPBatch_st fbCollectorUDPBatch_t;
+
+/** read-ahead thread and message ring; see fbCollectorEnableReadAhead() */
+typedef struct fbCollectorAhead_st fbCollectorAhead_t;
+
+/** Maximum number of datagrams read by one batched UDP receive */
+#define FB_UDP_BATCH_MAX 1024
+
+
+/**
+ * Read-ahead buffer of a TCP collector; see fbCollectorSetTCPReadBuffer().
+ * Octets in [start, end) have been read from the socket but not yet handed
+ * to the fBuf.
+ */
+typedef struct fbCollectorReadBuf_st {
+    /** Storage */
+    uint8_t  *buf;
+    /** Size of 'buf' */
+    size_t    size;
+    /** Offset of the first unconsumed octet */
+    size_t    start;
+    /** Offset just past the last octet read */
+    size_t    end;
+} fbCollectorReadBuf_t;
+
+/**
+ * A message partly read from a TCP or TLS stream, kept when a read is
+ * interrupted or would block so the next read continues it.
+ */
+typedef struct fbCollectorPartial_st {
+    /** Octets of the message read so far; allocated on first use */
+    uint8_t   *buf;
+    /** Number of octets in 'buf' */
+    size_t     got;
+    /** Message length from the header; 0 until the header is decoded */
+    uint16_t   len;
+} fbCollectorPartial_t;
+
+/**
+ * Input of a collector created by fbCollectorAllocFileRange(): the
+ * messages in 'prefix', then 'remaining' octets of the file.
+ */
+typedef struct fbCollectorRange_st {
+    /** Messages read before the file; owned by the collector */
+    uint8_t   *prefix;
+    /** Length of 'prefix' */
+    size_t     prefix_len;
+    /** Offset in 'prefix' of the next message */
+    size_t     prefix_off;
+    /** Octets of the file left to read */
+    uint64_t   remaining;
+} fbCollectorRange_t;
+
 /** structure definition of the start of IPFIX & NetFlow messages */
 typedef struct fbCollectorMsgVL_st {
     uint16_t   n_version;
@@ -331,8 +388,74 @@ struct fbCollector_st {
     fbCollectorTransClose_fn       cotransClose;
     fbCollectorSessionTimeout_fn   cotimeOut;
     void                          *translatorState;
+    /** UDP peers, most recently seen first */
     fbUDPConnSpec_t               *udp_head;
     fbUDPConnSpec_t               *udp_tail;
+    /**
+     * The specs in the udp_head list keyed by peer address and observation
+     * domain; created on the first datagram.
+     */
+    GHashTable                    *udp_peers;
+    /**
+     * Seconds a UDP peer may be idle before its session is freed.  Set by
+     * fbCollectorSetUDPTimeout(); FB_UDP_TIMEOUT by default.
+     */
+    uint32_t                       udp_timeout;
+    /** Counters reported by fbCollectorGetStats() */
+    fbCollectorStats_t             stats;
+    /** TRUE once fbCollectorEnableUDPStats() is called */
+    gboolean                       udp_stats;
+    /** Last SO_RXQ_OVFL count received from the socket */
+    uint32_t                       udp_ovfl;
+    /** Octets in the socket receive queue at the last sample */
+    uint64_t                       udp_queued;
+    /**
+     * Ring of datagrams read by one recvmmsg() call and handed out one at a
+     * time by the UDP reader.  NULL unless batching was enabled by
+     * fbCollectorSetUDPBatch().
+     */
+    fbCollectorUDPBatch_t         *udp_batch;
+    /**
+     * Read-ahead buffer for TCP.  NULL unless enabled by
+     * fbCollectorSetTCPReadBuffer().
+     */
+    fbCollectorReadBuf_t          *rbuf;
+    /**
+     * io_uring whose multishot receive fills 'rbuf'.  NULL unless enabled
+     * by fbCollectorSetIOBackend().
+     */
+    fbCollectorUring_t            *uring;
+    /** Message left unfinished by the last TCP or TLS read */
+    fbCollectorPartial_t           partial;
+    /**
+     * TRUE if reads return FB_ERROR_NLREAD instead of waiting for data.
+     * Set by fbCollectorSetNonBlocking().
+     */
+    gboolean                       nonblocking;
+    /**
+     * Read-only view of the input file for a collector created by
+     * fbCollectorAllocMappedFile(); NULL when the file is read as a stream.
+     */
+    uint8_t                       *map_base;
+    /** Length of the mapping at 'map_base' */
+    size_t                         map_len;
+    /** Offset in the mapping of the next message */
+    size_t                         map_off;
+    /**
+     * Decompressor of a gzip or zstd input file; NULL if the file is not
+     * compressed.
+     */
+    fbCompressStream_t            *compress;
+    /**
+     * Byte range of the file to read and messages to read before it, for a
+     * collector created by fbCollectorAllocFileRange(); NULL otherwise.
+     */
+    fbCollectorRange_t            *range;
+    /**
+     * Thread that reads messages ahead of the fBuf into a ring.  NULL
+     * unless enabled by fbCollectorEnableReadAhead().
+     */
+    fbCollectorAhead_t            *ahead;
 };
 
 #endif /* ifndef FB_COLLECTOR_H_ */
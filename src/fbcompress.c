@@ -0,0 +1,851 @@
+/*
+ *  Copyright 2006-2025 Carnegie Mellon University
+ *  See license information in LICENSE.txt.
+ */
+/**
+ *  @file fbcompress.c
+ *  Compressed file streams for file collectors and exporters
+ */
+/*
+ *  ------------------------------------------------------------------------
+ *  @DISTRIBUTION_STATEMENT_BEGIN@
+ *  libfixbuf 2.5
+ *
+ *  Copyright 2024 Carnegie Mellon University.
+ *
+ *  NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ *  INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ *  UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR
+ *  IMPLIED, AS TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF
+ *  FITNESS FOR PURPOSE OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS
+ *  OBTAINED FROM USE OF THE MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT
+ *  MAKE ANY WARRANTY OF ANY KIND WITH RESPECT TO FREEDOM FROM PATENT,
+ *  TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ *
+ *  Licensed under a GNU-Lesser GPL 3.0-style license, please see
+ *  LICENSE.txt or contact permission@sei.cmu.edu for full terms.
+ *
+ *  [DISTRIBUTION STATEMENT A] This material has been approved for public
+ *  release and unlimited distribution.  Please see Copyright notice for
+ *  non-US Government use and distribution.
+ *
+ *  This Software includes and/or makes use of Third-Party Software each
+ *  subject to its own license.
+ *
+ *  DM24-1020
+ *  @DISTRIBUTION_STATEMENT_END@
+ *  ------------------------------------------------------------------------
+ */
+
+#define _FIXBUF_SOURCE_
+#include <fixbuf/private.h>
+#include <pthread.h>
+#if HAVE_ZLIB
+#include <zlib.h>
+#endif
+#if HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+
+/*
+ *  A compressed stream moves data between the caller and a FILE through a
+ *  helper thread that runs the codec.  The two share a pair of blocks of
+ *  uncompressed data: while the caller reads (or fills) one block, the
+ *  helper decompresses into (or compresses from) the other.  Blocks are
+ *  used in turn, 0, 1, 0, ..., by both sides.
+ */
+
+/* Size of each uncompressed block */
+#define FB_COMPRESS_BLOCK   (256 * 1024)
+
+/* Size of the helper's buffer of compressed data */
+#define FB_COMPRESS_CBUF    (64 * 1024)
+
+/* Codec operations for the writer */
+typedef enum fbCompressOp_en {
+    FB_COMPRESS_OP_CONTINUE,
+    FB_COMPRESS_OP_FLUSH,
+    FB_COMPRESS_OP_END
+} fbCompressOp_t;
+
+typedef struct fbCompressBlock_st {
+    /** Uncompressed data */
+    uint8_t   *data;
+    /** Number of octets in 'data' */
+    size_t     len;
+    /** Caller's position in 'data' when reading */
+    size_t     off;
+    /** TRUE while the block belongs to the consumer of its data */
+    gboolean   full;
+    /** TRUE if the writer is to flush the codec after this block */
+    gboolean   sync;
+} fbCompressBlock_t;
+
+struct fbCompressStream_st {
+    FILE               *fp;
+    fbCompressCodec_t   codec;
+    gboolean            writing;
+    pthread_t           thread;
+    pthread_mutex_t     lock;
+    pthread_cond_t      cond;
+    fbCompressBlock_t   block[2];
+    /** Block the caller is using */
+    unsigned int        cur;
+    /** Set by the caller to end the helper */
+    gboolean            stop;
+    /** Set by the helper when it will produce no more blocks */
+    gboolean            done;
+    /** Error from the helper; NULL if none */
+    char               *errmsg;
+    /** Compressed data; used only by the helper */
+    uint8_t            *cbuf;
+#if HAVE_ZLIB
+    z_stream            zs;
+    /** TRUE while the gzip decoder is inside a member */
+    gboolean            zmember;
+    /** TRUE once the gzip decoder has completed a member */
+    gboolean            zended;
+#endif
+#if HAVE_ZSTD
+    ZSTD_DStream       *zds;
+    ZSTD_CCtx          *zcs;
+    /** Input and its position for the zstd decoder */
+    ZSTD_inBuffer       zin;
+    /** Result of the last ZSTD_decompressStream(); 0 between frames */
+    size_t              zpending;
+#endif
+    /** TRUE once the input FILE is at its end */
+    gboolean            in_eof;
+};
+
+
+fbCompressCodec_t
+fbCompressCodecForPath(
+    const char  *path)
+{
+    if (g_str_has_suffix(path, ".gz")) {
+        return FB_COMPRESS_GZIP;
+    }
+    if (g_str_has_suffix(path, ".zst")) {
+        return FB_COMPRESS_ZSTD;
+    }
+    return FB_COMPRESS_NONE;
+}
+
+fbCompressCodec_t
+fbCompressCodecForStream(
+    FILE  *fp)
+{
+    int c;
+
+    /* IPFIX, NetFlow V9, and sFlow all begin with 0x00; the first octets
+     * of the gzip and zstd magic numbers are enough to tell them apart */
+    c = getc(fp);
+    if (EOF == c) {
+        return FB_COMPRESS_NONE;
+    }
+    ungetc(c, fp);
+    switch (c) {
+      case 0x1f:
+        return FB_COMPRESS_GZIP;
+      case 0x28:
+        return FB_COMPRESS_ZSTD;
+      default:
+        return FB_COMPRESS_NONE;
+    }
+}
+
+/**
+ * fbCompressFail
+ *
+ * Records an error from the helper thread.  Called without the lock held;
+ * the error becomes visible to the caller once the helper sets 'done'.
+ *
+ */
+static void
+fbCompressFail(
+    fbCompressStream_t  *stream,
+    const char          *fmt,
+    ...)
+{
+    va_list ap;
+
+    if (stream->errmsg) {
+        return;
+    }
+    va_start(ap, fmt);
+    stream->errmsg = g_strdup_vprintf(fmt, ap);
+    va_end(ap);
+}
+
+/**
+ * fbCompressReadInput
+ *
+ * Reads more compressed data into 'cbuf'.  Returns the number of octets
+ * read, 0 at end of file or on error.
+ *
+ * This is the only place the helper may be cancelled, so that
+ * fbCompressStreamFree() does not wait forever on a helper blocked
+ * reading a pipe.
+ *
+ */
+static size_t
+fbCompressReadInput(
+    fbCompressStream_t  *stream)
+{
+    size_t rc;
+    int    state;
+
+    if (stream->in_eof) {
+        return 0;
+    }
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &state);
+    rc = fread(stream->cbuf, 1, FB_COMPRESS_CBUF, stream->fp);
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+    if (rc < FB_COMPRESS_CBUF) {
+        if (ferror(stream->fp)) {
+            fbCompressFail(stream, "Error reading compressed file: %s",
+                           strerror(errno));
+        }
+        stream->in_eof = TRUE;
+    }
+    return rc;
+}
+
+/**
+ * fbCompressDecode
+ *
+ * Decompresses into `out` until it holds `size` octets or the input ends.
+ * Sets `len` to the number of octets produced.  Returns FALSE on error.
+ *
+ */
+static gboolean
+fbCompressDecode(
+    fbCompressStream_t  *stream,
+    uint8_t             *out,
+    size_t               size,
+    size_t              *len)
+{
+    switch (stream->codec) {
+#if HAVE_ZLIB
+      case FB_COMPRESS_GZIP:
+        {
+            z_stream *zs = &stream->zs;
+            int       zrc;
+
+            zs->next_out = out;
+            zs->avail_out = size;
+            while (zs->avail_out) {
+                if (0 == zs->avail_in) {
+                    zs->next_in = stream->cbuf;
+                    zs->avail_in = fbCompressReadInput(stream);
+                    if (stream->errmsg) {
+                        return FALSE;
+                    }
+                    if (0 == zs->avail_in) {
+                        if (stream->zmember) {
+                            fbCompressFail(stream, "Truncated gzip file");
+                            return FALSE;
+                        }
+                        break;
+                    }
+                }
+                if (!stream->zmember && stream->zended &&
+                    zs->next_in[0] != 0x1f)
+                {
+                    /* like gzip(1), ignore trailing garbage after the
+                     * last member */
+                    zs->avail_in = 0;
+                    stream->in_eof = TRUE;
+                    break;
+                }
+                stream->zmember = TRUE;
+                zrc = inflate(zs, Z_NO_FLUSH);
+                if (Z_STREAM_END == zrc) {
+                    /* a gzip file may hold several members */
+                    inflateReset(zs);
+                    stream->zmember = FALSE;
+                    stream->zended = TRUE;
+                } else if (zrc != Z_OK && zrc != Z_BUF_ERROR) {
+                    fbCompressFail(stream, "Corrupt gzip data: %s",
+                                   zs->msg ? zs->msg : "unknown error");
+                    return FALSE;
+                }
+            }
+            *len = size - zs->avail_out;
+            return TRUE;
+        }
+#endif  /* HAVE_ZLIB */
+#if HAVE_ZSTD
+      case FB_COMPRESS_ZSTD:
+        {
+            ZSTD_outBuffer zout = {out, size, 0};
+
+            while (zout.pos < zout.size) {
+                if (stream->zin.pos == stream->zin.size) {
+                    stream->zin.src = stream->cbuf;
+                    stream->zin.size = fbCompressReadInput(stream);
+                    stream->zin.pos = 0;
+                    if (stream->errmsg) {
+                        return FALSE;
+                    }
+                    if (0 == stream->zin.size) {
+                        if (stream->zpending) {
+                            fbCompressFail(stream, "Truncated zstd file");
+                            return FALSE;
+                        }
+                        break;
+                    }
+                }
+                stream->zpending = ZSTD_decompressStream(stream->zds, &zout,
+                                                         &stream->zin);
+                if (ZSTD_isError(stream->zpending)) {
+                    fbCompressFail(stream, "Corrupt zstd data: %s",
+                                   ZSTD_getErrorName(stream->zpending));
+                    return FALSE;
+                }
+            }
+            *len = zout.pos;
+            return TRUE;
+        }
+#endif  /* HAVE_ZSTD */
+      default:
+        g_assert_not_reached();
+    }
+    return FALSE;
+}
+
+/**
+ * fbCompressEncode
+ *
+ * Compresses `len` octets at `in` and writes the result to the file,
+ * flushing or ending the compressed stream as `op` requests.  Returns
+ * FALSE on error.
+ *
+ */
+static gboolean
+fbCompressEncode(
+    fbCompressStream_t  *stream,
+    const uint8_t       *in,
+    size_t               len,
+    fbCompressOp_t       op)
+{
+    switch (stream->codec) {
+#if HAVE_ZLIB
+      case FB_COMPRESS_GZIP:
+        {
+            z_stream *zs = &stream->zs;
+            size_t    out;
+            int       flush;
+            int       zrc;
+
+            flush = ((FB_COMPRESS_OP_END == op) ? Z_FINISH
+                     : (FB_COMPRESS_OP_FLUSH == op) ? Z_SYNC_FLUSH
+                     : Z_NO_FLUSH);
+            zs->next_in = (Bytef *)in;
+            zs->avail_in = len;
+            do {
+                zs->next_out = stream->cbuf;
+                zs->avail_out = FB_COMPRESS_CBUF;
+                zrc = deflate(zs, flush);
+                if (Z_STREAM_ERROR == zrc) {
+                    fbCompressFail(stream, "gzip compression error");
+                    return FALSE;
+                }
+                out = FB_COMPRESS_CBUF - zs->avail_out;
+                if (out && fwrite(stream->cbuf, 1, out, stream->fp) != out) {
+                    fbCompressFail(stream, "Error writing compressed file: %s",
+                                   strerror(errno));
+                    return FALSE;
+                }
+            } while (0 == zs->avail_out);
+            return TRUE;
+        }
+#endif  /* HAVE_ZLIB */
+#if HAVE_ZSTD
+      case FB_COMPRESS_ZSTD:
+        {
+            ZSTD_inBuffer     zin = {in, len, 0};
+            ZSTD_outBuffer    zout;
+            ZSTD_EndDirective mode;
+            size_t            remaining;
+            size_t            out;
+
+            mode = ((FB_COMPRESS_OP_END == op) ? ZSTD_e_end
+                    : (FB_COMPRESS_OP_FLUSH == op) ? ZSTD_e_flush
+                    : ZSTD_e_continue);
+            do {
+                zout.dst = stream->cbuf;
+                zout.size = FB_COMPRESS_CBUF;
+                zout.pos = 0;
+                remaining = ZSTD_compressStream2(stream->zcs, &zout, &zin,
+                                                 mode);
+                if (ZSTD_isError(remaining)) {
+                    fbCompressFail(stream, "zstd compression error: %s",
+                                   ZSTD_getErrorName(remaining));
+                    return FALSE;
+                }
+                out = zout.pos;
+                if (out && fwrite(stream->cbuf, 1, out, stream->fp) != out) {
+                    fbCompressFail(stream, "Error writing compressed file: %s",
+                                   strerror(errno));
+                    return FALSE;
+                }
+            } while ((ZSTD_e_continue == mode) ? (zin.pos < zin.size)
+                     : (remaining != 0));
+            return TRUE;
+        }
+#endif  /* HAVE_ZSTD */
+      default:
+        g_assert_not_reached();
+    }
+    return FALSE;
+}
+
+/**
+ * fbCompressReadThread
+ *
+ * Helper thread of a reading stream: decompresses into each block in turn
+ * once the caller has emptied it.
+ *
+ */
+static void *
+fbCompressReadThread(
+    void  *arg)
+{
+    fbCompressStream_t *stream = (fbCompressStream_t *)arg;
+    fbCompressBlock_t  *blk;
+    unsigned int        i = 0;
+    size_t              len = 0;
+    gboolean            ok;
+    int                 state;
+
+    /* see fbCompressReadInput() */
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+
+    for (;;) {
+        blk = &stream->block[i];
+        pthread_mutex_lock(&stream->lock);
+        while (blk->full && !stream->stop) {
+            pthread_cond_wait(&stream->cond, &stream->lock);
+        }
+        if (stream->stop) {
+            break;
+        }
+        pthread_mutex_unlock(&stream->lock);
+
+        ok = fbCompressDecode(stream, blk->data, FB_COMPRESS_BLOCK, &len);
+
+        pthread_mutex_lock(&stream->lock);
+        if (!ok || 0 == len) {
+            break;
+        }
+        blk->len = len;
+        blk->off = 0;
+        blk->full = TRUE;
+        pthread_cond_broadcast(&stream->cond);
+        pthread_mutex_unlock(&stream->lock);
+        i ^= 1;
+    }
+
+    /* the lock is held */
+    stream->done = TRUE;
+    pthread_cond_broadcast(&stream->cond);
+    pthread_mutex_unlock(&stream->lock);
+    return NULL;
+}
+
+/**
+ * fbCompressWriteThread
+ *
+ * Helper thread of a writing stream: compresses each block in turn once
+ * the caller has filled it, and ends the compressed stream when stopped.
+ *
+ */
+static void *
+fbCompressWriteThread(
+    void  *arg)
+{
+    fbCompressStream_t *stream = (fbCompressStream_t *)arg;
+    fbCompressBlock_t  *blk;
+    unsigned int        i = 0;
+    gboolean            ok;
+
+    for (;;) {
+        blk = &stream->block[i];
+        pthread_mutex_lock(&stream->lock);
+        while (!blk->full && !stream->stop) {
+            pthread_cond_wait(&stream->cond, &stream->lock);
+        }
+        if (!blk->full) {
+            /* stopped with nothing left to compress */
+            pthread_mutex_unlock(&stream->lock);
+            if (fbCompressEncode(stream, NULL, 0, FB_COMPRESS_OP_END) &&
+                fflush(stream->fp) != 0)
+            {
+                fbCompressFail(stream, "Error writing compressed file: %s",
+                               strerror(errno));
+            }
+            pthread_mutex_lock(&stream->lock);
+            break;
+        }
+        pthread_mutex_unlock(&stream->lock);
+
+        ok = fbCompressEncode(stream, blk->data, blk->len,
+                              (blk->sync ? FB_COMPRESS_OP_FLUSH
+                               : FB_COMPRESS_OP_CONTINUE));
+        if (ok && blk->sync && fflush(stream->fp) != 0) {
+            fbCompressFail(stream, "Error writing compressed file: %s",
+                           strerror(errno));
+            ok = FALSE;
+        }
+
+        pthread_mutex_lock(&stream->lock);
+        blk->len = 0;
+        blk->sync = FALSE;
+        blk->full = FALSE;
+        if (!ok) {
+            break;
+        }
+        pthread_cond_broadcast(&stream->cond);
+        pthread_mutex_unlock(&stream->lock);
+        i ^= 1;
+    }
+
+    /* the lock is held */
+    stream->done = TRUE;
+    pthread_cond_broadcast(&stream->cond);
+    pthread_mutex_unlock(&stream->lock);
+    return NULL;
+}
+
+/**
+ * fbCompressCheckError
+ *
+ * Sets `err` and returns FALSE if the helper has failed.  Called with the
+ * lock held.
+ *
+ */
+static gboolean
+fbCompressCheckError(
+    fbCompressStream_t  *stream,
+    GError             **err)
+{
+    if (stream->done && stream->errmsg) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO, "%s", stream->errmsg);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ * fbCompressInitCodec
+ *
+ *
+ *
+ *
+ */
+static gboolean
+fbCompressInitCodec(
+    fbCompressStream_t  *stream,
+    GError             **err)
+{
+    switch (stream->codec) {
+      case FB_COMPRESS_GZIP:
+#if HAVE_ZLIB
+        {
+            int zrc;
+
+            if (stream->writing) {
+                /* 15 + 16: maximum window, gzip wrapper */
+                zrc = deflateInit2(&stream->zs, Z_DEFAULT_COMPRESSION,
+                                   Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+            } else {
+                /* 15 + 32: maximum window, detect gzip or zlib wrapper */
+                zrc = inflateInit2(&stream->zs, 15 + 32);
+            }
+            if (zrc != Z_OK) {
+                g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_SETUP,
+                            "Unable to initialize gzip codec: %s",
+                            stream->zs.msg ? stream->zs.msg : "zlib error");
+                return FALSE;
+            }
+            return TRUE;
+        }
+#else
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IMPL,
+                    "libfixbuf was built without gzip (zlib) support");
+        return FALSE;
+#endif  /* HAVE_ZLIB */
+      case FB_COMPRESS_ZSTD:
+#if HAVE_ZSTD
+        if (stream->writing) {
+            stream->zcs = ZSTD_createCCtx();
+        } else {
+            stream->zds = ZSTD_createDStream();
+            if (stream->zds) {
+                ZSTD_initDStream(stream->zds);
+            }
+        }
+        if (!stream->zcs && !stream->zds) {
+            g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_SETUP,
+                        "Unable to initialize zstd codec");
+            return FALSE;
+        }
+        return TRUE;
+#else
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IMPL,
+                    "libfixbuf was built without zstd support");
+        return FALSE;
+#endif  /* HAVE_ZSTD */
+      case FB_COMPRESS_NONE:
+        break;
+    }
+    g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IMPL,
+                "No compression codec given");
+    return FALSE;
+}
+
+/**
+ * fbCompressFreeCodec
+ *
+ *
+ *
+ *
+ */
+static void
+fbCompressFreeCodec(
+    fbCompressStream_t  *stream)
+{
+    switch (stream->codec) {
+#if HAVE_ZLIB
+      case FB_COMPRESS_GZIP:
+        if (stream->writing) {
+            deflateEnd(&stream->zs);
+        } else {
+            inflateEnd(&stream->zs);
+        }
+        break;
+#endif
+#if HAVE_ZSTD
+      case FB_COMPRESS_ZSTD:
+        ZSTD_freeCCtx(stream->zcs);
+        ZSTD_freeDStream(stream->zds);
+        break;
+#endif
+      default:
+        break;
+    }
+}
+
+fbCompressStream_t *
+fbCompressStreamAlloc(
+    FILE               *fp,
+    fbCompressCodec_t   codec,
+    gboolean            writing,
+    GError            **err)
+{
+    fbCompressStream_t *stream;
+    int                 rc;
+
+    stream = g_slice_new0(fbCompressStream_t);
+    stream->fp = fp;
+    stream->codec = codec;
+    stream->writing = writing;
+    if (!fbCompressInitCodec(stream, err)) {
+        g_slice_free(fbCompressStream_t, stream);
+        return NULL;
+    }
+    stream->cbuf = g_new(uint8_t, FB_COMPRESS_CBUF);
+    stream->block[0].data = g_new(uint8_t, FB_COMPRESS_BLOCK);
+    stream->block[1].data = g_new(uint8_t, FB_COMPRESS_BLOCK);
+    pthread_mutex_init(&stream->lock, NULL);
+    pthread_cond_init(&stream->cond, NULL);
+
+    rc = pthread_create(&stream->thread, NULL,
+                        (writing ? fbCompressWriteThread
+                         : fbCompressReadThread), stream);
+    if (rc != 0) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_SETUP,
+                    "Unable to start compression thread: %s", strerror(rc));
+        pthread_cond_destroy(&stream->cond);
+        pthread_mutex_destroy(&stream->lock);
+        fbCompressFreeCodec(stream);
+        g_free(stream->block[1].data);
+        g_free(stream->block[0].data);
+        g_free(stream->cbuf);
+        g_slice_free(fbCompressStream_t, stream);
+        return NULL;
+    }
+    return stream;
+}
+
+gboolean
+fbCompressStreamRead(
+    fbCompressStream_t  *stream,
+    uint8_t             *buf,
+    size_t               len,
+    size_t              *got,
+    GError             **err)
+{
+    fbCompressBlock_t *blk;
+    size_t             n;
+
+    g_assert(!stream->writing);
+
+    *got = 0;
+    while (*got < len) {
+        blk = &stream->block[stream->cur];
+        /* 'full' is only read under the lock, which also makes the
+         * helper's writes to the block visible */
+        pthread_mutex_lock(&stream->lock);
+        while (!blk->full && !stream->done) {
+            pthread_cond_wait(&stream->cond, &stream->lock);
+        }
+        if (!blk->full) {
+            /* the helper is finished: end of file or error */
+            n = fbCompressCheckError(stream, err);
+            pthread_mutex_unlock(&stream->lock);
+            return n;
+        }
+        pthread_mutex_unlock(&stream->lock);
+
+        n = MIN(len - *got, blk->len - blk->off);
+        memcpy(buf + *got, blk->data + blk->off, n);
+        blk->off += n;
+        *got += n;
+        if (blk->off == blk->len) {
+            /* hand the block back to the helper */
+            pthread_mutex_lock(&stream->lock);
+            blk->full = FALSE;
+            pthread_cond_broadcast(&stream->cond);
+            pthread_mutex_unlock(&stream->lock);
+            stream->cur ^= 1;
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * fbCompressHandOff
+ *
+ * Gives the caller's current block to the helper and waits until the other
+ * block is free.
+ *
+ */
+static gboolean
+fbCompressHandOff(
+    fbCompressStream_t  *stream,
+    gboolean             sync,
+    GError             **err)
+{
+    fbCompressBlock_t *blk = &stream->block[stream->cur];
+    gboolean           ok;
+
+    pthread_mutex_lock(&stream->lock);
+    if (!fbCompressCheckError(stream, err)) {
+        pthread_mutex_unlock(&stream->lock);
+        return FALSE;
+    }
+    blk->sync = sync;
+    blk->full = TRUE;
+    pthread_cond_broadcast(&stream->cond);
+    stream->cur ^= 1;
+    blk = &stream->block[stream->cur];
+    while (blk->full && !stream->done) {
+        pthread_cond_wait(&stream->cond, &stream->lock);
+    }
+    ok = fbCompressCheckError(stream, err);
+    pthread_mutex_unlock(&stream->lock);
+    return ok;
+}
+
+gboolean
+fbCompressStreamWrite(
+    fbCompressStream_t  *stream,
+    const uint8_t       *buf,
+    size_t               len,
+    GError             **err)
+{
+    fbCompressBlock_t *blk;
+    size_t             n;
+
+    g_assert(stream->writing);
+
+    while (len) {
+        blk = &stream->block[stream->cur];
+        n = MIN(len, FB_COMPRESS_BLOCK - blk->len);
+        memcpy(blk->data + blk->len, buf, n);
+        blk->len += n;
+        buf += n;
+        len -= n;
+        if (FB_COMPRESS_BLOCK == blk->len &&
+            !fbCompressHandOff(stream, FALSE, err))
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+gboolean
+fbCompressStreamFlush(
+    fbCompressStream_t  *stream,
+    GError             **err)
+{
+    fbCompressBlock_t *other;
+    gboolean           ok;
+
+    g_assert(stream->writing);
+
+    if (!fbCompressHandOff(stream, TRUE, err)) {
+        return FALSE;
+    }
+    /* the flushed block is now the other one; wait for the helper */
+    other = &stream->block[stream->cur ^ 1];
+    pthread_mutex_lock(&stream->lock);
+    while (other->full && !stream->done) {
+        pthread_cond_wait(&stream->cond, &stream->lock);
+    }
+    ok = fbCompressCheckError(stream, err);
+    pthread_mutex_unlock(&stream->lock);
+    return ok;
+}
+
+gboolean
+fbCompressStreamFree(
+    fbCompressStream_t  *stream,
+    GError             **err)
+{
+    gboolean ok = TRUE;
+
+    if (stream->writing && stream->block[stream->cur].len) {
+        ok = fbCompressHandOff(stream, FALSE, err);
+    }
+
+    pthread_mutex_lock(&stream->lock);
+    stream->stop = TRUE;
+    pthread_cond_broadcast(&stream->cond);
+    pthread_mutex_unlock(&stream->lock);
+    if (!stream->writing) {
+        /* the reader may be blocked on a pipe that never ends */
+        pthread_cancel(stream->thread);
+    }
+    pthread_join(stream->thread, NULL);
+
+    if (ok && stream->writing) {
+        /* report an error from ending the compressed stream */
+        ok = fbCompressCheckError(stream, err);
+    }
+
+    pthread_cond_destroy(&stream->cond);
+    pthread_mutex_destroy(&stream->lock);
+    fbCompressFreeCodec(stream);
+    g_free(stream->errmsg);
+    g_free(stream->block[1].data);
+    g_free(stream->block[0].data);
+    g_free(stream->cbuf);
+    g_slice_free(fbCompressStream_t, stream);
+    return ok;
+}
@@ -46,9 +46,20 @@
  * specified source interface for exported IPFIX flows.
  */
 
+#ifndef _GNU_SOURCE
+/* for sendmmsg() */
+#define _GNU_SOURCE
+#endif
 #define _FIXBUF_SOURCE_
 #include <fixbuf/private.h>
 #include <arpa/inet.h>
+#include <netinet/udp.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <limits.h>
+#if HAVE_LIBURING
+#include <liburing.h>
+#endif
 
 
 /**
@@ -84,6 +95,15 @@ typedef void
 (*fbExporterClose_fn)(
     fbExporter_t  *exporter);
 
+#if HAVE_LIBURING
+typedef struct fbExporterUring_st fbExporterUring_t;
+#endif
+typedef struct fbExporterUDPBatch_st fbExporterUDPBatch_t;
+typedef struct fbExporterCoalesce_st fbExporterCoalesce_t;
+typedef struct fbExporterAsync_st fbExporterAsync_t;
+typedef struct fbExporterRotate_st fbExporterRotate_t;
+typedef struct fbExporterFanout_st fbExporterFanout_t;
+
 struct fbExporter_st {
     /** Specifier used for stream open */
     union {
@@ -121,6 +141,30 @@ struct fbExporter_st {
     fbExporterWrite_fn   exwrite;
     fbExporterClose_fn   exclose;
     uint16_t             mtu;
+    /** Template refresh interval in seconds; 0 disables */
+    uint32_t             tmpl_refresh_secs;
+    /** Template refresh interval in messages; 0 disables */
+    uint32_t             tmpl_refresh_msgs;
+    /** Messages exported since the last template refresh */
+    uint32_t             tmpl_refresh_count;
+    /** Time of the last template refresh */
+    time_t               tmpl_refresh_last;
+#if HAVE_LIBURING
+    /** io_uring send state; NULL unless set by fbExporterSetIOBackend() */
+    fbExporterUring_t   *uring;
+#endif
+    /** Queued UDP messages; NULL unless set by fbExporterSetUDPBatch() */
+    fbExporterUDPBatch_t *udpbatch;
+    /** Gathered stream writes; NULL unless set by fbExporterSetCoalesce() */
+    fbExporterCoalesce_t *coalesce;
+    /** Export thread; NULL unless started by fbExporterEnableAsync() */
+    fbExporterAsync_t   *async;
+    /** File rotation state; NULL unless set by fbExporterSetRotation() */
+    fbExporterRotate_t  *rotate;
+    /** Children of a fan-out exporter; NULL for other exporters */
+    fbExporterFanout_t  *fanout;
+    /** Compressor of a gzip or zstd output file; NULL if not compressed */
+    fbCompressStream_t  *compress;
     char                 source_ip[V4_MAX_SOURCE_ENTRY_LENGTH + 1];
     char                 source_ip6[V6_MAX_SOURCE_ENTRY_LENGTH + 1];
 };
@@ -223,6 +267,70 @@ fbExporterCloseFile(
     exporter->active = FALSE;
 }
 
+/**
+ * fbExporterOpenCompressedFile
+ *
+ * Opens the file and starts the helper thread that compresses the data
+ * written to it.
+ *
+ */
+static gboolean
+fbExporterOpenCompressedFile(
+    fbExporter_t  *exporter,
+    GError       **err)
+{
+    if (!fbExporterOpenFile(exporter, err)) {
+        return FALSE;
+    }
+    exporter->compress = fbCompressStreamAlloc(
+        exporter->stream.fp, fbCompressCodecForPath(exporter->spec.path),
+        TRUE, err);
+    if (!exporter->compress) {
+        fbExporterCloseFile(exporter);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ * fbExporterWriteCompressed
+ *
+ *
+ *
+ *
+ */
+static gboolean
+fbExporterWriteCompressed(
+    fbExporter_t  *exporter,
+    uint8_t       *msgbase,
+    size_t         msglen,
+    GError       **err)
+{
+    return fbCompressStreamWrite(exporter->compress, msgbase, msglen, err);
+}
+
+/**
+ * fbExporterCloseCompressedFile
+ *
+ * Ends the compressed data, which waits for the helper thread to write
+ * it, and closes the file.
+ *
+ */
+static void
+fbExporterCloseCompressedFile(
+    fbExporter_t  *exporter)
+{
+    GError *err = NULL;
+
+    if (!fbCompressStreamFree(exporter->compress, &err)) {
+        g_warning("Error completing compressed file %s: %s",
+                  exporter->spec.path, err->message);
+        g_clear_error(&err);
+    }
+    exporter->compress = NULL;
+    fbExporterCloseFile(exporter);
+}
+
 /**
  * fbExporterAllocFile
  *
@@ -245,9 +353,16 @@ fbExporterAllocFile(
     exporter->spec.path = g_strdup(path);
 
     /* Set up stream management functions */
-    exporter->exopen = fbExporterOpenFile;
-    exporter->exwrite = fbExporterWriteFile;
-    exporter->exclose = fbExporterCloseFile;
+    if (fbCompressCodecForPath(path) != FB_COMPRESS_NONE) {
+        /* compress by file extension */
+        exporter->exopen = fbExporterOpenCompressedFile;
+        exporter->exwrite = fbExporterWriteCompressed;
+        exporter->exclose = fbExporterCloseCompressedFile;
+    } else {
+        exporter->exopen = fbExporterOpenFile;
+        exporter->exwrite = fbExporterWriteFile;
+        exporter->exclose = fbExporterCloseFile;
+    }
     exporter->mtu = 65496;
 
     return exporter;
@@ -734,726 +849,3535 @@ fbExporterCloseSocket(
     exporter->active = FALSE;
 }
 
-#if HAVE_OPENSSL
+/* Most messages a UDP batch may hold; the kernel's limit on GSO segments */
+#define FB_UDP_BATCH_MAX        64
+
+/* Default number of octets a UDP batch may hold */
+#define FB_UDP_BATCH_BYTES      65000
+
+/* Most octets one UDP GSO send may carry */
+#define FB_UDP_GSO_BYTES_MAX    65000
 
 /**
- * fbExporterOpenTLS
+ * Batched UDP send state.  Emitted messages are copied back to back into
+ * 'buf' and sent together when the batch is full or flushed: as one UDP
+ * GSO send when every message but the last has the same length, which
+ * the kernel splits into one datagram per message, and otherwise with
+ * sendmmsg().  Either way the datagrams leave in the order the messages
+ * were emitted, so their sequence numbers stay in order.
+ */
+struct fbExporterUDPBatch_st {
+    /** Queued messages */
+    uint8_t          *buf;
+    /** Size of buf; the batch is sent before it would overflow */
+    size_t            bufsize;
+    /** Octets of buf in use */
+    size_t            used;
+    /** Length of each queued message */
+    size_t            lens[FB_UDP_BATCH_MAX];
+    /** Number of messages that fill the batch */
+    unsigned int      max_count;
+    /** Number of queued messages */
+    unsigned int      count;
+    /** FALSE once the kernel has refused a GSO send */
+    gboolean          gso;
+    /** TRUE once a send error has been logged */
+    gboolean          warned;
+};
+
+static void
+fbExporterUDPBatchFree(
+    fbExporterUDPBatch_t  *batch)
+{
+    if (batch) {
+        g_free(batch->buf);
+        g_slice_free(fbExporterUDPBatch_t, batch);
+    }
+}
+
+/**
+ * fbExporterUDPBatchWarn
  *
+ * Logs the first failed send of a batch; UDP export carries on and the
+ * messages are lost, as with fbExporterWriteUDP().
  *
- * @param exporter
- * @param err
+ */
+static void
+fbExporterUDPBatchWarn(
+    fbExporterUDPBatch_t  *batch,
+    int                    error)
+{
+    if (!batch->warned) {
+        g_warning("I/O error on UDP send: %s (socket closed on receiver?)",
+                  strerror(error));
+        g_warning("packets will be lost");
+        batch->warned = TRUE;
+    }
+}
+
+#ifdef UDP_SEGMENT
+/**
+ * fbExporterUDPBatchSendGSO
+ *
+ * Sends the batch as one UDP GSO send if its messages allow it.  Returns
+ * TRUE if the batch has been sent or lost to a send error, FALSE if it
+ * must be sent another way.
  *
- * @return
  */
 static gboolean
-fbExporterOpenTLS(
-    fbExporter_t  *exporter,
-    GError       **err)
+fbExporterUDPBatchSendGSO(
+    fbExporter_t  *exporter)
 {
-    BIO     *conn = NULL;
-    char     errbuf[FB_SSL_ERR_BUFSIZ];
-    gboolean ok = TRUE;
-
-    /* Initialize SSL context if necessary */
-    if (!exporter->spec.conn->vssl_ctx) {
-        if (!fbConnSpecInitTLS(exporter->spec.conn, FALSE, err)) {
+    fbExporterUDPBatch_t *batch = exporter->udpbatch;
+    struct msghdr         msg;
+    struct iovec          iov;
+    struct cmsghdr       *cmsg;
+    union {
+        char             buf[CMSG_SPACE(sizeof(uint16_t))];
+        struct cmsghdr   align;
+    }                     ctrl;
+    uint16_t              segment;
+    unsigned int          i;
+    ssize_t               rc;
+
+    if (!batch->gso || batch->count < 2
+        || batch->used > FB_UDP_GSO_BYTES_MAX)
+    {
+        return FALSE;
+    }
+    /* the kernel cuts the data into segments of the first message's
+     * length; only the last may be shorter */
+    for (i = 1; i < batch->count - 1; ++i) {
+        if (batch->lens[i] != batch->lens[0]) {
             return FALSE;
         }
     }
-
-    /* open underlying socket */
-    if (!fbExporterOpenSocket(exporter, err)) {return FALSE;}
-
-    /* wrap a stream BIO around the opened socket */
-    if (!(conn = BIO_new_socket(exporter->stream.fd, 1))) {
-        ok = FALSE;
-        ERR_error_string_n(ERR_get_error(), errbuf, sizeof(errbuf));
-        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
-                    "couldn't wrap socket to %s:%s for TLS: %s",
-                    exporter->spec.conn->host, exporter->spec.conn->svc,
-                    errbuf);
-        ERR_clear_error();
-        goto end;
-    }
-
-    /* create SSL socket */
-    if (!(exporter->ssl = SSL_new((SSL_CTX *)exporter->spec.conn->vssl_ctx))) {
-        ok = FALSE;
-        ERR_error_string_n(ERR_get_error(), errbuf, sizeof(errbuf));
-        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
-                    "couldnt create TLS socket: %s", errbuf);
-        ERR_clear_error();
-        goto end;
+    if (batch->lens[batch->count - 1] > batch->lens[0]) {
+        return FALSE;
     }
 
-    /* connect to it */
-    SSL_set_bio(exporter->ssl, conn, conn);
-    if (SSL_connect(exporter->ssl) <= 0) {
-        ok = FALSE;
-        ERR_error_string_n(ERR_get_error(), errbuf, sizeof(errbuf));
-        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
-                    "couldn't connect TLS socket to %s:%s: %s",
-                    exporter->spec.conn->host, exporter->spec.conn->svc,
-                    errbuf);
-        ERR_clear_error();
-        goto end;
-    }
+    memset(&msg, 0, sizeof(msg));
+    memset(&ctrl, 0, sizeof(ctrl));
+    iov.iov_base = batch->buf;
+    iov.iov_len = batch->used;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = IPPROTO_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(segment));
+    segment = (uint16_t)batch->lens[0];
+    memcpy(CMSG_DATA(cmsg), &segment, sizeof(segment));
 
-    /* FIXME do post-connection verification */
+    do {
+        rc = sendmsg(exporter->stream.fd, &msg, 0);
+    } while (-1 == rc && EINTR == errno);
 
-  end:
-    if (!ok) {
-        exporter->active = FALSE;
-        if (exporter->ssl) {
-            SSL_free(exporter->ssl);
-            exporter->ssl = NULL;
-        } else if (conn) {
-            BIO_vfree(conn);
+    if (rc == (ssize_t)batch->used) {
+        return TRUE;
+    }
+    if (-1 == rc) {
+        switch (errno) {
+          case EINVAL:
+          case EIO:
+          case ENOPROTOOPT:
+          case EOPNOTSUPP:
+            /* kernel or device cannot segment; stop trying */
+            g_debug("UDP GSO unavailable (%s); sending messages one by one",
+                    strerror(errno));
+            batch->gso = FALSE;
+            return FALSE;
+          case EMSGSIZE:
+            return FALSE;
         }
+        fbExporterUDPBatchWarn(batch, errno);
     }
-    return ok;
+    return TRUE;
 }
-
-#if HAVE_OPENSSL_DTLS
+#endif  /* UDP_SEGMENT */
 
 /**
- * fbExporterOpenDTLS
+ * fbExporterUDPBatchFlush
  *
- * @param exporter
- * @param err
- *
- * @return
+ * Sends every queued message and empties the batch.
  *
  */
 static gboolean
-fbExporterOpenDTLS(
+fbExporterUDPBatchFlush(
     fbExporter_t  *exporter,
     GError       **err)
 {
-    BIO            *conn = NULL;
-    gboolean        ok = TRUE;
-    struct sockaddr peer;
-    char            errbuf[FB_SSL_ERR_BUFSIZ];
-    size_t          peerlen = sizeof(struct sockaddr);
-
-    /* Initialize SSL context if necessary */
-    if (!exporter->spec.conn->vssl_ctx) {
-        if (!fbConnSpecInitTLS(exporter->spec.conn, FALSE, err)) {
-            return FALSE;
-        }
-    }
-
-    /* open underlying socket */
-    if (!fbExporterOpenSocket(exporter, err)) {return FALSE;}
+    fbExporterUDPBatch_t *batch = exporter->udpbatch;
+    uint8_t              *msgbase = batch->buf;
+    unsigned int          i;
+#if HAVE_SENDMMSG
+    struct mmsghdr        msgs[FB_UDP_BATCH_MAX];
+    struct iovec          iov[FB_UDP_BATCH_MAX];
+    unsigned int          sent = 0;
+    int                   rc;
+#endif
 
-    /* wrap a datagram BIO around the opened socket */
-    if (!(conn = BIO_new_dgram(exporter->stream.fd, 1))) {
-        ok = FALSE;
-        ERR_error_string_n(ERR_get_error(), errbuf, sizeof(errbuf));
-        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
-                    "couldn't wrap socket to %s:%s for DTLS: %s",
-                    exporter->spec.conn->host, exporter->spec.conn->svc,
-                    errbuf);
-        ERR_clear_error();
-        goto end;
+    if (0 == batch->count) {
+        return TRUE;
     }
-
-    /* Tell dgram bio what its name is */
-    if (getsockname(exporter->stream.fd, &peer, (socklen_t *)&peerlen) < 0) {
-        ok = FALSE;
-        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
-                    "couldn't wrap socket to %s:%s for DTLS: %s",
-                    exporter->spec.conn->host, exporter->spec.conn->svc,
-                    strerror(errno));
-        goto end;
+#ifdef UDP_SEGMENT
+    if (fbExporterUDPBatchSendGSO(exporter)) {
+        batch->count = 0;
+        batch->used = 0;
+        return TRUE;
     }
-#if OPENSSL_VERSION_NUMBER < 0x10100000L
-    BIO_ctrl_set_connected(conn, 1, &peer);
-#else
-    BIO_ctrl_set_connected(conn, &peer);
 #endif
 
-    /* create SSL socket */
-    if (!(exporter->ssl = SSL_new((SSL_CTX *)exporter->spec.conn->vssl_ctx))) {
-        ok = FALSE;
-        ERR_error_string_n(ERR_get_error(), errbuf, sizeof(errbuf));
-        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
-                    "couldnt create DTLS socket: %s", errbuf);
-        ERR_clear_error();
-        goto end;
+#if HAVE_SENDMMSG
+    memset(msgs, 0, sizeof(msgs));
+    for (i = 0; i < batch->count; ++i) {
+        iov[i].iov_base = msgbase;
+        iov[i].iov_len = batch->lens[i];
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgbase += batch->lens[i];
     }
-
-    /* connect to it */
-    SSL_set_bio(exporter->ssl, conn, conn);
-    SSL_set_connect_state(exporter->ssl);
-
-    /* FIXME do post-connection verification */
-
-  end:
-    if (!ok) {
-        exporter->active = FALSE;
-        if (exporter->ssl) {
-            SSL_free(exporter->ssl);
-            exporter->ssl = NULL;
-        } else if (conn) {
-            BIO_vfree(conn);
+    while (sent < batch->count) {
+        rc = sendmmsg(exporter->stream.fd, msgs + sent, batch->count - sent,
+                      0);
+        if (rc > 0) {
+            sent += rc;
+        } else if (-1 == rc && EINTR == errno) {
+            continue;
+        } else {
+            /* the rest of the batch is lost */
+            fbExporterUDPBatchWarn(batch, errno);
+            break;
         }
     }
-    return ok;
-}
+#else  /* HAVE_SENDMMSG */
+    for (i = 0; i < batch->count; ++i) {
+        if (!fbExporterWriteUDP(exporter, msgbase, batch->lens[i], err)) {
+            batch->count = 0;
+            batch->used = 0;
+            return FALSE;
+        }
+        msgbase += batch->lens[i];
+    }
+#endif  /* HAVE_SENDMMSG */
 
-#endif /* HAVE_OPENSSL_DTLS */
+    batch->count = 0;
+    batch->used = 0;
+    return TRUE;
+}
 
 /**
- * fbExporterWriteTLS
+ * fbExporterWriteUDPBatch
  *
+ * Adds the message to the batch, sending the batch first if the message
+ * does not fit and afterward if the batch is full.
  *
- * @param exporter
- * @param msgbase
- * @param msglen
- * @param err
- *
- * @return
  */
 static gboolean
-fbExporterWriteTLS(
+fbExporterWriteUDPBatch(
     fbExporter_t  *exporter,
     uint8_t       *msgbase,
     size_t         msglen,
     GError       **err)
 {
-    char errbuf[FB_SSL_ERR_BUFSIZ];
-    int  rc;
+    fbExporterUDPBatch_t *batch = exporter->udpbatch;
 
-    while (msglen) {
-        rc = SSL_write(exporter->ssl, msgbase, msglen);
-        if (rc <= 0) {
-            ERR_error_string_n(ERR_get_error(), errbuf, sizeof(errbuf));
-            g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
-                        "I/O error: %s", errbuf);
-            ERR_clear_error();
+    if (batch->used + msglen > batch->bufsize) {
+        if (!fbExporterUDPBatchFlush(exporter, err)) {
             return FALSE;
         }
-
-        /* we sent some bytes - advance pointers */
-        msglen -= rc;
-        msgbase += rc;
+        if (msglen > batch->bufsize) {
+            return fbExporterWriteUDP(exporter, msgbase, msglen, err);
+        }
     }
 
+    memcpy(batch->buf + batch->used, msgbase, msglen);
+    batch->lens[batch->count] = msglen;
+    batch->used += msglen;
+    ++batch->count;
+
+    /* send now rather than on the next message if no room is left for a
+     * message of the MTU */
+    if (batch->count == batch->max_count
+        || batch->bufsize - batch->used < exporter->mtu)
+    {
+        return fbExporterUDPBatchFlush(exporter, err);
+    }
     return TRUE;
 }
 
 /**
- * fbExporterCloseTLS
- *
+ * fbExporterCloseUDPBatch
  *
- * @param exporter
+ * Sends any queued messages and closes the socket.
  *
  */
 static void
-fbExporterCloseTLS(
+fbExporterCloseUDPBatch(
     fbExporter_t  *exporter)
 {
-    SSL_shutdown(exporter->ssl);
-    SSL_free(exporter->ssl);
+    GError *err = NULL;
+
+    if (!fbExporterUDPBatchFlush(exporter, &err)) {
+        g_debug("Discarding UDP send error on close: %s", err->message);
+        g_clear_error(&err);
+    }
+    fbExporterCloseSocket(exporter);
+}
+
+/**
+ * Write coalescing state.  Emitted messages are copied into 'buf' and
+ * written to the stream in one call to the exporter's own write function
+ * when the next message would not fit, when the oldest message has waited
+ * 'max_delay' microseconds, or when the exporter is flushed or closed.
+ * The exporter's own functions are kept here while exwrite and exclose
+ * point at the coalescing ones.
+ *
+ * When 'max_delay' is set, the 'flusher' thread writes the buffer once
+ * its oldest message is due, so the delay holds even if no more messages
+ * are emitted.  'mutex' protects the buffer and every write to the stream;
+ * an error from the thread is kept in 'error' and reported by the next
+ * write or flush.
+ */
+struct fbExporterCoalesce_st {
+    /** Gathered messages */
+    uint8_t             *buf;
+    /** Size of buf */
+    size_t               bufsize;
+    /** Octets of buf in use */
+    size_t               used;
+    /** Longest a message may wait in buf, in microseconds; 0 for no limit */
+    gint64               max_delay;
+    /** Monotonic time the oldest message in buf was added */
+    gint64               first_time;
+    /** The exporter's own write function */
+    fbExporterWrite_fn   write;
+    /** The exporter's own close function */
+    fbExporterClose_fn   close;
+    /** Write error from the flush thread, not yet reported */
+    GError              *error;
+    /** TRUE while 'flusher' may be running */
+    gboolean             running;
+    /** Set to ask the flush thread to stop */
+    gboolean             stop;
+    pthread_t            flusher;
+    pthread_mutex_t      mutex;
+    pthread_cond_t       cond;
+};
+
+static void
+fbExporterCoalesceFree(
+    fbExporterCoalesce_t  *coalesce)
+{
+    if (coalesce) {
+        if (coalesce->running) {
+            pthread_mutex_lock(&coalesce->mutex);
+            coalesce->stop = TRUE;
+            pthread_cond_signal(&coalesce->cond);
+            pthread_mutex_unlock(&coalesce->mutex);
+            pthread_join(coalesce->flusher, NULL);
+        }
+        g_clear_error(&coalesce->error);
+        pthread_cond_destroy(&coalesce->cond);
+        pthread_mutex_destroy(&coalesce->mutex);
+        g_free(coalesce->buf);
+        g_slice_free(fbExporterCoalesce_t, coalesce);
+    }
+}
+
+/**
+ * fbExporterCoalesceFlushLocked
+ *
+ * Writes the gathered messages with the exporter's own write function and
+ * empties the buffer.  The messages are discarded if the write fails.
+ * The caller holds the coalescing mutex.
+ *
+ */
+static gboolean
+fbExporterCoalesceFlushLocked(
+    fbExporter_t  *exporter,
+    GError       **err)
+{
+    fbExporterCoalesce_t *coalesce = exporter->coalesce;
+    size_t                used = coalesce->used;
+
+    if (coalesce->error) {
+        g_propagate_error(err, coalesce->error);
+        coalesce->error = NULL;
+        return FALSE;
+    }
+    if (0 == used) {
+        return TRUE;
+    }
+    coalesce->used = 0;
+    return coalesce->write(exporter, coalesce->buf, used, err);
+}
+
+/**
+ * fbExporterCoalesceFlush
+ *
+ * Writes the gathered messages, reporting a write error from the flush
+ * thread first if there is one.
+ *
+ */
+static gboolean
+fbExporterCoalesceFlush(
+    fbExporter_t  *exporter,
+    GError       **err)
+{
+    fbExporterCoalesce_t *coalesce = exporter->coalesce;
+    gboolean              ok;
+
+    pthread_mutex_lock(&coalesce->mutex);
+    ok = fbExporterCoalesceFlushLocked(exporter, err);
+    pthread_mutex_unlock(&coalesce->mutex);
+    return ok;
+}
+
+/**
+ * fbExporterCoalesceThread
+ *
+ * Writes the buffer whenever its oldest message has waited 'max_delay',
+ * until asked to stop.
+ *
+ */
+static void *
+fbExporterCoalesceThread(
+    void  *arg)
+{
+    fbExporter_t         *exporter = (fbExporter_t *)arg;
+    fbExporterCoalesce_t *coalesce = exporter->coalesce;
+    struct timespec       ts;
+    gint64                wait;
+    gint64                due;
+
+    pthread_mutex_lock(&coalesce->mutex);
+    while (!coalesce->stop) {
+        if (0 == coalesce->used || 0 == coalesce->max_delay) {
+            pthread_cond_wait(&coalesce->cond, &coalesce->mutex);
+            continue;
+        }
+        wait = (coalesce->first_time + coalesce->max_delay
+                - g_get_monotonic_time());
+        if (wait > 0) {
+            /* the condition's clock is the real time clock */
+            due = g_get_real_time() + wait;
+            ts.tv_sec = due / G_USEC_PER_SEC;
+            ts.tv_nsec = (due % G_USEC_PER_SEC) * 1000;
+            pthread_cond_timedwait(&coalesce->cond, &coalesce->mutex, &ts);
+            continue;
+        }
+        fbExporterCoalesceFlushLocked(exporter, &coalesce->error);
+    }
+    pthread_mutex_unlock(&coalesce->mutex);
+    return NULL;
+}
+
+/**
+ * fbExporterWriteCoalesce
+ *
+ * Adds the message to the buffer, writing the buffer first if the message
+ * does not fit and afterward if its oldest message is due.
+ *
+ */
+static gboolean
+fbExporterWriteCoalesce(
+    fbExporter_t  *exporter,
+    uint8_t       *msgbase,
+    size_t         msglen,
+    GError       **err)
+{
+    fbExporterCoalesce_t *coalesce = exporter->coalesce;
+    gboolean              ok = TRUE;
+
+    pthread_mutex_lock(&coalesce->mutex);
+    if (coalesce->error
+        || coalesce->used + msglen > coalesce->bufsize)
+    {
+        if (!fbExporterCoalesceFlushLocked(exporter, err)) {
+            ok = FALSE;
+            goto END;
+        }
+        if (msglen > coalesce->bufsize) {
+            ok = coalesce->write(exporter, msgbase, msglen, err);
+            goto END;
+        }
+    }
+
+    if (0 == coalesce->used) {
+        coalesce->first_time = g_get_monotonic_time();
+        /* the flush thread now has a deadline to wait for */
+        pthread_cond_signal(&coalesce->cond);
+    }
+    memcpy(coalesce->buf + coalesce->used, msgbase, msglen);
+    coalesce->used += msglen;
+
+    if (coalesce->used == coalesce->bufsize
+        || (coalesce->max_delay
+            && (g_get_monotonic_time() - coalesce->first_time
+                >= coalesce->max_delay)))
+    {
+        ok = fbExporterCoalesceFlushLocked(exporter, err);
+    }
+  END:
+    pthread_mutex_unlock(&coalesce->mutex);
+    return ok;
+}
+
+/**
+ * fbExporterCloseCoalesce
+ *
+ * Writes any gathered messages and closes the stream.
+ *
+ */
+static void
+fbExporterCloseCoalesce(
+    fbExporter_t  *exporter)
+{
+    fbExporterCoalesce_t *coalesce = exporter->coalesce;
+    GError               *err = NULL;
+
+    pthread_mutex_lock(&coalesce->mutex);
+    if (!fbExporterCoalesceFlushLocked(exporter, &err)) {
+        g_debug("Discarding write error on close: %s", err->message);
+        g_clear_error(&err);
+    }
+    coalesce->close(exporter);
+    pthread_mutex_unlock(&coalesce->mutex);
+}
+
+/**
+ * fbExporterStopCoalesce
+ *
+ * Writes any gathered messages and restores the exporter's own write and
+ * close functions.
+ *
+ */
+static gboolean
+fbExporterStopCoalesce(
+    fbExporter_t  *exporter,
+    GError       **err)
+{
+    fbExporterCoalesce_t *coalesce = exporter->coalesce;
+    gboolean              ok = TRUE;
+
+    if (!coalesce) {
+        return TRUE;
+    }
+    if (exporter->active) {
+        ok = fbExporterCoalesceFlush(exporter, err);
+    }
+    exporter->exwrite = coalesce->write;
+    exporter->exclose = coalesce->close;
+    /* joins the flush thread before the exporter forgets it */
+    fbExporterCoalesceFree(coalesce);
+    exporter->coalesce = NULL;
+    return ok;
+}
+
+/**
+ * fbExporterWriteMessage
+ *
+ * Writes a message to the stream, opening it first if needed and closing
+ * it if the write fails.
+ *
+ */
+static gboolean
+fbExporterWriteMessage(
+    fbExporter_t  *exporter,
+    uint8_t       *msgbase,
+    size_t         msglen,
+    GError       **err)
+{
+    /* Ensure stream is open */
+    if (!exporter->active) {
+        g_assert(exporter->exopen);
+        if (!exporter->exopen(exporter, err)) {return FALSE;}
+    }
+
+    /* Attempt to write message */
+    if (exporter->exwrite(exporter, msgbase, msglen, err)) {return TRUE;}
+
+    /* Close exporter on write failure */
+    if (exporter->exclose) {exporter->exclose(exporter);}
+    return FALSE;
+}
+
+/**
+ * File rotation state.  The exporter's path is the current file's, and
+ * the counters cover what has been exported to it.  A finished file is
+ * closed by the 'closer' thread, so finishing its compressed data and
+ * closing it do not hold up the thread that emits messages.
+ */
+struct fbExporterRotate_st {
+    /** strftime() pattern of file names, plus %N for the file number */
+    char                *pattern;
+    /** Rotate once this many octets are exported to a file; 0 for none */
+    uint64_t             max_bytes;
+    /** Rotate once this many records are exported to a file; 0 for none */
+    uint64_t             max_records;
+    /** Rotate at each multiple of this many seconds; 0 for none */
+    uint32_t             interval;
+    /** Octets exported to the current file */
+    uint64_t             bytes;
+    /** Records exported to the current file */
+    uint64_t             records;
+    /** Time the current file was named */
+    time_t               start;
+    /** Number of the current file, counting from 0 */
+    uint32_t             serial;
+    /** TRUE while 'closer' may still be running */
+    gboolean             closing;
+    pthread_t            closer;
+};
+
+/**
+ * A file handed to the closer thread.
+ */
+typedef struct fbExporterRetired_st {
+    FILE                *fp;
+    fbCompressStream_t  *compress;
+    char                *path;
+} fbExporterRetired_t;
+
+/**
+ * fbExporterRetireThread
+ *
+ * Completes and closes a file the exporter has rotated away from.
+ *
+ */
+static void *
+fbExporterRetireThread(
+    void  *arg)
+{
+    fbExporterRetired_t *retired = (fbExporterRetired_t *)arg;
+    GError              *err = NULL;
+
+    if (retired->compress && !fbCompressStreamFree(retired->compress, &err)) {
+        g_warning("Couldn't complete %s: %s", retired->path, err->message);
+        g_clear_error(&err);
+    }
+    if (fclose(retired->fp) != 0) {
+        g_warning("Couldn't close %s: %s", retired->path, strerror(errno));
+    }
+    g_free(retired->path);
+    g_slice_free(fbExporterRetired_t, retired);
+    return NULL;
+}
+
+/**
+ * fbExporterRotateJoin
+ *
+ * Waits for the closer thread to finish the previous file.
+ *
+ */
+static void
+fbExporterRotateJoin(
+    fbExporterRotate_t  *rotate)
+{
+    if (rotate->closing) {
+        pthread_join(rotate->closer, NULL);
+        rotate->closing = FALSE;
+    }
+}
+
+/**
+ * fbExporterRotateSwitch
+ *
+ * Hands the current file, if open, to the closer thread and makes `name`
+ * the path the next message opens.  Takes ownership of `name`.  Runs on
+ * the export thread of an async exporter, in order with the messages.
+ * Returns FALSE if the coalesced messages could not be written to the
+ * current file, but switches files regardless.
+ *
+ */
+static gboolean
+fbExporterRotateSwitch(
+    fbExporter_t  *exporter,
+    char          *name,
+    GError       **err)
+{
+    fbExporterRotate_t  *rotate = exporter->rotate;
+    fbExporterRetired_t *retired;
+    gboolean             ok = TRUE;
+    int                  rv;
+
+    if (exporter->active) {
+        /* everything gathered so far belongs in the current file */
+        if (exporter->coalesce) {
+            ok = fbExporterCoalesceFlush(exporter, err);
+        }
+
+        /* hand the file to the closer thread; only one runs at a time */
+        fbExporterRotateJoin(rotate);
+        retired = g_slice_new0(fbExporterRetired_t);
+        retired->fp = exporter->stream.fp;
+        retired->compress = exporter->compress;
+        retired->path = g_strdup(exporter->spec.path);
+        exporter->stream.fp = NULL;
+        exporter->compress = NULL;
+        exporter->active = FALSE;
+
+        rv = pthread_create(&rotate->closer, NULL, fbExporterRetireThread,
+                            retired);
+        if (0 == rv) {
+            rotate->closing = TRUE;
+        } else {
+            fbExporterRetireThread(retired);
+        }
+    }
+
+    /* the next message opens the new file */
+    g_free(exporter->spec.path);
+    exporter->spec.path = name;
+    return ok;
+}
+
+/* Default number of messages the ring of an async exporter holds */
+#define FB_ASYNC_SLOTS_DEFAULT  64
+
+/* Bits of fbExporterAsync_t.waiting */
+#define FB_ASYNC_WAIT_DATA      0x01
+#define FB_ASYNC_WAIT_SPACE     0x02
+
+/**
+ * Asynchronous export state.  The emitting thread puts references to the
+ * fBuf's message buffers in a single-producer, single-consumer ring, and
+ * the export thread writes them to the stream in order and releases them.
+ * A slot is freed only after its message is written, so an empty ring
+ * means every queued message has been written.
+ *
+ * With FB_ASYNC_SPILL, messages that find the ring full are appended to
+ * the spill file, and so is every later message until the thread has
+ * written the whole file, which it reads only once the ring is empty.
+ * That keeps the messages in order.  The spill offsets are protected by
+ * 'mutex'.
+ *
+ * A slot with no message buffer marks a file rotation: the thread moves
+ * to the file in 'paths' after writing the messages before it.
+ */
+struct fbExporterAsync_st {
+    /** Message buffer of each slot */
+    fbMessageBuffer_t      **bufs;
+    /** Length of the message in each slot */
+    size_t                  *lens;
+    /** Next file of each rotation marker slot; NULL in the others */
+    char                   **paths;
+    /** Number of slots */
+    unsigned int             slots;
+    /** Next slot to fill; used only by the emitting thread */
+    unsigned int             tail;
+    /** Next slot to write; used only by the export thread */
+    unsigned int             head;
+    /** Number of full slots */
+    volatile gint            count;
+    /** FB_ASYNC_WAIT_* bits of the sides asleep on 'cond' */
+    volatile gint            waiting;
+    /** Set while messages are going to the spill file */
+    volatile gint            spilling;
+    /** Set to ask the thread to stop */
+    volatile gint            stop;
+    /** What to do with a message that finds the ring full */
+    fbAsyncPolicy_t          policy;
+    /** Spill file descriptor; -1 if none */
+    int                      spill_fd;
+    /** Path of the spill file */
+    char                    *spill_path;
+    /** Offset of the next message to read from the spill file */
+    off_t                    spill_read;
+    /** Offset at which the next spilled message is written */
+    off_t                    spill_write;
+    /** The first write error not yet reported to the emitting thread */
+    GError                  *error;
+    /** Counters; protected by 'mutex' so a snapshot is never torn */
+    fbExporterAsyncStats_t   stats;
+    pthread_t                thread;
+    pthread_mutex_t          mutex;
+    pthread_cond_t           cond;
+};
+
+/**
+ * fbExporterAsyncWake
+ *
+ * Wakes any side asleep on the async condition.
+ *
+ */
+static void
+fbExporterAsyncWake(
+    fbExporterAsync_t  *async)
+{
+    pthread_mutex_lock(&async->mutex);
+    pthread_cond_broadcast(&async->cond);
+    pthread_mutex_unlock(&async->mutex);
+}
+
+/**
+ * fbExporterAsyncCount
+ *
+ * Adds one to `counter`, a member of the async stats, holding the mutex.
+ *
+ */
+static void
+fbExporterAsyncCount(
+    fbExporterAsync_t  *async,
+    uint64_t           *counter)
+{
+    pthread_mutex_lock(&async->mutex);
+    ++*counter;
+    pthread_mutex_unlock(&async->mutex);
+}
+
+/**
+ * fbExporterAsyncKeepError
+ *
+ * Keeps `err` for the emitting thread unless an earlier error is still
+ * pending, and frees it otherwise.
+ *
+ */
+static void
+fbExporterAsyncKeepError(
+    fbExporterAsync_t  *async,
+    GError             *err)
+{
+    pthread_mutex_lock(&async->mutex);
+    if (NULL == async->error) {
+        async->error = err;
+        err = NULL;
+    }
+    pthread_mutex_unlock(&async->mutex);
+    g_clear_error(&err);
+}
+
+/**
+ * fbExporterAsyncWrite
+ *
+ * Writes one message from the export thread, keeping the first error for
+ * the emitting thread.
+ *
+ */
+static void
+fbExporterAsyncWrite(
+    fbExporter_t  *exporter,
+    uint8_t       *msgbase,
+    size_t         msglen)
+{
+    fbExporterAsync_t *async = exporter->async;
+    GError            *err = NULL;
+
+    if (fbExporterWriteMessage(exporter, msgbase, msglen, &err)) {
+        fbExporterAsyncCount(async, &async->stats.written);
+        return;
+    }
+    fbExporterAsyncCount(async, &async->stats.write_errors);
+    fbExporterAsyncKeepError(async, err);
+}
+
+/**
+ * fbExporterAsyncUnspill
+ *
+ * Writes the next message in the spill file.  Ends spilling when the file
+ * has been written entirely.
+ *
+ */
+static void
+fbExporterAsyncUnspill(
+    fbExporter_t  *exporter,
+    uint8_t       *msgbuf)
+{
+    fbExporterAsync_t *async = exporter->async;
+    uint16_t           msglen = 0;
+    ssize_t            rc;
+
+    pthread_mutex_lock(&async->mutex);
+    if (async->spill_read < async->spill_write) {
+        /* the IPFIX message header gives the length */
+        rc = pread(async->spill_fd, msgbuf, 4, async->spill_read);
+        if (4 == rc) {
+            memcpy(&msglen, msgbuf + 2, sizeof(msglen));
+            msglen = g_ntohs(msglen);
+        }
+        if (msglen < 4 || (async->spill_read + msglen > async->spill_write)
+            || (pread(async->spill_fd, msgbuf, msglen, async->spill_read)
+                != (ssize_t)msglen))
+        {
+            g_warning("Discarding unreadable spill file %s",
+                      async->spill_path);
+            async->spill_read = async->spill_write;
+            msglen = 0;
+        }
+    }
+    pthread_mutex_unlock(&async->mutex);
+
+    if (msglen) {
+        fbExporterAsyncWrite(exporter, msgbuf, msglen);
+    }
+
+    pthread_mutex_lock(&async->mutex);
+    async->spill_read += msglen;
+    if (async->spill_read >= async->spill_write) {
+        /* caught up; the emitting thread may use the ring again */
+        if (ftruncate(async->spill_fd, 0) != 0) {
+            g_debug("Unable to truncate spill file %s: %s",
+                    async->spill_path, strerror(errno));
+        }
+        async->spill_read = 0;
+        async->spill_write = 0;
+        g_atomic_int_set(&async->spilling, 0);
+        pthread_cond_broadcast(&async->cond);
+    }
+    pthread_mutex_unlock(&async->mutex);
+}
+
+/**
+ * fbExporterAsyncThread
+ *
+ * The export thread: writes queued messages, then spilled ones, until the
+ * exporter asks it to stop.
+ *
+ */
+static void *
+fbExporterAsyncThread(
+    void  *arg)
+{
+    fbExporter_t      *exporter = (fbExporter_t *)arg;
+    fbExporterAsync_t *async = exporter->async;
+    uint8_t           *spillbuf = NULL;
+    GError            *err = NULL;
+
+    if (async->spill_fd != -1) {
+        spillbuf = g_new(uint8_t, FB_MSGLEN_MAX);
+    }
+
+    for (;;) {
+        if (g_atomic_int_get(&async->count) > 0) {
+            if (NULL == async->bufs[async->head]) {
+                if (!fbExporterRotateSwitch(exporter,
+                                            async->paths[async->head], &err))
+                {
+                    fbExporterAsyncKeepError(async, err);
+                    err = NULL;
+                }
+                async->paths[async->head] = NULL;
+            } else {
+                fbExporterAsyncWrite(
+                    exporter,
+                    fbMessageBufferGetData(async->bufs[async->head]),
+                    async->lens[async->head]);
+                fbMessageBufferUnref(async->bufs[async->head]);
+                async->bufs[async->head] = NULL;
+            }
+            async->head = (async->head + 1) % async->slots;
+            g_atomic_int_add(&async->count, -1);
+            if (g_atomic_int_get(&async->waiting) & FB_ASYNC_WAIT_SPACE) {
+                fbExporterAsyncWake(async);
+            }
+            continue;
+        }
+        if (g_atomic_int_get(&async->spilling)) {
+            fbExporterAsyncUnspill(exporter, spillbuf);
+            continue;
+        }
+        if (g_atomic_int_get(&async->stop)) {
+            break;
+        }
+
+        pthread_mutex_lock(&async->mutex);
+        g_atomic_int_or((guint *)&async->waiting, FB_ASYNC_WAIT_DATA);
+        while (0 == g_atomic_int_get(&async->count)
+               && !g_atomic_int_get(&async->spilling)
+               && !g_atomic_int_get(&async->stop))
+        {
+            pthread_cond_wait(&async->cond, &async->mutex);
+        }
+        g_atomic_int_and((guint *)&async->waiting, ~FB_ASYNC_WAIT_DATA);
+        pthread_mutex_unlock(&async->mutex);
+    }
+
+    g_free(spillbuf);
+    return NULL;
+}
+
+/**
+ * fbExporterAsyncCheckError
+ *
+ * Sets `err` and returns FALSE if the export thread has failed to write
+ * a message since the last check.
+ *
+ */
+static gboolean
+fbExporterAsyncCheckError(
+    fbExporterAsync_t  *async,
+    GError            **err)
+{
+    GError *error;
+
+    pthread_mutex_lock(&async->mutex);
+    error = async->error;
+    async->error = NULL;
+    pthread_mutex_unlock(&async->mutex);
+
+    if (error) {
+        g_propagate_error(err, error);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ * fbExporterAsyncDrain
+ *
+ * Waits until the export thread has written every queued and spilled
+ * message, so the caller may use the stream.  Write errors stay pending
+ * for fbExporterAsyncCheckError().
+ *
+ */
+static void
+fbExporterAsyncDrain(
+    fbExporter_t  *exporter)
+{
+    fbExporterAsync_t *async = exporter->async;
+
+    if (NULL == async) {
+        return;
+    }
+    pthread_mutex_lock(&async->mutex);
+    g_atomic_int_or((guint *)&async->waiting, FB_ASYNC_WAIT_SPACE);
+    while (g_atomic_int_get(&async->count) > 0
+           || g_atomic_int_get(&async->spilling))
+    {
+        pthread_cond_wait(&async->cond, &async->mutex);
+    }
+    g_atomic_int_and((guint *)&async->waiting, ~FB_ASYNC_WAIT_SPACE);
+    pthread_mutex_unlock(&async->mutex);
+}
+
+/**
+ * fbExporterMessageHasTemplates
+ *
+ * Returns TRUE if the message holds a template or options template set.
+ *
+ */
+static gboolean
+fbExporterMessageHasTemplates(
+    const uint8_t  *msgbase,
+    size_t          msglen)
+{
+    size_t   off = 16;
+    uint16_t set_id;
+    uint16_t set_len;
+
+    while (off + 4 <= msglen) {
+        memcpy(&set_id, msgbase + off, sizeof(set_id));
+        memcpy(&set_len, msgbase + off + 2, sizeof(set_len));
+        set_id = g_ntohs(set_id);
+        set_len = g_ntohs(set_len);
+        if (FB_TID_TS == set_id || FB_TID_OTS == set_id) {
+            return TRUE;
+        }
+        if (set_len < 4) {
+            break;
+        }
+        off += set_len;
+    }
+    return FALSE;
+}
+
+/**
+ * fbExporterAsyncSpill
+ *
+ * Appends a message to the spill file.  Must be called with the mutex
+ * held.
+ *
+ */
+static gboolean
+fbExporterAsyncSpill(
+    fbExporterAsync_t  *async,
+    const uint8_t      *msgbase,
+    size_t              msglen,
+    GError            **err)
+{
+    if (pwrite(async->spill_fd, msgbase, msglen, async->spill_write)
+        != (ssize_t)msglen)
+    {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                    "Couldn't write %u bytes to spill file %s: %s",
+                    (uint32_t)msglen, async->spill_path, strerror(errno));
+        return FALSE;
+    }
+    async->spill_write += msglen;
+    ++async->stats.spilled;
+    g_atomic_int_set(&async->spilling, 1);
+    return TRUE;
+}
+
+/**
+ * fbExporterAsyncPush
+ *
+ * Hands a message to the export thread, applying the exporter's policy
+ * when the ring is full.  The ring takes a reference to `msgbuf`.
+ *
+ */
+static gboolean
+fbExporterAsyncPush(
+    fbExporter_t       *exporter,
+    fbMessageBuffer_t  *msgbuf,
+    size_t              msglen,
+    GError            **err)
+{
+    fbExporterAsync_t *async = exporter->async;
+    uint8_t           *msgbase = fbMessageBufferGetData(msgbuf);
+    gboolean           ok = TRUE;
+
+    if (!fbExporterAsyncCheckError(async, err)) {
+        return FALSE;
+    }
+
+    if (FB_ASYNC_SPILL == async->policy) {
+        /* once spilling, everything spills until the thread catches up */
+        if (g_atomic_int_get(&async->spilling)
+            || g_atomic_int_get(&async->count) == (gint)async->slots)
+        {
+            pthread_mutex_lock(&async->mutex);
+            if (g_atomic_int_get(&async->spilling)
+                || g_atomic_int_get(&async->count) == (gint)async->slots)
+            {
+                ok = fbExporterAsyncSpill(async, msgbase, msglen, err);
+                if (ok && (g_atomic_int_get(&async->waiting)
+                           & FB_ASYNC_WAIT_DATA))
+                {
+                    pthread_cond_broadcast(&async->cond);
+                }
+                pthread_mutex_unlock(&async->mutex);
+                return ok;
+            }
+            pthread_mutex_unlock(&async->mutex);
+        }
+    } else if (g_atomic_int_get(&async->count) == (gint)async->slots) {
+        /* templates are never dropped; losing them would make the
+         * collector unable to read the data that follows */
+        if (FB_ASYNC_DROP_NEWEST == async->policy
+            && !fbExporterMessageHasTemplates(msgbase, msglen))
+        {
+            fbExporterAsyncCount(async, &async->stats.dropped);
+            return TRUE;
+        }
+        pthread_mutex_lock(&async->mutex);
+        ++async->stats.blocked;
+        g_atomic_int_or((guint *)&async->waiting, FB_ASYNC_WAIT_SPACE);
+        while (g_atomic_int_get(&async->count) == (gint)async->slots) {
+            pthread_cond_wait(&async->cond, &async->mutex);
+        }
+        g_atomic_int_and((guint *)&async->waiting, ~FB_ASYNC_WAIT_SPACE);
+        pthread_mutex_unlock(&async->mutex);
+    }
+
+    async->bufs[async->tail] = fbMessageBufferRef(msgbuf);
+    async->lens[async->tail] = msglen;
+    async->tail = (async->tail + 1) % async->slots;
+    fbExporterAsyncCount(async, &async->stats.queued);
+    g_atomic_int_inc(&async->count);
+    if (g_atomic_int_get(&async->waiting) & FB_ASYNC_WAIT_DATA) {
+        fbExporterAsyncWake(async);
+    }
+    return TRUE;
+}
+
+/**
+ * fbExporterAsyncPushRotate
+ *
+ * Queues a move to the file `name` behind the messages already handed to
+ * the export thread, which takes ownership of `name`.  The marker is never
+ * dropped or spilled; it waits for the spill file to be written and for a
+ * free slot instead.
+ *
+ */
+static gboolean
+fbExporterAsyncPushRotate(
+    fbExporter_t  *exporter,
+    char          *name,
+    GError       **err)
+{
+    fbExporterAsync_t *async = exporter->async;
+
+    if (!fbExporterAsyncCheckError(async, err)) {
+        g_free(name);
+        return FALSE;
+    }
+
+    if (g_atomic_int_get(&async->spilling)
+        || g_atomic_int_get(&async->count) == (gint)async->slots)
+    {
+        pthread_mutex_lock(&async->mutex);
+        ++async->stats.blocked;
+        g_atomic_int_or((guint *)&async->waiting, FB_ASYNC_WAIT_SPACE);
+        while (g_atomic_int_get(&async->spilling)
+               || g_atomic_int_get(&async->count) == (gint)async->slots)
+        {
+            pthread_cond_wait(&async->cond, &async->mutex);
+        }
+        g_atomic_int_and((guint *)&async->waiting, ~FB_ASYNC_WAIT_SPACE);
+        pthread_mutex_unlock(&async->mutex);
+    }
+
+    async->bufs[async->tail] = NULL;
+    async->lens[async->tail] = 0;
+    async->paths[async->tail] = name;
+    async->tail = (async->tail + 1) % async->slots;
+    g_atomic_int_inc(&async->count);
+    if (g_atomic_int_get(&async->waiting) & FB_ASYNC_WAIT_DATA) {
+        fbExporterAsyncWake(async);
+    }
+    return TRUE;
+}
+
+/**
+ * fbExporterStopAsync
+ *
+ * Writes every queued message, then stops the export thread and frees
+ * its state.
+ *
+ */
+static void
+fbExporterStopAsync(
+    fbExporter_t  *exporter)
+{
+    fbExporterAsync_t *async = exporter->async;
+
+    if (NULL == async) {
+        return;
+    }
+    fbExporterAsyncDrain(exporter);
+    if (async->error) {
+        g_debug("Discarding async export error on stop: %s",
+                async->error->message);
+    }
+    g_atomic_int_set(&async->stop, 1);
+    fbExporterAsyncWake(async);
+    pthread_join(async->thread, NULL);
+
+    exporter->async = NULL;
+    if (async->spill_fd != -1) {
+        close(async->spill_fd);
+        unlink(async->spill_path);
+    }
+    g_free(async->spill_path);
+    g_clear_error(&async->error);
+    pthread_cond_destroy(&async->cond);
+    pthread_mutex_destroy(&async->mutex);
+    g_free(async->bufs);
+    g_free(async->lens);
+    g_free(async->paths);
+    g_slice_free(fbExporterAsync_t, async);
+}
+
+/**
+ * fbExporterRotateName
+ *
+ * Expands the rotation pattern for file number `serial` at time `now`.
+ * Returns NULL if the name is empty or too long.
+ *
+ */
+static char *
+fbExporterRotateName(
+    const char  *pattern,
+    uint32_t     serial,
+    time_t       now)
+{
+    GString   *fmt = g_string_new(NULL);
+    char       name[PATH_MAX];
+    struct tm  tm;
+    const char *cp;
+    size_t     len;
+
+    /* replace %N here; leave every other conversion to strftime() */
+    for (cp = pattern; *cp; ++cp) {
+        if ('%' == cp[0] && 'N' == cp[1]) {
+            g_string_append_printf(fmt, "%u", serial);
+            ++cp;
+        } else if ('%' == cp[0] && '\0' != cp[1]) {
+            g_string_append_c(fmt, *cp++);
+            g_string_append_c(fmt, *cp);
+        } else {
+            g_string_append_c(fmt, *cp);
+        }
+    }
+    gmtime_r(&now, &tm);
+    len = strftime(name, sizeof(name), fmt->str, &tm);
+    g_string_free(fmt, TRUE);
+
+    return (len ? g_strdup(name) : NULL);
+}
+
+static void
+fbExporterRotateFree(
+    fbExporterRotate_t  *rotate)
+{
+    if (rotate) {
+        fbExporterRotateJoin(rotate);
+        g_free(rotate->pattern);
+        g_slice_free(fbExporterRotate_t, rotate);
+    }
+}
+
+/* Seconds a fan-out child waits after its first failure before it is
+ * tried again; the wait doubles with each further failure */
+#define FB_FANOUT_RETRY_MIN     1
+#define FB_FANOUT_RETRY_MAX     64
+
+/* Scope elements that mark an options template of metadata records:
+ * templateId, and informationElementId of RFC 5610 */
+#define FB_FANOUT_IE_TID        145
+#define FB_FANOUT_IE_ID         303
+
+/**
+ * A child of a fan-out exporter.
+ */
+typedef struct fbExporterChild_st {
+    fbExporter_t  *exporter;
+    /** Seconds to wait after the next failure */
+    time_t         backoff;
+    /** Time before which messages are not sent to the child; 0 if up */
+    time_t         retry_at;
+    /** Messages the child missed while failed */
+    uint64_t       missed;
+} fbExporterChild_t;
+
+/**
+ * A template record seen in a message written to a fan-out exporter.
+ */
+typedef struct fbExporterFanoutTmpl_st {
+    /** FB_TID_TS or FB_TID_OTS */
+    uint16_t       set_id;
+    /** Length of rec */
+    uint16_t       len;
+    /** The record as it appeared in its set */
+    uint8_t       *rec;
+    /** For an options template of RFC 5610 information element type
+     * records or of template metadata records, maps the scope of each data
+     * record written with the template to the record, both GBytes; NULL
+     * for other templates */
+    GHashTable    *meta;
+} fbExporterFanoutTmpl_t;
+
+/**
+ * The templates of one observation domain written to a fan-out exporter.
+ */
+typedef struct fbExporterFanoutDomain_st {
+    /** Maps template ID to its fbExporterFanoutTmpl_t */
+    GHashTable    *tmpls;
+    /** Sequence number of the domain's latest message */
+    uint32_t       sequence;
+} fbExporterFanoutDomain_t;
+
+/**
+ * A message of templates and metadata records being built for a child of
+ * a fan-out exporter.
+ */
+typedef struct fbExporterFanoutMsg_st {
+    /** The child to write to */
+    fbExporter_t  *child;
+    /** The message; as long as the fan-out exporter's MTU */
+    uint8_t       *buf;
+    /** End of the message */
+    uint8_t       *cp;
+    /** Start of the open set; NULL if none */
+    uint8_t       *setbase;
+    /** Observation domain and sequence number of the message */
+    uint32_t       domain;
+    uint32_t       sequence;
+} fbExporterFanoutMsg_t;
+
+/**
+ * Fan-out state: every message written to the exporter is written to
+ * each child.  A child that fails is closed and skipped until its retry
+ * time, when the next message reopens it.  The template records and the
+ * RFC 5610 and template metadata records of the messages written are kept
+ * in 'domains', so a child that recovers is given what it lost before the
+ * message that reopens it.
+ */
+struct fbExporterFanout_st {
+    fbExporterChild_t  *children;
+    unsigned int        count;
+    /** Maps observation domain to its fbExporterFanoutDomain_t */
+    GHashTable         *domains;
+};
+
+static void
+fbExporterFanoutTmplFree(
+    fbExporterFanoutTmpl_t  *tmpl)
+{
+    if (tmpl->meta) {
+        g_hash_table_destroy(tmpl->meta);
+    }
+    g_free(tmpl->rec);
+    g_slice_free(fbExporterFanoutTmpl_t, tmpl);
+}
+
+static void
+fbExporterFanoutDomainFree(
+    fbExporterFanoutDomain_t  *dom)
+{
+    g_hash_table_destroy(dom->tmpls);
+    g_slice_free(fbExporterFanoutDomain_t, dom);
+}
+
+/**
+ * fbExporterFanoutIsMeta
+ *
+ * Returns TRUE if the options template record `rec` describes RFC 5610
+ * information element type records or template metadata records; that
+ * is, if a scope field is informationElementId or templateId.
+ *
+ */
+static gboolean
+fbExporterFanoutIsMeta(
+    const uint8_t  *rec)
+{
+    const uint8_t *fp = rec + 6;
+    uint16_t       count;
+    uint16_t       scope;
+    uint16_t       ie_num;
+    uint16_t       i;
+
+    memcpy(&count, rec + 2, sizeof(count));
+    memcpy(&scope, rec + 4, sizeof(scope));
+    count = g_ntohs(count);
+    scope = g_ntohs(scope);
+    for (i = 0; i < scope && i < count; ++i) {
+        memcpy(&ie_num, fp, sizeof(ie_num));
+        ie_num = g_ntohs(ie_num);
+        if (ie_num & IPFIX_ENTERPRISE_BIT) {
+            fp += 8;
+        } else if (FB_FANOUT_IE_TID == ie_num || FB_FANOUT_IE_ID == ie_num) {
+            return TRUE;
+        } else {
+            fp += 4;
+        }
+    }
+    return FALSE;
+}
+
+/**
+ * fbExporterFanoutLearnRecords
+ *
+ * Records the data records in the `ep - rp` octets at `rp`, the content of
+ * a data set described by the metadata template `tmpl`, replacing any
+ * earlier record with the same scope.  Stops at padding or at a malformed
+ * record.
+ *
+ */
+static void
+fbExporterFanoutLearnRecords(
+    fbExporterFanoutTmpl_t  *tmpl,
+    const uint8_t           *rp,
+    const uint8_t           *ep)
+{
+    const uint8_t *fp;
+    const uint8_t *start;
+    const uint8_t *scope_end;
+    uint16_t       count;
+    uint16_t       scope;
+    uint16_t       ie_num;
+    uint16_t       ie_len;
+    uint16_t       i;
+
+    memcpy(&count, tmpl->rec + 2, sizeof(count));
+    memcpy(&scope, tmpl->rec + 4, sizeof(scope));
+    count = g_ntohs(count);
+    scope = g_ntohs(scope);
+
+    while (rp < ep) {
+        start = rp;
+        scope_end = rp;
+        fp = tmpl->rec + 6;
+        for (i = 0; i < count; ++i) {
+            memcpy(&ie_num, fp, sizeof(ie_num));
+            memcpy(&ie_len, fp + 2, sizeof(ie_len));
+            fp += (g_ntohs(ie_num) & IPFIX_ENTERPRISE_BIT) ? 8 : 4;
+            ie_len = g_ntohs(ie_len);
+            if (FB_IE_VARLEN == ie_len) {
+                if (rp >= ep) {
+                    return;
+                }
+                ie_len = *rp++;
+                if (255 == ie_len) {
+                    if (ep - rp < 2) {
+                        return;
+                    }
+                    memcpy(&ie_len, rp, sizeof(ie_len));
+                    ie_len = g_ntohs(ie_len);
+                    rp += 2;
+                }
+            }
+            if ((size_t)(ep - rp) < ie_len) {
+                return;
+            }
+            rp += ie_len;
+            if (i + 1 == scope) {
+                scope_end = rp;
+            }
+        }
+        if (rp == start) {
+            return;
+        }
+        g_hash_table_replace(tmpl->meta,
+                             g_bytes_new(start, scope_end - start),
+                             g_bytes_new(start, rp - start));
+    }
+}
+
+/**
+ * fbExporterFanoutLearn
+ *
+ * Records the templates defined and withdrawn by a message written to the
+ * fan-out exporter, and the data records it holds for metadata templates.
+ * Stops at the first malformed set.
+ *
+ */
+static void
+fbExporterFanoutLearn(
+    fbExporterFanout_t  *fanout,
+    const uint8_t       *msgbase,
+    size_t               msglen)
+{
+    GHashTableIter            iter;
+    gpointer                  vtmpl;
+    fbExporterFanoutDomain_t *dom;
+    fbExporterFanoutTmpl_t   *tmpl;
+    const uint8_t            *rp;
+    const uint8_t            *ep;
+    uint32_t                  domain;
+    uint32_t                  sequence;
+    uint16_t                  set_id;
+    uint16_t                  set_len;
+    uint16_t                  tid;
+    uint16_t                  count;
+    uint16_t                  ie_num;
+    uint16_t                  i;
+    size_t                    off;
+    size_t                    len;
+
+    if (msglen < 16) {
+        return;
+    }
+    memcpy(&sequence, msgbase + 8, sizeof(sequence));
+    memcpy(&domain, msgbase + 12, sizeof(domain));
+    domain = g_ntohl(domain);
+
+    dom = g_hash_table_lookup(fanout->domains, GUINT_TO_POINTER(domain));
+    if (NULL == dom) {
+        dom = g_slice_new0(fbExporterFanoutDomain_t);
+        dom->tmpls = g_hash_table_new_full(
+            g_direct_hash, g_direct_equal, NULL,
+            (GDestroyNotify)fbExporterFanoutTmplFree);
+        g_hash_table_insert(fanout->domains, GUINT_TO_POINTER(domain), dom);
+    }
+    dom->sequence = g_ntohl(sequence);
+
+    for (off = 16; off + 4 <= msglen; off += set_len) {
+        memcpy(&set_id, msgbase + off, sizeof(set_id));
+        memcpy(&set_len, msgbase + off + 2, sizeof(set_len));
+        set_id = g_ntohs(set_id);
+        set_len = g_ntohs(set_len);
+        if (set_len < 4 || set_len > msglen - off) {
+            return;
+        }
+        if (set_id >= FB_TID_MIN_DATA) {
+            tmpl = g_hash_table_lookup(dom->tmpls, GUINT_TO_POINTER(set_id));
+            if (tmpl && tmpl->meta) {
+                fbExporterFanoutLearnRecords(tmpl, msgbase + off + 4,
+                                             msgbase + off + set_len);
+            }
+            continue;
+        }
+        if (FB_TID_TS != set_id && FB_TID_OTS != set_id) {
+            continue;
+        }
+
+        rp = msgbase + off + 4;
+        ep = msgbase + off + set_len;
+        while (ep - rp >= 4) {
+            memcpy(&tid, rp, sizeof(tid));
+            memcpy(&count, rp + 2, sizeof(count));
+            tid = g_ntohs(tid);
+            count = g_ntohs(count);
+
+            if (0 == count) {
+                /* a withdrawal; the set ID withdraws every template of
+                 * the set's kind */
+                if (tid == set_id) {
+                    g_hash_table_iter_init(&iter, dom->tmpls);
+                    while (g_hash_table_iter_next(&iter, NULL, &vtmpl)) {
+                        tmpl = (fbExporterFanoutTmpl_t *)vtmpl;
+                        if (tmpl->set_id == set_id) {
+                            g_hash_table_iter_remove(&iter);
+                        }
+                    }
+                } else {
+                    g_hash_table_remove(dom->tmpls, GUINT_TO_POINTER(tid));
+                }
+                rp += 4;
+                continue;
+            }
+
+            /* find the end of the record */
+            len = (FB_TID_OTS == set_id) ? 6 : 4;
+            for (i = 0; i < count; ++i) {
+                if (rp + len + 4 > ep) {
+                    return;
+                }
+                memcpy(&ie_num, rp + len, sizeof(ie_num));
+                len += (g_ntohs(ie_num) & IPFIX_ENTERPRISE_BIT) ? 8 : 4;
+            }
+            if (rp + len > ep) {
+                return;
+            }
+
+            /* a template written again unchanged, as by a refresh, keeps
+             * the metadata records seen with it */
+            tmpl = g_hash_table_lookup(dom->tmpls, GUINT_TO_POINTER(tid));
+            if (tmpl && tmpl->set_id == set_id && tmpl->len == len
+                && 0 == memcmp(tmpl->rec, rp, len))
+            {
+                rp += len;
+                continue;
+            }
+
+            tmpl = g_slice_new0(fbExporterFanoutTmpl_t);
+            tmpl->set_id = set_id;
+            tmpl->len = len;
+            tmpl->rec = g_malloc(len);
+            memcpy(tmpl->rec, rp, len);
+            if (FB_TID_OTS == set_id && fbExporterFanoutIsMeta(tmpl->rec)) {
+                tmpl->meta = g_hash_table_new_full(
+                    g_bytes_hash, g_bytes_equal,
+                    (GDestroyNotify)g_bytes_unref,
+                    (GDestroyNotify)g_bytes_unref);
+            }
+            g_hash_table_replace(dom->tmpls, GUINT_TO_POINTER(tid), tmpl);
+            rp += len;
+        }
+    }
+}
+
+/**
+ * fbExporterFanoutResyncWrite
+ *
+ * Ends the open set of the message being built in `msg`, fills in its
+ * header, and writes it to the child.  Does nothing if the message is
+ * empty.
+ *
+ */
+static gboolean
+fbExporterFanoutResyncWrite(
+    fbExporterFanoutMsg_t  *msg,
+    GError                **err)
+{
+    size_t   msglen = msg->cp - msg->buf;
+    uint16_t u16;
+    uint32_t u32;
+
+    if (msg->setbase) {
+        u16 = g_htons(msg->cp - msg->setbase);
+        memcpy(msg->setbase + 2, &u16, sizeof(u16));
+        msg->setbase = NULL;
+    }
+    msg->cp = msg->buf + 16;
+    if (msglen <= 16) {
+        return TRUE;
+    }
+
+    u16 = g_htons(0x000A);
+    memcpy(msg->buf, &u16, sizeof(u16));
+    u16 = g_htons(msglen);
+    memcpy(msg->buf + 2, &u16, sizeof(u16));
+    u32 = g_htonl(time(NULL));
+    memcpy(msg->buf + 4, &u32, sizeof(u32));
+    u32 = g_htonl(msg->sequence);
+    memcpy(msg->buf + 8, &u32, sizeof(u32));
+    u32 = g_htonl(msg->domain);
+    memcpy(msg->buf + 12, &u32, sizeof(u32));
+
+    return fbExportMessage(msg->child, msg->buf, msglen, err);
+}
+
+/**
+ * fbExporterFanoutResyncAdd
+ *
+ * Appends the `len` octets at `rec` to a set with ID `set_id` in the
+ * message being built in `msg`, starting a new set if the open one has
+ * another ID and writing the message first if the record does not fit in
+ * `mtu`.
+ *
+ */
+static gboolean
+fbExporterFanoutResyncAdd(
+    fbExporterFanoutMsg_t  *msg,
+    size_t                  mtu,
+    uint16_t                set_id,
+    const uint8_t          *rec,
+    size_t                  len,
+    GError                **err)
+{
+    uint16_t u16;
+
+    if (msg->setbase) {
+        memcpy(&u16, msg->setbase, sizeof(u16));
+        if (g_ntohs(u16) != set_id) {
+            u16 = g_htons(msg->cp - msg->setbase);
+            memcpy(msg->setbase + 2, &u16, sizeof(u16));
+            msg->setbase = NULL;
+        }
+    }
+    if ((size_t)(msg->cp - msg->buf) + (msg->setbase ? 0 : 4) + len > mtu) {
+        if (!fbExporterFanoutResyncWrite(msg, err)) {
+            return FALSE;
+        }
+    }
+    if (NULL == msg->setbase) {
+        msg->setbase = msg->cp;
+        u16 = g_htons(set_id);
+        memcpy(msg->cp, &u16, sizeof(u16));
+        msg->cp += 4;
+    }
+    memcpy(msg->cp, rec, len);
+    msg->cp += len;
+    return TRUE;
+}
+
+/**
+ * fbExporterFanoutResync
+ *
+ * Writes the templates the fan-out exporter has seen to the child `child`
+ * only, followed by the metadata records seen with them, in messages no
+ * longer than the exporter's MTU with the header of each domain.  Opens
+ * the child if needed.  Every record fits a message, since it came in one
+ * written to the exporter.
+ *
+ */
+static gboolean
+fbExporterFanoutResync(
+    fbExporter_t  *exporter,
+    fbExporter_t  *child,
+    GError       **err)
+{
+    GHashTableIter            diter;
+    GHashTableIter            titer;
+    GHashTableIter            riter;
+    gpointer                  vdomain;
+    gpointer                  vdom;
+    gpointer                  vtid;
+    gpointer                  vtmpl;
+    gpointer                  vrec;
+    fbExporterFanoutDomain_t *dom;
+    fbExporterFanoutTmpl_t   *tmpl;
+    fbExporterFanoutMsg_t     msg;
+    const uint8_t            *rec;
+    gsize                     len;
+    uint16_t                  set_id;
+    int                       pass;
+    gboolean                  ok = TRUE;
+
+    msg.child = child;
+    msg.buf = g_new(uint8_t, exporter->mtu);
+    msg.setbase = NULL;
+
+    g_hash_table_iter_init(&diter, exporter->fanout->domains);
+    while (ok && g_hash_table_iter_next(&diter, &vdomain, &vdom)) {
+        dom = (fbExporterFanoutDomain_t *)vdom;
+        msg.domain = GPOINTER_TO_UINT(vdomain);
+        msg.sequence = dom->sequence;
+        msg.cp = msg.buf + 16;
+        /* templates, then options templates, then metadata records */
+        for (pass = 0; ok && pass < 3; ++pass) {
+            set_id = (0 == pass) ? FB_TID_TS : FB_TID_OTS;
+            g_hash_table_iter_init(&titer, dom->tmpls);
+            while (ok && g_hash_table_iter_next(&titer, &vtid, &vtmpl)) {
+                tmpl = (fbExporterFanoutTmpl_t *)vtmpl;
+                if (pass < 2) {
+                    if (tmpl->set_id == set_id) {
+                        ok = fbExporterFanoutResyncAdd(
+                            &msg, exporter->mtu, set_id,
+                            tmpl->rec, tmpl->len, err);
+                    }
+                    continue;
+                }
+                if (NULL == tmpl->meta) {
+                    continue;
+                }
+                g_hash_table_iter_init(&riter, tmpl->meta);
+                while (ok && g_hash_table_iter_next(&riter, NULL, &vrec)) {
+                    rec = g_bytes_get_data((GBytes *)vrec, &len);
+                    ok = fbExporterFanoutResyncAdd(
+                        &msg, exporter->mtu, GPOINTER_TO_UINT(vtid),
+                        rec, len, err);
+                }
+            }
+        }
+        if (ok) {
+            ok = fbExporterFanoutResyncWrite(&msg, err);
+        }
+    }
+
+    g_free(msg.buf);
+    return ok;
+}
+
+/**
+ * fbExporterOpenFanout
+ *
+ * Opens the fan-out exporter.  Each child opens on its first message.
+ *
+ */
+static gboolean
+fbExporterOpenFanout(
+    fbExporter_t  *exporter,
+    GError       **err)
+{
+    if (0 == exporter->fanout->count) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_SETUP,
+                    "Fan-out exporter has no children");
+        return FALSE;
+    }
+    exporter->active = TRUE;
+    return TRUE;
+}
+
+/**
+ * fbExporterWriteFanout
+ *
+ * Writes the message to every child that is not waiting to retry, first
+ * giving the templates to a child whose wait is over.  Fails only if no
+ * child took the message.
+ *
+ */
+static gboolean
+fbExporterWriteFanout(
+    fbExporter_t  *exporter,
+    uint8_t       *msgbase,
+    size_t         msglen,
+    GError       **err)
+{
+    fbExporterFanout_t *fanout = exporter->fanout;
+    fbExporterChild_t  *child;
+    GError             *child_err = NULL;
+    time_t              now = 0;
+    unsigned int        written = 0;
+    unsigned int        i;
+
+    fbExporterFanoutLearn(fanout, msgbase, msglen);
+
+    for (i = 0; i < fanout->count; ++i) {
+        child = &fanout->children[i];
+        if (child->retry_at) {
+            if (0 == now) {
+                now = time(NULL);
+            }
+            if (now < child->retry_at) {
+                ++child->missed;
+                continue;
+            }
+        }
+
+        /* a reopened child must have the templates before any data */
+        if ((0 == child->retry_at
+             || fbExporterFanoutResync(exporter, child->exporter,
+                                       &child_err))
+            && fbExportMessage(child->exporter, msgbase, msglen, &child_err))
+        {
+            if (child->retry_at) {
+                g_message("Fan-out child %u recovered after missing %"
+                          G_GUINT64_FORMAT " messages", i, child->missed);
+                child->retry_at = 0;
+                child->backoff = 0;
+                child->missed = 0;
+            }
+            ++written;
+            continue;
+        }
+
+        /* the child closed itself; skip it for a while */
+        if (0 == now) {
+            now = time(NULL);
+        }
+        if (0 == child->retry_at) {
+            g_warning("Fan-out child %u failed: %s", i, child_err->message);
+        }
+        child->backoff = (child->backoff
+                          ? MIN(child->backoff * 2, FB_FANOUT_RETRY_MAX)
+                          : FB_FANOUT_RETRY_MIN);
+        child->retry_at = now + child->backoff;
+        ++child->missed;
+        if (written || i + 1 < fanout->count) {
+            g_clear_error(&child_err);
+        }
+    }
+
+    if (0 == written && child_err) {
+        g_propagate_error(err, child_err);
+        return FALSE;
+    }
+    g_clear_error(&child_err);
+    return TRUE;
+}
+
+/**
+ * fbExporterCloseFanout
+ *
+ * Closes every child.
+ *
+ */
+static void
+fbExporterCloseFanout(
+    fbExporter_t  *exporter)
+{
+    unsigned int i;
+
+    for (i = 0; i < exporter->fanout->count; ++i) {
+        fbExporterClose(exporter->fanout->children[i].exporter);
+    }
+    exporter->active = FALSE;
+}
+
+static void
+fbExporterFanoutFree(
+    fbExporterFanout_t  *fanout)
+{
+    unsigned int i;
+
+    if (fanout) {
+        for (i = 0; i < fanout->count; ++i) {
+            fbExporterFree(fanout->children[i].exporter);
+        }
+        g_free(fanout->children);
+        g_hash_table_destroy(fanout->domains);
+        g_slice_free(fbExporterFanout_t, fanout);
+    }
+}
+
+#if HAVE_LIBURING
+
+/* Number of messages an io_uring exporter may have queued or in flight */
+#define FB_URING_SLOTS        64
+
+/* Queued messages and octets that cause an io_uring exporter to submit */
+#define FB_URING_BATCH_MSGS   16
+#define FB_URING_BATCH_BYTES  65536
+
+/**
+ * io_uring send state.  Messages are copied into a ring of MTU-sized
+ * slots.  The slots from 'head' hold 'count' messages, the first
+ * 'submitted' of which have been handed to the kernel; the rest are queued
+ * until a batch threshold is reached or the exporter is flushed.  Each
+ * submission is one chain of linked sends that the kernel starts only once
+ * every earlier send has completed, which keeps the messages in order on
+ * the socket.
+ */
+struct fbExporterUring_st {
+    struct io_uring   ring;
+    /** Message storage, 'slotlen' octets per slot */
+    uint8_t          *bufs;
+    /** Size of each slot; the exporter's MTU */
+    size_t            slotlen;
+    /** Length of the message in each slot */
+    size_t            lens[FB_URING_SLOTS];
+    /** First occupied slot */
+    unsigned int      head;
+    /** Number of occupied slots */
+    unsigned int      count;
+    /** Number of occupied slots submitted to the kernel */
+    unsigned int      submitted;
+    /** Octets in the occupied slots not yet submitted */
+    size_t            queued_bytes;
+    /** errno of the first failed send; 0 if none */
+    int               error;
+};
+
+static void
+fbExporterUringFree(
+    fbExporterUring_t  *uring)
+{
+    if (uring) {
+        io_uring_queue_exit(&uring->ring);
+        g_free(uring->bufs);
+        g_slice_free(fbExporterUring_t, uring);
+    }
+}
+
+/**
+ * fbExporterUringSubmit
+ *
+ * Submits every queued message as one chain of linked sends.  If an
+ * earlier chain is still in flight, the new chain is marked to drain it
+ * first.
+ *
+ */
+static void
+fbExporterUringSubmit(
+    fbExporter_t  *exporter)
+{
+    fbExporterUring_t   *uring = exporter->uring;
+    struct io_uring_sqe *sqe;
+    unsigned int         slot;
+    unsigned int         i;
+    int                  flags;
+
+    if (uring->submitted == uring->count) {
+        return;
+    }
+    /* MSG_WAITALL makes the kernel finish a partial stream send */
+    flags = MSG_NOSIGNAL;
+    if (exporter->spec.conn->transport == FB_TCP) {
+        flags |= MSG_WAITALL;
+    }
+    for (i = uring->submitted; i < uring->count; ++i) {
+        slot = (uring->head + i) % FB_URING_SLOTS;
+        sqe = io_uring_get_sqe(&uring->ring);
+        io_uring_prep_send(sqe, exporter->stream.fd,
+                           uring->bufs + (size_t)slot * uring->slotlen,
+                           uring->lens[slot], flags);
+        io_uring_sqe_set_data64(sqe, slot);
+        if (i == uring->submitted && uring->submitted) {
+            sqe->flags |= IOSQE_IO_DRAIN;
+        }
+        if (i + 1 < uring->count) {
+            sqe->flags |= IOSQE_IO_LINK;
+        }
+    }
+    uring->submitted = uring->count;
+    uring->queued_bytes = 0;
+    io_uring_submit(&uring->ring);
+}
+
+/**
+ * fbExporterUringReap
+ *
+ * Collects completed sends, freeing their slots and recording the first
+ * error.  When `wait` is TRUE, waits for at least one completion if any
+ * send is in flight.
+ *
+ */
+static void
+fbExporterUringReap(
+    fbExporter_t  *exporter,
+    gboolean       wait)
+{
+    fbExporterUring_t   *uring = exporter->uring;
+    struct io_uring_cqe *cqe;
+    unsigned int         slot;
+    int                  ret;
+
+    while (uring->submitted) {
+        if (wait) {
+            ret = io_uring_wait_cqe(&uring->ring, &cqe);
+            if (-EINTR == ret) {
+                continue;
+            }
+        } else {
+            ret = io_uring_peek_cqe(&uring->ring, &cqe);
+        }
+        if (ret < 0) {
+            return;
+        }
+        slot = (unsigned int)io_uring_cqe_get_data64(cqe);
+        if (cqe->res < 0) {
+            if (!uring->error) {
+                uring->error = -cqe->res;
+            }
+        } else if ((size_t)cqe->res != uring->lens[slot] && !uring->error) {
+            uring->error = EIO;
+        }
+        io_uring_cqe_seen(&uring->ring, cqe);
+        /* chains run one after another, so sends complete in order */
+        uring->head = (uring->head + 1) % FB_URING_SLOTS;
+        --uring->count;
+        --uring->submitted;
+        wait = FALSE;
+    }
+}
+
+/**
+ * fbExporterUringCheckError
+ *
+ * Sets `err` and returns FALSE if a send has failed.
+ *
+ */
+static gboolean
+fbExporterUringCheckError(
+    fbExporter_t  *exporter,
+    GError       **err)
+{
+    int error = exporter->uring->error;
+
+    if (!error) {
+        return TRUE;
+    }
+    exporter->uring->error = 0;
+    if (EPIPE == error) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_NLWRITE,
+                    "Connection reset (EPIPE) on io_uring send");
+    } else {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                    "I/O error on io_uring send: %s", strerror(error));
+    }
+    return FALSE;
+}
+
+/**
+ * fbExporterUringFlush
+ *
+ * Submits any queued messages and waits until every message has been
+ * sent.
+ *
+ */
+static gboolean
+fbExporterUringFlush(
+    fbExporter_t  *exporter,
+    GError       **err)
+{
+    fbExporterUringSubmit(exporter);
+    while (exporter->uring->count) {
+        fbExporterUringReap(exporter, TRUE);
+    }
+    return fbExporterUringCheckError(exporter, err);
+}
+
+/**
+ * fbExporterWriteUring
+ *
+ * Copies the message into a free slot and queues it.  Submits the queue
+ * without waiting for the sends once it reaches a batch threshold or
+ * fills the slots; waits only when every slot is occupied.
+ *
+ */
+static gboolean
+fbExporterWriteUring(
+    fbExporter_t  *exporter,
+    uint8_t       *msgbase,
+    size_t         msglen,
+    GError       **err)
+{
+    fbExporterUring_t *uring = exporter->uring;
+    unsigned int       slot;
+
+    g_assert(msglen <= uring->slotlen);
+
+    fbExporterUringReap(exporter, FALSE);
+    if (uring->count == FB_URING_SLOTS) {
+        fbExporterUringSubmit(exporter);
+        fbExporterUringReap(exporter, TRUE);
+    }
+    if (!fbExporterUringCheckError(exporter, err)) {
+        return FALSE;
+    }
+
+    slot = (uring->head + uring->count) % FB_URING_SLOTS;
+    memcpy(uring->bufs + (size_t)slot * uring->slotlen, msgbase, msglen);
+    uring->lens[slot] = msglen;
+    ++uring->count;
+    uring->queued_bytes += msglen;
+
+    if (uring->count - uring->submitted >= FB_URING_BATCH_MSGS
+        || uring->queued_bytes >= FB_URING_BATCH_BYTES
+        || uring->count == FB_URING_SLOTS)
+    {
+        fbExporterUringSubmit(exporter);
+    }
+    return TRUE;
+}
+
+/**
+ * fbExporterCloseUring
+ *
+ * Sends any queued messages and closes the socket.  The ring is kept for
+ * when the exporter is reopened.
+ *
+ */
+static void
+fbExporterCloseUring(
+    fbExporter_t  *exporter)
+{
+    GError *err = NULL;
+
+    if (!fbExporterUringFlush(exporter, &err)) {
+        g_debug("Discarding io_uring send error on close: %s", err->message);
+        g_clear_error(&err);
+    }
+    /* a failed chain leaves the rest of its slots canceled; forget them */
+    exporter->uring->head = 0;
+    exporter->uring->count = 0;
+    exporter->uring->submitted = 0;
+    exporter->uring->queued_bytes = 0;
+    fbExporterCloseSocket(exporter);
+}
+
+#endif  /* HAVE_LIBURING */
+
+#if HAVE_OPENSSL
+
+/**
+ * fbExporterOpenTLS
+ *
+ *
+ * @param exporter
+ * @param err
+ *
+ * @return
+ */
+static gboolean
+fbExporterOpenTLS(
+    fbExporter_t  *exporter,
+    GError       **err)
+{
+    BIO     *conn = NULL;
+    char     errbuf[FB_SSL_ERR_BUFSIZ];
+    gboolean ok = TRUE;
+
+    /* Initialize SSL context if necessary */
+    if (!exporter->spec.conn->vssl_ctx) {
+        if (!fbConnSpecInitTLS(exporter->spec.conn, FALSE, err)) {
+            return FALSE;
+        }
+    }
+
+    /* open underlying socket */
+    if (!fbExporterOpenSocket(exporter, err)) {return FALSE;}
+
+    /* wrap a stream BIO around the opened socket */
+    if (!(conn = BIO_new_socket(exporter->stream.fd, 1))) {
+        ok = FALSE;
+        ERR_error_string_n(ERR_get_error(), errbuf, sizeof(errbuf));
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
+                    "couldn't wrap socket to %s:%s for TLS: %s",
+                    exporter->spec.conn->host, exporter->spec.conn->svc,
+                    errbuf);
+        ERR_clear_error();
+        goto end;
+    }
+
+    /* create SSL socket */
+    if (!(exporter->ssl = SSL_new((SSL_CTX *)exporter->spec.conn->vssl_ctx))) {
+        ok = FALSE;
+        ERR_error_string_n(ERR_get_error(), errbuf, sizeof(errbuf));
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
+                    "couldnt create TLS socket: %s", errbuf);
+        ERR_clear_error();
+        goto end;
+    }
+
+    /* connect to it */
+    SSL_set_bio(exporter->ssl, conn, conn);
+    if (SSL_connect(exporter->ssl) <= 0) {
+        ok = FALSE;
+        ERR_error_string_n(ERR_get_error(), errbuf, sizeof(errbuf));
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
+                    "couldn't connect TLS socket to %s:%s: %s",
+                    exporter->spec.conn->host, exporter->spec.conn->svc,
+                    errbuf);
+        ERR_clear_error();
+        goto end;
+    }
+
+    /* FIXME do post-connection verification */
+
+  end:
+    if (!ok) {
+        exporter->active = FALSE;
+        if (exporter->ssl) {
+            SSL_free(exporter->ssl);
+            exporter->ssl = NULL;
+        } else if (conn) {
+            BIO_vfree(conn);
+        }
+    }
+    return ok;
+}
+
+#if HAVE_OPENSSL_DTLS
+
+/**
+ * fbExporterOpenDTLS
+ *
+ * @param exporter
+ * @param err
+ *
+ * @return
+ *
+ */
+static gboolean
+fbExporterOpenDTLS(
+    fbExporter_t  *exporter,
+    GError       **err)
+{
+    BIO            *conn = NULL;
+    gboolean        ok = TRUE;
+    struct sockaddr peer;
+    char            errbuf[FB_SSL_ERR_BUFSIZ];
+    size_t          peerlen = sizeof(struct sockaddr);
+
+    /* Initialize SSL context if necessary */
+    if (!exporter->spec.conn->vssl_ctx) {
+        if (!fbConnSpecInitTLS(exporter->spec.conn, FALSE, err)) {
+            return FALSE;
+        }
+    }
+
+    /* open underlying socket */
+    if (!fbExporterOpenSocket(exporter, err)) {return FALSE;}
+
+    /* wrap a datagram BIO around the opened socket */
+    if (!(conn = BIO_new_dgram(exporter->stream.fd, 1))) {
+        ok = FALSE;
+        ERR_error_string_n(ERR_get_error(), errbuf, sizeof(errbuf));
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
+                    "couldn't wrap socket to %s:%s for DTLS: %s",
+                    exporter->spec.conn->host, exporter->spec.conn->svc,
+                    errbuf);
+        ERR_clear_error();
+        goto end;
+    }
+
+    /* Tell dgram bio what its name is */
+    if (getsockname(exporter->stream.fd, &peer, (socklen_t *)&peerlen) < 0) {
+        ok = FALSE;
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
+                    "couldn't wrap socket to %s:%s for DTLS: %s",
+                    exporter->spec.conn->host, exporter->spec.conn->svc,
+                    strerror(errno));
+        goto end;
+    }
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+    BIO_ctrl_set_connected(conn, 1, &peer);
+#else
+    BIO_ctrl_set_connected(conn, &peer);
+#endif
+
+    /* create SSL socket */
+    if (!(exporter->ssl = SSL_new((SSL_CTX *)exporter->spec.conn->vssl_ctx))) {
+        ok = FALSE;
+        ERR_error_string_n(ERR_get_error(), errbuf, sizeof(errbuf));
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
+                    "couldnt create DTLS socket: %s", errbuf);
+        ERR_clear_error();
+        goto end;
+    }
+
+    /* connect to it */
+    SSL_set_bio(exporter->ssl, conn, conn);
+    SSL_set_connect_state(exporter->ssl);
+
+    /* FIXME do post-connection verification */
+
+  end:
+    if (!ok) {
+        exporter->active = FALSE;
+        if (exporter->ssl) {
+            SSL_free(exporter->ssl);
+            exporter->ssl = NULL;
+        } else if (conn) {
+            BIO_vfree(conn);
+        }
+    }
+    return ok;
+}
+
+#endif /* HAVE_OPENSSL_DTLS */
+
+/**
+ * fbExporterWriteTLS
+ *
+ *
+ * @param exporter
+ * @param msgbase
+ * @param msglen
+ * @param err
+ *
+ * @return
+ */
+static gboolean
+fbExporterWriteTLS(
+    fbExporter_t  *exporter,
+    uint8_t       *msgbase,
+    size_t         msglen,
+    GError       **err)
+{
+    char errbuf[FB_SSL_ERR_BUFSIZ];
+    int  rc;
+
+    while (msglen) {
+        rc = SSL_write(exporter->ssl, msgbase, msglen);
+        if (rc <= 0) {
+            ERR_error_string_n(ERR_get_error(), errbuf, sizeof(errbuf));
+            g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                        "I/O error: %s", errbuf);
+            ERR_clear_error();
+            return FALSE;
+        }
+
+        /* we sent some bytes - advance pointers */
+        msglen -= rc;
+        msgbase += rc;
+    }
+
+    return TRUE;
+}
+
+/**
+ * fbExporterCloseTLS
+ *
+ *
+ * @param exporter
+ *
+ */
+static void
+fbExporterCloseTLS(
+    fbExporter_t  *exporter)
+{
+    SSL_shutdown(exporter->ssl);
+    SSL_free(exporter->ssl);
     exporter->active = FALSE;
 }
 
-#endif /* HAVE_OPENSSL */
+#endif /* HAVE_OPENSSL */
+
+/**
+ * fbExporterGetMTU
+ *
+ * @param exporter
+ *
+ * @return
+ */
+uint16_t
+fbExporterGetMTU(
+    fbExporter_t  *exporter)
+{
+    return exporter->mtu;
+}
+
+/**
+ * fbExporterAllocNet
+ *
+ * @param spec
+ *
+ * @return
+ */
+fbExporter_t *
+fbExporterAllocNet(
+    fbConnSpec_t  *spec)
+{
+    fbExporter_t *exporter = NULL;
+
+    /* Host must not be null */
+    g_assert(spec->host);
+
+    /* Create a new exporter */
+    exporter = g_slice_new0(fbExporter_t);
+
+    /* Copy the connection specifier */
+    exporter->spec.conn = fbConnSpecCopy(spec);
+
+    /* Set up functions */
+    switch (spec->transport) {
+#if FB_ENABLE_SCTP
+      case FB_SCTP:
+        exporter->exopen = fbExporterOpenSocket;
+        exporter->exwrite = fbExporterWriteSCTP;
+        exporter->exclose = fbExporterCloseSocket;
+        exporter->sctp_mode = FB_F_SCTP_AUTOSTREAM;
+        exporter->sctp_stream = 0;
+        exporter->mtu = 8192;
+        break;
+#endif /* if FB_ENABLE_SCTP */
+      case FB_TCP:
+        exporter->exopen = fbExporterOpenSocket;
+        exporter->exwrite = fbExporterWriteTCP;
+        exporter->exclose = fbExporterCloseSocket;
+        exporter->mtu = 8192;
+        break;
+      case FB_UDP:
+        exporter->exopen = fbExporterOpenSocket;
+        exporter->exwrite = fbExporterWriteUDP;
+        exporter->exclose = fbExporterCloseSocket;
+        exporter->mtu = 1420;
+        break;
+#if HAVE_OPENSSL
+#if HAVE_OPENSSL_DTLS_SCTP
+      case FB_DTLS_SCTP:
+        exporter->exopen = fbExporterOpenDTLS;
+        exporter->exwrite = fbExporterWriteTLS;
+        exporter->exclose = fbExporterCloseTLS;
+        exporter->sctp_mode = FB_F_SCTP_AUTOSTREAM;
+        exporter->sctp_stream = 0;
+        exporter->mtu = 8192;
+        break;
+#endif /* if HAVE_OPENSSL_DTLS_SCTP */
+      case FB_TLS_TCP:
+        exporter->exopen = fbExporterOpenTLS;
+        exporter->exwrite = fbExporterWriteTLS;
+        exporter->exclose = fbExporterCloseTLS;
+        exporter->mtu = 8192;
+        break;
+#if HAVE_OPENSSL_DTLS
+      case FB_DTLS_UDP:
+        exporter->exopen = fbExporterOpenDTLS;
+        exporter->exwrite = fbExporterWriteTLS;
+        exporter->exclose = fbExporterCloseTLS;
+        exporter->mtu = 1320;
+        break;
+#endif /* if HAVE_OPENSSL_DTLS */
+#endif /* if HAVE_OPENSSL */
+      default:
+#ifndef FB_ENABLE_SCTP
+        if (spec->transport == FB_SCTP || spec->transport == FB_DTLS_SCTP) {
+            g_error("Libfixbuf not enabled for SCTP Transport. "
+                    " Run configure with --with-sctp");
+        }
+#endif /* ifndef FB_ENABLE_SCTP */
+        if (spec->transport == FB_TLS_TCP || spec->transport == FB_DTLS_SCTP ||
+            spec->transport == FB_DTLS_UDP)
+        {
+            g_error("Libfixbuf not enabled for this mode of transport. "
+                    " Run configure with --with-openssl");
+        }
+    }
+
+    /* Return new exporter */
+    return exporter;
+}
+
+#if HAVE_SPREAD
+
+/**
+ * fbExporterSpreadReceiver
+ *
+ */
+static void *
+fbExporterSpreadReceiver(
+    void  *arg)
+{
+    int           i = 0;
+    char          grp[MAX_GROUP_NAME];
+    fbExporter_t *exporter = (fbExporter_t *)arg;
+    fbSpreadSpec_t *spread = exporter->spec.spread;
+    service       service_type = 0;
+    char          sender[MAX_GROUP_NAME];
+    int           num_groups = 0;
+    int16         mess_type = 0;
+    int           endian_mismatch;
+    int           run = 1;
+    int           ret;
+    membership_info memb_info;
+
+#if 0
+    /*  this loop is to allow a debugger to be attached */
+    int foo = 1;
+    do {
+        sleep(1);
+    } while (foo);
+#endif /* if 0 */
+
+    ret = SP_connect(spread->daemon, 0, 0, 1,
+                     &(spread->recv_mbox), spread->recv_privgroup);
+
+    if (ret != ACCEPT_SESSION) {
+        g_set_error(&(spread->recv_err), FB_ERROR_DOMAIN, FB_ERROR_CONN,
+                    "error connecting to Spread daemon %s: %s",
+                    spread->daemon, fbConnSpreadError(ret));
+        return 0;
+    }
+
+    for (i = 0; i < spread->num_groups; i++) {
+        /* exporter listener only joins template/control plane group,
+         * the group name is always the name of the data plane group
+         * plus 'T' added to the end. */
+        memset(grp, 0, sizeof(grp));
+        strncpy(grp, spread->groups[i].name, sizeof(grp) - 2);
+        strcat(grp, "T");
+        ret = SP_join(spread->recv_mbox, grp);
+        if (ret) {
+            g_set_error(&(spread->recv_err), FB_ERROR_DOMAIN, FB_ERROR_CONN,
+                        "error joining to Spread group %s: %s",
+                        spread->groups[i].name, fbConnSpreadError(ret));
+            return 0;
+        }
+    }
+
+    do {
+        ret = SP_receive(spread->recv_mbox, &service_type, sender,
+                         spread->recv_max_groups, &num_groups,
+                         (char (*)[]) spread->recv_groups,
+                         &mess_type, &endian_mismatch, spread->recv_max,
+                         spread->recv_mess);
+
+        if (spread->recv_exit) {
+            SP_disconnect(spread->recv_mbox);
+            continue;
+        }
+
+        if (ret < 0) {
+            if (ret == GROUPS_TOO_SHORT) {
+                g_free(spread->recv_groups);
+                spread->recv_max_groups = -ret;
+                spread->recv_groups = g_new0(sp_groupname_t,
+                                             spread->recv_max_groups);
+            } else if (ret == BUFFER_TOO_SHORT) {
+                g_free(spread->recv_mess);
+                spread->recv_max = -endian_mismatch;
+                spread->recv_mess = g_new0(char, spread->recv_max);
+            } else {
+                g_set_error(&(spread->recv_err), FB_ERROR_DOMAIN, FB_ERROR_IO,
+                            "error receiving Spread message: %s",
+                            fbConnSpreadError(ret));
+
+                SP_disconnect(spread->recv_mbox);
+
+                run = 0;
+            }
+            continue;
+        }
+        /* actually received a message! Now process it */
+        if (!Is_reg_memb_mess(service_type) ||
+            !Is_caused_join_mess(service_type))
+        {
+            continue;
+        }
+
+        if (SP_get_memb_info(spread->recv_mess, service_type, &memb_info) < 0) {
+            continue;
+        }
+        if (!memb_info.changed_member[0]) {
+            continue;
+        }
+        if (strncmp(memb_info.changed_member, spread->recv_privgroup,
+                    MAX_GROUP_NAME) == 0)
+        {
+            continue;
+        }
+
+        /** Send Relevant Templates to New Member only. */
+        /** memb_info.changed_member is private group name */
+        /** sender is group they are subscribing to */
+        fbSessionSetPrivateGroup(spread->session,
+                                 sender, memb_info.changed_member);
+    } while (run);
+
+    return 0;
+}
+
+/**
+ * fbExporterSpreadOpen
+ *
+ * @param exporter
+ * @param err
+ */
+static gboolean
+fbExporterSpreadOpen(
+    fbExporter_t  *exporter,
+    GError       **err)
+{
+    int ret;
+
+    if (!exporter->spec.spread->daemon) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
+                    "Spread daemon name cannot be null");
+        return FALSE;
+    }
+    if (!exporter->spec.spread->daemon[0]) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
+                    "Spread daemon name cannot be empty");
+        return FALSE;
+    }
+
+    if (!(memchr(exporter->spec.spread->daemon, 0, 261))) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
+                    "Spread daemon name too long");
+        return FALSE;
+    }
+    if (!exporter->spec.spread->groups) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
+                    "Spread groups cannot be null");
+        return FALSE;
+    }
+    if (!exporter->spec.spread->groups[0].name[0]) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
+                    "Spread groups cannot be empty");
+        return FALSE;
+    }
+    if (!exporter->spec.spread->session) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
+                    "Spread session cannot be null");
+        return FALSE;
+    }
+
+    pthread_mutex_init(&(exporter->spec.spread->write_lock), 0);
+
+    ret = SP_connect(exporter->spec.spread->daemon, 0, 0, 0,
+                     &(exporter->spec.spread->mbox),
+                     exporter->spec.spread->privgroup);
+    if (ret != ACCEPT_SESSION) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
+                    "error connecting to Spread daemon %s: %s",
+                    exporter->spec.spread->daemon, fbConnSpreadError(ret));
+        return FALSE;
+    }
+
+    exporter->spec.spread->recv_err = 0;
+    exporter->spec.spread->recv_exit = 0;
+    ret = pthread_create(&(exporter->spec.spread->recv_thread), NULL,
+                         fbExporterSpreadReceiver, exporter);
+    if (ret) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
+                    "error creating Spread receiver thread: %s", strerror(ret));
+        SP_disconnect(exporter->spec.spread->mbox);
+        return FALSE;
+    }
+
+    /*pthread_detach(exporter->spec.spread->recv_thread);*/
+
+    exporter->active = TRUE;
+    return TRUE;
+}
+
+/**
+ * fbExporterSpreadWrite
+ *
+ * @param exporter
+ * @param msg
+ * @param msg size
+ * @param err
+ */
+static gboolean
+fbExporterSpreadWrite(
+    fbExporter_t  *exporter,
+    uint8_t       *msgbase,
+    size_t         msglen,
+    GError       **err)
+{
+    int ret = 0;
+    fbSpreadSpec_t *spread;
+
+    pthread_mutex_lock(&(exporter->spec.spread->write_lock));
+
+    spread = exporter->spec.spread;
+
+    if (spread->num_groups_to_send == 1) {
+        ret = SP_multicast(spread->mbox, RELIABLE_MESS,
+                           spread->groups_to_send[0].name,
+                           0, msglen, (const char *)msgbase);
+    } else if (spread->num_groups == 1) {
+        ret = SP_multicast(spread->mbox, RELIABLE_MESS,
+                           spread->groups[0].name,
+                           0, msglen, (const char *)msgbase);
+    } else if (spread->num_groups_to_send > 1) {
+        ret = SP_multigroup_multicast(spread->mbox, RELIABLE_MESS,
+                                      spread->num_groups_to_send,
+                                      (const char (*)[]) spread->groups_to_send,
+                                      0, msglen, (const char *)msgbase);
+    } else {
+        ret = SP_multigroup_multicast(spread->mbox, RELIABLE_MESS,
+                                      spread->num_groups,
+                                      (const char (*)[]) spread->groups,
+                                      0, msglen, (const char *)msgbase);
+    }
+
+    if (ret < 0) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
+                    "error receiving Spread message: %s",
+                    fbConnSpreadError(ret));
+    }
+
+    pthread_mutex_unlock(&(exporter->spec.spread->write_lock));
+
+    return (ret < 0) ? FALSE : TRUE;
+}
 
 /**
- * fbExporterGetMTU
+ * fbExporterSpreadClose
  *
  * @param exporter
- *
- * @return
  */
-uint16_t
-fbExporterGetMTU(
+static void
+fbExporterSpreadClose(
     fbExporter_t  *exporter)
 {
-    return exporter->mtu;
+    if (exporter->active) {
+        pthread_cancel(exporter->spec.spread->recv_thread);
+        pthread_join(exporter->spec.spread->recv_thread, NULL);
+        SP_disconnect(exporter->spec.spread->mbox);
+    }
+    exporter->active = FALSE;
 }
 
 /**
- * fbExporterAllocNet
- *
- * @param spec
+ * fbExporterAllocSpread
  *
- * @return
+ * @param Spread_params
  */
 fbExporter_t *
-fbExporterAllocNet(
-    fbConnSpec_t  *spec)
+fbExporterAllocSpread(
+    fbSpreadParams_t  *params)
 {
     fbExporter_t *exporter = NULL;
 
-    /* Host must not be null */
-    g_assert(spec->host);
+    g_assert(params->daemon);
+    g_assert(params->groups);
+    g_assert(params->groups[0]);
 
-    /* Create a new exporter */
     exporter = g_slice_new0(fbExporter_t);
 
-    /* Copy the connection specifier */
-    exporter->spec.conn = fbConnSpecCopy(spec);
+    exporter->spec.spread = fbConnSpreadCopy(params);
 
-    /* Set up functions */
-    switch (spec->transport) {
-#if FB_ENABLE_SCTP
-      case FB_SCTP:
-        exporter->exopen = fbExporterOpenSocket;
-        exporter->exwrite = fbExporterWriteSCTP;
-        exporter->exclose = fbExporterCloseSocket;
-        exporter->sctp_mode = FB_F_SCTP_AUTOSTREAM;
-        exporter->sctp_stream = 0;
-        exporter->mtu = 8192;
-        break;
-#endif /* if FB_ENABLE_SCTP */
-      case FB_TCP:
-        exporter->exopen = fbExporterOpenSocket;
-        exporter->exwrite = fbExporterWriteTCP;
-        exporter->exclose = fbExporterCloseSocket;
-        exporter->mtu = 8192;
-        break;
-      case FB_UDP:
-        exporter->exopen = fbExporterOpenSocket;
-        exporter->exwrite = fbExporterWriteUDP;
-        exporter->exclose = fbExporterCloseSocket;
-        exporter->mtu = 1420;
-        break;
-#if HAVE_OPENSSL
-#if HAVE_OPENSSL_DTLS_SCTP
-      case FB_DTLS_SCTP:
-        exporter->exopen = fbExporterOpenDTLS;
-        exporter->exwrite = fbExporterWriteTLS;
-        exporter->exclose = fbExporterCloseTLS;
-        exporter->sctp_mode = FB_F_SCTP_AUTOSTREAM;
-        exporter->sctp_stream = 0;
-        exporter->mtu = 8192;
-        break;
-#endif /* if HAVE_OPENSSL_DTLS_SCTP */
-      case FB_TLS_TCP:
-        exporter->exopen = fbExporterOpenTLS;
-        exporter->exwrite = fbExporterWriteTLS;
-        exporter->exclose = fbExporterCloseTLS;
-        exporter->mtu = 8192;
-        break;
-#if HAVE_OPENSSL_DTLS
-      case FB_DTLS_UDP:
-        exporter->exopen = fbExporterOpenDTLS;
-        exporter->exwrite = fbExporterWriteTLS;
-        exporter->exclose = fbExporterCloseTLS;
-        exporter->mtu = 1320;
-        break;
-#endif /* if HAVE_OPENSSL_DTLS */
-#endif /* if HAVE_OPENSSL */
-      default:
-#ifndef FB_ENABLE_SCTP
-        if (spec->transport == FB_SCTP || spec->transport == FB_DTLS_SCTP) {
-            g_error("Libfixbuf not enabled for SCTP Transport. "
-                    " Run configure with --with-sctp");
-        }
-#endif /* ifndef FB_ENABLE_SCTP */
-        if (spec->transport == FB_TLS_TCP || spec->transport == FB_DTLS_SCTP ||
-            spec->transport == FB_DTLS_UDP)
-        {
-            g_error("Libfixbuf not enabled for this mode of transport. "
-                    " Run configure with --with-openssl");
+    exporter->exopen = fbExporterSpreadOpen;
+    exporter->exwrite = fbExporterSpreadWrite;
+    exporter->exclose = fbExporterSpreadClose;
+#ifdef DEBUG
+    exporter->mtu = 8192;
+#else
+    exporter->mtu = FB_SPREAD_MTU;
+#endif
+
+    return exporter;
+}
+
+/**
+ * fbExporterSetGroupsToSend
+ *
+ * @param exporter
+ * @param groups
+ * @param num_groups
+ *
+ */
+void
+fbExporterSetGroupsToSend(
+    fbExporter_t  *exporter,
+    char         **groups,
+    int            num_groups)
+{
+    int    n = 0;
+    char **g = 0;
+    fbSpreadSpec_t *spread = exporter->spec.spread;
+
+    if (!spread->groups_to_send) {
+        spread->groups_to_send = g_new0(sp_groupname_t, spread->num_groups);
+    }
+
+    g = groups;
+
+    for (n = 0; n < num_groups; n++) {
+        strncpy(spread->groups_to_send[n].name, *g, MAX_GROUP_NAME - 1);
+        g++;
+    }
+
+    spread->num_groups_to_send = n;
+}
+
+/**
+ * fbExporterCheckGroups
+ *
+ * If we are sending to a new (different) group of Spread Groups - return TRUE
+ * to emit the buffer and set new export groups.
+ *
+ * @param exporter
+ * @param groups
+ * @param num_groups
+ */
+gboolean
+fbExporterCheckGroups(
+    fbExporter_t  *exporter,
+    char         **groups,
+    int            num_groups)
+{
+    int n;
+    fbSpreadSpec_t *spread = exporter->spec.spread;
+
+    if (num_groups != spread->num_groups_to_send) {
+        return TRUE;
+    }
+
+    for (n = 0; n < num_groups; n++) {
+        if (strcmp(spread->groups_to_send[n].name, groups[n]) != 0) {
+            return TRUE;
         }
     }
-
-    /* Return new exporter */
-    return exporter;
+
+    return FALSE;
+}
+
+#endif /* HAVE_SPREAD */
+
+/**
+ * fbExporterSetStream
+ *
+ * @param exporter
+ * @param sctp_stream
+ *
+ */
+void
+fbExporterSetStream(
+    fbExporter_t  *exporter,
+    int            sctp_stream)
+{
+    exporter->sctp_mode &= ~FB_F_SCTP_AUTOSTREAM;
+    exporter->sctp_stream = sctp_stream;
+}
+
+/**
+ * fbExporterAutoStream
+ *
+ * @param exporter
+ *
+ *
+ */
+void
+fbExporterAutoStream(
+    fbExporter_t  *exporter)
+{
+    exporter->sctp_mode |= FB_F_SCTP_AUTOSTREAM;
+}
+
+/**
+ * fbExporterSetTemplateRefresh
+ *
+ * @param exporter
+ * @param interval
+ * @param msg_count
+ *
+ */
+void
+fbExporterSetTemplateRefresh(
+    fbExporter_t  *exporter,
+    uint32_t       interval,
+    uint32_t       msg_count)
+{
+    exporter->tmpl_refresh_secs = interval;
+    exporter->tmpl_refresh_msgs = msg_count;
+    fbExporterResetTemplateRefresh(exporter);
+}
+
+/**
+ * fbExporterResetTemplateRefresh
+ *
+ * @param exporter
+ *
+ */
+void
+fbExporterResetTemplateRefresh(
+    fbExporter_t  *exporter)
+{
+    if (exporter) {
+        exporter->tmpl_refresh_count = 0;
+        exporter->tmpl_refresh_last = time(NULL);
+    }
 }
 
-#if HAVE_SPREAD
-
 /**
- * fbExporterSpreadReceiver
+ * fbExporterTemplateRefreshDue
+ *
+ * Counts one exported message against the template refresh interval and
+ * returns TRUE (resetting the interval) when templates should be resent.
+ *
+ * @param exporter
  *
+ * @return
  */
-static void *
-fbExporterSpreadReceiver(
-    void  *arg)
+gboolean
+fbExporterTemplateRefreshDue(
+    fbExporter_t  *exporter)
 {
-    int           i = 0;
-    char          grp[MAX_GROUP_NAME];
-    fbExporter_t *exporter = (fbExporter_t *)arg;
-    fbSpreadSpec_t *spread = exporter->spec.spread;
-    service       service_type = 0;
-    char          sender[MAX_GROUP_NAME];
-    int           num_groups = 0;
-    int16         mess_type = 0;
-    int           endian_mismatch;
-    int           run = 1;
-    int           ret;
-    membership_info memb_info;
+    if (!exporter->tmpl_refresh_secs && !exporter->tmpl_refresh_msgs) {
+        return FALSE;
+    }
 
-#if 0
-    /*  this loop is to allow a debugger to be attached */
-    int foo = 1;
-    do {
-        sleep(1);
-    } while (foo);
-#endif /* if 0 */
+    ++exporter->tmpl_refresh_count;
+    if ((exporter->tmpl_refresh_msgs &&
+         exporter->tmpl_refresh_count >= exporter->tmpl_refresh_msgs) ||
+        (exporter->tmpl_refresh_secs &&
+         (time(NULL) - exporter->tmpl_refresh_last >=
+          (time_t)exporter->tmpl_refresh_secs)))
+    {
+        fbExporterResetTemplateRefresh(exporter);
+        return TRUE;
+    }
 
-    ret = SP_connect(spread->daemon, 0, 0, 1,
-                     &(spread->recv_mbox), spread->recv_privgroup);
+    return FALSE;
+}
 
-    if (ret != ACCEPT_SESSION) {
-        g_set_error(&(spread->recv_err), FB_ERROR_DOMAIN, FB_ERROR_CONN,
-                    "error connecting to Spread daemon %s: %s",
-                    spread->daemon, fbConnSpreadError(ret));
-        return 0;
+gboolean
+fbExporterSetIOBackend(
+    fbExporter_t   *exporter,
+    fbIOBackend_t   backend,
+    GError        **err)
+{
+    /* the export thread must be idle while the writer changes */
+    fbExporterAsyncDrain(exporter);
+
+    if (exporter->exopen != fbExporterOpenSocket ||
+        (exporter->spec.conn->transport != FB_TCP &&
+         exporter->spec.conn->transport != FB_UDP))
+    {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IMPL,
+                    "Alternate I/O backends are only supported on TCP and"
+                    " UDP exporters");
+        return FALSE;
     }
 
-    for (i = 0; i < spread->num_groups; i++) {
-        /* exporter listener only joins template/control plane group,
-         * the group name is always the name of the data plane group
-         * plus 'T' added to the end. */
-        memset(grp, 0, sizeof(grp));
-        strncpy(grp, spread->groups[i].name, sizeof(grp) - 2);
-        strcat(grp, "T");
-        ret = SP_join(spread->recv_mbox, grp);
-        if (ret) {
-            g_set_error(&(spread->recv_err), FB_ERROR_DOMAIN, FB_ERROR_CONN,
-                        "error joining to Spread group %s: %s",
-                        spread->groups[i].name, fbConnSpreadError(ret));
-            return 0;
+    /* an I/O backend replaces write coalescing and UDP batching */
+    if (!fbExporterStopCoalesce(exporter, err)) {
+        return FALSE;
+    }
+    if (exporter->udpbatch) {
+        if (!fbExporterUDPBatchFlush(exporter, err)) {
+            return FALSE;
         }
+        fbExporterUDPBatchFree(exporter->udpbatch);
+        exporter->udpbatch = NULL;
     }
 
-    do {
-        ret = SP_receive(spread->recv_mbox, &service_type, sender,
-                         spread->recv_max_groups, &num_groups,
-                         (char (*)[]) spread->recv_groups,
-                         &mess_type, &endian_mismatch, spread->recv_max,
-                         spread->recv_mess);
-
-        if (spread->recv_exit) {
-            SP_disconnect(spread->recv_mbox);
-            continue;
+    switch (backend) {
+      case FB_IO_SYSCALL:
+#if HAVE_LIBURING
+        if (exporter->uring) {
+            if (!fbExporterUringFlush(exporter, err)) {
+                return FALSE;
+            }
+            fbExporterUringFree(exporter->uring);
+            exporter->uring = NULL;
+        }
+#endif  /* HAVE_LIBURING */
+        exporter->exwrite = ((exporter->spec.conn->transport == FB_TCP)
+                             ? fbExporterWriteTCP : fbExporterWriteUDP);
+        exporter->exclose = fbExporterCloseSocket;
+        return TRUE;
+      case FB_IO_URING:
+#if HAVE_LIBURING
+        if (!exporter->uring) {
+            fbExporterUring_t *uring = g_slice_new0(fbExporterUring_t);
+            int                ret;
+
+            ret = io_uring_queue_init(FB_URING_SLOTS, &uring->ring, 0);
+            if (ret < 0) {
+                g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                            "Unable to create io_uring: %s", strerror(-ret));
+                g_slice_free(fbExporterUring_t, uring);
+                return FALSE;
+            }
+            uring->slotlen = exporter->mtu;
+            uring->bufs = g_new(uint8_t, (size_t)FB_URING_SLOTS *
+                                uring->slotlen);
+            exporter->uring = uring;
         }
+        exporter->exwrite = fbExporterWriteUring;
+        exporter->exclose = fbExporterCloseUring;
+        return TRUE;
+#else
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IMPL,
+                    "libfixbuf was built without io_uring support");
+        return FALSE;
+#endif  /* HAVE_LIBURING */
+    }
 
-        if (ret < 0) {
-            if (ret == GROUPS_TOO_SHORT) {
-                g_free(spread->recv_groups);
-                spread->recv_max_groups = -ret;
-                spread->recv_groups = g_new0(sp_groupname_t,
-                                             spread->recv_max_groups);
-            } else if (ret == BUFFER_TOO_SHORT) {
-                g_free(spread->recv_mess);
-                spread->recv_max = -endian_mismatch;
-                spread->recv_mess = g_new0(char, spread->recv_max);
-            } else {
-                g_set_error(&(spread->recv_err), FB_ERROR_DOMAIN, FB_ERROR_IO,
-                            "error receiving Spread message: %s",
-                            fbConnSpreadError(ret));
+    g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IMPL,
+                "Unknown I/O backend %d", (int)backend);
+    return FALSE;
+}
 
-                SP_disconnect(spread->recv_mbox);
+gboolean
+fbExporterSetUDPBatch(
+    fbExporter_t  *exporter,
+    unsigned int   count,
+    size_t         bytes,
+    GError       **err)
+{
+    fbExporterUDPBatch_t *batch;
 
-                run = 0;
-            }
-            continue;
-        }
-        /* actually received a message! Now process it */
-        if (!Is_reg_memb_mess(service_type) ||
-            !Is_caused_join_mess(service_type))
-        {
-            continue;
-        }
+    /* the export thread must be idle while the writer changes */
+    fbExporterAsyncDrain(exporter);
 
-        if (SP_get_memb_info(spread->recv_mess, service_type, &memb_info) < 0) {
-            continue;
-        }
-        if (!memb_info.changed_member[0]) {
-            continue;
-        }
-        if (strncmp(memb_info.changed_member, spread->recv_privgroup,
-                    MAX_GROUP_NAME) == 0)
-        {
-            continue;
-        }
+    if (exporter->exopen != fbExporterOpenSocket ||
+        exporter->spec.conn->transport != FB_UDP)
+    {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IMPL,
+                    "Batched sends are only supported on UDP exporters");
+        return FALSE;
+    }
+#if HAVE_LIBURING
+    if (exporter->uring) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IMPL,
+                    "Batched sends are not supported with io_uring");
+        return FALSE;
+    }
+#endif
+    if (count > FB_UDP_BATCH_MAX) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_SETUP,
+                    "UDP batch count %u exceeds the maximum of %u",
+                    count, FB_UDP_BATCH_MAX);
+        return FALSE;
+    }
+    if (0 == bytes) {
+        bytes = FB_UDP_BATCH_BYTES;
+    }
+    if (bytes < exporter->mtu || bytes > FB_MSGLEN_MAX) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_SETUP,
+                    "UDP batch size %lu is outside the range %u-%u",
+                    (unsigned long)bytes, (unsigned int)exporter->mtu,
+                    FB_MSGLEN_MAX);
+        return FALSE;
+    }
 
-        /** Send Relevant Templates to New Member only. */
-        /** memb_info.changed_member is private group name */
-        /** sender is group they are subscribing to */
-        fbSessionSetPrivateGroup(spread->session,
-                                 sender, memb_info.changed_member);
-    } while (run);
+    batch = exporter->udpbatch;
+    if (batch && !fbExporterUDPBatchFlush(exporter, err)) {
+        return FALSE;
+    }
 
-    return 0;
+    if (count <= 1) {
+        fbExporterUDPBatchFree(batch);
+        exporter->udpbatch = NULL;
+        exporter->exwrite = fbExporterWriteUDP;
+        exporter->exclose = fbExporterCloseSocket;
+        return TRUE;
+    }
+
+    if (!batch) {
+        batch = g_slice_new0(fbExporterUDPBatch_t);
+        exporter->udpbatch = batch;
+    }
+    if (batch->bufsize != bytes) {
+        batch->buf = g_renew(uint8_t, batch->buf, bytes);
+        batch->bufsize = bytes;
+    }
+    batch->max_count = count;
+    batch->gso = TRUE;
+
+    exporter->exwrite = fbExporterWriteUDPBatch;
+    exporter->exclose = fbExporterCloseUDPBatch;
+    return TRUE;
 }
 
-/**
- * fbExporterSpreadOpen
- *
- * @param exporter
- * @param err
- */
-static gboolean
-fbExporterSpreadOpen(
+gboolean
+fbExporterSetCoalesce(
     fbExporter_t  *exporter,
+    size_t         bytes,
+    uint32_t       max_delay_ms,
     GError       **err)
 {
-    int ret;
+    fbExporterCoalesce_t *coalesce;
+    fbExporterWrite_fn    write;
+    int                   rv;
 
-    if (!exporter->spec.spread->daemon) {
-        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
-                    "Spread daemon name cannot be null");
+    /* the export thread must be idle while the writer changes */
+    fbExporterAsyncDrain(exporter);
+
+    coalesce = exporter->coalesce;
+    write = coalesce ? coalesce->write : exporter->exwrite;
+    if (write != fbExporterWriteFile && write != fbExporterWriteTCP
+#if HAVE_OPENSSL
+        && !(write == fbExporterWriteTLS
+             && exporter->spec.conn->transport == FB_TLS_TCP)
+#endif
+        )
+    {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IMPL,
+                    "Write coalescing is only supported on uncompressed file"
+                    " and TCP exporters using system calls");
         return FALSE;
     }
-    if (!exporter->spec.spread->daemon[0]) {
-        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
-                    "Spread daemon name cannot be empty");
-        return FALSE;
+    if (0 == bytes) {
+        return fbExporterStopCoalesce(exporter, err);
     }
 
-    if (!(memchr(exporter->spec.spread->daemon, 0, 261))) {
-        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
-                    "Spread daemon name too long");
+    if (coalesce) {
+        if (exporter->active && !fbExporterCoalesceFlush(exporter, err)) {
+            return FALSE;
+        }
+    } else {
+        coalesce = g_slice_new0(fbExporterCoalesce_t);
+        coalesce->write = exporter->exwrite;
+        coalesce->close = exporter->exclose;
+        pthread_mutex_init(&coalesce->mutex, NULL);
+        pthread_cond_init(&coalesce->cond, NULL);
+        exporter->coalesce = coalesce;
+        exporter->exwrite = fbExporterWriteCoalesce;
+        exporter->exclose = fbExporterCloseCoalesce;
+    }
+    pthread_mutex_lock(&coalesce->mutex);
+    if (coalesce->bufsize != bytes) {
+        coalesce->buf = g_renew(uint8_t, coalesce->buf, bytes);
+        coalesce->bufsize = bytes;
+    }
+    coalesce->max_delay = (gint64)max_delay_ms * 1000;
+    pthread_cond_signal(&coalesce->cond);
+    pthread_mutex_unlock(&coalesce->mutex);
+
+    if (coalesce->max_delay && !coalesce->running) {
+        rv = pthread_create(&coalesce->flusher, NULL,
+                            fbExporterCoalesceThread, exporter);
+        if (rv != 0) {
+            g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                        "Couldn't start flush thread: %s", strerror(rv));
+            fbExporterStopCoalesce(exporter, NULL);
+            return FALSE;
+        }
+        coalesce->running = TRUE;
+    }
+    return TRUE;
+}
+
+gboolean
+fbExporterEnableAsync(
+    fbExporter_t     *exporter,
+    unsigned int      slots,
+    fbAsyncPolicy_t   policy,
+    const char       *spill_path,
+    GError          **err)
+{
+    fbExporterAsync_t *async;
+    int                rv;
+
+    if (exporter->async) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_SETUP,
+                    "Asynchronous export is already enabled");
         return FALSE;
     }
-    if (!exporter->spec.spread->groups) {
-        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
-                    "Spread groups cannot be null");
+    if (exporter->exopen == fbExporterOpenBuffer) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IMPL,
+                    "Asynchronous export is not supported on buffer"
+                    " exporters");
         return FALSE;
     }
-    if (!exporter->spec.spread->groups[0].name[0]) {
-        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
-                    "Spread groups cannot be empty");
+    if (policy != FB_ASYNC_BLOCK && policy != FB_ASYNC_DROP_NEWEST
+        && policy != FB_ASYNC_SPILL)
+    {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_SETUP,
+                    "Unknown asynchronous export policy %d", (int)policy);
         return FALSE;
     }
-    if (!exporter->spec.spread->session) {
-        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
-                    "Spread session cannot be null");
+    if (FB_ASYNC_SPILL == policy && NULL == spill_path) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_SETUP,
+                    "The spill policy requires a spill file");
         return FALSE;
     }
+    if (0 == slots) {
+        slots = FB_ASYNC_SLOTS_DEFAULT;
+    }
 
-    pthread_mutex_init(&(exporter->spec.spread->write_lock), 0);
+    async = g_slice_new0(fbExporterAsync_t);
+    async->spill_fd = -1;
+    if (FB_ASYNC_SPILL == policy) {
+        async->spill_fd = open(spill_path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (-1 == async->spill_fd) {
+            g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                        "Couldn't open spill file %s: %s",
+                        spill_path, strerror(errno));
+            g_slice_free(fbExporterAsync_t, async);
+            return FALSE;
+        }
+        async->spill_path = g_strdup(spill_path);
+    }
+    async->policy = policy;
+    async->slots = slots;
+    async->bufs = g_new0(fbMessageBuffer_t *, slots);
+    async->lens = g_new0(size_t, slots);
+    async->paths = g_new0(char *, slots);
+    pthread_mutex_init(&async->mutex, NULL);
+    pthread_cond_init(&async->cond, NULL);
+    exporter->async = async;
+
+    rv = pthread_create(&async->thread, NULL, fbExporterAsyncThread,
+                        exporter);
+    if (rv != 0) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                    "Couldn't start export thread: %s", strerror(rv));
+        exporter->async = NULL;
+        if (async->spill_fd != -1) {
+            close(async->spill_fd);
+            unlink(async->spill_path);
+        }
+        g_free(async->spill_path);
+        pthread_cond_destroy(&async->cond);
+        pthread_mutex_destroy(&async->mutex);
+        g_free(async->bufs);
+        g_free(async->lens);
+        g_free(async->paths);
+        g_slice_free(fbExporterAsync_t, async);
+        return FALSE;
+    }
+    return TRUE;
+}
 
-    ret = SP_connect(exporter->spec.spread->daemon, 0, 0, 0,
-                     &(exporter->spec.spread->mbox),
-                     exporter->spec.spread->privgroup);
-    if (ret != ACCEPT_SESSION) {
-        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
-                    "error connecting to Spread daemon %s: %s",
-                    exporter->spec.spread->daemon, fbConnSpreadError(ret));
+gboolean
+fbExporterGetAsyncStats(
+    fbExporter_t            *exporter,
+    fbExporterAsyncStats_t  *stats)
+{
+    fbExporterAsync_t *async = exporter->async;
+
+    if (NULL == async) {
         return FALSE;
     }
+    pthread_mutex_lock(&async->mutex);
+    *stats = async->stats;
+    pthread_mutex_unlock(&async->mutex);
+    return TRUE;
+}
 
-    exporter->spec.spread->recv_err = 0;
-    exporter->spec.spread->recv_exit = 0;
-    ret = pthread_create(&(exporter->spec.spread->recv_thread), NULL,
-                         fbExporterSpreadReceiver, exporter);
-    if (ret) {
-        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
-                    "error creating Spread receiver thread: %s", strerror(ret));
-        SP_disconnect(exporter->spec.spread->mbox);
+gboolean
+fbExporterSetRotation(
+    fbExporter_t  *exporter,
+    const char    *pattern,
+    uint64_t       max_bytes,
+    uint64_t       max_records,
+    uint32_t       interval,
+    GError       **err)
+{
+    fbExporterRotate_t *rotate;
+    char               *name;
+    time_t              now;
+
+    /* the export thread must be idle while the path changes */
+    fbExporterAsyncDrain(exporter);
+
+    if ((exporter->exopen != fbExporterOpenFile &&
+         exporter->exopen != fbExporterOpenCompressedFile) ||
+        0 == strcmp(exporter->spec.path, "-"))
+    {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IMPL,
+                    "Rotation is only supported on file exporters");
+        return FALSE;
+    }
+    if (NULL == pattern) {
+        /* keep writing the current file */
+        fbExporterRotateFree(exporter->rotate);
+        exporter->rotate = NULL;
+        return TRUE;
+    }
+    if (fbCompressCodecForPath(pattern)
+        != fbCompressCodecForPath(exporter->spec.path))
+    {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_SETUP,
+                    "Rotation pattern %s and path %s differ in compression",
+                    pattern, exporter->spec.path);
         return FALSE;
     }
 
-    /*pthread_detach(exporter->spec.spread->recv_thread);*/
+    now = time(NULL);
+    name = fbExporterRotateName(pattern, 0, now);
+    if (NULL == name) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_SETUP,
+                    "Rotation pattern %s gives an empty or overlong name",
+                    pattern);
+        return FALSE;
+    }
 
-    exporter->active = TRUE;
+    rotate = exporter->rotate;
+    if (NULL == rotate) {
+        rotate = g_slice_new0(fbExporterRotate_t);
+        exporter->rotate = rotate;
+    }
+    g_free(rotate->pattern);
+    rotate->pattern = g_strdup(pattern);
+    rotate->max_bytes = max_bytes;
+    rotate->max_records = max_records;
+    rotate->interval = interval;
+
+    if (exporter->active) {
+        /* the open file becomes the first file of the rotation */
+        g_free(name);
+    } else {
+        g_free(exporter->spec.path);
+        exporter->spec.path = name;
+        rotate->bytes = 0;
+        rotate->records = 0;
+        rotate->start = now;
+        rotate->serial = 0;
+    }
     return TRUE;
 }
 
-/**
- * fbExporterSpreadWrite
- *
- * @param exporter
- * @param msg
- * @param msg size
- * @param err
- */
-static gboolean
-fbExporterSpreadWrite(
+gboolean
+fbExporterRotationDue(
     fbExporter_t  *exporter,
-    uint8_t       *msgbase,
-    size_t         msglen,
-    GError       **err)
+    uint32_t       records)
 {
-    int ret = 0;
-    fbSpreadSpec_t *spread;
-
-    pthread_mutex_lock(&(exporter->spec.spread->write_lock));
-
-    spread = exporter->spec.spread;
+    fbExporterRotate_t *rotate = exporter->rotate;
+    time_t              now;
 
-    if (spread->num_groups_to_send == 1) {
-        ret = SP_multicast(spread->mbox, RELIABLE_MESS,
-                           spread->groups_to_send[0].name,
-                           0, msglen, (const char *)msgbase);
-    } else if (spread->num_groups == 1) {
-        ret = SP_multicast(spread->mbox, RELIABLE_MESS,
-                           spread->groups[0].name,
-                           0, msglen, (const char *)msgbase);
-    } else if (spread->num_groups_to_send > 1) {
-        ret = SP_multigroup_multicast(spread->mbox, RELIABLE_MESS,
-                                      spread->num_groups_to_send,
-                                      (const char (*)[]) spread->groups_to_send,
-                                      0, msglen, (const char *)msgbase);
-    } else {
-        ret = SP_multigroup_multicast(spread->mbox, RELIABLE_MESS,
-                                      spread->num_groups,
-                                      (const char (*)[]) spread->groups,
-                                      0, msglen, (const char *)msgbase);
+    if (NULL == rotate) {
+        return FALSE;
     }
+    rotate->records += records;
 
-    if (ret < 0) {
-        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_CONN,
-                    "error receiving Spread message: %s",
-                    fbConnSpreadError(ret));
+    if (rotate->max_bytes && rotate->bytes >= rotate->max_bytes) {
+        return TRUE;
     }
-
-    pthread_mutex_unlock(&(exporter->spec.spread->write_lock));
-
-    return (ret < 0) ? FALSE : TRUE;
+    if (rotate->max_records && rotate->records >= rotate->max_records) {
+        return TRUE;
+    }
+    if (rotate->interval) {
+        /* rotate on multiples of the interval since the epoch, so files
+         * line up with the clock */
+        now = time(NULL);
+        if (now / rotate->interval != rotate->start / rotate->interval) {
+            return TRUE;
+        }
+    }
+    return FALSE;
 }
 
-/**
- * fbExporterSpreadClose
- *
- * @param exporter
- */
-static void
-fbExporterSpreadClose(
-    fbExporter_t  *exporter)
+gboolean
+fbExporterRotate(
+    fbExporter_t  *exporter,
+    GError       **err)
 {
-    if (exporter->active) {
-        pthread_cancel(exporter->spec.spread->recv_thread);
-        pthread_join(exporter->spec.spread->recv_thread, NULL);
-        SP_disconnect(exporter->spec.spread->mbox);
+    fbExporterRotate_t *rotate = exporter->rotate;
+    char               *name;
+    time_t              now;
+    gboolean            ok = TRUE;
+
+    now = time(NULL);
+    name = fbExporterRotateName(rotate->pattern, rotate->serial + 1, now);
+    if (NULL == name) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_SETUP,
+                    "Rotation pattern %s gives an empty or overlong name",
+                    rotate->pattern);
+        return FALSE;
     }
-    exporter->active = FALSE;
+
+    /* everything emitted so far belongs in the current file; an async
+     * exporter switches files on its export thread, in order */
+    if (exporter->async) {
+        if (!fbExporterAsyncPushRotate(exporter, name, err)) {
+            return FALSE;
+        }
+    } else {
+        /* the path switches even if flushing the old file fails, so the
+         * new file is counted either way and its name is not reused */
+        ok = fbExporterRotateSwitch(exporter, name, err);
+    }
+
+    ++rotate->serial;
+    rotate->bytes = 0;
+    rotate->records = 0;
+    rotate->start = now;
+    fbExporterResetTemplateRefresh(exporter);
+    return ok;
 }
 
-/**
- * fbExporterAllocSpread
- *
- * @param Spread_params
- */
 fbExporter_t *
-fbExporterAllocSpread(
-    fbSpreadParams_t  *params)
+fbExporterAllocFanout(
+    void)
 {
-    fbExporter_t *exporter = NULL;
-
-    g_assert(params->daemon);
-    g_assert(params->groups);
-    g_assert(params->groups[0]);
+    fbExporter_t *exporter;
 
     exporter = g_slice_new0(fbExporter_t);
-
-    exporter->spec.spread = fbConnSpreadCopy(params);
-
-    exporter->exopen = fbExporterSpreadOpen;
-    exporter->exwrite = fbExporterSpreadWrite;
-    exporter->exclose = fbExporterSpreadClose;
-#ifdef DEBUG
-    exporter->mtu = 8192;
-#else
-    exporter->mtu = FB_SPREAD_MTU;
-#endif
+    exporter->fanout = g_slice_new0(fbExporterFanout_t);
+    exporter->fanout->domains = g_hash_table_new_full(
+        g_direct_hash, g_direct_equal, NULL,
+        (GDestroyNotify)fbExporterFanoutDomainFree);
+    exporter->exopen = fbExporterOpenFanout;
+    exporter->exwrite = fbExporterWriteFanout;
+    exporter->exclose = fbExporterCloseFanout;
+    exporter->mtu = 65496;
 
     return exporter;
 }
 
-/**
- * fbExporterSetGroupsToSend
- *
- * @param exporter
- * @param groups
- * @param num_groups
- *
- */
-void
-fbExporterSetGroupsToSend(
+gboolean
+fbExporterAddFanoutChild(
     fbExporter_t  *exporter,
-    char         **groups,
-    int            num_groups)
+    fbExporter_t  *child,
+    GError       **err)
 {
-    int    n = 0;
-    char **g = 0;
-    fbSpreadSpec_t *spread = exporter->spec.spread;
+    fbExporterFanout_t *fanout = exporter->fanout;
 
-    if (!spread->groups_to_send) {
-        spread->groups_to_send = g_new0(sp_groupname_t, spread->num_groups);
+    if (NULL == fanout) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_SETUP,
+                    "Exporter is not a fan-out exporter");
+        return FALSE;
+    }
+    if (child == exporter || child->exopen == fbExporterOpenBuffer) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IMPL,
+                    "Exporter cannot be a fan-out child");
+        return FALSE;
     }
 
-    g = groups;
+    /* the export thread must be idle while the children change */
+    fbExporterAsyncDrain(exporter);
 
-    for (n = 0; n < num_groups; n++) {
-        strncpy(spread->groups_to_send[n].name, *g, MAX_GROUP_NAME - 1);
-        g++;
-    }
+    fanout->children = g_renew(fbExporterChild_t, fanout->children,
+                               fanout->count + 1);
+    memset(&fanout->children[fanout->count], 0, sizeof(fbExporterChild_t));
+    fanout->children[fanout->count].exporter = child;
+    ++fanout->count;
 
-    spread->num_groups_to_send = n;
+    /* every message must fit every child */
+    if (child->mtu < exporter->mtu) {
+        exporter->mtu = child->mtu;
+    }
+    return TRUE;
 }
 
-/**
- * fbExporterCheckGroups
- *
- * If we are sending to a new (different) group of Spread Groups - return TRUE
- * to emit the buffer and set new export groups.
- *
- * @param exporter
- * @param groups
- * @param num_groups
- */
 gboolean
-fbExporterCheckGroups(
+fbExporterFlush(
     fbExporter_t  *exporter,
-    char         **groups,
-    int            num_groups)
+    GError       **err)
 {
-    int n;
-    fbSpreadSpec_t *spread = exporter->spec.spread;
-
-    if (num_groups != spread->num_groups_to_send) {
+    if (exporter->async) {
+        fbExporterAsyncDrain(exporter);
+        if (!fbExporterAsyncCheckError(exporter->async, err)) {
+            return FALSE;
+        }
+    }
+    if (!exporter->active) {
         return TRUE;
     }
-
-    for (n = 0; n < num_groups; n++) {
-        if (strcmp(spread->groups_to_send[n].name, groups[n]) != 0) {
-            return TRUE;
+    if (exporter->fanout) {
+        gboolean     ok = TRUE;
+        unsigned int i;
+
+        /* flush every child; report the first failure */
+        for (i = 0; i < exporter->fanout->count; ++i) {
+            if (!fbExporterFlush(exporter->fanout->children[i].exporter,
+                                 ok ? err : NULL))
+            {
+                ok = FALSE;
+            }
         }
+        return ok;
     }
-
-    return FALSE;
-}
-
-#endif /* HAVE_SPREAD */
-
-/**
- * fbExporterSetStream
- *
- * @param exporter
- * @param sctp_stream
- *
- */
-void
-fbExporterSetStream(
-    fbExporter_t  *exporter,
-    int            sctp_stream)
-{
-    exporter->sctp_mode &= ~FB_F_SCTP_AUTOSTREAM;
-    exporter->sctp_stream = sctp_stream;
-}
-
-/**
- * fbExporterAutoStream
- *
- * @param exporter
- *
- *
- */
-void
-fbExporterAutoStream(
-    fbExporter_t  *exporter)
-{
-    exporter->sctp_mode |= FB_F_SCTP_AUTOSTREAM;
+    if (exporter->coalesce) {
+        if (!fbExporterCoalesceFlush(exporter, err)) {
+            return FALSE;
+        }
+        if (exporter->coalesce->write == fbExporterWriteFile
+            && fflush(exporter->stream.fp) != 0)
+        {
+            g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                        "I/O error: %s", strerror(errno));
+            return FALSE;
+        }
+        return TRUE;
+    }
+#if HAVE_LIBURING
+    if (exporter->uring) {
+        return fbExporterUringFlush(exporter, err);
+    }
+#endif
+    if (exporter->udpbatch) {
+        return fbExporterUDPBatchFlush(exporter, err);
+    }
+    if (exporter->compress) {
+        return fbCompressStreamFlush(exporter->compress, err);
+    }
+    if (exporter->exwrite == fbExporterWriteFile) {
+        if (fflush(exporter->stream.fp) != 0) {
+            g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                        "I/O error: %s", strerror(errno));
+            return FALSE;
+        }
+    }
+    return TRUE;
 }
 
 #if 0
@@ -1499,18 +4423,51 @@ fbExportMessage(
     size_t         msglen,
     GError       **err)
 {
-    /* Ensure stream is open */
-    if (!exporter->active) {
-        g_assert(exporter->exopen);
-        if (!exporter->exopen(exporter, err)) {return FALSE;}
+    fbMessageBuffer_t *msgbuf;
+    gboolean           ok;
+
+    if (exporter->rotate) {
+        exporter->rotate->bytes += msglen;
+    }
+    if (NULL == exporter->async) {
+        return fbExporterWriteMessage(exporter, msgbase, msglen, err);
     }
 
-    /* Attempt to write message */
-    if (exporter->exwrite(exporter, msgbase, msglen, err)) {return TRUE;}
+    /* copy the message so it goes through the ring in order */
+    msgbuf = fbMessageBufferAllocSize(msglen);
+    memcpy(fbMessageBufferGetData(msgbuf), msgbase, msglen);
+    ok = fbExporterAsyncPush(exporter, msgbuf, msglen, err);
+    fbMessageBufferUnref(msgbuf);
+    return ok;
+}
 
-    /* Close exporter on write failure */
-    if (exporter->exclose) {exporter->exclose(exporter);}
-    return FALSE;
+/**
+ * fbExportMessageBuffer
+ *
+ *
+ * @param exporter
+ * @param msgbuf
+ * @param msglen
+ * @param err
+ *
+ * @return
+ *
+ */
+gboolean
+fbExportMessageBuffer(
+    fbExporter_t       *exporter,
+    fbMessageBuffer_t  *msgbuf,
+    size_t              msglen,
+    GError            **err)
+{
+    if (exporter->rotate) {
+        exporter->rotate->bytes += msglen;
+    }
+    if (exporter->async) {
+        return fbExporterAsyncPush(exporter, msgbuf, msglen, err);
+    }
+    return fbExporterWriteMessage(exporter, fbMessageBufferGetData(msgbuf),
+                                  msglen, err);
 }
 
 /**
@@ -1524,8 +4481,14 @@ void
 fbExporterFree(
     fbExporter_t  *exporter)
 {
+    fbExporterStopAsync(exporter);
     fbExporterClose(exporter);
-    if (exporter->exwrite == fbExporterWriteFile) {
+    /* file exporters, including those from fbExporterAllocFP(), hold a
+     * path; their write function may be wrapped, so check how they open */
+    if (exporter->exopen == fbExporterOpenFile
+        || exporter->exopen == fbExporterOpenCompressedFile
+        || NULL == exporter->exopen)
+    {
         g_free(exporter->spec.path);
     }
 #ifdef HAVE_SPREAD
@@ -1537,6 +4500,13 @@ fbExporterFree(
         fbConnSpecFree(exporter->spec.conn);
     }
 
+#if HAVE_LIBURING
+    fbExporterUringFree(exporter->uring);
+#endif
+    fbExporterUDPBatchFree(exporter->udpbatch);
+    fbExporterCoalesceFree(exporter->coalesce);
+    fbExporterRotateFree(exporter->rotate);
+    fbExporterFanoutFree(exporter->fanout);
     g_slice_free(fbExporter_t, exporter);
 }
 
@@ -1551,6 +4521,8 @@ void
 fbExporterClose(
     fbExporter_t  *exporter)
 {
+    /* write what the export thread has queued; errors stay pending */
+    fbExporterAsyncDrain(exporter);
     if (exporter->active && exporter->exclose) {exporter->exclose(exporter);}
 }
 
@@ -0,0 +1,1538 @@
+/*
+ *  Copyright 2006-2025 Carnegie Mellon University
+ *  See license information in LICENSE.txt.
+ */
+/**
+ *  @file fbindex.c
+ *  Message index of an IPFIX file and parallel decoding of the file
+ */
+/*
+ *  ------------------------------------------------------------------------
+ *  @DISTRIBUTION_STATEMENT_BEGIN@
+ *  libfixbuf 2.5
+ *
+ *  Copyright 2024 Carnegie Mellon University.
+ *
+ *  NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ *  INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ *  UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR
+ *  IMPLIED, AS TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF
+ *  FITNESS FOR PURPOSE OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS
+ *  OBTAINED FROM USE OF THE MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT
+ *  MAKE ANY WARRANTY OF ANY KIND WITH RESPECT TO FREEDOM FROM PATENT,
+ *  TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ *
+ *  Licensed under a GNU-Lesser GPL 3.0-style license, please see
+ *  LICENSE.txt or contact permission@sei.cmu.edu for full terms.
+ *
+ *  [DISTRIBUTION STATEMENT A] This material has been approved for public
+ *  release and unlimited distribution.  Please see Copyright notice for
+ *  non-US Government use and distribution.
+ *
+ *  This Software includes and/or makes use of Third-Party Software each
+ *  subject to its own license.
+ *
+ *  DM24-1020
+ *  @DISTRIBUTION_STATEMENT_END@
+ *  ------------------------------------------------------------------------
+ */
+
+#define _FIXBUF_SOURCE_
+#include <fixbuf/private.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+
+/*
+ *  An index lists the offset, length, and header fields of every IPFIX
+ *  Message in a file, along with the IDs of the templates each message
+ *  defines or withdraws.  It is built by one sequential pass over the file
+ *  that reads message and set headers and skips data sets.
+ *
+ *  Decoding can start at any message once the templates in effect there
+ *  are known.  For each (domain, template ID) the last message before the
+ *  start point that defined or withdrew that template is a "definer".
+ *  Reading the template sets of every definer, in file order, recreates
+ *  the template state: a template a definer sets up may be replaced by a
+ *  later definer, but never by a message that is not replayed.
+ */
+
+/* Size of an IPFIX Message header */
+#define FB_INDEX_MSGHDR     16
+
+/* Size of an IPFIX Set header */
+#define FB_INDEX_SETHDR     4
+
+/* Magic number and version of a saved index */
+#define FB_INDEX_MAGIC      "FBIX"
+#define FB_INDEX_VERSION    1
+
+/* Size of the header of a saved index and of each message it lists */
+#define FB_INDEX_FILEHDR    24
+#define FB_INDEX_FILEMSG    24
+
+/* Initial number of entries allocated in the arrays of an index */
+#define FB_INDEX_INITIAL    1024
+
+/* Elements of an RFC 5610 information element type record */
+#define FB_INDEX_IE_ID      303
+#define FB_INDEX_IE_TYPE    339
+#define FB_INDEX_IE_DESC    340
+#define FB_INDEX_IE_NAME    341
+#define FB_INDEX_IE_BEGIN   342
+#define FB_INDEX_IE_END     343
+#define FB_INDEX_IE_SEM     344
+#define FB_INDEX_IE_UNITS   345
+#define FB_INDEX_IE_PEN     346
+
+/* One IPFIX Message in an indexed file */
+typedef struct fbIndexMsg_st {
+    /** Offset of the message in the file */
+    uint64_t   offset;
+    /** Export time from the message header */
+    uint32_t   export_time;
+    /** Observation domain from the message header */
+    uint32_t   domain;
+    /** Index in the tids array of the first template ID of this message */
+    uint32_t   tid_start;
+    /** Length of the message */
+    uint16_t   length;
+    /** Number of template IDs this message defines or withdraws */
+    uint16_t   tid_count;
+} fbIndexMsg_t;
+
+struct fbFileIndex_st {
+    /** Size of the indexed file */
+    uint64_t       file_size;
+    /** The messages, in file order */
+    fbIndexMsg_t  *msgs;
+    /** Number of entries in 'msgs' */
+    uint32_t       msg_count;
+    /** Number of entries allocated for 'msgs' */
+    uint32_t       msg_alloc;
+    /** The template IDs defined or withdrawn by the messages */
+    uint16_t      *tids;
+    /** Number of entries in 'tids' */
+    uint32_t       tid_count;
+    /** Number of entries allocated for 'tids' */
+    uint32_t       tid_alloc;
+};
+
+/* A range of messages decoded by one worker */
+typedef struct fbParallelChunk_st {
+    /** Index of the first message of the chunk */
+    uint32_t   first;
+    /** Index of one past the last message of the chunk */
+    uint32_t   last;
+    /** Indexes of the messages whose templates precede the chunk */
+    uint32_t  *replay;
+    /** Number of entries in 'replay' */
+    uint32_t   replay_count;
+} fbParallelChunk_t;
+
+struct fbParallelReader_st {
+    /** Path of the file */
+    char               *path;
+    /** Descriptor used to read template sets for the chunk prefixes */
+    int                 fd;
+    /** Session cloned by each worker; not owned by the reader */
+    fbSession_t        *session;
+    /** Index of the file */
+    fbFileIndex_t      *index;
+    /** The chunks */
+    fbParallelChunk_t  *chunks;
+    /** Number of entries in 'chunks' */
+    unsigned int        chunk_count;
+};
+
+/* State shared by the workers of fbParallelReaderRun() */
+typedef struct fbParallelRun_st {
+    fbParallelReader_t    *reader;
+    fbParallelDecode_fn    decode;
+    fbParallelDeliver_fn   deliver;
+    void                  *app_ctx;
+    gboolean               ordered;
+    /** Held around each delivery when not ordered, so only one runs */
+    pthread_mutex_t        deliver_mutex;
+    /** Protects the members below */
+    pthread_mutex_t        mutex;
+    /** Next chunk to decode */
+    unsigned int           next_chunk;
+    /** Next chunk to deliver when ordered */
+    unsigned int           next_deliver;
+    /** TRUE while a worker is delivering results when ordered */
+    gboolean               delivering;
+    /** Results waiting to be delivered when ordered */
+    void                 **results;
+    /** Whether each chunk in 'results' is decoded */
+    gboolean              *done;
+    /** First error; stops the run */
+    GError                *error;
+} fbParallelRun_t;
+
+/*
+ * Layout of an options template that describes RFC 5610 information
+ * element type records, kept by a scan that adds elements to a model
+ */
+typedef struct fbIndexTypeTmpl_st {
+    /** Number of each field; 0 for an enterprise-specific field */
+    uint16_t  *nums;
+    /** Length of each field; FB_IE_VARLEN if variable */
+    uint16_t  *lens;
+    /** Number of fields */
+    uint16_t   count;
+    /** Length of the shortest record */
+    uint16_t   minlen;
+} fbIndexTypeTmpl_t;
+
+
+/**
+ * fbIndexReadU16
+ *
+ * Returns the 16-bit value in network byte order at `cp`, which need not
+ * be aligned.
+ *
+ */
+static uint16_t
+fbIndexReadU16(
+    const uint8_t  *cp)
+{
+    uint16_t val;
+
+    memcpy(&val, cp, sizeof(val));
+    return g_ntohs(val);
+}
+
+/**
+ * fbIndexReadU32
+ *
+ * Returns the 32-bit value in network byte order at `cp`, which need not
+ * be aligned.
+ *
+ */
+static uint32_t
+fbIndexReadU32(
+    const uint8_t  *cp)
+{
+    uint32_t val;
+
+    memcpy(&val, cp, sizeof(val));
+    return g_ntohl(val);
+}
+
+/**
+ * fbIndexAddTid
+ *
+ * Notes that the newest message of `index` defines or withdraws `tid`.
+ *
+ */
+static void
+fbIndexAddTid(
+    fbFileIndex_t  *index,
+    uint16_t        tid)
+{
+    if (index->tid_count == index->tid_alloc) {
+        index->tid_alloc *= 2;
+        index->tids = g_renew(uint16_t, index->tids, index->tid_alloc);
+    }
+    index->tids[index->tid_count++] = tid;
+    ++index->msgs[index->msg_count - 1].tid_count;
+}
+
+/**
+ * fbIndexAddAlien
+ *
+ * Adds the element `ent`/`num` to `model` if it is not there.  Decoding
+ * a template adds unknown elements to the model, which worker threads
+ * cannot do safely, so the scan adds them first.
+ *
+ */
+static void
+fbIndexAddAlien(
+    fbInfoModel_t  *model,
+    uint32_t        ent,
+    uint16_t        num,
+    uint16_t        len)
+{
+    fbInfoElement_t ie;
+
+    memset(&ie, 0, sizeof(ie));
+    ie.ent = ent;
+    ie.num = num;
+    ie.len = len;
+    if (!fbInfoModelGetElement(model, &ie)) {
+        fbInfoModelAddAlienElement(model, &ie);
+    }
+}
+
+/**
+ * fbIndexTypeTmplFree
+ *
+ */
+static void
+fbIndexTypeTmplFree(
+    gpointer   v_tt)
+{
+    fbIndexTypeTmpl_t *tt = (fbIndexTypeTmpl_t *)v_tt;
+
+    g_free(tt->nums);
+    g_free(tt->lens);
+    g_slice_free(fbIndexTypeTmpl_t, tt);
+}
+
+/**
+ * fbIndexTypeTmplCheck
+ *
+ * Returns TRUE if the template `tt` has every element of an RFC 5610
+ * information element type record, as fbInfoModelTypeInfoRecord() asks.
+ *
+ */
+static gboolean
+fbIndexTypeTmplCheck(
+    const fbIndexTypeTmpl_t  *tt)
+{
+    static const uint16_t wanted[] = {
+        FB_INDEX_IE_PEN, FB_INDEX_IE_ID, FB_INDEX_IE_TYPE, FB_INDEX_IE_SEM,
+        FB_INDEX_IE_UNITS, FB_INDEX_IE_BEGIN, FB_INDEX_IE_END,
+        FB_INDEX_IE_NAME, FB_INDEX_IE_DESC
+    };
+    unsigned int i;
+    uint16_t     j;
+
+    for (i = 0; i < sizeof(wanted) / sizeof(wanted[0]); ++i) {
+        for (j = 0; j < tt->count && tt->nums[j] != wanted[i]; ++j) {}
+        if (j == tt->count) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * fbIndexTypeTmplForget
+ *
+ * A GHRFunc that removes the type templates of the observation domain
+ * `v_domain` when the message withdraws all of its templates.
+ *
+ */
+static gboolean
+fbIndexTypeTmplForget(
+    gpointer   key,
+    gpointer   value,
+    gpointer   v_domain)
+{
+    return ((*(gint64 *)key >> 16) == (gint64)GPOINTER_TO_UINT(v_domain));
+}
+
+/**
+ * fbIndexApplyTypeSet
+ *
+ * Adds the element described by each RFC 5610 information element type
+ * record in the data set of `len` octets at `set`, whose template is
+ * `tt`, to `model`.  Integers may use reduced-length encoding.  A
+ * truncated record is ignored, as fBufNext() would.
+ *
+ */
+static void
+fbIndexApplyTypeSet(
+    fbInfoModel_t            *model,
+    const fbIndexTypeTmpl_t  *tt,
+    const uint8_t            *set,
+    uint16_t                  len)
+{
+    const uint8_t         *cp = set + FB_INDEX_SETHDR;
+    const uint8_t         *end = set + len;
+    fbInfoElementOptRec_t  rec;
+    uint64_t               val;
+    uint16_t               i, j, flen;
+
+    /* anything shorter than a record is padding */
+    while (end - cp >= tt->minlen) {
+        memset(&rec, 0, sizeof(rec));
+        for (i = 0; i < tt->count; ++i) {
+            flen = tt->lens[i];
+            if (FB_IE_VARLEN == flen) {
+                if (end - cp < 1) {
+                    return;
+                }
+                flen = *cp++;
+                if (255 == flen) {
+                    if (end - cp < 2) {
+                        return;
+                    }
+                    flen = fbIndexReadU16(cp);
+                    cp += 2;
+                }
+            }
+            if (end - cp < flen) {
+                return;
+            }
+            if (FB_INDEX_IE_NAME == tt->nums[i]) {
+                rec.ie_name.buf = (uint8_t *)cp;
+                rec.ie_name.len = flen;
+            } else if (FB_INDEX_IE_DESC == tt->nums[i]) {
+                rec.ie_desc.buf = (uint8_t *)cp;
+                rec.ie_desc.len = flen;
+            } else {
+                val = 0;
+                for (j = 0; j < flen && j < sizeof(val); ++j) {
+                    val = (val << 8) | cp[j];
+                }
+                switch (tt->nums[i]) {
+                  case FB_INDEX_IE_PEN:
+                    rec.ie_pen = (uint32_t)val;
+                    break;
+                  case FB_INDEX_IE_ID:
+                    rec.ie_id = (uint16_t)val;
+                    break;
+                  case FB_INDEX_IE_TYPE:
+                    rec.ie_type = (uint8_t)val;
+                    break;
+                  case FB_INDEX_IE_SEM:
+                    rec.ie_semantic = (uint8_t)val;
+                    break;
+                  case FB_INDEX_IE_UNITS:
+                    rec.ie_units = (uint16_t)val;
+                    break;
+                  case FB_INDEX_IE_BEGIN:
+                    rec.ie_range_begin = val;
+                    break;
+                  case FB_INDEX_IE_END:
+                    rec.ie_range_end = val;
+                    break;
+                }
+            }
+            cp += flen;
+        }
+        fbInfoElementAddOptRecElement(model, &rec);
+    }
+}
+
+/**
+ * fbIndexScanTemplateSet
+ *
+ * Records the IDs of the templates in the template or options template
+ * set of `len` octets at `set` and, when `model` is not NULL, adds
+ * their unknown elements to it.  When `types` is not NULL, it keeps the
+ * layout of each options template for RFC 5610 information element type
+ * records, keyed by observation domain and template ID.
+ *
+ */
+static gboolean
+fbIndexScanTemplateSet(
+    fbFileIndex_t  *index,
+    fbInfoModel_t  *model,
+    GHashTable     *types,
+    uint16_t        set_id,
+    const uint8_t  *set,
+    uint16_t        len,
+    GError        **err)
+{
+    const uint8_t     *cp = set + FB_INDEX_SETHDR;
+    const uint8_t     *end = set + len;
+    fbIndexTypeTmpl_t *tt = NULL;
+    uint32_t           domain = index->msgs[index->msg_count - 1].domain;
+    gint64            *tkey;
+    gint64             key;
+    uint16_t           tid = 0;
+    uint16_t           count, num, ie_len, i;
+    uint32_t           ent;
+
+    /* anything shorter than a record header is padding */
+    while (end - cp >= 4) {
+        tid = fbIndexReadU16(cp);
+        count = fbIndexReadU16(cp + 2);
+        cp += 4;
+        fbIndexAddTid(index, tid);
+        if (types) {
+            /* a new definition replaces the old; so does a withdrawal */
+            if (FB_TID_TS == tid || FB_TID_OTS == tid) {
+                g_hash_table_foreach_remove(types, fbIndexTypeTmplForget,
+                                            GUINT_TO_POINTER(domain));
+            } else {
+                key = ((gint64)domain << 16) | tid;
+                g_hash_table_remove(types, &key);
+            }
+        }
+        if (0 == count) {
+            /* a withdrawal */
+            continue;
+        }
+        if (FB_TID_OTS == set_id) {
+            if (end - cp < 2) {
+                goto TRUNCATED;
+            }
+            cp += 2;
+            if (types) {
+                tt = g_slice_new0(fbIndexTypeTmpl_t);
+                tt->nums = g_new0(uint16_t, count);
+                tt->lens = g_new0(uint16_t, count);
+            }
+        }
+        for (i = 0; i < count; ++i) {
+            if (end - cp < 4) {
+                goto TRUNCATED;
+            }
+            num = fbIndexReadU16(cp);
+            ie_len = fbIndexReadU16(cp + 2);
+            cp += 4;
+            ent = 0;
+            if (num & IPFIX_ENTERPRISE_BIT) {
+                if (end - cp < 4) {
+                    goto TRUNCATED;
+                }
+                ent = fbIndexReadU32(cp);
+                cp += 4;
+                num &= ~IPFIX_ENTERPRISE_BIT;
+            }
+            if (model) {
+                fbIndexAddAlien(model, ent, num, ie_len);
+            }
+            if (tt) {
+                tt->nums[i] = (ent ? 0 : num);
+                tt->lens[i] = ie_len;
+                tt->minlen += ((FB_IE_VARLEN == ie_len) ? 1 : ie_len);
+                ++tt->count;
+            }
+        }
+        if (tt) {
+            if (fbIndexTypeTmplCheck(tt)) {
+                tkey = g_new(gint64, 1);
+                *tkey = ((gint64)domain << 16) | tid;
+                g_hash_table_insert(types, tkey, tt);
+            } else {
+                fbIndexTypeTmplFree(tt);
+            }
+            tt = NULL;
+        }
+    }
+    return TRUE;
+
+  TRUNCATED:
+    if (tt) {
+        fbIndexTypeTmplFree(tt);
+    }
+    g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IPFIX,
+                "Template %#06x is truncated", tid);
+    return FALSE;
+}
+
+/**
+ * fbIndexScanMessage
+ *
+ * Adds the message of `len` octets at `msg`, found at `offset` in the
+ * file, to `index`.  With `model`, also adds the elements the message's
+ * templates and RFC 5610 information element type records use to it.
+ *
+ */
+static gboolean
+fbIndexScanMessage(
+    fbFileIndex_t  *index,
+    fbInfoModel_t  *model,
+    GHashTable     *types,
+    uint64_t        offset,
+    const uint8_t  *msg,
+    uint16_t        len,
+    GError        **err)
+{
+    fbIndexMsg_t            *entry;
+    const fbIndexTypeTmpl_t *tt;
+    gint64                   key;
+    uint16_t                 off, set_id, set_len;
+
+    if (index->msg_count == index->msg_alloc) {
+        index->msg_alloc *= 2;
+        index->msgs = g_renew(fbIndexMsg_t, index->msgs, index->msg_alloc);
+    }
+    entry = &index->msgs[index->msg_count++];
+    entry->offset = offset;
+    entry->length = len;
+    entry->export_time = fbIndexReadU32(msg + 4);
+    entry->domain = fbIndexReadU32(msg + 12);
+    entry->tid_start = index->tid_count;
+    entry->tid_count = 0;
+
+    for (off = FB_INDEX_MSGHDR; len - off >= FB_INDEX_SETHDR; off += set_len) {
+        set_id = fbIndexReadU16(msg + off);
+        set_len = fbIndexReadU16(msg + off + 2);
+        if (set_len < FB_INDEX_SETHDR || set_len > len - off) {
+            g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IPFIX,
+                        "Set of length %u at offset %" G_GUINT64_FORMAT
+                        " does not fit its message",
+                        set_len, (guint64)(offset + off));
+            return FALSE;
+        }
+        if (FB_TID_TS == set_id || FB_TID_OTS == set_id) {
+            if (!fbIndexScanTemplateSet(index, model, types, set_id,
+                                        msg + off, set_len, err))
+            {
+                return FALSE;
+            }
+        } else if (types && set_id >= FB_TID_MIN_DATA) {
+            key = ((gint64)entry->domain << 16) | set_id;
+            if ((tt = g_hash_table_lookup(types, &key))) {
+                fbIndexApplyTypeSet(model, tt, msg + off, set_len);
+            }
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * fbIndexScan
+ *
+ * Builds the index of the uncompressed IPFIX file `fp`.  When `model` is
+ * not NULL, adds to it every element the file's templates use and every
+ * element its RFC 5610 information element type records describe, so
+ * that decoding the file changes nothing in the model.
+ *
+ */
+static fbFileIndex_t *
+fbIndexScan(
+    FILE           *fp,
+    fbInfoModel_t  *model,
+    GError        **err)
+{
+    fbFileIndex_t *index;
+    GHashTable    *types = NULL;
+    uint8_t       *msg;
+    uint64_t       offset = 0;
+    uint16_t       version, len;
+    size_t         rc;
+
+    index = g_slice_new0(fbFileIndex_t);
+    index->msg_alloc = FB_INDEX_INITIAL;
+    index->msgs = g_new(fbIndexMsg_t, index->msg_alloc);
+    index->tid_alloc = FB_INDEX_INITIAL;
+    index->tids = g_new(uint16_t, index->tid_alloc);
+    msg = g_malloc(FB_MSGLEN_MAX);
+    if (model) {
+        types = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free,
+                                      fbIndexTypeTmplFree);
+    }
+
+    for (;;) {
+        rc = fread(msg, 1, FB_INDEX_MSGHDR, fp);
+        if (0 == rc && feof(fp)) {
+            break;
+        }
+        if (rc < FB_INDEX_MSGHDR) {
+            goto READERR;
+        }
+        version = fbIndexReadU16(msg);
+        len = fbIndexReadU16(msg + 2);
+        if (version != 0x000A) {
+            g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IPFIX,
+                        "Illegal IPFIX Message version %#06x at offset %"
+                        G_GUINT64_FORMAT, version, (guint64)offset);
+            goto ERROR;
+        }
+        if (len < FB_INDEX_MSGHDR) {
+            g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IPFIX,
+                        "Illegal IPFIX Message length %u at offset %"
+                        G_GUINT64_FORMAT, len, (guint64)offset);
+            goto ERROR;
+        }
+        rc = fread(msg + FB_INDEX_MSGHDR, 1, len - FB_INDEX_MSGHDR, fp);
+        if (rc < (size_t)(len - FB_INDEX_MSGHDR)) {
+            goto READERR;
+        }
+        if (!fbIndexScanMessage(index, model, types, offset, msg, len, err))
+        {
+            goto ERROR;
+        }
+        offset += len;
+    }
+
+    g_free(msg);
+    if (types) {
+        g_hash_table_destroy(types);
+    }
+    index->file_size = offset;
+    return index;
+
+  READERR:
+    if (ferror(fp)) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                    "I/O error: %s", strerror(errno));
+    } else {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_EOF,
+                    "IPFIX Message at offset %" G_GUINT64_FORMAT
+                    " is truncated", (guint64)offset);
+    }
+  ERROR:
+    g_free(msg);
+    if (types) {
+        g_hash_table_destroy(types);
+    }
+    fbFileIndexFree(index);
+    return NULL;
+}
+
+/**
+ * fbIndexScanPath
+ *
+ * Builds the index of the file at `path`, which may not be compressed
+ * since the index holds offsets in the file.
+ *
+ */
+static fbFileIndex_t *
+fbIndexScanPath(
+    const char     *path,
+    fbInfoModel_t  *model,
+    GError        **err)
+{
+    fbFileIndex_t *index;
+    FILE          *fp;
+
+    fp = fopen(path, "r");
+    if (!fp) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                    "Couldn't open %s for collection: %s",
+                    path, strerror(errno));
+        return NULL;
+    }
+    if (fbCompressCodecForStream(fp) != FB_COMPRESS_NONE) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IMPL,
+                    "Cannot index compressed file %s", path);
+        fclose(fp);
+        return NULL;
+    }
+    index = fbIndexScan(fp, model, err);
+    fclose(fp);
+    if (!index) {
+        g_prefix_error(err, "%s: ", path);
+    }
+    return index;
+}
+
+/**
+ * fbIndexDefinerKey
+ *
+ */
+static gint64 *
+fbIndexDefinerKey(
+    uint32_t   domain,
+    uint16_t   tid)
+{
+    gint64 *key = g_new(gint64, 1);
+
+    *key = ((gint64)domain << 16) | tid;
+    return key;
+}
+
+/**
+ * fbIndexDefinersAlloc
+ *
+ * Returns a table that maps a (domain, template ID) key to one more than
+ * the index of the last message that defined or withdrew the template.
+ *
+ */
+static GHashTable *
+fbIndexDefinersAlloc(
+    void)
+{
+    return g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, NULL);
+}
+
+/**
+ * fbIndexDefinersAdd
+ *
+ * Updates `definers` with the templates of message `m` of `index`.
+ *
+ */
+static void
+fbIndexDefinersAdd(
+    const fbFileIndex_t  *index,
+    GHashTable           *definers,
+    uint32_t              m)
+{
+    const fbIndexMsg_t *msg = &index->msgs[m];
+    uint32_t            i;
+
+    for (i = 0; i < msg->tid_count; ++i) {
+        g_hash_table_replace(
+            definers,
+            fbIndexDefinerKey(msg->domain, index->tids[msg->tid_start + i]),
+            GUINT_TO_POINTER(m + 1));
+    }
+}
+
+/**
+ * fbIndexCompareU32
+ *
+ */
+static int
+fbIndexCompareU32(
+    const void  *a,
+    const void  *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return (x < y) ? -1 : (x > y);
+}
+
+/**
+ * fbIndexDefinersReplay
+ *
+ * Returns the sorted indexes of the messages in `definers` and sets
+ * `count` to their number.
+ *
+ */
+static uint32_t *
+fbIndexDefinersReplay(
+    GHashTable  *definers,
+    uint32_t    *count)
+{
+    GHashTableIter iter;
+    gpointer       value;
+    uint32_t      *replay;
+    uint32_t       n = 0;
+    uint32_t       i, j;
+
+    replay = g_new(uint32_t, g_hash_table_size(definers) + 1);
+    g_hash_table_iter_init(&iter, definers);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        replay[n++] = GPOINTER_TO_UINT(value) - 1;
+    }
+    qsort(replay, n, sizeof(uint32_t), fbIndexCompareU32);
+
+    /* a message may define several templates */
+    for (i = j = 0; i < n; ++i) {
+        if (0 == j || replay[j - 1] != replay[i]) {
+            replay[j++] = replay[i];
+        }
+    }
+    *count = j;
+    return replay;
+}
+
+/**
+ * fbIndexBuildPrefix
+ *
+ * Reads the messages of `index` listed in `replay` from `fd` and sets
+ * `prefix` to copies that hold only their template sets, for a range
+ * collector.  The copies have sequence number zero so the session does
+ * not report them as out of sequence.
+ *
+ */
+static gboolean
+fbIndexBuildPrefix(
+    const fbFileIndex_t  *index,
+    int                   fd,
+    const uint32_t       *replay,
+    uint32_t              replay_count,
+    uint8_t             **prefix,
+    size_t               *prefix_len,
+    GError              **err)
+{
+    const fbIndexMsg_t *msg;
+    uint8_t            *out;
+    uint8_t            *buf;
+    size_t              total = 0;
+    ssize_t             rc;
+    uint32_t            i;
+    uint16_t            off, set_id, set_len, out_len, wire_len;
+
+    for (i = 0; i < replay_count; ++i) {
+        total += index->msgs[replay[i]].length;
+    }
+    *prefix = NULL;
+    *prefix_len = 0;
+    if (0 == total) {
+        return TRUE;
+    }
+    *prefix = g_malloc(total);
+    buf = g_malloc(FB_MSGLEN_MAX);
+    out = *prefix;
+
+    for (i = 0; i < replay_count; ++i) {
+        msg = &index->msgs[replay[i]];
+        rc = pread(fd, buf, msg->length, (off_t)msg->offset);
+        if (rc != msg->length) {
+            g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                        "Couldn't read IPFIX Message at offset %"
+                        G_GUINT64_FORMAT ": %s", (guint64)msg->offset,
+                        (rc < 0) ? strerror(errno) : "short read");
+            goto ERROR;
+        }
+        /* a loaded index was not made from these bytes, so the file may
+         * have changed since; check the message before copying from it */
+        if (msg->length < FB_INDEX_MSGHDR
+            || fbIndexReadU16(buf + 2) != msg->length)
+        {
+            goto CHANGED;
+        }
+        memcpy(out, buf, FB_INDEX_MSGHDR);
+        memset(out + 8, 0, 4);
+        out_len = FB_INDEX_MSGHDR;
+        for (off = FB_INDEX_MSGHDR; msg->length - off >= FB_INDEX_SETHDR;
+             off += set_len)
+        {
+            set_id = fbIndexReadU16(buf + off);
+            set_len = fbIndexReadU16(buf + off + 2);
+            if (set_len < FB_INDEX_SETHDR || set_len > msg->length - off) {
+                goto CHANGED;
+            }
+            if (FB_TID_TS == set_id || FB_TID_OTS == set_id) {
+                memcpy(out + out_len, buf + off, set_len);
+                out_len += set_len;
+            }
+        }
+        wire_len = g_htons(out_len);
+        memcpy(out + 2, &wire_len, sizeof(wire_len));
+        out += out_len;
+    }
+
+    g_free(buf);
+    *prefix_len = out - *prefix;
+    return TRUE;
+
+  CHANGED:
+    g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                "IPFIX Message at offset %" G_GUINT64_FORMAT
+                " does not match the index; the file has changed",
+                (guint64)msg->offset);
+  ERROR:
+    g_free(buf);
+    g_free(*prefix);
+    *prefix = NULL;
+    return FALSE;
+}
+
+/**
+ * fbIndexPut
+ *
+ * Copies the `len` octets at `val` to `*cp` and advances `*cp`.
+ *
+ */
+static void
+fbIndexPut(
+    uint8_t     **cp,
+    const void   *val,
+    size_t        len)
+{
+    memcpy(*cp, val, len);
+    *cp += len;
+}
+
+/**
+ * fbIndexGet
+ *
+ * Copies `len` octets from `*cp` to `val` and advances `*cp`.
+ *
+ */
+static void
+fbIndexGet(
+    const uint8_t  **cp,
+    void            *val,
+    size_t           len)
+{
+    memcpy(val, *cp, len);
+    *cp += len;
+}
+
+fbFileIndex_t *
+fbFileIndexBuild(
+    const char  *path,
+    GError     **err)
+{
+    g_assert(path);
+    return fbIndexScanPath(path, NULL, err);
+}
+
+uint32_t
+fbFileIndexGetMessageCount(
+    const fbFileIndex_t  *index)
+{
+    return index->msg_count;
+}
+
+gboolean
+fbFileIndexSave(
+    const fbFileIndex_t  *index,
+    const char           *path,
+    GError              **err)
+{
+    const fbIndexMsg_t *msg;
+    GError             *child_err = NULL;
+    uint8_t            *buf;
+    uint8_t            *cp;
+    size_t              len;
+    uint64_t            u64;
+    uint32_t            u32;
+    uint16_t            u16;
+    uint32_t            i;
+    gboolean            ok;
+
+    len = (FB_INDEX_FILEHDR + (size_t)index->msg_count * FB_INDEX_FILEMSG
+           + (size_t)index->tid_count * sizeof(uint16_t));
+    buf = g_malloc(len);
+    cp = buf;
+
+    fbIndexPut(&cp, FB_INDEX_MAGIC, 4);
+    u32 = g_htonl(FB_INDEX_VERSION);
+    fbIndexPut(&cp, &u32, sizeof(u32));
+    u64 = GUINT64_TO_BE(index->file_size);
+    fbIndexPut(&cp, &u64, sizeof(u64));
+    u32 = g_htonl(index->msg_count);
+    fbIndexPut(&cp, &u32, sizeof(u32));
+    u32 = g_htonl(index->tid_count);
+    fbIndexPut(&cp, &u32, sizeof(u32));
+
+    for (i = 0; i < index->msg_count; ++i) {
+        msg = &index->msgs[i];
+        u64 = GUINT64_TO_BE(msg->offset);
+        fbIndexPut(&cp, &u64, sizeof(u64));
+        u32 = g_htonl(msg->export_time);
+        fbIndexPut(&cp, &u32, sizeof(u32));
+        u32 = g_htonl(msg->domain);
+        fbIndexPut(&cp, &u32, sizeof(u32));
+        u32 = g_htonl(msg->tid_start);
+        fbIndexPut(&cp, &u32, sizeof(u32));
+        u16 = g_htons(msg->length);
+        fbIndexPut(&cp, &u16, sizeof(u16));
+        u16 = g_htons(msg->tid_count);
+        fbIndexPut(&cp, &u16, sizeof(u16));
+    }
+    for (i = 0; i < index->tid_count; ++i) {
+        u16 = g_htons(index->tids[i]);
+        fbIndexPut(&cp, &u16, sizeof(u16));
+    }
+
+    ok = g_file_set_contents(path, (const gchar *)buf, len, &child_err);
+    g_free(buf);
+    if (!ok) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                    "Couldn't write index %s: %s", path, child_err->message);
+        g_clear_error(&child_err);
+    }
+    return ok;
+}
+
+fbFileIndex_t *
+fbFileIndexLoad(
+    const char  *path,
+    GError     **err)
+{
+    fbFileIndex_t *index;
+    fbIndexMsg_t  *msg;
+    GError        *child_err = NULL;
+    gchar         *contents;
+    gsize          len;
+    const uint8_t *cp;
+    uint64_t       u64;
+    uint64_t       end = 0;
+    uint32_t       u32;
+    uint16_t       u16;
+    uint32_t       i;
+
+    if (!g_file_get_contents(path, &contents, &len, &child_err)) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                    "Couldn't read index %s: %s", path, child_err->message);
+        g_clear_error(&child_err);
+        return NULL;
+    }
+    cp = (const uint8_t *)contents;
+    if (len < FB_INDEX_FILEHDR || memcmp(cp, FB_INDEX_MAGIC, 4) != 0) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                    "%s is not a libfixbuf message index", path);
+        g_free(contents);
+        return NULL;
+    }
+    cp += 4;
+    fbIndexGet(&cp, &u32, sizeof(u32));
+    if (g_ntohl(u32) != FB_INDEX_VERSION) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                    "Message index %s has unsupported version %u",
+                    path, g_ntohl(u32));
+        g_free(contents);
+        return NULL;
+    }
+
+    index = g_slice_new0(fbFileIndex_t);
+    fbIndexGet(&cp, &u64, sizeof(u64));
+    index->file_size = GUINT64_FROM_BE(u64);
+    fbIndexGet(&cp, &u32, sizeof(u32));
+    index->msg_count = g_ntohl(u32);
+    fbIndexGet(&cp, &u32, sizeof(u32));
+    index->tid_count = g_ntohl(u32);
+    if (len != (FB_INDEX_FILEHDR
+                + (uint64_t)index->msg_count * FB_INDEX_FILEMSG
+                + (uint64_t)index->tid_count * sizeof(uint16_t)))
+    {
+        goto CORRUPT;
+    }
+    index->msg_alloc = MAX(index->msg_count, 1);
+    index->msgs = g_new(fbIndexMsg_t, index->msg_alloc);
+    index->tid_alloc = MAX(index->tid_count, 1);
+    index->tids = g_new(uint16_t, index->tid_alloc);
+
+    for (i = 0; i < index->msg_count; ++i) {
+        msg = &index->msgs[i];
+        fbIndexGet(&cp, &u64, sizeof(u64));
+        msg->offset = GUINT64_FROM_BE(u64);
+        fbIndexGet(&cp, &u32, sizeof(u32));
+        msg->export_time = g_ntohl(u32);
+        fbIndexGet(&cp, &u32, sizeof(u32));
+        msg->domain = g_ntohl(u32);
+        fbIndexGet(&cp, &u32, sizeof(u32));
+        msg->tid_start = g_ntohl(u32);
+        fbIndexGet(&cp, &u16, sizeof(u16));
+        msg->length = g_ntohs(u16);
+        fbIndexGet(&cp, &u16, sizeof(u16));
+        msg->tid_count = g_ntohs(u16);
+        /* messages must be contiguous and their template IDs present */
+        if (msg->offset != end || msg->length < FB_INDEX_MSGHDR
+            || msg->tid_start > index->tid_count
+            || msg->tid_count > index->tid_count - msg->tid_start)
+        {
+            goto CORRUPT;
+        }
+        end += msg->length;
+    }
+    if (end != index->file_size) {
+        goto CORRUPT;
+    }
+    for (i = 0; i < index->tid_count; ++i) {
+        fbIndexGet(&cp, &u16, sizeof(u16));
+        index->tids[i] = g_ntohs(u16);
+    }
+
+    g_free(contents);
+    return index;
+
+  CORRUPT:
+    g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                "Message index %s is corrupt", path);
+    g_free(contents);
+    fbFileIndexFree(index);
+    return NULL;
+}
+
+void
+fbFileIndexFree(
+    fbFileIndex_t  *index)
+{
+    if (index) {
+        g_free(index->msgs);
+        g_free(index->tids);
+        g_slice_free(fbFileIndex_t, index);
+    }
+}
+
+fbCollector_t *
+fbCollectorAllocFileTimeRange(
+    void                 *ctx,
+    const char           *path,
+    const fbFileIndex_t  *index,
+    uint32_t              start_time,
+    uint32_t              end_time,
+    GError              **err)
+{
+    fbCollector_t *collector;
+    GHashTable    *definers;
+    struct stat    st;
+    uint32_t      *replay;
+    uint32_t       replay_count;
+    uint8_t       *prefix;
+    size_t         prefix_len;
+    uint32_t       first, last;
+    uint64_t       offset, length;
+    int            fd;
+    gboolean       ok;
+
+    g_assert(path);
+    g_assert(index);
+
+    fd = open(path, O_RDONLY);
+    if (-1 == fd) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                    "Couldn't open %s for collection: %s",
+                    path, strerror(errno));
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size != index->file_size) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                    "Message index does not match %s", path);
+        close(fd);
+        return NULL;
+    }
+
+    /* the range starts at the first message at or after start_time and
+     * ends before the next message later than end_time */
+    definers = fbIndexDefinersAlloc();
+    for (first = 0; first < index->msg_count; ++first) {
+        if (index->msgs[first].export_time >= start_time) {
+            break;
+        }
+        fbIndexDefinersAdd(index, definers, first);
+    }
+    for (last = first; last < index->msg_count; ++last) {
+        if (index->msgs[last].export_time > end_time) {
+            break;
+        }
+    }
+    offset = ((first < index->msg_count)
+              ? index->msgs[first].offset : index->file_size);
+    length = ((last < index->msg_count)
+              ? index->msgs[last].offset : index->file_size) - offset;
+
+    replay = fbIndexDefinersReplay(definers, &replay_count);
+    g_hash_table_destroy(definers);
+    ok = fbIndexBuildPrefix(index, fd, replay, replay_count,
+                            &prefix, &prefix_len, err);
+    g_free(replay);
+    close(fd);
+    if (!ok) {
+        return NULL;
+    }
+
+    collector = fbCollectorAllocFileRange(ctx, path, offset, length,
+                                          prefix, prefix_len, err);
+    if (!collector) {
+        g_free(prefix);
+    }
+    return collector;
+}
+
+/**
+ * fbParallelReaderSplit
+ *
+ * Divides the messages of the reader's index into chunks of about
+ * `chunk_size` octets and finds the templates that precede each chunk.
+ *
+ */
+static void
+fbParallelReaderSplit(
+    fbParallelReader_t  *reader,
+    uint64_t             chunk_size)
+{
+    const fbFileIndex_t *index = reader->index;
+    fbParallelChunk_t   *chunk = NULL;
+    GHashTable          *definers;
+    unsigned int         alloc = 16;
+    uint32_t             m;
+
+    reader->chunks = g_new0(fbParallelChunk_t, alloc);
+    definers = fbIndexDefinersAlloc();
+
+    for (m = 0; m < index->msg_count; ++m) {
+        if (NULL == chunk
+            || (index->msgs[m].offset - index->msgs[chunk->first].offset
+                >= chunk_size))
+        {
+            if (chunk) {
+                chunk->last = m;
+            }
+            if (reader->chunk_count == alloc) {
+                alloc *= 2;
+                reader->chunks = g_renew(fbParallelChunk_t, reader->chunks,
+                                         alloc);
+            }
+            chunk = &reader->chunks[reader->chunk_count++];
+            memset(chunk, 0, sizeof(*chunk));
+            chunk->first = m;
+            chunk->replay = fbIndexDefinersReplay(definers,
+                                                  &chunk->replay_count);
+        }
+        fbIndexDefinersAdd(index, definers, m);
+    }
+    if (chunk) {
+        chunk->last = m;
+    }
+
+    g_hash_table_destroy(definers);
+}
+
+fbParallelReader_t *
+fbParallelReaderAlloc(
+    const char   *path,
+    fbSession_t  *session,
+    uint64_t      chunk_size,
+    GError      **err)
+{
+    fbParallelReader_t *reader;
+    fbFileIndex_t      *index;
+
+    g_assert(path);
+    g_assert(session);
+
+    index = fbIndexScanPath(path, fbSessionGetInfoModel(session), err);
+    if (!index) {
+        return NULL;
+    }
+
+    reader = g_slice_new0(fbParallelReader_t);
+    reader->fd = open(path, O_RDONLY);
+    if (-1 == reader->fd) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                    "Couldn't open %s for collection: %s",
+                    path, strerror(errno));
+        fbFileIndexFree(index);
+        g_slice_free(fbParallelReader_t, reader);
+        return NULL;
+    }
+    reader->path = g_strdup(path);
+    reader->session = session;
+    reader->index = index;
+    fbParallelReaderSplit(reader, chunk_size ? chunk_size : 1);
+
+    return reader;
+}
+
+unsigned int
+fbParallelReaderGetChunkCount(
+    fbParallelReader_t  *reader)
+{
+    return reader->chunk_count;
+}
+
+void
+fbParallelReaderFree(
+    fbParallelReader_t  *reader)
+{
+    unsigned int i;
+
+    if (NULL == reader) {
+        return;
+    }
+    for (i = 0; i < reader->chunk_count; ++i) {
+        g_free(reader->chunks[i].replay);
+    }
+    g_free(reader->chunks);
+    fbFileIndexFree(reader->index);
+    close(reader->fd);
+    g_free(reader->path);
+    g_slice_free(fbParallelReader_t, reader);
+}
+
+/**
+ * fbParallelDecodeChunk
+ *
+ * Gives the application an fBuf that reads chunk `c`, preceded by the
+ * templates in effect at its start.
+ *
+ */
+static gboolean
+fbParallelDecodeChunk(
+    fbParallelRun_t  *run,
+    unsigned int      c,
+    void            **result,
+    GError          **err)
+{
+    fbParallelReader_t      *reader = run->reader;
+    const fbParallelChunk_t *chunk = &reader->chunks[c];
+    const fbIndexMsg_t      *last;
+    fbCollector_t           *collector;
+    fbSession_t             *session;
+    fBuf_t                  *fbuf;
+    uint8_t                 *prefix;
+    size_t                   prefix_len;
+    uint64_t                 offset;
+    uint64_t                 length;
+    gboolean                 ok;
+
+    if (!fbIndexBuildPrefix(reader->index, reader->fd, chunk->replay,
+                            chunk->replay_count, &prefix, &prefix_len, err))
+    {
+        return FALSE;
+    }
+    last = &reader->index->msgs[chunk->last - 1];
+    offset = reader->index->msgs[chunk->first].offset;
+    length = last->offset + last->length - offset;
+    collector = fbCollectorAllocFileRange(NULL, reader->path, offset, length,
+                                          prefix, prefix_len, err);
+    if (!collector) {
+        g_free(prefix);
+        return FALSE;
+    }
+
+    /* cloning marks the model session's template table as shared */
+    pthread_mutex_lock(&run->mutex);
+    session = fbSessionClone(reader->session);
+    pthread_mutex_unlock(&run->mutex);
+
+    fbuf = fBufAllocForCollection(session, collector);
+    /* the scan added the elements of the type records to the model */
+    fBufSetSharedInfoModel(fbuf);
+    *result = NULL;
+    ok = run->decode(fbuf, c, run->app_ctx, result, err);
+    fBufFree(fbuf);
+    return ok;
+}
+
+/**
+ * fbParallelDeliverReady
+ *
+ * Delivers decoded results in chunk order until reaching a chunk that is
+ * not finished.  Called and returns with the run's mutex held; only one
+ * worker delivers at a time, and it releases the mutex while the
+ * application handles each result.
+ *
+ */
+static void
+fbParallelDeliverReady(
+    fbParallelRun_t  *run)
+{
+    unsigned int c;
+    void        *result;
+
+    if (run->delivering) {
+        return;
+    }
+    run->delivering = TRUE;
+    while (run->next_deliver < run->reader->chunk_count
+           && run->done[run->next_deliver])
+    {
+        c = run->next_deliver++;
+        result = run->results[c];
+        pthread_mutex_unlock(&run->mutex);
+        run->deliver(c, result, run->app_ctx);
+        pthread_mutex_lock(&run->mutex);
+    }
+    run->delivering = FALSE;
+}
+
+/**
+ * fbParallelWorker
+ *
+ * The body of each worker thread: decodes chunks until none remain or a
+ * chunk fails.
+ *
+ */
+static void *
+fbParallelWorker(
+    void  *arg)
+{
+    fbParallelRun_t *run = (fbParallelRun_t *)arg;
+    GError          *err = NULL;
+    void            *result;
+    unsigned int     c;
+
+    pthread_mutex_lock(&run->mutex);
+    while (!run->error && run->next_chunk < run->reader->chunk_count) {
+        c = run->next_chunk++;
+        pthread_mutex_unlock(&run->mutex);
+
+        if (!fbParallelDecodeChunk(run, c, &result, &err)) {
+            pthread_mutex_lock(&run->mutex);
+            if (run->error) {
+                g_clear_error(&err);
+            } else {
+                if (NULL == err) {
+                    g_set_error(&err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                                "Decoding chunk %u failed", c);
+                }
+                run->error = err;
+                err = NULL;
+            }
+            break;
+        }
+
+        if (!run->ordered) {
+            /* deliver in any order, but one result at a time; the other
+             * workers keep decoding meanwhile */
+            pthread_mutex_lock(&run->deliver_mutex);
+            run->deliver(c, result, run->app_ctx);
+            pthread_mutex_unlock(&run->deliver_mutex);
+            pthread_mutex_lock(&run->mutex);
+            continue;
+        }
+        pthread_mutex_lock(&run->mutex);
+        run->results[c] = result;
+        run->done[c] = TRUE;
+        fbParallelDeliverReady(run);
+    }
+    pthread_mutex_unlock(&run->mutex);
+    return NULL;
+}
+
+gboolean
+fbParallelReaderRun(
+    fbParallelReader_t    *reader,
+    unsigned int           threads,
+    gboolean               ordered,
+    fbParallelDecode_fn    decode,
+    fbParallelDeliver_fn   deliver,
+    void                  *app_ctx,
+    GError               **err)
+{
+    fbParallelRun_t run;
+    pthread_t      *tids;
+    unsigned int    started;
+    unsigned int    c;
+    long            ncpu;
+    int             rv;
+
+    g_assert(reader);
+    g_assert(decode);
+    g_assert(deliver);
+
+    if (0 == threads) {
+        ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (ncpu > 0) ? (unsigned int)ncpu : 1;
+    }
+    if (threads > reader->chunk_count) {
+        threads = MAX(reader->chunk_count, 1);
+    }
+
+    memset(&run, 0, sizeof(run));
+    run.reader = reader;
+    run.decode = decode;
+    run.deliver = deliver;
+    run.app_ctx = app_ctx;
+    run.ordered = ordered;
+    pthread_mutex_init(&run.mutex, NULL);
+    pthread_mutex_init(&run.deliver_mutex, NULL);
+    if (ordered) {
+        run.results = g_new0(void *, reader->chunk_count + 1);
+        run.done = g_new0(gboolean, reader->chunk_count + 1);
+    }
+
+    tids = g_new(pthread_t, threads);
+    for (started = 0; started < threads; ++started) {
+        rv = pthread_create(&tids[started], NULL, fbParallelWorker, &run);
+        if (rv != 0) {
+            if (0 == started) {
+                g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                            "Couldn't start worker thread: %s",
+                            strerror(rv));
+                g_free(tids);
+                g_free(run.results);
+                g_free(run.done);
+                pthread_mutex_destroy(&run.mutex);
+                pthread_mutex_destroy(&run.deliver_mutex);
+                return FALSE;
+            }
+            /* carry on with the workers already running */
+            break;
+        }
+    }
+    for (c = 0; c < started; ++c) {
+        pthread_join(tids[c], NULL);
+    }
+    g_free(tids);
+
+    if (ordered) {
+        /* after a failure, hand over any result left behind a gap so the
+         * application can release it */
+        for (c = run.next_deliver; c < reader->chunk_count; ++c) {
+            if (run.done[c]) {
+                deliver(c, run.results[c], app_ctx);
+            }
+        }
+        g_free(run.results);
+        g_free(run.done);
+    }
+    pthread_mutex_destroy(&run.mutex);
+    pthread_mutex_destroy(&run.deliver_mutex);
+
+    if (run.error) {
+        g_propagate_error(err, run.error);
+        return FALSE;
+    }
+    return TRUE;
+}
@@ -107,6 +107,21 @@ struct fbListener_st {
     int                    lsock;
     /** mode (-1 for udp) */
     int                    mode;
+    /**
+     * Whether the passive sockets are bound with SO_REUSEPORT so that
+     * several listeners (shards) can share one port.  Set by
+     * fbListenerAllocShards().
+     */
+    gboolean               reuseport;
+    /**
+     * Size of the read-ahead buffer given to each TCP collector; 0 for
+     * unbuffered reads.  Set by fbListenerSetTCPReadBuffer().
+     */
+    size_t                 tcp_rbuf_size;
+    /**
+     * I/O backend of each TCP collector.  Set by fbListenerSetIOBackend().
+     */
+    fbIOBackend_t          io_backend;
     /**
      * Interrupt pipe read end file descriptor.
      * Used to unblock a call to fbListenerWait().
@@ -262,6 +277,16 @@ fbListenerInitSocket(
         if (cpfd->fd < 0) {
             i++; continue;
         }
+#ifdef SO_REUSEPORT
+        if (listener->reuseport) {
+            int on = 1;
+            if (setsockopt(cpfd->fd, SOL_SOCKET, SO_REUSEPORT,
+                           &on, sizeof(on)) == -1)
+            {
+                close(cpfd->fd); cpfd->fd = -1; i++; continue;
+            }
+        }
+#endif /* ifdef SO_REUSEPORT */
         if (bind(cpfd->fd, ai->ai_addr, ai->ai_addrlen) == -1) {
             close(cpfd->fd); cpfd->fd = -1; i++; continue;
         }
@@ -371,18 +396,19 @@ fbListenerInitUDPSocket(
 }
 
 /**
- * fbListenerAlloc
- *
- *
+ * fbListenerAllocHelper
  *
+ * Implements fbListenerAlloc().  When `reuseport` is TRUE, the passive
+ * sockets are bound with SO_REUSEPORT.
  *
  */
-fbListener_t *
-fbListenerAlloc(
+static fbListener_t *
+fbListenerAllocHelper(
     fbConnSpec_t          *spec,
     fbSession_t           *session,
     fbListenerAppInit_fn   appinit,
     fbListenerAppFree_fn   appfree,
+    gboolean               reuseport,
     GError               **err)
 {
     fbListener_t *listener = NULL;
@@ -402,6 +428,7 @@ fbListenerAlloc(
     listener->lsock = -1;
     listener->rip = -1;
     listener->wip = -1;
+    listener->reuseport = reuseport;
 
     if (ownSocket) { /* user handling own socket creation and connections */
         listener->spec = NULL;
@@ -480,6 +507,80 @@ fbListenerAlloc(
     return NULL;
 }
 
+/**
+ * fbListenerAlloc
+ *
+ *
+ *
+ *
+ */
+fbListener_t *
+fbListenerAlloc(
+    fbConnSpec_t          *spec,
+    fbSession_t           *session,
+    fbListenerAppInit_fn   appinit,
+    fbListenerAppFree_fn   appfree,
+    GError               **err)
+{
+    return fbListenerAllocHelper(spec, session, appinit, appfree, FALSE, err);
+}
+
+/**
+ * fbListenerAllocShards
+ *
+ *
+ *
+ *
+ */
+gboolean
+fbListenerAllocShards(
+    fbConnSpec_t          *spec,
+    fbSession_t           *session,
+    fbListenerAppInit_fn   appinit,
+    fbListenerAppFree_fn   appfree,
+    unsigned int           count,
+    fbListener_t         **shards,
+    GError               **err)
+{
+#ifdef SO_REUSEPORT
+    unsigned int i;
+#endif
+
+    g_assert(spec);
+    g_assert(shards);
+
+    if (spec->transport != FB_UDP) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IMPL,
+                    "Sharded listeners are only supported for UDP");
+        return FALSE;
+    }
+    if (0 == count) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_SETUP,
+                    "Sharded listener requires at least one shard");
+        return FALSE;
+    }
+#ifndef SO_REUSEPORT
+    g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IMPL,
+                "Sharded listeners require SO_REUSEPORT, which is not"
+                " available on this platform");
+    return FALSE;
+#else
+    for (i = 0; i < count; ++i) {
+        shards[i] = fbListenerAllocHelper(spec, session, appinit, appfree,
+                                          TRUE, err);
+        if (NULL == shards[i]) {
+            while (i > 0) {
+                --i;
+                fbListenerFree(shards[i]);
+                shards[i] = NULL;
+            }
+            return FALSE;
+        }
+    }
+    return TRUE;
+#endif  /* SO_REUSEPORT */
+}
+
 
 /**
  * fbListenerFreeBuffer
@@ -668,6 +769,31 @@ fbListenerAddPollFD(
     }
 }
 
+/**
+ * fbListenerSetupCollectorTCP
+ *
+ * Applies the listener's read-ahead buffer size and I/O backend to a new
+ * TCP collector.
+ *
+ */
+static void
+fbListenerSetupCollectorTCP(
+    fbListener_t   *listener,
+    fbCollector_t  *collector)
+{
+    GError *err = NULL;
+
+    if (listener->tcp_rbuf_size) {
+        fbCollectorSetTCPReadBuffer(collector, listener->tcp_rbuf_size, NULL);
+    }
+    if (listener->io_backend != FB_IO_SYSCALL &&
+        !fbCollectorSetIOBackend(collector, listener->io_backend, &err))
+    {
+        g_warning("Unable to set collector I/O backend: %s", err->message);
+        g_clear_error(&err);
+    }
+}
+
 /**
  * fbListenerWaitAccept
  *
@@ -719,6 +845,9 @@ fbListenerWaitAccept(
       case FB_TCP:
         collector = fbCollectorAllocSocket(listener, ctx, asock,
                                            &(peer.so), peerlen, err);
+        if (collector && listener->spec->transport == FB_TCP) {
+            fbListenerSetupCollectorTCP(listener, collector);
+        }
         break;
 #if HAVE_OPENSSL
 #if HAVE_OPENSSL_DTLS_SCTP
@@ -795,6 +924,45 @@ fbListenerRemove(
     }
 }
 
+/**
+ * fbListenerFindPending
+ *
+ * Returns the buffer of a collector of `listener` that holds messages it
+ * has already received, which poll() cannot report, or NULL if none does.
+ * The collector read last is checked first.  The buffer found becomes the
+ * listener's last buffer.
+ *
+ */
+static fBuf_t *
+fbListenerFindPending(
+    fbListener_t  *listener)
+{
+    GHashTableIter iter;
+    gpointer       key;
+    gpointer       value;
+
+    if (listener->lastbuf &&
+        fbCollectorHasPendingMessages(fBufGetCollector(listener->lastbuf)))
+    {
+        return listener->lastbuf;
+    }
+    g_hash_table_iter_init(&iter, listener->fdtab);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        if (value != listener->lastbuf &&
+            fbCollectorHasPendingMessages(fBufGetCollector((fBuf_t *)value)))
+        {
+            listener->lsock = GPOINTER_TO_INT(key);
+            listener->lastbuf = (fBuf_t *)value;
+            if (listener->mode < 0) {
+                fbCollectorSetFD(fBufGetCollector(listener->lastbuf),
+                                 listener->lsock);
+            }
+            return listener->lastbuf;
+        }
+    }
+    return NULL;
+}
+
 /**
  * fbListenerWait
  *
@@ -813,6 +981,13 @@ fbListenerWait(
     int          rc;
     unsigned int i;
 
+    /* a batched UDP collector, buffered TCP collector, or read-ahead
+     * thread may hold messages that the socket will not report as
+     * readable */
+    if ((fbuf = fbListenerFindPending(listener))) {
+        return fbuf;
+    }
+
     /* wait for data available on one of our file descriptors */
     rc = poll(listener->pfd_array, listener->pfd_len, -1);
 
@@ -1011,6 +1186,36 @@ fbListenerGetConnSpec(
 }
 
 
+/**
+ * fbListenerSetTCPReadBuffer
+ *
+ *
+ *
+ *
+ */
+void
+fbListenerSetTCPReadBuffer(
+    fbListener_t  *listener,
+    size_t         size)
+{
+    listener->tcp_rbuf_size = size;
+}
+
+/**
+ * fbListenerSetIOBackend
+ *
+ *
+ *
+ *
+ */
+void
+fbListenerSetIOBackend(
+    fbListener_t   *listener,
+    fbIOBackend_t   backend)
+{
+    listener->io_backend = backend;
+}
+
 /**
  * fbListenerGetCollector
  *
@@ -1222,6 +1427,16 @@ fbListenerGroupWait(
 
     g_assert(group);
 
+    /* a batched UDP collector, buffered TCP collector, or read-ahead
+     * thread may hold messages that the socket will not report as
+     * readable */
+    for (entry = group->head; entry; entry = entry->next) {
+        if (fbListenerFindPending(entry->listener)) {
+            result = fbListenerNewResult(&resultHead, entry->listener);
+            group->lastlist = entry;
+        }
+    }
+
     /* wait for data available on one of our file descriptors */
 
     while (!resultHead) {
@@ -1385,6 +1600,7 @@ fbListenerOwnSocketCollectorTCP(
     if (!collector) {
         return NULL;
     }
+    fbListenerSetupCollectorTCP(listener, collector);
 
     fbuf = fBufAllocForCollection(fbSessionClone(listener->session), collector);
 
@@ -0,0 +1,324 @@
+/*
+ *  Copyright 2006-2025 Carnegie Mellon University
+ *  See license information in LICENSE.txt.
+ */
+/**
+ *  @file fbmsgbuf.c
+ *  Reference-counted IPFIX message buffers and buffer pools
+ */
+/*
+ *  ------------------------------------------------------------------------
+ *  @DISTRIBUTION_STATEMENT_BEGIN@
+ *  libfixbuf 2.5
+ *
+ *  Copyright 2024 Carnegie Mellon University.
+ *
+ *  NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ *  INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ *  UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR
+ *  IMPLIED, AS TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF
+ *  FITNESS FOR PURPOSE OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS
+ *  OBTAINED FROM USE OF THE MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT
+ *  MAKE ANY WARRANTY OF ANY KIND WITH RESPECT TO FREEDOM FROM PATENT,
+ *  TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ *
+ *  Licensed under a GNU-Lesser GPL 3.0-style license, please see
+ *  LICENSE.txt or contact permission@sei.cmu.edu for full terms.
+ *
+ *  [DISTRIBUTION STATEMENT A] This material has been approved for public
+ *  release and unlimited distribution.  Please see Copyright notice for
+ *  non-US Government use and distribution.
+ *
+ *  This Software includes and/or makes use of Third-Party Software each
+ *  subject to its own license.
+ *
+ *  DM24-1020
+ *  @DISTRIBUTION_STATEMENT_END@
+ *  ------------------------------------------------------------------------
+ */
+
+#define _FIXBUF_SOURCE_
+#include <fixbuf/private.h>
+#include <pthread.h>
+
+
+/*
+ *  A message buffer is a block of memory that holds IPFIX Messages for an
+ *  fBuf.  Each buffer carries a reference count so it can be handed from
+ *  one thread to another, and most buffers come from a pool that keeps
+ *  released buffers of one size for reuse.  A buffer that is not from a
+ *  pool is freed when its last reference is dropped.
+ */
+
+/** Bounds on the size of a buffer in a pool. */
+#define FB_MSGBUF_SIZE_MIN      32
+#define FB_MSGBUF_SIZE_MAX      (FB_MSGLEN_MAX + 1)
+
+/** Default number of released buffers a pool keeps. */
+#define FB_MSGBUF_IDLE_DEFAULT  64
+
+struct fbMessageBuffer_st {
+    /** Pool the buffer returns to; NULL if allocated on its own. */
+    fbBufferPool_t     *pool;
+    /** Next buffer on the pool's idle list. */
+    fbMessageBuffer_t  *next;
+    /** The octets of the buffer; follows this structure in memory. */
+    uint8_t            *data;
+    /** Number of octets in data. */
+    size_t              capacity;
+    /** Number of octets of data that hold messages. */
+    size_t              length;
+    /** Reference count. */
+    volatile gint       refcount;
+};
+
+struct fbBufferPool_st {
+    /** Protects idle and idle_count. */
+    pthread_mutex_t     lock;
+    /** Released buffers ready for reuse. */
+    fbMessageBuffer_t  *idle;
+    /** Number of buffers on idle. */
+    unsigned int        idle_count;
+    /** Most buffers to keep on idle. */
+    unsigned int        max_idle;
+    /** Size of every buffer in the pool. */
+    size_t              buffer_size;
+    /** References held by the application, fBufs, and buffers. */
+    volatile gint       refcount;
+};
+
+
+/**
+ * fbMessageBufferNew
+ *
+ * Allocates a buffer with room for `capacity` octets, holding one
+ * reference.
+ *
+ */
+static fbMessageBuffer_t *
+fbMessageBufferNew(
+    fbBufferPool_t  *pool,
+    size_t           capacity)
+{
+    fbMessageBuffer_t *msgbuf;
+
+    msgbuf = (fbMessageBuffer_t *)g_malloc(sizeof(*msgbuf) + capacity);
+    msgbuf->pool = pool;
+    msgbuf->next = NULL;
+    msgbuf->data = (uint8_t *)(msgbuf + 1);
+    msgbuf->capacity = capacity;
+    msgbuf->length = 0;
+    msgbuf->refcount = 1;
+
+    return msgbuf;
+}
+
+
+/**
+ * fbBufferPoolUnref
+ *
+ * Drops a reference to `pool`, freeing it and its idle buffers when the
+ * last reference goes.
+ *
+ */
+static void
+fbBufferPoolUnref(
+    fbBufferPool_t  *pool)
+{
+    fbMessageBuffer_t *msgbuf;
+
+    if (!g_atomic_int_dec_and_test(&pool->refcount)) {
+        return;
+    }
+    while (pool->idle) {
+        msgbuf = pool->idle;
+        pool->idle = msgbuf->next;
+        g_free(msgbuf);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    g_slice_free(fbBufferPool_t, pool);
+}
+
+
+fbBufferPool_t *
+fbBufferPoolAlloc(
+    size_t         buffer_size,
+    unsigned int   max_idle,
+    GError       **err)
+{
+    fbBufferPool_t *pool;
+
+    if (buffer_size < FB_MSGBUF_SIZE_MIN || buffer_size > FB_MSGBUF_SIZE_MAX) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_BUFSZ,
+                    "Message buffer size %lu is outside the range %u-%u",
+                    (unsigned long)buffer_size, FB_MSGBUF_SIZE_MIN,
+                    FB_MSGBUF_SIZE_MAX);
+        return NULL;
+    }
+
+    pool = g_slice_new0(fbBufferPool_t);
+    pthread_mutex_init(&pool->lock, NULL);
+    pool->buffer_size = buffer_size;
+    pool->max_idle = max_idle ? max_idle : FB_MSGBUF_IDLE_DEFAULT;
+    pool->refcount = 1;
+
+    return pool;
+}
+
+
+void
+fbBufferPoolFree(
+    fbBufferPool_t  *pool)
+{
+    if (pool) {
+        fbBufferPoolUnref(pool);
+    }
+}
+
+
+fbBufferPool_t *
+fbBufferPoolRef(
+    fbBufferPool_t  *pool)
+{
+    g_atomic_int_inc(&pool->refcount);
+    return pool;
+}
+
+
+size_t
+fbBufferPoolGetBufferSize(
+    const fbBufferPool_t  *pool)
+{
+    return pool->buffer_size;
+}
+
+
+fbMessageBuffer_t *
+fbMessageBufferAlloc(
+    fbBufferPool_t  *pool)
+{
+    fbMessageBuffer_t *msgbuf;
+
+    pthread_mutex_lock(&pool->lock);
+    msgbuf = pool->idle;
+    if (msgbuf) {
+        pool->idle = msgbuf->next;
+        --pool->idle_count;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (msgbuf) {
+        msgbuf->next = NULL;
+        msgbuf->length = 0;
+        msgbuf->refcount = 1;
+    } else {
+        msgbuf = fbMessageBufferNew(pool, pool->buffer_size);
+    }
+    fbBufferPoolRef(pool);
+
+    return msgbuf;
+}
+
+
+fbMessageBuffer_t *
+fbMessageBufferAllocSize(
+    size_t   capacity)
+{
+    return fbMessageBufferNew(NULL, capacity);
+}
+
+
+fbMessageBuffer_t *
+fbMessageBufferRef(
+    fbMessageBuffer_t  *msgbuf)
+{
+    g_atomic_int_inc(&msgbuf->refcount);
+    return msgbuf;
+}
+
+
+void
+fbMessageBufferUnref(
+    fbMessageBuffer_t  *msgbuf)
+{
+    fbBufferPool_t *pool;
+
+    if (NULL == msgbuf || !g_atomic_int_dec_and_test(&msgbuf->refcount)) {
+        return;
+    }
+
+    pool = msgbuf->pool;
+    if (NULL == pool) {
+        g_free(msgbuf);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->idle_count < pool->max_idle) {
+        msgbuf->next = pool->idle;
+        pool->idle = msgbuf;
+        ++pool->idle_count;
+        msgbuf = NULL;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    g_free(msgbuf);
+    fbBufferPoolUnref(pool);
+}
+
+
+gboolean
+fbMessageBufferIsShared(
+    fbMessageBuffer_t  *msgbuf)
+{
+    return (g_atomic_int_get(&msgbuf->refcount) > 1);
+}
+
+
+fbBufferPool_t *
+fbMessageBufferGetPool(
+    const fbMessageBuffer_t  *msgbuf)
+{
+    return msgbuf->pool;
+}
+
+
+uint8_t *
+fbMessageBufferGetData(
+    fbMessageBuffer_t  *msgbuf)
+{
+    return msgbuf->data;
+}
+
+
+size_t
+fbMessageBufferGetCapacity(
+    const fbMessageBuffer_t  *msgbuf)
+{
+    return msgbuf->capacity;
+}
+
+
+size_t
+fbMessageBufferGetLength(
+    const fbMessageBuffer_t  *msgbuf)
+{
+    return msgbuf->length;
+}
+
+
+gboolean
+fbMessageBufferSetLength(
+    fbMessageBuffer_t  *msgbuf,
+    size_t              length,
+    GError            **err)
+{
+    if (length > msgbuf->capacity) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_BUFSZ,
+                    "Length %lu exceeds message buffer capacity %lu",
+                    (unsigned long)length, (unsigned long)msgbuf->capacity);
+        return FALSE;
+    }
+    msgbuf->length = length;
+    return TRUE;
+}
@@ -1480,9 +1480,17 @@ fbCollectorSetNetflowV9Translator(
     GError        **err)
 {
     GHashTable *hashTable = NULL;
-    struct fbCollectorNetflowV9State_st *nflowState =
-        g_malloc(sizeof(struct fbCollectorNetflowV9State_st));
+    struct fbCollectorNetflowV9State_st *nflowState = NULL;
 
+    /* the V9 length function reads the stream itself */
+    if (collector->compress) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IMPL,
+                    "Netflow V9 translation of compressed files is not"
+                    " supported");
+        return FALSE;
+    }
+
+    nflowState = g_malloc(sizeof(struct fbCollectorNetflowV9State_st));
     if (NULL == nflowState) {
         g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_TRANSMISC,
                     "failure to allocate Netflow V9 translator state");
@@ -0,0 +1,578 @@
+/*
+ *  Copyright 2006-2025 Carnegie Mellon University
+ *  See license information in LICENSE.txt.
+ */
+/**
+ *  @file fbpartition.c
+ *  Hash-partitioned export of records to several exporters
+ */
+/*
+ *  ------------------------------------------------------------------------
+ *  @DISTRIBUTION_STATEMENT_BEGIN@
+ *  libfixbuf 2.5
+ *
+ *  Copyright 2024 Carnegie Mellon University.
+ *
+ *  NO WARRANTY. THIS CARNEGIE MELLON UNIVERSITY AND SOFTWARE ENGINEERING
+ *  INSTITUTE MATERIAL IS FURNISHED ON AN "AS-IS" BASIS. CARNEGIE MELLON
+ *  UNIVERSITY MAKES NO WARRANTIES OF ANY KIND, EITHER EXPRESSED OR
+ *  IMPLIED, AS TO ANY MATTER INCLUDING, BUT NOT LIMITED TO, WARRANTY OF
+ *  FITNESS FOR PURPOSE OR MERCHANTABILITY, EXCLUSIVITY, OR RESULTS
+ *  OBTAINED FROM USE OF THE MATERIAL. CARNEGIE MELLON UNIVERSITY DOES NOT
+ *  MAKE ANY WARRANTY OF ANY KIND WITH RESPECT TO FREEDOM FROM PATENT,
+ *  TRADEMARK, OR COPYRIGHT INFRINGEMENT.
+ *
+ *  Licensed under a GNU-Lesser GPL 3.0-style license, please see
+ *  LICENSE.txt or contact permission@sei.cmu.edu for full terms.
+ *
+ *  [DISTRIBUTION STATEMENT A] This material has been approved for public
+ *  release and unlimited distribution.  Please see Copyright notice for
+ *  non-US Government use and distribution.
+ *
+ *  This Software includes and/or makes use of Third-Party Software each
+ *  subject to its own license.
+ *
+ *  DM24-1020
+ *  @DISTRIBUTION_STATEMENT_END@
+ *  ------------------------------------------------------------------------
+ */
+
+#define _FIXBUF_SOURCE_
+#include <fixbuf/private.h>
+
+
+/*
+ *  A partitioner spreads the records an application appends across
+ *  several exporters.  Each exporter has its own fBuf and session, and
+ *  therefore its own messages and sequence numbers; every session holds
+ *  the same templates.  The exporter a record goes to is chosen by a hash
+ *  of the values of the key elements in the record, so all records with
+ *  the same key reach the same collector.
+ */
+
+/** Most key elements a partitioner accepts. */
+#define FB_PARTITION_KEY_MAX    32
+
+/**
+ * An element of the partitioning key.
+ */
+typedef struct fbPartitionKey_st {
+    uint32_t    ent;
+    uint16_t    num;
+} fbPartitionKey_t;
+
+/**
+ * Where a key element is in a record described by the internal template.
+ */
+typedef struct fbPartitionField_st {
+    uint16_t    offset;
+    uint16_t    len;
+    /** FALSE if the template lacks the element */
+    gboolean    present;
+    /** TRUE if the field is an fbVarfield_t */
+    gboolean    varlen;
+} fbPartitionField_t;
+
+/**
+ * An exporter of a partitioner.  The fBuf is created when the first
+ * record is appended; until then the session and exporter are held here.
+ */
+typedef struct fbPartitionChild_st {
+    fbSession_t   *session;
+    fbExporter_t  *exporter;
+    fBuf_t        *fbuf;
+} fbPartitionChild_t;
+
+struct fbPartitioner_st {
+    /** Holds the templates given to each new child; never exports. */
+    fbSession_t           *session;
+    fbPartitionChild_t    *children;
+    unsigned int           count;
+    /** TRUE once a record has been appended; no children may be added */
+    gboolean               started;
+    fbPartitionKey_t       key[FB_PARTITION_KEY_MAX];
+    unsigned int           key_count;
+    /** Internal template the fields below were found in */
+    fbTemplate_t          *int_tmpl;
+    /** The key elements in records of int_tmpl, in key order */
+    fbPartitionField_t     fields[FB_PARTITION_KEY_MAX];
+    uint16_t               int_tid;
+    uint16_t               ext_tid;
+    uint32_t               domain;
+    uint32_t               export_time;
+};
+
+
+/**
+ * fbPartitionerFindFields
+ *
+ * Finds the key elements in the internal template `tmpl`, using the
+ * in-memory layout the transcoder uses.  Key elements the template lacks
+ * do not take part in the hash.  The fields are kept in key order so the
+ * hash of a flow does not depend on the order of the template.
+ *
+ */
+static void
+fbPartitionerFindFields(
+    fbPartitioner_t  *part,
+    fbTemplate_t     *tmpl)
+{
+    const fbInfoElement_t *ie;
+    fbPartitionField_t    *field;
+    uint16_t               offset = 0;
+    uint16_t               size;
+    uint16_t               i;
+    unsigned int           k;
+
+    memset(part->fields, 0, sizeof(part->fields));
+
+    for (i = 0; i < tmpl->ie_count; ++i) {
+        ie = tmpl->ie_ary[i];
+        if (ie->len != FB_IE_VARLEN) {
+            size = ie->len;
+        } else if (ie->type == FB_BASIC_LIST) {
+            size = sizeof(fbBasicList_t);
+        } else if (ie->type == FB_SUB_TMPL_LIST) {
+            size = sizeof(fbSubTemplateList_t);
+        } else if (ie->type == FB_SUB_TMPL_MULTI_LIST) {
+            size = sizeof(fbSubTemplateMultiList_t);
+        } else {
+            size = sizeof(fbVarfield_t);
+        }
+
+        for (k = 0; k < part->key_count; ++k) {
+            field = &part->fields[k];
+            if (!field->present && part->key[k].ent == ie->ent
+                && part->key[k].num == ie->num)
+            {
+                field->present = TRUE;
+                field->offset = offset;
+                field->len = size;
+                field->varlen = (ie->len == FB_IE_VARLEN);
+                break;
+            }
+        }
+        offset += size;
+    }
+
+    part->int_tmpl = tmpl;
+}
+
+/**
+ * fbPartitionerHashOctets
+ *
+ * Adds `len` octets at `cp` to the 32-bit FNV-1a hash `h`.
+ *
+ */
+static uint32_t
+fbPartitionerHashOctets(
+    uint32_t        h,
+    const uint8_t  *cp,
+    size_t          len)
+{
+    size_t i;
+
+    for (i = 0; i < len; ++i) {
+        h = (h ^ cp[i]) * 16777619U;
+    }
+    return h;
+}
+
+/**
+ * fbPartitionerHash
+ *
+ * Returns the hash of the observation domain and the key fields of the
+ * record at `recbase`: 32-bit FNV-1a followed by a final mix so the low
+ * bits, which select the child, depend on every input octet.
+ *
+ */
+static uint32_t
+fbPartitionerHash(
+    const fbPartitioner_t  *part,
+    const uint8_t          *recbase,
+    size_t                  recsize)
+{
+    const fbPartitionField_t *field;
+    const fbVarfield_t       *vf;
+    const uint8_t            *cp;
+    size_t                    len;
+    uint32_t                  h;
+    unsigned int              i;
+
+    h = fbPartitionerHashOctets(2166136261U, (const uint8_t *)&part->domain,
+                                sizeof(part->domain));
+
+    for (i = 0; i < part->key_count; ++i) {
+        field = &part->fields[i];
+        if (!field->present
+            || (size_t)field->offset + field->len > recsize)
+        {
+            continue;
+        }
+        if (field->varlen) {
+            vf = (const fbVarfield_t *)(recbase + field->offset);
+            cp = vf->buf;
+            len = vf->len;
+        } else {
+            cp = recbase + field->offset;
+            len = field->len;
+        }
+        if (cp) {
+            h = fbPartitionerHashOctets(h, cp, len);
+        }
+    }
+
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35U;
+    h ^= h >> 16;
+    return h;
+}
+
+/**
+ * fbPartitionerStart
+ *
+ * Creates the fBuf of a child, writes the templates of the session to
+ * it, and selects the partitioner's templates.
+ *
+ */
+static gboolean
+fbPartitionerStart(
+    fbPartitioner_t     *part,
+    fbPartitionChild_t  *child,
+    GError             **err)
+{
+    child->fbuf = fBufAllocForExport(child->session, child->exporter);
+    if (part->export_time) {
+        fBufSetExportTime(child->fbuf, part->export_time);
+    }
+    if (!fbSessionExportTemplates(child->session, err)) {
+        return FALSE;
+    }
+    if (part->int_tid
+        && !fBufSetInternalTemplate(child->fbuf, part->int_tid, err))
+    {
+        return FALSE;
+    }
+    if (part->ext_tid
+        && !fBufSetExportTemplate(child->fbuf, part->ext_tid, err))
+    {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+fbPartitioner_t *
+fbPartitionerAlloc(
+    fbSession_t                *session,
+    const fbInfoElementSpec_t  *key,
+    GError                    **err)
+{
+    fbPartitioner_t       *part;
+    const fbInfoElement_t *ie;
+
+    part = g_slice_new0(fbPartitioner_t);
+
+    for (; key && key->name; ++key) {
+        if (part->key_count == FB_PARTITION_KEY_MAX) {
+            g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_SETUP,
+                        "Partition key has more than %d elements",
+                        FB_PARTITION_KEY_MAX);
+            goto ERROR;
+        }
+        ie = fbInfoModelGetElementByName(fbSessionGetInfoModel(session),
+                                         key->name);
+        if (NULL == ie) {
+            g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_NOELEMENT,
+                        "No such information element %s", key->name);
+            goto ERROR;
+        }
+        if (ie->type == FB_BASIC_LIST || ie->type == FB_SUB_TMPL_LIST
+            || ie->type == FB_SUB_TMPL_MULTI_LIST)
+        {
+            g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_SETUP,
+                        "List element %s cannot be part of a partition key",
+                        key->name);
+            goto ERROR;
+        }
+        part->key[part->key_count].ent = ie->ent;
+        part->key[part->key_count].num = ie->num;
+        ++part->key_count;
+    }
+
+    part->session = fbSessionClone(session);
+    if (!fbSessionCopyExternalTemplates(part->session, session, err)) {
+        fbSessionFree(part->session);
+        goto ERROR;
+    }
+    part->domain = fbSessionGetDomain(session);
+
+    return part;
+
+  ERROR:
+    g_slice_free(fbPartitioner_t, part);
+    return NULL;
+}
+
+void
+fbPartitionerFree(
+    fbPartitioner_t  *part)
+{
+    fbPartitionChild_t *child;
+    unsigned int        i;
+
+    if (NULL == part) {
+        return;
+    }
+    for (i = 0; i < part->count; ++i) {
+        child = &part->children[i];
+        if (child->fbuf) {
+            /* frees the exporter and session as well */
+            fBufFree(child->fbuf);
+        } else {
+            fbExporterFree(child->exporter);
+            fbSessionFree(child->session);
+        }
+    }
+    g_free(part->children);
+    fbSessionFree(part->session);
+    g_slice_free(fbPartitioner_t, part);
+}
+
+gboolean
+fbPartitionerAddExporter(
+    fbPartitioner_t  *part,
+    fbExporter_t     *exporter,
+    GError          **err)
+{
+    fbSession_t *session;
+
+    if (part->started) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_SETUP,
+                    "Cannot add an exporter to a partitioner in use");
+        return FALSE;
+    }
+
+    session = fbSessionClone(part->session);
+    if (!fbSessionCopyExternalTemplates(session, part->session, err)) {
+        fbSessionFree(session);
+        return FALSE;
+    }
+
+    part->children = g_renew(fbPartitionChild_t, part->children,
+                             part->count + 1);
+    part->children[part->count].session = session;
+    part->children[part->count].exporter = exporter;
+    part->children[part->count].fbuf = NULL;
+    ++part->count;
+
+    return TRUE;
+}
+
+unsigned int
+fbPartitionerGetCount(
+    const fbPartitioner_t  *part)
+{
+    return part->count;
+}
+
+uint16_t
+fbPartitionerAddTemplate(
+    fbPartitioner_t  *part,
+    gboolean          internal,
+    uint16_t          tid,
+    fbTemplate_t     *tmpl,
+    GError          **err)
+{
+    unsigned int i;
+
+    /* the first session picks the ID when asked to; the others use it */
+    tid = fbSessionAddTemplate(part->session, internal, tid, tmpl, err);
+    if (0 == tid) {
+        return 0;
+    }
+    for (i = 0; i < part->count; ++i) {
+        if (!fbSessionAddTemplate(part->children[i].session, internal, tid,
+                                  tmpl, err))
+        {
+            return 0;
+        }
+    }
+    if (internal && tid == part->int_tid) {
+        fbPartitionerFindFields(part, tmpl);
+    }
+    return tid;
+}
+
+gboolean
+fbPartitionerRemoveTemplate(
+    fbPartitioner_t  *part,
+    gboolean          internal,
+    uint16_t          tid,
+    GError          **err)
+{
+    unsigned int i;
+
+    if (!fbSessionRemoveTemplate(part->session, internal, tid, err)) {
+        return FALSE;
+    }
+    for (i = 0; i < part->count; ++i) {
+        if (!fbSessionRemoveTemplate(part->children[i].session, internal,
+                                     tid, err))
+        {
+            return FALSE;
+        }
+    }
+    if (internal && tid == part->int_tid) {
+        part->int_tid = 0;
+        part->int_tmpl = NULL;
+    }
+    if (!internal && tid == part->ext_tid) {
+        part->ext_tid = 0;
+    }
+    return TRUE;
+}
+
+gboolean
+fbPartitionerSetDomain(
+    fbPartitioner_t  *part,
+    uint32_t          domain,
+    GError          **err)
+{
+    fbPartitionChild_t *child;
+    gboolean            ok = TRUE;
+    unsigned int        i;
+
+    fbSessionSetDomain(part->session, domain);
+    for (i = 0; i < part->count; ++i) {
+        child = &part->children[i];
+        /* a message belongs to one domain; finish the current one */
+        if (child->fbuf && !fBufEmit(child->fbuf, ok ? err : NULL)) {
+            ok = FALSE;
+        }
+        fbSessionSetDomain(child->session, domain);
+        /* write the templates of the domain it has not written yet */
+        if (child->fbuf
+            && !fbSessionExportTemplatesDelta(child->session,
+                                              ok ? err : NULL))
+        {
+            ok = FALSE;
+        }
+    }
+    part->domain = domain;
+    part->ext_tid = 0;
+    return ok;
+}
+
+void
+fbPartitionerSetExportTime(
+    fbPartitioner_t  *part,
+    uint32_t          extime)
+{
+    unsigned int i;
+
+    for (i = 0; i < part->count; ++i) {
+        if (part->children[i].fbuf) {
+            fBufSetExportTime(part->children[i].fbuf, extime);
+        }
+    }
+    part->export_time = extime;
+}
+
+gboolean
+fbPartitionerSetInternalTemplate(
+    fbPartitioner_t  *part,
+    uint16_t          tid,
+    GError          **err)
+{
+    fbTemplate_t *tmpl;
+    unsigned int  i;
+
+    tmpl = fbSessionGetTemplate(part->session, TRUE, tid, err);
+    if (NULL == tmpl) {
+        return FALSE;
+    }
+    for (i = 0; i < part->count; ++i) {
+        if (part->children[i].fbuf
+            && !fBufSetInternalTemplate(part->children[i].fbuf, tid, err))
+        {
+            return FALSE;
+        }
+    }
+    part->int_tid = tid;
+    if (tmpl != part->int_tmpl) {
+        fbPartitionerFindFields(part, tmpl);
+    }
+    return TRUE;
+}
+
+gboolean
+fbPartitionerSetExportTemplate(
+    fbPartitioner_t  *part,
+    uint16_t          tid,
+    GError          **err)
+{
+    unsigned int i;
+
+    if (NULL == fbSessionGetTemplate(part->session, FALSE, tid, err)) {
+        return FALSE;
+    }
+    for (i = 0; i < part->count; ++i) {
+        if (part->children[i].fbuf
+            && !fBufSetExportTemplate(part->children[i].fbuf, tid, err))
+        {
+            return FALSE;
+        }
+    }
+    part->ext_tid = tid;
+    return TRUE;
+}
+
+gboolean
+fbPartitionerAppend(
+    fbPartitioner_t  *part,
+    uint8_t          *recbase,
+    size_t            recsize,
+    GError          **err)
+{
+    fbPartitionChild_t *child;
+
+    if (0 == part->count) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_SETUP,
+                    "Partitioner has no exporters");
+        return FALSE;
+    }
+    if (NULL == part->int_tmpl) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_TMPL,
+                    "Partitioner has no internal template");
+        return FALSE;
+    }
+
+    part->started = TRUE;
+    child = &part->children[fbPartitionerHash(part, recbase, recsize)
+                            % part->count];
+    if (NULL == child->fbuf && !fbPartitionerStart(part, child, err)) {
+        return FALSE;
+    }
+    return fBufAppend(child->fbuf, recbase, recsize, err);
+}
+
+gboolean
+fbPartitionerEmit(
+    fbPartitioner_t  *part,
+    GError          **err)
+{
+    gboolean     ok = TRUE;
+    unsigned int i;
+
+    /* emit every exporter's message; report the first failure */
+    for (i = 0; i < part->count; ++i) {
+        if (part->children[i].fbuf
+            && !fBufEmit(part->children[i].fbuf, ok ? err : NULL))
+        {
+            ok = FALSE;
+        }
+    }
+    return ok;
+}
@@ -51,6 +51,27 @@
 /** Size of the tmpl_pair_array */
 #define TMPL_PAIR_ARRAY_SIZE    (sizeof(uint16_t) * (1 << 16))
 
+/** Initial capacity of the tmpl_pair_map, as a power of 2 */
+#define TMPL_PAIR_MAP_MIN_BITS  3
+
+/**
+ * Number of template pairs above which the tmpl_pair_map is replaced by
+ * the dense tmpl_pair_array.  At this size the map uses 16 KB.
+ */
+#define TMPL_PAIR_MAP_MAX_PAIRS 2048
+
+/** Size in bytes of a tmpl_pair_map with capacity 2^'bits' */
+#define TMPL_PAIR_MAP_SIZE(bits)  (sizeof(fbTemplatePair_t) << (bits))
+
+/**
+ * An entry in the open-addressed template pair map.  An 'ext_tid' of 0
+ * marks an empty slot.
+ */
+typedef struct fbTemplatePair_st {
+    uint16_t   ext_tid;
+    uint16_t   int_tid;
+} fbTemplatePair_t;
+
 #if HAVE_SPREAD
 /* Lock the mutex on session 's' when spread is active */
 #define FB_SPREAD_MUTEX_LOCK(s)     pthread_mutex_lock(&(s)->ext_ttab_wlock)
@@ -66,11 +87,39 @@
  * members become a FOO[2] array and the `internal` gboolean used by
  * several function is used as the index into those arrays. */
 
+/**
+ * Per-domain record of what has changed since the last export to the
+ * session's current export buffer.  The presence of a record for a domain
+ * means a full export has succeeded in that domain, and
+ * fbSessionExportTemplatesDelta() need only send what is recorded as
+ * changed since.
+ */
+typedef struct fbSessionDelta_st {
+    /**
+     * External templates added or replaced since the last export, whether
+     * or not they were also written when added.  Maps template ID to
+     * template.
+     */
+    GHashTable  *dirty_ttab;
+    /**
+     * External templates removed since the last export.  Maps template ID
+     * to the removed template, to which the table holds a reference.
+     */
+    GHashTable  *withdrawn_ttab;
+    /**
+     * Information elements whose type metadata records have been
+     * exported.  Used as a set.
+     */
+    GHashTable  *sent_ies;
+} fbSessionDelta_t;
+
 struct fbSession_st {
     /** Information model. */
     fbInfoModel_t             *model;
     /**
      * Internal template table. Maps template ID to internal template.
+     * The table holds a reference to each template and may be shared
+     * with the sessions cloned from this one; see 'int_ttab_users'.
      */
     GHashTable                *int_ttab;
     /**
@@ -78,10 +127,17 @@ struct fbSession_st {
      * Maps template ID to external template.
      */
     GHashTable                *ext_ttab;
+    /**
+     * Open-addressed hash table (linear probing) of template pairs,
+     * with capacity 2^'tmpl_pair_bits'.  Used while the session has no
+     * more than TMPL_PAIR_MAP_MAX_PAIRS pairs.
+     */
+    fbTemplatePair_t          *tmpl_pair_map;
     /**
      * Array of size 2^16 where index is external TID and value is
-     * internal TID.  The number if valid entries in the array is
-     * maintained by 'num_tmpl_pairs'.
+     * internal TID.  Replaces 'tmpl_pair_map' once the session has
+     * more than TMPL_PAIR_MAP_MAX_PAIRS pairs.  The number of valid
+     * entries is maintained by 'num_tmpl_pairs'.
      */
     uint16_t                  *tmpl_pair_array;
     /**
@@ -113,6 +169,13 @@ struct fbSession_st {
      * Current observation domain ID.
      */
     uint32_t                   domain;
+    /**
+     * Domain delta export table.  Maps domain to the fbSessionDelta_t
+     * describing what has been exported to the template dynamics
+     * buffer's exporter in that domain.  Emptied when the template
+     * dynamics buffer changes.
+     */
+    GHashTable                *dom_delta;
     /**
      * Last/next sequence number in current observation domain.
      */
@@ -130,10 +193,14 @@ struct fbSession_st {
      */
     GError                    *tdyn_err;
     /**
-     * The number of valid pairs in 'tmpl_pair_array'.  Used to free
-     * the array when it is empty.
+     * The number of valid pairs in 'tmpl_pair_map' or
+     * 'tmpl_pair_array'.  Used to free them when empty.
      */
-    uint16_t                   num_tmpl_pairs;
+    uint32_t                   num_tmpl_pairs;
+    /**
+     * The capacity of 'tmpl_pair_map' as a power of 2.
+     */
+    uint8_t                    tmpl_pair_bits;
     /**
      * The TID to use for exporting enterprise-specific IEs when
      * export_info_element_metadata is true.
@@ -173,17 +240,43 @@ struct fbSession_st {
      */
     gboolean                   export_template_metadata;
     /**
-     * Flag to set when an internal template is added or removed. The flag is
-     * unset when SetInternalTemplate is called. This ensures the internal
-     * template set to the most up-to-date template
+     * Number of sessions referencing 'int_ttab', shared by all of them;
+     * NULL if the table has never been shared.  While it is above 1 the
+     * table must be copied before it is modified.
+     */
+    volatile gint             *int_ttab_users;
+    /**
+     * Generation of the internal template table.  Given a new value from
+     * fbSessionNextGeneration() whenever an internal template is added or
+     * removed.  An fBuf_t caches the generation alongside its internal
+     * template and only repeats the lookup when the two differ.  Sessions
+     * that share 'int_ttab' also share the generation.
+     */
+    uint32_t                   int_generation;
+    /**
+     * Generation of the current external template table.  Given a new value
+     * whenever an external template is added or removed or 'ext_ttab' is
+     * switched to another domain or group.
+     */
+    uint32_t                   ext_generation;
+    /**
+     * Cached encoding of the external templates in 'tmpl_sets_ttab' as
+     * template and options template sets, used for template refresh.
+     */
+    uint8_t                   *tmpl_sets;
+    /**
+     * The length of the encoded sets in 'tmpl_sets'.
+     */
+    size_t                     tmpl_sets_len;
+    /**
+     * The external template table 'tmpl_sets' was built from, or NULL
+     * when the cache is invalid.
      */
-    gboolean                   intTmplTableChanged;
+    GHashTable                *tmpl_sets_ttab;
     /**
-     * Flag to set when an external template is added or removed. The flag is
-     * unset when SetExportTemplate is called. This ensures the external
-     * template set to the most up-to-date template
+     * The maximum set length 'tmpl_sets' was built with.
      */
-    gboolean                   extTmplTableChanged;
+    uint16_t                   tmpl_sets_maxlen;
 
 
 #if HAVE_SPREAD
@@ -247,6 +340,43 @@ fbSessionSpreadAddTemplatesHelper(
     GError       **err);
 #endif  /* HAVE_SPREAD */
 
+static fbSessionDelta_t *
+fbSessionDeltaAlloc(
+    void)
+{
+    fbSessionDelta_t *delta = g_slice_new0(fbSessionDelta_t);
+
+    delta->dirty_ttab = g_hash_table_new(g_direct_hash, g_direct_equal);
+    delta->withdrawn_ttab = g_hash_table_new_full(
+        g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)fbTemplateRelease);
+    delta->sent_ies = g_hash_table_new(g_direct_hash, g_direct_equal);
+    return delta;
+}
+
+static void
+fbSessionDeltaFree(
+    fbSessionDelta_t  *delta)
+{
+    g_hash_table_destroy(delta->dirty_ttab);
+    g_hash_table_destroy(delta->withdrawn_ttab);
+    g_hash_table_destroy(delta->sent_ies);
+    g_slice_free(fbSessionDelta_t, delta);
+}
+
+/**
+ *  Returns a new template table generation number.  Generations come from a
+ *  single process-wide counter so that an fBuf_t moved between sessions by
+ *  fBufSetSession() never mistakes another session's table for its own.
+ */
+static uint32_t
+fbSessionNextGeneration(
+    void)
+{
+    static volatile gint generation = 0;
+
+    return (uint32_t)g_atomic_int_add(&generation, 1) + 1;
+}
+
 fbSession_t *
 fbSessionAlloc(
     fbInfoModel_t  *model)
@@ -260,7 +390,15 @@ fbSessionAlloc(
     session->model = model;
 
     /* Allocate internal template table */
-    session->int_ttab = g_hash_table_new(g_direct_hash, g_direct_equal);
+    session->int_ttab =
+        g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                              NULL, (GDestroyNotify)fbTemplateRelease);
+    session->int_generation = fbSessionNextGeneration();
+
+    /* Allocate delta export table */
+    session->dom_delta =
+        g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                              NULL, (GDestroyNotify)fbSessionDeltaFree);
 
 #if HAVE_SPREAD
     /* this lock is needed only if Spread is enabled */
@@ -270,6 +408,7 @@ fbSessionAlloc(
     /* Reset session externals (will allocate domain template tables, etc.) */
     fbSessionResetExternal(session);
 
+    session->tmpl_pair_map = NULL;
     session->tmpl_pair_array = NULL;
     session->num_tmpl_pairs = 0;
     session->new_template_callback = NULL;
@@ -335,14 +474,16 @@ fbSessionSetMetadataExportElements(
 
 /*
  *  Writes the info element type metadata for all non-standard
- *  elements in the info model to the template dynamics buffer of
- *  'session'.
+ *  elements in the info model that are not in 'sent_ies' to the
+ *  template dynamics buffer of 'session', adding each element written
+ *  to 'sent_ies'.
  *
  *  Does NOT restore the internal and external templates of the fBuf.
  */
 static gboolean
 fbSessionWriteTypeMetadata(
     fbSession_t  *session,
+    GHashTable   *sent_ies,
     GError      **err)
 {
     fbInfoModelIter_t      iter;
@@ -400,6 +541,9 @@ fbSessionWriteTypeMetadata(
         if (ie->ent == 0 || ie->ent == FB_IE_PEN_REVERSE) {
             continue;
         }
+        if (g_hash_table_lookup(sent_ies, ie)) {
+            continue;
+        }
 
         if (!fbInfoElementWriteOptionsRecord(
                 session->tdyn_buf, ie, session->info_element_metadata_tid,
@@ -412,6 +556,7 @@ fbSessionWriteTypeMetadata(
             g_propagate_error(err, child_err);
             return FALSE;
         }
+        g_hash_table_insert(sent_ies, (gpointer)ie, (gpointer)ie);
     }
 
 #if FB_DEBUG_MD
@@ -720,36 +865,141 @@ fbSessionNewTemplateCallbackAppCtx(
     return session->tmpl_app_ctx;
 }
 
+/*
+ *  Returns the slot of 'ext_tid' in the template pair map: the slot
+ *  holding it, or the empty slot where it would be inserted.
+ */
+static fbTemplatePair_t *
+fbSessionPairMapSlot(
+    const fbSession_t  *session,
+    uint16_t            ext_tid)
+{
+    uint32_t mask = (1u << session->tmpl_pair_bits) - 1;
+    uint32_t i;
+
+    /* Fibonacci hashing; the map always has an empty slot */
+    i = ((uint32_t)ext_tid * 2654435769u) >> (32 - session->tmpl_pair_bits);
+    while (session->tmpl_pair_map[i].ext_tid
+           && session->tmpl_pair_map[i].ext_tid != ext_tid)
+    {
+        i = (i + 1) & mask;
+    }
+    return &session->tmpl_pair_map[i];
+}
+
+/*
+ *  Moves the pairs in the template pair map into a new map with
+ *  capacity 2^'bits', or into the dense tmpl_pair_array if 'bits' is 0.
+ */
+static void
+fbSessionPairMapResize(
+    fbSession_t  *session,
+    uint8_t       bits)
+{
+    fbTemplatePair_t *old_map = session->tmpl_pair_map;
+    uint8_t           old_bits = session->tmpl_pair_bits;
+    uint32_t          i;
+
+    if (bits) {
+        session->tmpl_pair_map =
+            (fbTemplatePair_t *)g_slice_alloc0(TMPL_PAIR_MAP_SIZE(bits));
+        session->tmpl_pair_bits = bits;
+        for (i = 0; i < (1u << old_bits); ++i) {
+            if (old_map[i].ext_tid) {
+                *fbSessionPairMapSlot(session, old_map[i].ext_tid) =
+                    old_map[i];
+            }
+        }
+    } else {
+        session->tmpl_pair_array =
+            (uint16_t *)g_slice_alloc0(TMPL_PAIR_ARRAY_SIZE);
+        for (i = 0; i < (1u << old_bits); ++i) {
+            if (old_map[i].ext_tid) {
+                session->tmpl_pair_array[old_map[i].ext_tid] =
+                    old_map[i].int_tid;
+            }
+        }
+        session->tmpl_pair_map = NULL;
+        session->tmpl_pair_bits = 0;
+    }
+    g_slice_free1(TMPL_PAIR_MAP_SIZE(old_bits), old_map);
+}
+
+/*
+ *  Frees the template pair map or array of 'session'.
+ */
+static void
+fbSessionFreeTemplatePairs(
+    fbSession_t  *session)
+{
+    if (session->tmpl_pair_map) {
+        g_slice_free1(TMPL_PAIR_MAP_SIZE(session->tmpl_pair_bits),
+                      session->tmpl_pair_map);
+        session->tmpl_pair_map = NULL;
+        session->tmpl_pair_bits = 0;
+    }
+    if (session->tmpl_pair_array) {
+        g_slice_free1(TMPL_PAIR_ARRAY_SIZE, session->tmpl_pair_array);
+        session->tmpl_pair_array = NULL;
+    }
+    session->num_tmpl_pairs = 0;
+}
+
 void
 fbSessionAddTemplatePair(
     fbSession_t  *session,
     uint16_t      ext_tid,
     uint16_t      int_tid)
 {
-    gboolean madeTable = FALSE;
+    fbTemplatePair_t *slot;
 
-    if (!session->tmpl_pair_array) {
-        session->tmpl_pair_array =
-            (uint16_t *)g_slice_alloc0(TMPL_PAIR_ARRAY_SIZE);
-        madeTable = TRUE;
-    }
-
-    if ((ext_tid == int_tid) || (int_tid == 0)) {
-        session->tmpl_pair_array[ext_tid] = int_tid;
-        session->num_tmpl_pairs++;
+    /* 0 is not a template ID and marks empty slots in the map */
+    if (0 == ext_tid) {
         return;
     }
 
     /* external and internal tids are different */
     /* only add the template pair if the internal template exists */
-    if (fbSessionGetTemplate(session, TRUE, int_tid, NULL)) {
-        session->tmpl_pair_array[ext_tid] = int_tid;
-        session->num_tmpl_pairs++;
-    } else {
-        if (madeTable) {
-            g_slice_free1(TMPL_PAIR_ARRAY_SIZE, session->tmpl_pair_array);
-            session->tmpl_pair_array = NULL;
+    if ((ext_tid != int_tid) && (int_tid != 0)
+        && !fbSessionGetTemplate(session, TRUE, int_tid, NULL))
+    {
+        return;
+    }
+
+    if (session->tmpl_pair_array) {
+        /* a pair with int_tid 0 cannot be told apart from no pair in the
+         * array and is never removed; it keeps the array alive */
+        if (!session->tmpl_pair_array[ext_tid]) {
+            session->num_tmpl_pairs++;
         }
+        session->tmpl_pair_array[ext_tid] = int_tid;
+        return;
+    }
+
+    if (!session->tmpl_pair_map) {
+        session->tmpl_pair_map = (fbTemplatePair_t *)g_slice_alloc0(
+            TMPL_PAIR_MAP_SIZE(TMPL_PAIR_MAP_MIN_BITS));
+        session->tmpl_pair_bits = TMPL_PAIR_MAP_MIN_BITS;
+    }
+
+    slot = fbSessionPairMapSlot(session, ext_tid);
+    if (slot->ext_tid) {
+        /* replace an existing pair */
+        slot->int_tid = int_tid;
+        return;
+    }
+    slot->ext_tid = ext_tid;
+    slot->int_tid = int_tid;
+    session->num_tmpl_pairs++;
+
+    /* keep the load factor at or below one half; switch to the dense
+     * array once the map would be larger than is worthwhile */
+    if (session->num_tmpl_pairs > TMPL_PAIR_MAP_MAX_PAIRS) {
+        fbSessionPairMapResize(session, 0);
+    } else if (session->num_tmpl_pairs * 2
+               > (1u << session->tmpl_pair_bits))
+    {
+        fbSessionPairMapResize(session, session->tmpl_pair_bits + 1);
     }
 }
 
@@ -758,19 +1008,61 @@ fbSessionRemoveTemplatePair(
     fbSession_t  *session,
     uint16_t      ext_tid)
 {
-    if (!session->tmpl_pair_array) {
+    fbTemplatePair_t *slot;
+    uint32_t          mask;
+    uint32_t          i, j, home;
+
+    if (session->tmpl_pair_array) {
+        if (session->tmpl_pair_array[ext_tid]) {
+            session->num_tmpl_pairs--;
+            if (!session->num_tmpl_pairs) {
+                /* this was the last one, free the array */
+                fbSessionFreeTemplatePairs(session);
+                return;
+            }
+            session->tmpl_pair_array[ext_tid] = 0;
+        }
+        return;
+    }
+
+    if (!session->tmpl_pair_map || 0 == ext_tid) {
         return;
     }
 
-    if (session->tmpl_pair_array[ext_tid]) {
-        session->num_tmpl_pairs--;
-        if (!session->num_tmpl_pairs) {
-            /* this was the last one, free the array */
-            g_slice_free1(TMPL_PAIR_ARRAY_SIZE, session->tmpl_pair_array);
-            session->tmpl_pair_array = NULL;
-            return;
+    slot = fbSessionPairMapSlot(session, ext_tid);
+    if (!slot->ext_tid) {
+        return;
+    }
+    session->num_tmpl_pairs--;
+    if (!session->num_tmpl_pairs) {
+        /* this was the last one, free the map */
+        fbSessionFreeTemplatePairs(session);
+        return;
+    }
+
+    /* backward-shift deletion: move later entries of the probe run into
+     * the hole so that lookups never need tombstones */
+    mask = (1u << session->tmpl_pair_bits) - 1;
+    i = slot - session->tmpl_pair_map;
+    j = i;
+    for (;;) {
+        session->tmpl_pair_map[i].ext_tid = 0;
+        session->tmpl_pair_map[i].int_tid = 0;
+        for (;;) {
+            j = (j + 1) & mask;
+            if (!session->tmpl_pair_map[j].ext_tid) {
+                return;
+            }
+            home = (((uint32_t)session->tmpl_pair_map[j].ext_tid
+                     * 2654435769u) >> (32 - session->tmpl_pair_bits));
+            /* leave the entry if its home slot lies cyclically in (i, j] */
+            if (i <= j ? (i < home && home <= j) : (i < home || home <= j)) {
+                continue;
+            }
+            break;
         }
-        session->tmpl_pair_array[ext_tid] = 0;
+        session->tmpl_pair_map[i] = session->tmpl_pair_map[j];
+        i = j;
     }
 }
 
@@ -779,14 +1071,19 @@ fbSessionLookupTemplatePair(
     fbSession_t  *session,
     uint16_t      ext_tid)
 {
+    if (session->tmpl_pair_array) {
+        return session->tmpl_pair_array[ext_tid];
+    }
+
     /* if there are no current pairs, just return ext_tid because that means
      * we should decode the entire external template
      */
-    if (!session->tmpl_pair_array) {
+    if (!session->tmpl_pair_map) {
         return ext_tid;
     }
 
-    return session->tmpl_pair_array[ext_tid];
+    /* an unpaired ext_tid lands on an empty slot whose int_tid is 0 */
+    return fbSessionPairMapSlot(session, ext_tid)->int_tid;
 }
 
 static void
@@ -799,6 +1096,65 @@ fbSessionFreeOneTemplate(
     fbTemplateRelease(tmpl);
 }
 
+static void
+fbSessionRemoveOneTemplateTcplan(
+    void          *vtid __attribute__((unused)),
+    fbTemplate_t  *tmpl,
+    fbSession_t   *session)
+{
+    fBufRemoveTemplateTcplan(session->tdyn_buf, tmpl);
+}
+
+/*
+ *  Drops the reference of 'session' to its internal template table,
+ *  releasing the templates if no other session shares the table.
+ */
+static void
+fbSessionReleaseInternalTemplates(
+    fbSession_t  *session)
+{
+    if (session->int_ttab_users
+        && g_atomic_int_dec_and_test(session->int_ttab_users))
+    {
+        g_free((gpointer)session->int_ttab_users);
+    }
+    session->int_ttab_users = NULL;
+    g_hash_table_unref(session->int_ttab);
+    session->int_ttab = NULL;
+}
+
+/*
+ *  Gives 'session' a private copy of its internal template table if the
+ *  table is shared with another session.  Must be called before
+ *  modifying session->int_ttab.
+ */
+static void
+fbSessionUnshareInternalTemplates(
+    fbSession_t  *session)
+{
+    GHashTable    *ttab;
+    GHashTableIter iter;
+    gpointer       vtid;
+    gpointer       vtmpl;
+
+    /* the table stays in place once every clone has released it */
+    if (!session->int_ttab_users
+        || g_atomic_int_get(session->int_ttab_users) <= 1)
+    {
+        return;
+    }
+
+    ttab = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                 NULL, (GDestroyNotify)fbTemplateRelease);
+    g_hash_table_iter_init(&iter, session->int_ttab);
+    while (g_hash_table_iter_next(&iter, &vtid, &vtmpl)) {
+        g_hash_table_insert(ttab, vtid, vtmpl);
+        fbTemplateRetain((fbTemplate_t *)vtmpl);
+    }
+    fbSessionReleaseInternalTemplates(session);
+    session->int_ttab = ttab;
+}
+
 static void
 fbSessionResetOneDomain(
     void         *vdomain __attribute__((unused)),
@@ -831,6 +1187,16 @@ fbSessionResetExternal(
     FB_SPREAD_MUTEX_LOCK(session);
     session->ext_ttab = NULL;
     FB_SPREAD_MUTEX_UNLOCK(session);
+    session->ext_generation = fbSessionNextGeneration();
+
+    /* Forget what was exported */
+    g_hash_table_remove_all(session->dom_delta);
+
+    /* Drop the encoded template sets */
+    g_free(session->tmpl_sets);
+    session->tmpl_sets = NULL;
+    session->tmpl_sets_len = 0;
+    session->tmpl_sets_ttab = NULL;
 
     /* Clear out the old sequence number table if we have one */
     if (session->dom_seqtab) {
@@ -879,14 +1245,16 @@ fbSessionFree(
     }
     fbSessionResetExternal(session);
     g_hash_table_foreach(session->int_ttab,
-                         (GHFunc)fbSessionFreeOneTemplate, session);
-    g_hash_table_destroy(session->int_ttab);
+                         (GHFunc)fbSessionRemoveOneTemplateTcplan, session);
+    /* releases the templates unless the table is shared with a clone */
+    fbSessionReleaseInternalTemplates(session);
     g_hash_table_destroy(session->dom_ttab);
+    g_hash_table_destroy(session->dom_delta);
     if (session->dom_seqtab) {
         g_hash_table_destroy(session->dom_seqtab);
     }
-    g_slice_free1(TMPL_PAIR_ARRAY_SIZE, session->tmpl_pair_array);
-    session->tmpl_pair_array = NULL;
+    fbSessionFreeTemplatePairs(session);
+    g_free(session->tmpl_sets);
 #if HAVE_SPREAD
     if (session->grp_ttab) {
         g_hash_table_destroy(session->grp_ttab);
@@ -917,6 +1285,7 @@ fbSessionSetDomain(
                             session->ext_ttab);
     }
     FB_SPREAD_MUTEX_UNLOCK(session);
+    session->ext_generation = fbSessionNextGeneration();
 
     /* Stash current sequence number */
     g_hash_table_insert(session->dom_seqtab,
@@ -1043,6 +1412,7 @@ fbSessionSetPrivateGroup(
                             session->ext_ttab);
     }
     FB_SPREAD_MUTEX_UNLOCK(session);
+    session->ext_generation = fbSessionNextGeneration();
 
     g_hash_table_insert(session->grp_seqtab, GUINT_TO_POINTER(session->group),
                         GUINT_TO_POINTER(session->sequence));
@@ -1108,6 +1478,10 @@ fbSessionSpreadAddTemplatesHelper(
         }
     }
 
+    if (internal) {
+        fbSessionUnshareInternalTemplates(session);
+    }
+
     /* Select a template table to add the template to */
     ttab = internal ? session->int_ttab : session->ext_ttab;
 
@@ -1148,6 +1522,7 @@ fbSessionSpreadAddTemplatesHelper(
         }
 
         FB_SPREAD_MUTEX_UNLOCK(session);
+        session->ext_generation = fbSessionNextGeneration();
         g_hash_table_insert(session->grp_seqtab,
                             GUINT_TO_POINTER(session->group),
                             GUINT_TO_POINTER(session->sequence));
@@ -1196,6 +1571,7 @@ fbSessionSpreadAddTemplatesHelper(
     session->ext_ttab = g_hash_table_lookup(session->grp_ttab,
                                             GUINT_TO_POINTER(group_offset));
     FB_SPREAD_MUTEX_UNLOCK(session);
+    session->ext_generation = fbSessionNextGeneration();
 
     g_hash_table_insert(session->grp_seqtab, GUINT_TO_POINTER(session->group),
                         GUINT_TO_POINTER(session->sequence));
@@ -1328,6 +1704,7 @@ fbSessionSetGroup(
         }
 
         FB_SPREAD_MUTEX_UNLOCK(session);
+        session->ext_generation = fbSessionNextGeneration();
     }
 
     g_hash_table_insert(session->grp_seqtab, GUINT_TO_POINTER(session->group),
@@ -1393,6 +1770,10 @@ fbSessionAddTemplateHelper(
     g_assert(tid == FB_TID_AUTO || tid >= FB_TID_MIN_DATA);
     g_assert(err);
 
+    if (internal) {
+        fbSessionUnshareInternalTemplates(session);
+    }
+
     /* Select a template table to add the template to */
     ttab = internal ? session->int_ttab : session->ext_ttab;
 
@@ -1446,6 +1827,16 @@ fbSessionAddTemplateHelper(
 #endif
     g_hash_table_insert(ttab, GUINT_TO_POINTER((unsigned int)tid), tmpl);
 
+    /* Remember the template for the next delta export */
+    if (!internal) {
+        fbSessionDelta_t *delta = (fbSessionDelta_t *)g_hash_table_lookup(
+            session->dom_delta, GUINT_TO_POINTER(session->domain));
+        if (delta) {
+            g_hash_table_insert(delta->dirty_ttab,
+                                GUINT_TO_POINTER((unsigned int)tid), tmpl);
+        }
+    }
+
     if (internal &&
         tmpl->ie_internal_len > session->largestInternalTemplateLength)
     {
@@ -1454,9 +1845,10 @@ fbSessionAddTemplateHelper(
     }
 
     if (internal) {
-        session->intTmplTableChanged = TRUE;
+        session->int_generation = fbSessionNextGeneration();
     } else {
-        session->extTmplTableChanged = TRUE;
+        session->ext_generation = fbSessionNextGeneration();
+        session->tmpl_sets_ttab = NULL;
     }
 
 #if HAVE_SPREAD
@@ -1482,13 +1874,17 @@ fbSessionRemoveTemplate(
     fbTemplate_t *tmpl = NULL;
     gboolean      ok = TRUE;
 
-    /* Select a template table to remove the template from */
-    ttab = internal ? session->int_ttab : session->ext_ttab;
-
     /* Get the template to remove */
     tmpl = fbSessionGetTemplate(session, internal, tid, err);
     if (!tmpl) {return FALSE;}
 
+    if (internal) {
+        fbSessionUnshareInternalTemplates(session);
+    }
+
+    /* Select a template table to remove the template from */
+    ttab = internal ? session->int_ttab : session->ext_ttab;
+
     /* Write template withdrawal to dynamics buffer */
     if (fBufGetExporter(session->tdyn_buf) && !internal) {
         ok = fBufAppendTemplate(session->tdyn_buf, tid, tmpl, TRUE, err);
@@ -1500,12 +1896,31 @@ fbSessionRemoveTemplate(
         FB_SPREAD_MUTEX_LOCK(session);
     }
 #endif
-    g_hash_table_remove(ttab, GUINT_TO_POINTER((unsigned int)tid));
+    if (internal) {
+        /* the reference held by the table is released below */
+        g_hash_table_steal(ttab, GUINT_TO_POINTER((unsigned int)tid));
+    } else {
+        g_hash_table_remove(ttab, GUINT_TO_POINTER((unsigned int)tid));
+    }
+
+    if (!internal) {
+        fbSessionDelta_t *delta = (fbSessionDelta_t *)g_hash_table_lookup(
+            session->dom_delta, GUINT_TO_POINTER(session->domain));
+        if (delta) {
+            /* the next delta export withdraws it */
+            g_hash_table_remove(delta->dirty_ttab,
+                                GUINT_TO_POINTER((unsigned int)tid));
+            fbTemplateRetain(tmpl);
+            g_hash_table_replace(delta->withdrawn_ttab,
+                                 GUINT_TO_POINTER((unsigned int)tid), tmpl);
+        }
+    }
 
     if (internal) {
-        session->intTmplTableChanged = TRUE;
+        session->int_generation = fbSessionNextGeneration();
     } else {
-        session->extTmplTableChanged = TRUE;
+        session->ext_generation = fbSessionNextGeneration();
+        session->tmpl_sets_ttab = NULL;
     }
 
     fbSessionRemoveTemplatePair(session, tid);
@@ -1687,15 +2102,54 @@ fbSessionExportOneTemplate(
     }
 }
 
-gboolean
-fbSessionExportTemplates(
+/**
+ * fbSessionExportOneWithdrawal
+ *
+ * A GHFunc that writes a withdrawal of the template `tmpl` to the session's
+ * template dynamics buffer, keeping the first error in the session.
+ */
+static void
+fbSessionExportOneWithdrawal(
+    void          *vtid,
+    fbTemplate_t  *tmpl,
+    fbSession_t   *session)
+{
+    uint16_t tid = (uint16_t)GPOINTER_TO_UINT(vtid);
+
+    if (fBufGetExporter(session->tdyn_buf) && !session->tdyn_err) {
+        if (!fBufAppendTemplate(session->tdyn_buf, tid, tmpl,
+                                TRUE, &session->tdyn_err))
+        {
+            if (!session->tdyn_err) {
+                g_set_error(&session->tdyn_err, FB_ERROR_DOMAIN, FB_ERROR_IO,
+                            "Unspecified template export error");
+            }
+        }
+    }
+}
+
+/*
+ *  Helper for fbSessionExportTemplates() and
+ *  fbSessionExportTemplatesDelta().
+ *
+ *  When 'delta' is TRUE and a full export has already been done in the
+ *  current domain since the template dynamics buffer was set, exports
+ *  the withdrawals and templates recorded since the last export and the
+ *  element metadata not yet exported.  Otherwise exports everything and,
+ *  if that succeeds, starts a new delta record for the current domain.
+ */
+static gboolean
+fbSessionExportTemplatesHelper(
     fbSession_t  *session,
+    gboolean      delta,
     GError      **err)
 {
-    uint16_t int_tid;
-    uint16_t ext_tid;
-    GError  *child_err = NULL;
-    gboolean ret = TRUE;
+    fbSessionDelta_t *drec;
+    GHashTable       *ttab;
+    uint16_t          int_tid;
+    uint16_t          ext_tid;
+    GError           *child_err = NULL;
+    gboolean          ret = TRUE;
 
     /* require an exporter */
     if (!fBufGetExporter(session->tdyn_buf)) {
@@ -1705,12 +2159,47 @@ fbSessionExportTemplates(
     int_tid = fBufGetInternalTemplate(session->tdyn_buf);
     ext_tid = fBufGetExportTemplate(session->tdyn_buf);
 
+#if HAVE_SPREAD
+    /* the delta records follow domains, not Spread groups */
+    if (session->group) {
+        delta = FALSE;
+    }
+#endif
+
+    drec = (fbSessionDelta_t *)g_hash_table_lookup(
+        session->dom_delta, GUINT_TO_POINTER(session->domain));
+    if (!delta || !drec) {
+        /* a full export fills a new record, kept only if it succeeds */
+        delta = FALSE;
+        drec = fbSessionDeltaAlloc();
+    }
+
+    /* the templates to export */
+    ttab = delta ? drec->dirty_ttab : session->ext_ttab;
+
+    /* withdrawals go first, since a withdrawn ID may be in use again */
+    if (delta && g_hash_table_size(drec->withdrawn_ttab)) {
+        FB_SPREAD_MUTEX_LOCK(session);
+        g_clear_error(&session->tdyn_err);
+        g_hash_table_foreach(drec->withdrawn_ttab,
+                             (GHFunc)fbSessionExportOneWithdrawal, session);
+        FB_SPREAD_MUTEX_UNLOCK(session);
+        if (session->tdyn_err) {
+            g_propagate_error(err, session->tdyn_err);
+            session->tdyn_err = NULL;
+            ret = FALSE;
+            goto END;
+        }
+    }
+
     if (session->export_info_element_metadata) {
 #if FB_DEBUG_MD
         fprintf(stderr, "Exporting info element metadata; template %#x\n",
                 session->info_element_metadata_tid);
 #endif
-        if (!fbSessionExportTemplate(
+        if ((!delta || g_hash_table_lookup(
+                 ttab, GUINT_TO_POINTER(session->info_element_metadata_tid)))
+            && !fbSessionExportTemplate(
                 session, session->info_element_metadata_tid, err))
         {
 #if FB_DEBUG_MD
@@ -1721,7 +2210,7 @@ fbSessionExportTemplates(
             ret = FALSE;
             goto END;
         }
-        if (!fbSessionWriteTypeMetadata(session, err)) {
+        if (!fbSessionWriteTypeMetadata(session, drec->sent_ies, err)) {
             ret = FALSE;
             goto END;
         }
@@ -1732,7 +2221,9 @@ fbSessionExportTemplates(
         fprintf(stderr, "Exporting template metadata; template %#x\n",
                 session->template_metadata_tid);
 #endif
-        if (!fbSessionExportTemplate(
+        if ((!delta || g_hash_table_lookup(
+                 ttab, GUINT_TO_POINTER(session->template_metadata_tid)))
+            && !fbSessionExportTemplate(
                 session, session->template_metadata_tid, err))
         {
 #if FB_DEBUG_MD
@@ -1743,7 +2234,7 @@ fbSessionExportTemplates(
             ret = FALSE;
             goto END;
         }
-        if (session->ext_ttab && fBufGetExporter(session->tdyn_buf)) {
+        if (ttab && fBufGetExporter(session->tdyn_buf)) {
             if (!fBufSetInternalTemplate(session->tdyn_buf,
                                          session->template_metadata_tid,
                                          &child_err))
@@ -1778,7 +2269,7 @@ fbSessionExportTemplates(
                  * fbSessionGetTemplate which will try to acquire lock */
                 g_clear_error(&session->tdyn_err);
                 g_hash_table_foreach(
-                    session->ext_ttab,
+                    ttab,
                     (GHFunc)fbSessionExportOneTemplateMetadataRecord, session);
                 if (session->tdyn_err) {
                     g_propagate_error(&child_err, session->tdyn_err);
@@ -1796,9 +2287,9 @@ fbSessionExportTemplates(
     }
 
     FB_SPREAD_MUTEX_LOCK(session);
-    if (session->ext_ttab) {
+    if (ttab) {
         g_clear_error(&session->tdyn_err);
-        g_hash_table_foreach(session->ext_ttab,
+        g_hash_table_foreach(ttab,
                              (GHFunc)fbSessionExportOneTemplate, session);
         if (session->tdyn_err) {
             g_propagate_error(err, session->tdyn_err);
@@ -1809,6 +2300,24 @@ fbSessionExportTemplates(
     FB_SPREAD_MUTEX_UNLOCK(session);
 
   END:
+    if (delta) {
+        if (ret) {
+            /* everything changed has now been written */
+            g_hash_table_remove_all(drec->withdrawn_ttab);
+            g_hash_table_remove_all(drec->dirty_ttab);
+        }
+    } else if (ret) {
+        /* a full export restarts the delta record and the template
+         * refresh interval */
+        g_hash_table_replace(session->dom_delta,
+                             GUINT_TO_POINTER(session->domain), drec);
+        fbExporterResetTemplateRefresh(fBufGetExporter(session->tdyn_buf));
+    } else {
+        /* an incomplete full export must be repeated */
+        fbSessionDeltaFree(drec);
+        g_hash_table_remove(session->dom_delta,
+                            GUINT_TO_POINTER(session->domain));
+    }
     if (int_tid
         && !fBufSetInternalTemplate(session->tdyn_buf, int_tid, &child_err))
     {
@@ -1830,22 +2339,204 @@ fbSessionExportTemplates(
     return ret;
 }
 
-static void
-fbSessionCloneOneTemplate(
-    void          *vtid,
-    fbTemplate_t  *tmpl,
-    fbSession_t   *session)
+gboolean
+fbSessionExportTemplates(
+    fbSession_t  *session,
+    GError      **err)
 {
-    uint16_t tid = (uint16_t)GPOINTER_TO_UINT(vtid);
-    GError  *err = NULL;
+    return fbSessionExportTemplatesHelper(session, FALSE, err);
+}
 
-    if (!fbSessionAddTemplateHelper(session, TRUE, tid, tmpl, NULL, NULL,
-                                    &err))
+gboolean
+fbSessionExportTemplatesDelta(
+    fbSession_t  *session,
+    GError      **err)
+{
+    return fbSessionExportTemplatesHelper(session, TRUE, err);
+}
+
+gboolean
+fbSessionReplayTemplates(
+    fbSession_t  *session,
+    GError      **err)
+{
+    GHashTableIter iter;
+    gpointer       vdomain;
+    uint32_t      *domains;
+    guint          count = 0;
+    guint          i;
+    uint32_t       domain = session->domain;
+    gboolean       ok = TRUE;
+
+    /* require an exporter */
+    if (!fBufGetExporter(session->tdyn_buf)) {
+        return TRUE;
+    }
+
+    /* nothing has been exported to the new file, so every domain needs
+     * a full export before a delta export may be used again */
+    g_hash_table_remove_all(session->dom_delta);
+
+    /* fbSessionSetDomain() may add to the table, so copy the domains */
+    FB_SPREAD_MUTEX_LOCK(session);
+    domains = g_new(uint32_t, g_hash_table_size(session->dom_ttab));
+    g_hash_table_iter_init(&iter, session->dom_ttab);
+    while (g_hash_table_iter_next(&iter, &vdomain, NULL)) {
+        domains[count++] = GPOINTER_TO_UINT(vdomain);
+    }
+    FB_SPREAD_MUTEX_UNLOCK(session);
+
+    /* each domain's templates go in messages with that domain's header */
+    for (i = 0; i < count && ok; ++i) {
+        fbSessionSetDomain(session, domains[i]);
+        ok = (fbSessionExportTemplatesHelper(session, FALSE, err)
+              && fBufEmit(session->tdyn_buf, err));
+    }
+    g_free(domains);
+
+    fbSessionSetDomain(session, domain);
+    return ok;
+}
+
+/* Writes the 16-bit value 'v' to 'p' in network byte order and advances
+ * 'p' */
+#define FB_SESSION_WRITEINC_U16(p, v)               \
+    {                                               \
+        uint16_t _u16 = g_htons(v);                 \
+        memcpy((p), &_u16, sizeof(uint16_t));       \
+        (p) += sizeof(uint16_t);                    \
+    }
+
+/* Writes the 32-bit value 'v' to 'p' in network byte order and advances
+ * 'p' */
+#define FB_SESSION_WRITEINC_U32(p, v)               \
+    {                                               \
+        uint32_t _u32 = g_htonl(v);                 \
+        memcpy((p), &_u32, sizeof(uint32_t));       \
+        (p) += sizeof(uint32_t);                    \
+    }
+
+/*
+ *  Encodes every template in the current external template table as
+ *  template sets followed by options template sets, starting a new set
+ *  whenever adding a template would make the set longer than 'maxlen'.
+ *  Stores the result in session->tmpl_sets.
+ */
+static gboolean
+fbSessionBuildTemplateSets(
+    fbSession_t  *session,
+    uint16_t      maxlen,
+    GError      **err)
+{
+    GHashTableIter iter;
+    gpointer       vtid;
+    gpointer       vtmpl;
+    fbTemplate_t  *tmpl;
+    uint8_t       *cp;
+    uint8_t       *setbase;
+    size_t         bufsize = 0;
+    uint16_t       setlen;
+    uint16_t       i;
+    int            options;
+
+    g_free(session->tmpl_sets);
+    session->tmpl_sets = NULL;
+    session->tmpl_sets_len = 0;
+    session->tmpl_sets_ttab = NULL;
+
+    if (!session->ext_ttab) {
+        return TRUE;
+    }
+
+    /* Size the buffer for the worst case of one set per template */
+    g_hash_table_iter_init(&iter, session->ext_ttab);
+    while (g_hash_table_iter_next(&iter, &vtid, &vtmpl)) {
+        tmpl = (fbTemplate_t *)vtmpl;
+        if (tmpl->tmpl_len + 4 > maxlen) {
+            g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_EOM,
+                        "Template %#06x too large for template refresh "
+                        "(need %u bytes, %u available)",
+                        GPOINTER_TO_UINT(vtid), tmpl->tmpl_len + 4, maxlen);
+            return FALSE;
+        }
+        bufsize += tmpl->tmpl_len + 4;
+    }
+    session->tmpl_sets = g_malloc(bufsize ? bufsize : 1);
+    cp = session->tmpl_sets;
+
+    for (options = 0; options < 2; ++options) {
+        setbase = NULL;
+        g_hash_table_iter_init(&iter, session->ext_ttab);
+        while (g_hash_table_iter_next(&iter, &vtid, &vtmpl)) {
+            tmpl = (fbTemplate_t *)vtmpl;
+            if ((tmpl->scope_count != 0) != (options != 0)) {
+                continue;
+            }
+
+            /* Close the set if this template does not fit */
+            if (setbase && (cp - setbase) + tmpl->tmpl_len > maxlen) {
+                setlen = g_htons(cp - setbase);
+                memcpy(setbase + 2, &setlen, sizeof(setlen));
+                setbase = NULL;
+            }
+            if (!setbase) {
+                setbase = cp;
+                FB_SESSION_WRITEINC_U16(cp, options ? FB_TID_OTS : FB_TID_TS);
+                FB_SESSION_WRITEINC_U16(cp, 0);
+            }
+
+            FB_SESSION_WRITEINC_U16(cp, GPOINTER_TO_UINT(vtid));
+            FB_SESSION_WRITEINC_U16(cp, tmpl->ie_count);
+            if (tmpl->scope_count) {
+                FB_SESSION_WRITEINC_U16(cp, tmpl->scope_count);
+            }
+            for (i = 0; i < tmpl->ie_count; i++) {
+                if (tmpl->ie_ary[i]->ent) {
+                    FB_SESSION_WRITEINC_U16(
+                        cp, IPFIX_ENTERPRISE_BIT | tmpl->ie_ary[i]->num);
+                    FB_SESSION_WRITEINC_U16(cp, tmpl->ie_ary[i]->len);
+                    FB_SESSION_WRITEINC_U32(cp, tmpl->ie_ary[i]->ent);
+                } else {
+                    FB_SESSION_WRITEINC_U16(cp, tmpl->ie_ary[i]->num);
+                    FB_SESSION_WRITEINC_U16(cp, tmpl->ie_ary[i]->len);
+                }
+            }
+        }
+        if (setbase) {
+            setlen = g_htons(cp - setbase);
+            memcpy(setbase + 2, &setlen, sizeof(setlen));
+        }
+    }
+
+    session->tmpl_sets_len = cp - session->tmpl_sets;
+    session->tmpl_sets_ttab = session->ext_ttab;
+    session->tmpl_sets_maxlen = maxlen;
+
+    return TRUE;
+}
+
+gboolean
+fbSessionGetTemplateSets(
+    fbSession_t     *session,
+    uint16_t         maxlen,
+    const uint8_t  **sets,
+    size_t          *setslen,
+    GError         **err)
+{
+    gboolean ok = TRUE;
+
+    FB_SPREAD_MUTEX_LOCK(session);
+    if (!session->tmpl_sets_ttab
+        || session->tmpl_sets_ttab != session->ext_ttab
+        || session->tmpl_sets_maxlen != maxlen)
     {
-        g_warning("Session clone internal template copy failed: %s",
-                  err->message);
-        g_clear_error(&err);
+        ok = fbSessionBuildTemplateSets(session, maxlen, err);
     }
+    FB_SPREAD_MUTEX_UNLOCK(session);
+
+    *sets = session->tmpl_sets;
+    *setslen = session->tmpl_sets_len;
+    return ok;
 }
 
 fbSession_t *
@@ -1857,9 +2548,21 @@ fbSessionClone(
     /* Create a new session using the information model from the base */
     session = fbSessionAlloc(base->model);
 
-    /* Add each internal template from the base session to the new session */
-    g_hash_table_foreach(base->int_ttab,
-                         (GHFunc)fbSessionCloneOneTemplate, session);
+    /* Share the internal template table of the base; whichever session
+     * modifies the table first makes itself a private copy */
+    if (NULL == base->int_ttab_users) {
+        base->int_ttab_users = g_new(gint, 1);
+        *base->int_ttab_users = 1;
+    }
+    g_atomic_int_inc(base->int_ttab_users);
+    g_hash_table_unref(session->int_ttab);
+    session->int_ttab = g_hash_table_ref(base->int_ttab);
+    session->int_ttab_users = base->int_ttab_users;
+    session->largestInternalTemplate = base->largestInternalTemplate;
+    session->largestInternalTemplateLength =
+        base->largestInternalTemplateLength;
+    session->int_next_tid = base->int_next_tid;
+    session->int_generation = base->int_generation;
 
     /* Need to copy over callbacks because in the UDP case we won't have
      * access to the session until after we call fBufNext and by that
@@ -1874,6 +2577,42 @@ fbSessionClone(
     return session;
 }
 
+gboolean
+fbSessionCopyExternalTemplates(
+    fbSession_t  *session,
+    fbSession_t  *base,
+    GError      **err)
+{
+    GHashTableIter diter;
+    GHashTableIter titer;
+    gpointer       vdomain;
+    gpointer       vttab;
+    gpointer       vtid;
+    gpointer       vtmpl;
+
+    /* the metadata templates are among those copied below */
+    session->export_info_element_metadata = base->export_info_element_metadata;
+    session->info_element_metadata_tid = base->info_element_metadata_tid;
+    session->export_template_metadata = base->export_template_metadata;
+    session->template_metadata_tid = base->template_metadata_tid;
+
+    g_hash_table_iter_init(&diter, base->dom_ttab);
+    while (g_hash_table_iter_next(&diter, &vdomain, &vttab)) {
+        fbSessionSetDomain(session, GPOINTER_TO_UINT(vdomain));
+        g_hash_table_iter_init(&titer, (GHashTable *)vttab);
+        while (g_hash_table_iter_next(&titer, &vtid, &vtmpl)) {
+            if (!fbSessionAddTemplate(session, FALSE, GPOINTER_TO_UINT(vtid),
+                                      (fbTemplate_t *)vtmpl, err))
+            {
+                return FALSE;
+            }
+        }
+    }
+    fbSessionSetDomain(session, base->domain);
+
+    return TRUE;
+}
+
 uint32_t
 fbSessionGetSequence(
     fbSession_t  *session)
@@ -1894,6 +2633,10 @@ fbSessionSetTemplateBuffer(
     fbSession_t  *session,
     fBuf_t       *fbuf)
 {
+    /* nothing has been exported through a new buffer */
+    if (session->tdyn_buf != fbuf) {
+        g_hash_table_remove_all(session->dom_delta);
+    }
     session->tdyn_buf = fbuf;
 }
 
@@ -1904,32 +2647,12 @@ fbSessionGetInfoModel(
     return session->model;
 }
 
-void
-fbSessionClearIntTmplTableFlag(
-    fbSession_t  *session)
-{
-    session->intTmplTableChanged = FALSE;
-}
-
-void
-fbSessionClearExtTmplTableFlag(
-    fbSession_t  *session)
-{
-    session->extTmplTableChanged = FALSE;
-}
-
-int
-fbSessionIntTmplTableFlagIsSet(
-    fbSession_t  *session)
-{
-    return session->intTmplTableChanged;
-}
-
-int
-fbSessionExtTmplTableFlagIsSet(
-    fbSession_t  *session)
+uint32_t
+fbSessionGetTemplateGeneration(
+    fbSession_t  *session,
+    gboolean      internal)
 {
-    return session->extTmplTableChanged;
+    return (internal) ? session->int_generation : session->ext_generation;
 }
 
 void
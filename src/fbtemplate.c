@@ -88,18 +88,19 @@ void
 fbTemplateRetain(
     fbTemplate_t  *tmpl)
 {
-    /* Increment reference count */
-    ++(tmpl->ref_count);
+    /* Increment reference count; atomic since clones of a session, which
+     * share templates, may be used on different threads */
+    g_atomic_int_inc(&tmpl->ref_count);
 }
 
 void
 fbTemplateRelease(
     fbTemplate_t  *tmpl)
 {
-    /* Decrement reference count */
-    --(tmpl->ref_count);
-    /* Free if not referenced */
-    fbTemplateFreeUnused(tmpl);
+    /* Decrement reference count and free if no longer referenced */
+    if (g_atomic_int_add(&tmpl->ref_count, -1) <= 1) {
+        fbTemplateFree(tmpl);
+    }
 }
 
 void
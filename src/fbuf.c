@@ -237,12 +237,30 @@ struct fBuf_st {
     uint16_t          int_tid;
     /** Current external template ID. */
     uint16_t          ext_tid;
+    /**
+     * Session template table generation 'int_tmpl' was looked up in; 0 if
+     * 'int_tmpl' did not come from the internal table.
+     */
+    uint32_t          int_tmpl_gen;
+    /** Session template table generation 'ext_tmpl' was looked up in. */
+    uint32_t          ext_tmpl_gen;
     /** Current special set ID. */
     uint16_t          spec_tid;
     /** Automatic insert flag - tid of options tmpl */
     uint16_t          auto_insert_tid;
     /** Automatic mode flag */
     gboolean          automatic;
+    /**
+     * TRUE while a new file of a rotating exporter is given the templates;
+     * the messages emitted meanwhile do not count toward rotation or
+     * template refresh.
+     */
+    gboolean          replaying;
+    /**
+     * TRUE if the information model is shared with other threads; set by
+     * fBufSetSharedInfoModel().
+     */
+    gboolean          shared_model;
     /** Export time in seconds since 0UTC 1 Jan 1970 */
     uint32_t          extime;
     /** Record counter. */
@@ -274,8 +292,20 @@ struct fBuf_st {
      * Valid only after a call to fBufNextSetHeader() (called by fBufNext()).
      */
     uint8_t          *sep;
-    /** Message buffer. */
-    uint8_t           buf[FB_MSGLEN_MAX + 1];
+    /**
+     * Start of the message storage; the data of msgbuf.  NULL until the
+     * first message is read or written.
+     */
+    uint8_t          *buf;
+    /** Message storage, allocated from pool when it is set. */
+    fbMessageBuffer_t *msgbuf;
+    /** Pool for message storage; NULL to allocate storage on its own. */
+    fbBufferPool_t   *pool;
+    /**
+     * TRUE when msgbuf was set by fBufSetMessageBuffer() and its
+     * messages are read before any from the collector.
+     */
+    gboolean          swapped;
 };
 
 int transcodeCount = 0;
@@ -2812,6 +2842,64 @@ fbTranscode(
  *==================================================================*/
 
 
+/**
+ * fBufPrepareStorage
+ *
+ * Makes sure the message storage of `fbuf` holds at least `needed`
+ * octets and is not referenced by anyone else, replacing it if not, and
+ * points the current position at its start.
+ *
+ */
+static void
+fBufPrepareStorage(
+    fBuf_t  *fbuf,
+    size_t   needed)
+{
+    fbBufferPool_t *pool = NULL;
+
+    /* use the pool unless its buffers are too small */
+    if (fbuf->pool && fbBufferPoolGetBufferSize(fbuf->pool) >= needed) {
+        pool = fbuf->pool;
+    }
+
+    if (fbuf->msgbuf) {
+        if (!fbMessageBufferIsShared(fbuf->msgbuf)
+            && fbMessageBufferGetCapacity(fbuf->msgbuf) >= needed
+            && fbMessageBufferGetPool(fbuf->msgbuf) == pool)
+        {
+            fbuf->cp = fbuf->mep = fbuf->buf;
+            return;
+        }
+        fbMessageBufferUnref(fbuf->msgbuf);
+    }
+
+    if (pool) {
+        fbuf->msgbuf = fbMessageBufferAlloc(pool);
+    } else {
+        fbuf->msgbuf = fbMessageBufferAllocSize(needed);
+    }
+    fbuf->buf = fbMessageBufferGetData(fbuf->msgbuf);
+    fbuf->cp = fbuf->mep = fbuf->buf;
+}
+
+
+/**
+ * fBufReleaseStorage
+ *
+ * Drops the message storage of `fbuf`.
+ *
+ */
+static void
+fBufReleaseStorage(
+    fBuf_t  *fbuf)
+{
+    fbMessageBufferUnref(fbuf->msgbuf);
+    fbuf->msgbuf = NULL;
+    fbuf->buf = NULL;
+    fbuf->swapped = FALSE;
+}
+
+
 /**
  * fBufRewind
  *
@@ -2824,7 +2912,7 @@ void
 fBufRewind(
     fBuf_t  *fbuf)
 {
-    if (fbuf->collector || fbuf->exporter) {
+    if ((fbuf->collector || fbuf->exporter) && !fbuf->swapped) {
         /* Reset the buffer */
         fbuf->cp = fbuf->buf;
     } else {
@@ -2851,6 +2939,13 @@ fBufGetInternalTemplate(
     return fbuf->int_tid;
 }
 
+void
+fBufSetSharedInfoModel(
+    fBuf_t  *fbuf)
+{
+    fbuf->shared_model = TRUE;
+}
+
 
 
 /**
@@ -2869,9 +2964,11 @@ fBufSetInternalTemplate(
 {
     /* Look up new internal template if necessary */
     if (!fbuf->int_tmpl || fbuf->int_tid != int_tid ||
-        fbSessionIntTmplTableFlagIsSet(fbuf->session))
+        fbuf->int_tmpl_gen != fbSessionGetTemplateGeneration(fbuf->session,
+                                                             TRUE))
     {
-        fbSessionClearIntTmplTableFlag(fbuf->session);
+        fbuf->int_tmpl_gen = fbSessionGetTemplateGeneration(fbuf->session,
+                                                            TRUE);
         fbuf->int_tid = int_tid;
         fbuf->int_tmpl = fbSessionGetTemplate(fbuf->session, TRUE, int_tid,
                                               err);
@@ -2997,6 +3094,9 @@ fBufFree(
         fbCollectorFree(fbuf->collector);
     }
 
+    fBufReleaseStorage(fbuf);
+    fbBufferPoolFree(fbuf->pool);
+
     fbSessionFree(fbuf->session);
     g_slice_free(fBuf_t, fbuf);
 }
@@ -3030,7 +3130,8 @@ fBufAppendMessageHeader(
     /* can only append message header if we have an exporter */
     g_assert(fbuf->exporter);
 
-    /* get MTU from exporter */
+    /* get MTU from exporter and make room for a message that size */
+    fBufPrepareStorage(fbuf, fbExporterGetMTU(fbuf->exporter));
     fbuf->mep += fbExporterGetMTU(fbuf->exporter);
     g_assert(FB_REM_MSG(fbuf) > FB_MTU_MIN);
 
@@ -3209,10 +3310,11 @@ fBufSetExportTemplate(
 {
     /* Look up new external template if necessary */
     if (!fbuf->ext_tmpl || fbuf->ext_tid != ext_tid ||
-        fbSessionExtTmplTableFlagIsSet(fbuf->session))
+        fbuf->ext_tmpl_gen != fbSessionGetTemplateGeneration(fbuf->session,
+                                                             FALSE))
     {
-        fbSessionClearExtTmplTableFlag(fbuf->session);
-
+        fbuf->ext_tmpl_gen = fbSessionGetTemplateGeneration(fbuf->session,
+                                                            FALSE);
         fbuf->ext_tid = ext_tid;
         fbuf->ext_tmpl = fbSessionGetTemplate(fbuf->session, FALSE, ext_tid,
                                               err);
@@ -3246,6 +3348,8 @@ fBufSetDecodeSubTemplates(
         return FALSE;
     }
     fbuf->ext_tid = ext_tid;
+    fbuf->ext_tmpl_gen = fbSessionGetTemplateGeneration(fbuf->session, FALSE);
+    fbuf->int_tmpl_gen = fbSessionGetTemplateGeneration(fbuf->session, TRUE);
     if (ext_tid == int_tid) {
         fbuf->int_tid = int_tid;
         fbuf->int_tmpl = fbSessionGetTemplate(fbuf->session, TRUE, int_tid,
@@ -3254,6 +3358,7 @@ fBufSetDecodeSubTemplates(
         if (!fbuf->int_tmpl) {
             g_clear_error(err);
             fbuf->int_tmpl = fbuf->ext_tmpl;
+            fbuf->int_tmpl_gen = 0;
         }
     } else {
         fbuf->int_tmpl = fbSessionGetTemplate(fbuf->session, TRUE, int_tid,
@@ -3279,9 +3384,11 @@ fBufSetEncodeSubTemplates(
         return FALSE;
     }
     fbuf->ext_tid = ext_tid;
+    fbuf->ext_tmpl_gen = fbSessionGetTemplateGeneration(fbuf->session, FALSE);
     if (ext_tid == int_tid) {
         fbuf->int_tid = int_tid;
         fbuf->int_tmpl = fbuf->ext_tmpl;
+        fbuf->int_tmpl_gen = 0;
     } else {
         fbuf->int_tmpl = fbSessionGetTemplate(fbuf->session, TRUE, int_tid,
                                               err);
@@ -3289,6 +3396,8 @@ fBufSetEncodeSubTemplates(
             return FALSE;
         }
         fbuf->int_tid = int_tid;
+        fbuf->int_tmpl_gen = fbSessionGetTemplateGeneration(fbuf->session,
+                                                            TRUE);
     }
 
     return TRUE;
@@ -3301,7 +3410,12 @@ fBufResetExportTemplate(
     uint16_t   ext_tid,
     GError   **err)
 {
-    if (!fbuf->ext_tmpl || fbuf->ext_tid != ext_tid) {
+    if (!fbuf->ext_tmpl || fbuf->ext_tid != ext_tid ||
+        fbuf->ext_tmpl_gen != fbSessionGetTemplateGeneration(fbuf->session,
+                                                             FALSE))
+    {
+        fbuf->ext_tmpl_gen = fbSessionGetTemplateGeneration(fbuf->session,
+                                                            FALSE);
         fbuf->ext_tid = ext_tid;
         fbuf->ext_tmpl = fbSessionGetTemplate(fbuf->session, FALSE, ext_tid,
                                               err);
@@ -3612,6 +3726,107 @@ fBufAppend(
 }
 
 
+/**
+ * fBufEmitTemplateRefresh
+ *
+ * Writes the session's cached template sets to the exporter in as many
+ * messages as needed.  Called at a message boundary, with the buffer
+ * rewound.
+ *
+ */
+static gboolean
+fBufEmitTemplateRefresh(
+    fBuf_t  *fbuf,
+    GError **err)
+{
+    const uint8_t *sets;
+    size_t         setslen;
+    size_t         off = 0;
+    size_t         chunk;
+    uint16_t       maxbody;
+    uint16_t       setlen;
+    uint16_t       msglen;
+
+    maxbody = fbExporterGetMTU(fbuf->exporter) - 16;
+    if (!fbSessionGetTemplateSets(fbuf->session, maxbody, &sets, &setslen,
+                                  err))
+    {
+        return FALSE;
+    }
+
+    while (off < setslen) {
+        /* Pack as many whole sets as fit into one message */
+        chunk = 0;
+        while (off + chunk < setslen) {
+            memcpy(&setlen, sets + off + chunk + 2, sizeof(setlen));
+            setlen = g_ntohs(setlen);
+            if (chunk + setlen > maxbody) {
+                break;
+            }
+            chunk += setlen;
+        }
+
+        fBufAppendMessageHeader(fbuf);
+        memcpy(fbuf->cp, sets + off, chunk);
+        fbuf->cp += chunk;
+
+        msglen = g_htons(fbuf->cp - fbuf->msgbase);
+        memcpy(fbuf->msgbase + 2, &msglen, sizeof(msglen));
+
+#if FB_DEBUG_WR
+        fBufDebugHex("rfsh", fbuf->buf, fbuf->cp - fbuf->msgbase);
+#endif
+
+        if (!fbExportMessageBuffer(fbuf->exporter, fbuf->msgbuf,
+                                   fbuf->cp - fbuf->msgbase, err))
+        {
+            fBufRewind(fbuf);
+            return FALSE;
+        }
+        fBufRewind(fbuf);
+        off += chunk;
+    }
+
+    return TRUE;
+}
+
+/**
+ * fBufEmitReplayTemplates
+ *
+ * Writes the templates of every observation domain of the session, with
+ * their RFC 5610 metadata if enabled, to the new file of a rotating
+ * exporter, each domain in messages of its own.  Looks up the buffer's
+ * current templates again afterward.
+ *
+ */
+static gboolean
+fBufEmitReplayTemplates(
+    fBuf_t  *fbuf,
+    GError **err)
+{
+    uint16_t int_tid = fbuf->int_tid;
+    uint16_t ext_tid = fbuf->ext_tid;
+    GError  *child_err = NULL;
+    gboolean ok;
+
+    fbuf->replaying = TRUE;
+    ok = fbSessionReplayTemplates(fbuf->session, err);
+    fbuf->replaying = FALSE;
+    if (!ok) {
+        /* drop what was gathered of the failed message */
+        fBufRewind(fbuf);
+    }
+
+    if (int_tid && !fBufSetInternalTemplate(fbuf, int_tid, &child_err)) {
+        g_clear_error(&child_err);
+    }
+    if (ext_tid && !fBufSetExportTemplate(fbuf, ext_tid, &child_err)) {
+        g_clear_error(&child_err);
+    }
+    return ok;
+}
+
+
 /**
  * fBufEmit
  *
@@ -3625,6 +3840,8 @@ fBufEmit(
     fBuf_t  *fbuf,
     GError **err)
 {
+    GError  *child_err = NULL;
+    gboolean rotate;
     uint16_t msglen;
 
     /* Short-circuit on no message available */
@@ -3654,8 +3871,8 @@ fBufEmit(
 #endif
 
     /* Hand the message content to the exporter */
-    if (!fbExportMessage(fbuf->exporter, fbuf->buf,
-                         fbuf->cp - fbuf->msgbase, err))
+    if (!fbExportMessageBuffer(fbuf->exporter, fbuf->msgbuf,
+                               fbuf->cp - fbuf->msgbase, err))
     {
         return FALSE;
     }
@@ -3664,9 +3881,36 @@ fBufEmit(
     fbSessionSetSequence(fbuf->session, fbSessionGetSequence(fbuf->session) +
                          fbuf->rc);
 
+    /* Messages of templates for a new file count toward nothing */
+    if (fbuf->replaying) {
+        fBufRewind(fbuf);
+        return TRUE;
+    }
+    rotate = fbExporterRotationDue(fbuf->exporter, fbuf->rc);
+
     /* Rewind message */
     fBufRewind(fbuf);
 
+    /* The message has been exported, so a failure to resend the
+     * templates is reported but does not fail the emit */
+    if (rotate) {
+        /* Start the next file with the templates of every domain */
+        if (!fbExporterRotate(fbuf->exporter, err)) {
+            return FALSE;
+        }
+        if (!fBufEmitReplayTemplates(fbuf, &child_err)) {
+            g_warning("Couldn't write templates to the new file: %s",
+                      child_err->message);
+            g_clear_error(&child_err);
+        }
+    } else if (fbExporterTemplateRefreshDue(fbuf->exporter)
+               && !fBufEmitTemplateRefresh(fbuf, &child_err))
+    {
+        /* Resend the cached templates if the refresh interval elapsed */
+        g_warning("Couldn't resend templates: %s", child_err->message);
+        g_clear_error(&child_err);
+    }
+
     /* All done */
     return TRUE;
 }
@@ -3716,6 +3960,10 @@ fBufSetExporter(
         fbExporterFree(fbuf->exporter);
     }
 
+    if (fbuf->swapped) {
+        fBufReleaseStorage(fbuf);
+    }
+
     fbuf->exporter = exporter;
     fbSessionSetTemplateBuffer(fbuf->session, fbuf);
     fBufRewind(fbuf);
@@ -3817,12 +4065,36 @@ fBufNextMessage(
     /* Rewind the buffer before reading a new message */
     fBufRewind(fbuf);
 
+    if (fbuf->swapped && 0 == fbuf->buflen) {
+        /* done with the messages from fBufSetMessageBuffer() */
+        fBufReleaseStorage(fbuf);
+        fBufRewind(fbuf);
+    }
+
     /* Read next message from the collector */
-    if (fbuf->collector) {
-        msglen = sizeof(fbuf->buf);
-        if (!fbCollectMessage(fbuf->collector, fbuf->buf, &msglen, err)) {
+    if (fbuf->swapped) {
+        if (!fbCollectMessageBuffer(fbuf->cp, fbuf->buflen, &msglen, err)) {
             return FALSE;
         }
+        fbuf->buflen -= msglen;
+    } else if (fbuf->collector) {
+        if (fbCollectorIsMapped(fbuf->collector)) {
+            /* decode the message where it lies in the collector's mapping
+             * of the file instead of copying it into buf */
+            if (!fbCollectMappedMessage(fbuf->collector, &fbuf->cp, &msglen,
+                                        err))
+            {
+                return FALSE;
+            }
+        } else {
+            fBufPrepareStorage(fbuf, (fbuf->pool
+                                      ? fbBufferPoolGetBufferSize(fbuf->pool)
+                                      : FB_MSGLEN_MAX + 1));
+            msglen = fbMessageBufferGetCapacity(fbuf->msgbuf);
+            if (!fbCollectMessage(fbuf->collector, fbuf->buf, &msglen, err)) {
+                return FALSE;
+            }
+        }
     } else {
         if (fbuf->buflen) {
             if (!fbCollectMessageBuffer(fbuf->cp, fbuf->buflen, &msglen, err)) {
@@ -3841,7 +4113,7 @@ fBufNextMessage(
     fbuf->mep = fbuf->cp + msglen;
 
 #if FB_DEBUG_RD
-    fBufDebugHex("read", fbuf->buf, msglen);
+    fBufDebugHex("read", fbuf->cp, msglen);
 #endif
 #if FB_DEBUG_LWR
     fprintf(stderr, "read %lu (%04lx)\n", msglen, msglen);
@@ -3908,6 +4180,10 @@ fBufNextMessage(
                       "(in domain %#010x, expected %#010x, got %#010x)",
                       fbSessionGetDomain(fbuf->session), ex_sequence,
                       mh_sequence);
+            if (fbuf->collector) {
+                fbCollectorNoteSequenceGap(fbuf->collector, ex_sequence,
+                                           mh_sequence);
+            }
         }
         fbSessionSetSequence(fbuf->session, mh_sequence);
     }
@@ -3995,9 +4271,14 @@ fBufNextSetHeader(
                 return FALSE;
             }
             fbuf->spec_tid = set_id;
-        } else if (!fbuf->ext_tmpl || fbuf->ext_tid != set_id) {
+        } else if (!fbuf->ext_tmpl || fbuf->ext_tid != set_id ||
+                   (fbuf->ext_tmpl_gen !=
+                    fbSessionGetTemplateGeneration(fbuf->session, FALSE)))
+        {
             fbuf->spec_tid = 0;
             fbuf->ext_tid = set_id;
+            fbuf->ext_tmpl_gen =
+                fbSessionGetTemplateGeneration(fbuf->session, FALSE);
             fbuf->ext_tmpl = fbSessionGetTemplate(fbuf->session, FALSE,
                                                   set_id, err);
             if (!fbuf->ext_tmpl) {
@@ -4183,6 +4464,12 @@ fBufConsumeInfoElementTypeRecord(
     uint16_t              tid = fbuf->int_tid;
     size_t bufsize;
 
+    if (fbuf->shared_model) {
+        /* the elements were added before the model was shared */
+        fBufSkipCurrentSet(fbuf);
+        return TRUE;
+    }
+
     if (!fBufSetInternalTemplate(fbuf, fbuf->auto_insert_tid, err)) {
         return FALSE;
     }
@@ -4524,12 +4811,106 @@ fBufSetBuffer(
     fbuf->collector = NULL;
     fbuf->exporter = NULL;
 
+    /* messages are read from buf; no storage of our own is needed */
+    fBufReleaseStorage(fbuf);
+
     fbuf->cp = buf;
     fbuf->mep = fbuf->cp;
     fbuf->buflen = buflen;
 }
 
 
+/**
+ * fBufSetBufferPool
+ *
+ *
+ */
+void
+fBufSetBufferPool(
+    fBuf_t          *fbuf,
+    fbBufferPool_t  *pool)
+{
+    if (pool) {
+        fbBufferPoolRef(pool);
+    }
+    fbBufferPoolFree(fbuf->pool);
+    fbuf->pool = pool;
+}
+
+
+/**
+ * fBufSetMessageBuffer
+ *
+ *
+ */
+gboolean
+fBufSetMessageBuffer(
+    fBuf_t             *fbuf,
+    fbMessageBuffer_t  *msgbuf,
+    GError            **err)
+{
+    if (fbuf->exporter) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_SETUP,
+                    "Cannot set a message buffer on an export buffer");
+        return FALSE;
+    }
+    if (0 == fbMessageBufferGetLength(msgbuf)) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_BUFSZ,
+                    "Message buffer is empty");
+        return FALSE;
+    }
+
+    fbMessageBufferRef(msgbuf);
+    fBufReleaseStorage(fbuf);
+
+    fbuf->msgbuf = msgbuf;
+    fbuf->buf = fbMessageBufferGetData(msgbuf);
+    fbuf->buflen = fbMessageBufferGetLength(msgbuf);
+    fbuf->swapped = TRUE;
+    fbuf->mep = fbuf->buf;
+    fBufRewind(fbuf);
+
+    return TRUE;
+}
+
+
+/**
+ * fBufRetainCurrentMessage
+ *
+ *
+ */
+fbMessageBuffer_t *
+fBufRetainCurrentMessage(
+    fBuf_t  *fbuf,
+    GError **err)
+{
+    if (fbuf->exporter) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_SETUP,
+                    "Cannot retain the message of an export buffer");
+        return NULL;
+    }
+    if (NULL == fbuf->msgbase) {
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_EOM,
+                    "No current message to retain");
+        return NULL;
+    }
+    if (NULL == fbuf->msgbuf || fbuf->msgbase < fbuf->buf
+        || fbuf->msgbase >= (fbuf->buf +
+                             fbMessageBufferGetCapacity(fbuf->msgbuf)))
+    {
+        /* the message lies in a mapped file or in the application's
+         * buffer from fBufSetBuffer() */
+        g_set_error(err, FB_ERROR_DOMAIN, FB_ERROR_IMPL,
+                    "Current message is not in a message buffer");
+        return NULL;
+    }
+
+    /* the fBuf sees the extra reference and reads the next message into
+     * fresh storage */
+    return fbMessageBufferRef(fbuf->msgbuf);
+}
+
+
 /**
  * fBufGetCollector
  *